@@ -0,0 +1,127 @@
+/**
+ * @file AdaptiveSchedule.h
+ * @brief Sleep interval which adapts to the rate of change of the climate: it grows while the readings are steady
+ * and falls back to the minimum as soon as a reading jumps. Depends only on the C library, so tools/ can replay
+ * recorded logs with the same code.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+/**
+ * @brief State of the schedule. Valid when zero initialised, so it can be declared with RTC_DATA_ATTR.
+ *
+ */
+struct ScheduleState {
+    uint32_t interval;
+    float temperature;
+    float humidity;
+    float pressure;
+};
+
+/**
+ * @brief Largest change between two samples that still counts as steady.
+ *
+ */
+struct ScheduleTolerance {
+    float temperature = 0.2;
+    float humidity = 1.0;
+    float pressure = 0.3;
+};
+
+/**
+ * @brief A class for choosing the sleep interval after each sample. While temperature (°C), humidity (%) and
+ * pressure (hPa) change less than the tolerance since the previous sample, the interval is doubled up to the
+ * maximum. A larger change or a failed reading (NAN) resets it to the minimum.
+ *
+ * @code
+ * RTC_DATA_ATTR ScheduleState scheduleState;
+ * AdaptiveSchedule schedule(scheduleState, 10, 600);
+ * deepSleepForSeconds(schedule.next(sample.temperature, sample.humidity, sample.pressure));
+ * @endcode
+ */
+class AdaptiveSchedule {
+
+    private:
+        ScheduleState& _state;
+        uint32_t _minSeconds;
+        uint32_t _maxSeconds;
+        ScheduleTolerance _tolerance;
+
+        static bool steady(float value, float previous, float tolerance) {
+            return fabs(value - previous) <= tolerance;
+        }
+
+    public:
+
+        /**
+         * @brief Construct a new AdaptiveSchedule object.
+         *
+         * @param state state, usually declared with RTC_DATA_ATTR
+         * @param minSeconds interval after a change
+         * @param maxSeconds largest interval while the readings are steady
+         * @param tolerance largest steady change per channel
+         */
+        AdaptiveSchedule(ScheduleState& state, uint32_t minSeconds, uint32_t maxSeconds,
+            const ScheduleTolerance& tolerance = ScheduleTolerance()) : _state(state), _tolerance(tolerance) {
+                setLimits(minSeconds, maxSeconds);
+        }
+
+        /**
+         * @brief Changes the range of the interval, e.g. equal limits for a fixed interval.
+         *
+         * @param minSeconds interval after a change
+         * @param maxSeconds largest interval while the readings are steady
+         */
+        void setLimits(uint32_t minSeconds, uint32_t maxSeconds) {
+            _minSeconds = minSeconds > 0 ? minSeconds : 1;
+            _maxSeconds = maxSeconds > _minSeconds ? maxSeconds : _minSeconds;
+        }
+
+        /**
+         * @brief Takes a new sample into account and returns the time until the next one.
+         *
+         * @param temperature temperature in °C
+         * @param humidity humidity in %
+         * @param pressure pressure in hPa
+         * @return uint32_t sleep interval in seconds
+         */
+        uint32_t next(float temperature, float humidity, float pressure) {
+            if(_state.interval > 0
+                && steady(temperature, _state.temperature, _tolerance.temperature)
+                && steady(humidity, _state.humidity, _tolerance.humidity)
+                && steady(pressure, _state.pressure, _tolerance.pressure)) {
+                    _state.interval = _state.interval > _maxSeconds / 2 ? _maxSeconds : _state.interval * 2;
+            } else {
+                _state.interval = _minSeconds;
+            }
+            _state.temperature = temperature;
+            _state.humidity = humidity;
+            _state.pressure = pressure;
+            return _state.interval;
+        }
+
+        /**
+         * @brief Returns the interval chosen by the last call of next().
+         *
+         * @return uint32_t sleep interval in seconds, the minimum before the first sample
+         */
+        uint32_t interval() {
+            return _state.interval > 0 ? _state.interval : _minSeconds;
+        }
+
+        /**
+         * @brief Forgets the previous sample, so the next interval is the minimum.
+         *
+         */
+        void reset() {
+            _state.interval = 0;
+        }
+};
@@ -0,0 +1,343 @@
+/**
+ * @file AwakeProfiler.h
+ * @brief Measures how long each phase of a wakeup takes, keeps rolling min/mean/max over the last windows of cycles
+ * in RTC memory and estimates the battery consumption per day from these numbers.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <HAL.h>
+
+/**
+ * @brief Number of windows the statistics are kept for. A report covers the current and the previous windows, the
+ * oldest window is dropped when a new one starts.
+ */
+#ifndef AWAKE_PROFILE_WINDOWS
+#define AWAKE_PROFILE_WINDOWS 4
+#endif
+
+/**
+ * @brief Phases of a wakeup. PHASE_BOOT is the time from reset to setup(), PHASE_SLEEP the entry into deep sleep
+ * from the end of the work to the call of deepSleep(), PHASE_AWAKE the whole cycle including the boot until deep
+ * sleep is entered.
+ */
+enum AwakePhase {
+    PHASE_BOOT,
+    PHASE_SERIAL,
+    PHASE_SD,
+    PHASE_SENSORS,
+    PHASE_REFERENCE,
+    PHASE_READ,
+    PHASE_LOG,
+    PHASE_SLEEP,
+    PHASE_AWAKE,
+    PHASE_COUNT
+};
+
+/**
+ * @brief Statistics of one phase in a window.
+ *
+ */
+struct PhaseStatistics {
+    uint32_t count;
+    uint32_t minimum;
+    uint32_t maximum;
+    uint64_t sum;
+};
+
+/**
+ * @brief Statistics of all phases in a window of cycles.
+ *
+ */
+struct AwakeWindow {
+    uint32_t cycles;
+    uint32_t sleepSeconds;
+    PhaseStatistics phases[PHASE_COUNT];
+};
+
+/**
+ * @brief Statistics of the last windows. Valid when zero initialised, so it can be declared with RTC_DATA_ATTR.
+ *
+ */
+struct AwakeProfile {
+    uint8_t current;
+    AwakeWindow windows[AWAKE_PROFILE_WINDOWS];
+};
+
+/**
+ * @brief Current consumption used for the energy estimate. The SD card and the radio draw their current in addition
+ * to the awake current; radio and light sleep are only used by the native simulation.
+ *
+ */
+struct EnergyModel {
+    float awakeMilliamps = 45;
+    float sdMilliamps = 25;
+    float sleepMicroamps = 10;
+    float radioMilliamps = 100;
+    float lightSleepMicroamps = 800;
+};
+
+/**
+ * @brief A class for timing the phases of a wakeup with hal::micros64(). The durations are added to the current
+ * window; all getters and the report combine the windows kept in the profile, so the numbers roll over the last
+ * AWAKE_PROFILE_WINDOWS windows instead of starting from zero after every report.
+ *
+ * @code
+ * profiler.start(PHASE_READ);
+ * ClimateReading reading = climate.read();
+ * profiler.stop();
+ * @endcode
+ */
+class AwakeProfiler {
+
+    private:
+        AwakeProfile& _profile;
+        AwakePhase _phase = PHASE_COUNT;
+        uint64_t _phaseStart = 0;
+        uint64_t _cycleStart = 0;
+
+        AwakeWindow& window() {
+            return _profile.windows[_profile.current % AWAKE_PROFILE_WINDOWS];
+        }
+
+    public:
+
+        /**
+         * @brief Returns the name of a phase as used in the diagnostics file.
+         *
+         * @param phase phase
+         * @return const char* name
+         */
+        static const char* name(AwakePhase phase) {
+            static const char* const names[PHASE_COUNT] = {
+                "boot", "serial", "sd", "sensors", "reference", "read", "log", "sleep", "awake"
+            };
+            return names[phase];
+        }
+
+        /**
+         * @brief Construct a new AwakeProfiler object.
+         *
+         * @param profile statistics, usually declared with RTC_DATA_ATTR
+         */
+        AwakeProfiler(AwakeProfile& profile) : _profile(profile) {
+        }
+
+        /**
+         * @brief Records the boot time. Call it at the start of setup().
+         *
+         */
+        void boot() {
+            _cycleStart = 0;
+            record(PHASE_BOOT, hal::micros64());
+        }
+
+        /**
+         * @brief Starts a new cycle without a boot, e.g. at the start of loop().
+         *
+         */
+        void beginCycle() {
+            _cycleStart = hal::micros64();
+        }
+
+        /**
+         * @brief Starts timing a phase.
+         *
+         * @param phase phase
+         */
+        void start(AwakePhase phase) {
+            _phase = phase;
+            _phaseStart = hal::micros64();
+        }
+
+        /**
+         * @brief Stops timing the phase started last.
+         *
+         */
+        void stop() {
+            if(_phase != PHASE_COUNT) {
+                record(_phase, hal::micros64() - _phaseStart);
+                _phase = PHASE_COUNT;
+            }
+        }
+
+        /**
+         * @brief Records the duration of the whole cycle and stops the phase started last, usually PHASE_SLEEP. Call
+         * it right before deepSleep().
+         *
+         * @param sleepSeconds sleep time following this cycle
+         */
+        void endCycle(uint32_t sleepSeconds = 0) {
+            stop();
+            record(PHASE_AWAKE, hal::micros64() - _cycleStart);
+            window().cycles++;
+            window().sleepSeconds += sleepSeconds;
+        }
+
+        /**
+         * @brief Adds a duration to the statistics of a phase.
+         *
+         * @param phase phase
+         * @param micros duration in microseconds
+         */
+        void record(AwakePhase phase, uint64_t micros) {
+            PhaseStatistics& statistics = window().phases[phase];
+            uint32_t duration = micros > UINT32_MAX ? UINT32_MAX : micros;
+            if(statistics.count == 0 || duration < statistics.minimum) {
+                statistics.minimum = duration;
+            }
+            if(duration > statistics.maximum) {
+                statistics.maximum = duration;
+            }
+            statistics.sum += duration;
+            statistics.count++;
+        }
+
+        /**
+         * @brief Returns the statistics of a phase over the windows kept.
+         *
+         * @param phase phase
+         * @return PhaseStatistics statistics
+         */
+        PhaseStatistics statistics(AwakePhase phase) {
+            PhaseStatistics combined = {0, 0, 0, 0};
+            for(uint8_t i = 0; i < AWAKE_PROFILE_WINDOWS; i++) {
+                const PhaseStatistics& statistics = _profile.windows[i].phases[phase];
+                if(statistics.count == 0) {
+                    continue;
+                }
+                if(combined.count == 0 || statistics.minimum < combined.minimum) {
+                    combined.minimum = statistics.minimum;
+                }
+                if(statistics.maximum > combined.maximum) {
+                    combined.maximum = statistics.maximum;
+                }
+                combined.sum += statistics.sum;
+                combined.count += statistics.count;
+            }
+            return combined;
+        }
+
+        /**
+         * @brief Returns the mean duration of a phase over the windows kept.
+         *
+         * @param phase phase
+         * @return float mean in milliseconds
+         */
+        float mean(AwakePhase phase) {
+            PhaseStatistics combined = statistics(phase);
+            return combined.count ? combined.sum / 1000.0 / combined.count : 0;
+        }
+
+        /**
+         * @brief Returns the number of cycles of the current window, e.g. to decide when to report.
+         *
+         * @return uint32_t cycles since nextWindow()
+         */
+        uint32_t cycles() {
+            return window().cycles;
+        }
+
+        /**
+         * @brief Returns the number of cycles of all windows kept.
+         *
+         * @return uint32_t cycles
+         */
+        uint32_t totalCycles() {
+            uint32_t cycles = 0;
+            for(uint8_t i = 0; i < AWAKE_PROFILE_WINDOWS; i++) {
+                cycles += _profile.windows[i].cycles;
+            }
+            return cycles;
+        }
+
+        /**
+         * @brief Returns the mean sleep time passed to endCycle() over the windows kept, e.g. for an adaptive
+         * schedule.
+         *
+         * @return float mean sleep time in seconds
+         */
+        float meanSleepSeconds() {
+            uint64_t sleepSeconds = 0;
+            for(uint8_t i = 0; i < AWAKE_PROFILE_WINDOWS; i++) {
+                sleepSeconds += _profile.windows[i].sleepSeconds;
+            }
+            uint32_t cycles = totalCycles();
+            return cycles ? (float) sleepSeconds / cycles : 0;
+        }
+
+        /**
+         * @brief Estimates the battery consumption per day from the mean duration of a cycle. The SD card phases are
+         * averaged over all cycles, because in deep sleep mode the card is not used in every cycle.
+         *
+         * @param sleepSeconds sleep time between two cycles
+         * @param model current consumption
+         * @return float consumption in mAh per day
+         */
+        float milliampHoursPerDay(float sleepSeconds, const EnergyModel& model = EnergyModel()) {
+            uint32_t cycles = totalCycles();
+            if(cycles == 0) {
+                return 0;
+            }
+            float awake = statistics(PHASE_AWAKE).sum / 1e6 / cycles;
+            float sd = (statistics(PHASE_SD).sum + statistics(PHASE_LOG).sum) / 1e6 / cycles;
+            float charge = awake * model.awakeMilliamps + sd * model.sdMilliamps + sleepSeconds * model.sleepMicroamps / 1000;
+            return charge * (86400 / (awake + sleepSeconds)) / 3600;
+        }
+
+        /**
+         * @brief Appends a diagnostics record with the cycles, mean, min and max of every phase in ms and the
+         * estimated consumption over the windows kept to a csv file on the mounted SD card. The header is written to a
+         * new file.
+         *
+         * @param path file path
+         * @param sleepSeconds sleep time between two cycles
+         * @param model current consumption
+         * @return success/failure of writing
+         */
+        boolean writeReport(const char* path, float sleepSeconds, const EnergyModel& model = EnergyModel()) {
+            boolean exists = hal::storage().exists(path);
+            File file = hal::storage().open(path, FILE_APPEND);
+            if(!file) {
+                return false;
+            }
+            if(!exists) {
+                file.print("time,cycles");
+                for(int phase = 0; phase < PHASE_COUNT; phase++) {
+                    const char* phaseName = name((AwakePhase) phase);
+                    file.printf(",%s_mean,%s_min,%s_max", phaseName, phaseName, phaseName);
+                }
+                file.print(",mAhPerDay\n");
+            }
+            file.printf("%ld,%u", (long) hal::epoch(), (unsigned) totalCycles());
+            for(int phase = 0; phase < PHASE_COUNT; phase++) {
+                PhaseStatistics combined = statistics((AwakePhase) phase);
+                file.printf(",%.3f,%.3f,%.3f", mean((AwakePhase) phase), combined.minimum / 1000.0, combined.maximum / 1000.0);
+            }
+            boolean success = file.printf(",%.3f\n", milliampHoursPerDay(sleepSeconds, model)) > 0;
+            file.close();
+            return success;
+        }
+
+        /**
+         * @brief Starts a new window, e.g. after writing a report. The oldest window is dropped, the others are kept.
+         *
+         */
+        void nextWindow() {
+            _profile.current = (_profile.current + 1) % AWAKE_PROFILE_WINDOWS;
+            memset(&window(), 0, sizeof(AwakeWindow));
+        }
+
+        /**
+         * @brief Drops all windows.
+         *
+         */
+        void reset() {
+            memset(&_profile, 0, sizeof(_profile));
+        }
+};
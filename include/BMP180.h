@@ -0,0 +1,360 @@
+/**
+ * @file BMP180.h
+ * @brief Minimal driver for the BMP085 and BMP180 barometric pressure sensors. In contrast to the Adafruit library,
+ * one temperature and one pressure conversion provide both values, and the I2C transactions are counted.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <HAL.h>
+#include <Barometric.h>
+#include <cmath>
+
+#define BMP180_ADDRESS 0x77
+#define BMP180_CHIP_ID 0x55
+
+#define BMP180_ULTRALOWPOWER 0
+#define BMP180_STANDARD 1
+#define BMP180_HIGHRES 2
+#define BMP180_ULTRAHIGHRES 3
+
+#define BMP180_REGISTER_CALIBRATION 0xAA
+#define BMP180_REGISTER_CHIP_ID 0xD0
+#define BMP180_REGISTER_CONTROL 0xF4
+#define BMP180_REGISTER_DATA 0xF6
+#define BMP180_COMMAND_TEMPERATURE 0x2E
+#define BMP180_COMMAND_PRESSURE 0x34
+
+/**
+ * @brief Calibration coefficients from the EEPROM of the sensor. They never change, so they can be kept in RTC memory
+ * and passed to BMP180::begin() after deep sleep instead of reading the EEPROM again.
+ *
+ */
+struct BMP180Calibration {
+    int16_t ac1, ac2, ac3, b1, b2, mb, mc, md;
+    uint16_t ac4, ac5, ac6;
+};
+
+/**
+ * @brief A class for reading the BMP085 or BMP180 sensor.
+ *
+ */
+class BMP180 {
+
+    private:
+        hal::SensorBus* _bus = &hal::sensorBus();
+        uint8_t _oversampling = BMP180_ULTRAHIGHRES;
+        uint32_t _transactions = 0;
+        int16_t ac1, ac2, ac3, b1, b2, mb, mc, md;
+        uint16_t ac4, ac5, ac6;
+
+        boolean writeRegister(uint8_t reg, uint8_t value) {
+            _transactions++;
+            _bus->beginTransmission(BMP180_ADDRESS);
+            _bus->write(reg);
+            _bus->write(value);
+            return _bus->endTransmission() == 0;
+        }
+
+        boolean readRegisters(uint8_t reg, uint8_t* buffer, uint8_t length) {
+            _transactions += 2;
+            _bus->beginTransmission(BMP180_ADDRESS);
+            _bus->write(reg);
+            if(_bus->endTransmission(false) != 0) {
+                return false;
+            }
+            if(_bus->requestFrom((uint8_t) BMP180_ADDRESS, length) != length) {
+                return false;
+            }
+            for(uint8_t i = 0; i < length; i++) {
+                buffer[i] = _bus->read();
+            }
+            return true;
+        }
+
+        int32_t computeB5(int32_t UT) {
+            int32_t X1 = ((UT - (int32_t) ac6) * (int32_t) ac5) >> 15;
+            int32_t X2 = ((int32_t) mc << 11) / (X1 + (int32_t) md);
+            return X1 + X2;
+        }
+
+    public:
+
+        /**
+         * @brief Checks the chip id and reads the calibration coefficients.
+         *
+         * @param oversampling pressure oversampling, BMP180_ULTRALOWPOWER to BMP180_ULTRAHIGHRES
+         * @param bus I2C bus
+         * @return boolean success of initalisation
+         */
+        boolean begin(uint8_t oversampling = BMP180_ULTRAHIGHRES, hal::SensorBus* bus = &hal::sensorBus()) {
+            _bus = bus;
+            _oversampling = oversampling > BMP180_ULTRAHIGHRES ? BMP180_ULTRAHIGHRES : oversampling;
+            _bus->begin();
+            uint8_t id;
+            if(!readRegisters(BMP180_REGISTER_CHIP_ID, &id, 1) || id != BMP180_CHIP_ID) {
+                return false;
+            }
+            uint8_t c[22];
+            if(!readRegisters(BMP180_REGISTER_CALIBRATION, c, sizeof(c))) {
+                return false;
+            }
+            ac1 = (c[0] << 8) | c[1];
+            ac2 = (c[2] << 8) | c[3];
+            ac3 = (c[4] << 8) | c[5];
+            ac4 = (c[6] << 8) | c[7];
+            ac5 = (c[8] << 8) | c[9];
+            ac6 = (c[10] << 8) | c[11];
+            b1 = (c[12] << 8) | c[13];
+            b2 = (c[14] << 8) | c[15];
+            mb = (c[16] << 8) | c[17];
+            mc = (c[18] << 8) | c[19];
+            md = (c[20] << 8) | c[21];
+            return true;
+        }
+
+        /**
+         * @brief Initialises the driver with calibration coefficients read before, e.g. on a wakeup from deep sleep.
+         * No I2C transaction is needed.
+         *
+         * @param calibration coefficients returned by calibration()
+         * @param oversampling pressure oversampling, BMP180_ULTRALOWPOWER to BMP180_ULTRAHIGHRES
+         * @param bus I2C bus
+         * @return boolean success of initalisation
+         */
+        boolean begin(const BMP180Calibration& calibration, uint8_t oversampling = BMP180_ULTRAHIGHRES, hal::SensorBus* bus = &hal::sensorBus()) {
+            _bus = bus;
+            _oversampling = oversampling > BMP180_ULTRAHIGHRES ? BMP180_ULTRAHIGHRES : oversampling;
+            _bus->begin();
+            ac1 = calibration.ac1;
+            ac2 = calibration.ac2;
+            ac3 = calibration.ac3;
+            ac4 = calibration.ac4;
+            ac5 = calibration.ac5;
+            ac6 = calibration.ac6;
+            b1 = calibration.b1;
+            b2 = calibration.b2;
+            mb = calibration.mb;
+            mc = calibration.mc;
+            md = calibration.md;
+            return true;
+        }
+
+        /**
+         * @brief Returns the calibration coefficients read by begin().
+         *
+         * @return BMP180Calibration coefficients
+         */
+        BMP180Calibration calibration() {
+            BMP180Calibration calibration;
+            calibration.ac1 = ac1;
+            calibration.ac2 = ac2;
+            calibration.ac3 = ac3;
+            calibration.ac4 = ac4;
+            calibration.ac5 = ac5;
+            calibration.ac6 = ac6;
+            calibration.b1 = b1;
+            calibration.b2 = b2;
+            calibration.mb = mb;
+            calibration.mc = mc;
+            calibration.md = md;
+            return calibration;
+        }
+
+        /**
+         * @brief Returns the duration of a pressure conversion for the selected oversampling.
+         *
+         * @return uint32_t conversion time in microseconds
+         */
+        uint32_t pressureConversionMicros() {
+            const uint32_t times[] = {4500, 7500, 13500, 25500};
+            return times[_oversampling];
+        }
+
+        /**
+         * @brief Returns the duration of a temperature conversion.
+         *
+         * @return uint32_t conversion time in microseconds
+         */
+        uint32_t temperatureConversionMicros() {
+            return 4500;
+        }
+
+        /**
+         * @brief Starts a temperature conversion without waiting for it. The result can be read with
+         * readTemperatureResult() after temperatureConversionMicros().
+         *
+         * @return boolean success of starting the conversion
+         */
+        boolean startTemperature() {
+            return writeRegister(BMP180_REGISTER_CONTROL, BMP180_COMMAND_TEMPERATURE);
+        }
+
+        /**
+         * @brief Reads the result of a finished temperature conversion.
+         *
+         * @return int32_t raw temperature
+         */
+        int32_t readTemperatureResult() {
+            uint8_t data[2] = {0, 0};
+            readRegisters(BMP180_REGISTER_DATA, data, 2);
+            return (data[0] << 8) | data[1];
+        }
+
+        /**
+         * @brief Starts a pressure conversion without waiting for it. The result can be read with
+         * readPressureResult() after pressureConversionMicros().
+         *
+         * @return boolean success of starting the conversion
+         */
+        boolean startPressure() {
+            return writeRegister(BMP180_REGISTER_CONTROL, BMP180_COMMAND_PRESSURE + (_oversampling << 6));
+        }
+
+        /**
+         * @brief Reads the result of a finished pressure conversion.
+         *
+         * @return int32_t raw pressure
+         */
+        int32_t readPressureResult() {
+            uint8_t data[3] = {0, 0, 0};
+            readRegisters(BMP180_REGISTER_DATA, data, 3);
+            return (((int32_t) data[0] << 16) | ((int32_t) data[1] << 8) | data[2]) >> (8 - _oversampling);
+        }
+
+        /**
+         * @brief Runs one temperature conversion and returns the uncompensated value.
+         *
+         * @return int32_t raw temperature
+         */
+        int32_t readRawTemperature() {
+            startTemperature();
+            delayMicroseconds(temperatureConversionMicros());
+            return readTemperatureResult();
+        }
+
+        /**
+         * @brief Runs one pressure conversion and returns the uncompensated value.
+         *
+         * @return int32_t raw pressure
+         */
+        int32_t readRawPressure() {
+            startPressure();
+            delayMicroseconds(pressureConversionMicros());
+            return readPressureResult();
+        }
+
+        /**
+         * @brief Calculates the temperature from a raw temperature.
+         *
+         * @param UT raw temperature
+         * @return float temperature in °C
+         */
+        float compensateTemperature(int32_t UT) {
+            return ((computeB5(UT) + 8) >> 4) / 10.0;
+        }
+
+        /**
+         * @brief Calculates the pressure from a raw temperature and a raw pressure as described in the datasheet.
+         *
+         * @param UT raw temperature
+         * @param UP raw pressure
+         * @return int32_t pressure in Pa
+         */
+        int32_t compensatePressure(int32_t UT, int32_t UP) {
+            int32_t B6 = computeB5(UT) - 4000;
+            int32_t X1 = ((int32_t) b2 * ((B6 * B6) >> 12)) >> 11;
+            int32_t X2 = ((int32_t) ac2 * B6) >> 11;
+            int32_t X3 = X1 + X2;
+            int32_t B3 = ((((int32_t) ac1 * 4 + X3) << _oversampling) + 2) / 4;
+            X1 = ((int32_t) ac3 * B6) >> 13;
+            X2 = ((int32_t) b1 * ((B6 * B6) >> 12)) >> 16;
+            X3 = ((X1 + X2) + 2) >> 2;
+            uint32_t B4 = ((uint32_t) ac4 * (uint32_t) (X3 + 32768)) >> 15;
+            uint32_t B7 = ((uint32_t) UP - B3) * (uint32_t) (50000UL >> _oversampling);
+            int32_t p = B7 < 0x80000000 ? (B7 * 2) / B4 : (B7 / B4) * 2;
+            X1 = (p >> 8) * (p >> 8);
+            X1 = (X1 * 3038) >> 16;
+            X2 = (-7357 * p) >> 16;
+            return p + ((X1 + X2 + (int32_t) 3791) >> 4);
+        }
+
+        /**
+         * @brief Reads temperature and pressure with one conversion each.
+         *
+         * @param temperature temperature in °C
+         * @param pressure pressure in Pa
+         */
+        void read(float& temperature, int32_t& pressure) {
+            int32_t UT = readRawTemperature();
+            int32_t UP = readRawPressure();
+            temperature = compensateTemperature(UT);
+            pressure = compensatePressure(UT, UP);
+        }
+
+        /**
+         * @brief Reads the temperature.
+         *
+         * @return float temperature in °C
+         */
+        float readTemperature() {
+            return compensateTemperature(readRawTemperature());
+        }
+
+        /**
+         * @brief Reads the pressure. This needs a temperature and a pressure conversion.
+         *
+         * @return int32_t pressure in Pa
+         */
+        int32_t readPressure() {
+            float temperature;
+            int32_t pressure;
+            read(temperature, pressure);
+            return pressure;
+        }
+
+        /**
+         * @brief Returns the number of I2C transactions since the last reset.
+         *
+         * @return uint32_t number of transactions
+         */
+        uint32_t transactions() {
+            return _transactions;
+        }
+
+        /**
+         * @brief Resets the I2C transaction counter.
+         *
+         */
+        void resetTransactions() {
+            _transactions = 0;
+        }
+
+        /**
+         * @brief Calculates the altitude from a pressure with the international barometric formula, see
+         * Barometric.h.
+         *
+         * @param pressure pressure in Pa
+         * @param sealevelPressure pressure at sealevel in Pa
+         * @return float altitude in m
+         */
+        static float altitude(float pressure, float sealevelPressure = 101325) {
+            return Barometric::altitude(pressure, sealevelPressure);
+        }
+
+        /**
+         * @brief Calculates the pressure at sealevel from a pressure measured at a given altitude, see Barometric.h.
+         *
+         * @param pressure pressure in Pa
+         * @param altitude_meters altitude of the measurement
+         * @return float pressure at sealevel in Pa
+         */
+        static float sealevelPressure(float pressure, float altitude_meters) {
+            return Barometric::sealevelPressure(pressure, altitude_meters);
+        }
+};
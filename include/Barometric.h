@@ -0,0 +1,348 @@
+/**
+ * @file Barometric.h
+ * @brief Fast kernels of the international barometric formula for altitude and sealevel pressure, in float and in
+ * int32 fixed point, for single values and arrays of samples. The powers of the formula are approximated by cubic
+ * Hermite polynomials on 64 intervals, whose coefficients are generated at compile time, so no pow() is called
+ * inside the operating range. It only depends on the C library, so the host tools in tools/ use the same code.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Error against the reference formula with pow() (tools/bench_barometric.cpp), for pressures from 300 to 1100 hPa,
+ * sealevel pressures from 950 to 1050 hPa and altitudes from -500 to 9000 m:
+ * - float: altitude within 1 cm, sealevel pressure within 0.2 Pa, limited by the float precision
+ * - fixed point: altitude within 2 mm, sealevel pressure within 0.6 Pa, mostly the rounding of the result to mm and Pa
+ * Outside of the range of the tables the reference formula is used.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+/**
+ * @brief Number of polynomial pieces of a power table.
+ */
+#define BAROMETRIC_INTERVALS 64
+
+/**
+ * @brief Fraction bits of the fixed point values: Q4.28.
+ */
+#define BAROMETRIC_FIXED_BITS 28
+
+/**
+ * @brief Altitude constant of the barometric formula in m.
+ */
+#define BAROMETRIC_ALTITUDE_SCALE 44330
+
+/**
+ * @brief One polynomial piece y + t * (m + t * (c2 + t * c3)) for t from 0 to 1 over the interval.
+ *
+ * @tparam T float or int32_t in Q4.28
+ */
+template <typename T>
+struct PowerSegment {
+    T y, m, c2, c3;
+};
+
+/**
+ * @brief The polynomial pieces of a table.
+ *
+ * @tparam T float or int32_t in Q4.28
+ */
+template <typename T>
+struct PowerSegments {
+    PowerSegment<T> segments[BAROMETRIC_INTERVALS];
+};
+
+/**
+ * @brief Compile time math for the tables: the C library is not constexpr, so the logarithm and the exponential
+ * function are evaluated as series in double precision. Written as single return functions for C++11.
+ *
+ */
+class BarometricMath {
+
+    private:
+        static constexpr double logSeries(double z2, double power, int k) {
+            return k > 80 ? 0 : power / (2 * k + 1) + logSeries(z2, power * z2, k + 1);
+        }
+
+        static constexpr double expSeries(double y, double term, int k) {
+            return k > 40 ? term : term + expSeries(y, term * y / (k + 1), k + 1);
+        }
+
+        static constexpr double fixed(double value) {
+            return value * (1 << BAROMETRIC_FIXED_BITS) + (value < 0 ? -0.5 : 0.5);
+        }
+
+    public:
+        template <int... I>
+        struct Indices {};
+
+        template <int N, int... I>
+        struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+
+        template <int... I>
+        struct MakeIndices<0, I...> {
+            typedef Indices<I...> type;
+        };
+
+        /**
+         * @brief Natural logarithm for x > 0, from the series of artanh((x - 1) / (x + 1)).
+         */
+        static constexpr double log(double x) {
+            return 2 * logSeries(((x - 1) / (x + 1)) * ((x - 1) / (x + 1)), (x - 1) / (x + 1), 0);
+        }
+
+        /**
+         * @brief Exponential function for small arguments, from its Taylor series.
+         */
+        static constexpr double exp(double y) {
+            return expSeries(y, 1, 0);
+        }
+
+        /**
+         * @brief x to the power of a for x > 0.
+         */
+        static constexpr double power(double x, double a) {
+            return exp(a * log(x));
+        }
+
+        /**
+         * @brief Hermite piece of x^a between x0 and x1, scaled to t from 0 to 1. m0 and m1 are the slopes times the
+         * interval width.
+         */
+        template <typename T>
+        static constexpr PowerSegment<T> segment(double y0, double y1, double m0, double m1, bool isFixed) {
+            return isFixed
+                ? PowerSegment<T>{(T) fixed(y0), (T) fixed(m0), (T) fixed(3 * (y1 - y0) - 2 * m0 - m1), (T) fixed(2 * (y0 - y1) + m0 + m1)}
+                : PowerSegment<T>{(T) y0, (T) m0, (T) (3 * (y1 - y0) - 2 * m0 - m1), (T) (2 * (y0 - y1) + m0 + m1)};
+        }
+
+        template <typename T>
+        static constexpr PowerSegment<T> segment(double x0, double width, double a, bool isFixed) {
+            return segment<T>(power(x0, a), power(x0 + width, a), a * power(x0, a - 1) * width,
+                a * power(x0 + width, a - 1) * width, isFixed);
+        }
+
+        /**
+         * @brief All pieces of x^a from minimum to maximum.
+         */
+        template <typename T, int... I>
+        static constexpr PowerSegments<T> table(Indices<I...>, double a, double minimum, double maximum, bool isFixed) {
+            return PowerSegments<T>{{segment<T>(minimum + I * (maximum - minimum) / BAROMETRIC_INTERVALS,
+                (maximum - minimum) / BAROMETRIC_INTERVALS, a, isFixed)...}};
+        }
+};
+
+/**
+ * @brief Compile time table of x^a for x from minimum to maximum with its float and fixed point evaluation.
+ *
+ * @tparam ExponentMillionths exponent a in millionths
+ * @tparam MinimumSixteenths smallest x in sixteenths
+ * @tparam MaximumSixteenths largest x in sixteenths
+ */
+template <int32_t ExponentMillionths, int32_t MinimumSixteenths, int32_t MaximumSixteenths>
+class PowerTable {
+
+    public:
+        static constexpr PowerSegments<float> floatTable = BarometricMath::table<float>(
+            typename BarometricMath::MakeIndices<BAROMETRIC_INTERVALS>::type(), ExponentMillionths / 1e6,
+            MinimumSixteenths / 16.0, MaximumSixteenths / 16.0, false);
+        static constexpr PowerSegments<int32_t> fixedTable = BarometricMath::table<int32_t>(
+            typename BarometricMath::MakeIndices<BAROMETRIC_INTERVALS>::type(), ExponentMillionths / 1e6,
+            MinimumSixteenths / 16.0, MaximumSixteenths / 16.0, true);
+
+        /**
+         * @brief Returns x^a.
+         *
+         * @param x base
+         * @return float power
+         */
+        static float evaluate(float x) {
+            float position = (x - MinimumSixteenths / 16.0f) * (float) (16.0 * BAROMETRIC_INTERVALS / (MaximumSixteenths - MinimumSixteenths));
+            if(!(position >= 0 && position < BAROMETRIC_INTERVALS)) {
+                return pow(x, ExponentMillionths / 1e6);
+            }
+            int index = (int) position;
+            float t = position - index;
+            const PowerSegment<float>& s = floatTable.segments[index];
+            return s.y + t * (s.m + t * (s.c2 + t * s.c3));
+        }
+
+        /**
+         * @brief Returns x^a in fixed point.
+         *
+         * @param x base in Q4.28
+         * @return int32_t power in Q4.28
+         */
+        static int32_t evaluate(int32_t x) {
+            const int64_t minimum = (int64_t) MinimumSixteenths << (BAROMETRIC_FIXED_BITS - 4);
+            //position in the table in Q.28: intervals per unit of x times the distance to the start
+            int64_t position = ((int64_t) x - minimum) * (16 * BAROMETRIC_INTERVALS) / (MaximumSixteenths - MinimumSixteenths);
+            if(position < 0 || position >= ((int64_t) BAROMETRIC_INTERVALS << BAROMETRIC_FIXED_BITS)) {
+                double value = pow((double) x / (1 << BAROMETRIC_FIXED_BITS), ExponentMillionths / 1e6);
+                return (int32_t) (value * (1 << BAROMETRIC_FIXED_BITS) + 0.5);
+            }
+            int index = (int) (position >> BAROMETRIC_FIXED_BITS);
+            int64_t t = position & ((1 << BAROMETRIC_FIXED_BITS) - 1);
+            const PowerSegment<int32_t>& s = fixedTable.segments[index];
+            int64_t value = s.c3;
+            value = s.c2 + ((value * t) >> BAROMETRIC_FIXED_BITS);
+            value = s.m + ((value * t) >> BAROMETRIC_FIXED_BITS);
+            return (int32_t) (s.y + ((value * t) >> BAROMETRIC_FIXED_BITS));
+        }
+};
+
+template <int32_t ExponentMillionths, int32_t MinimumSixteenths, int32_t MaximumSixteenths>
+constexpr PowerSegments<float> PowerTable<ExponentMillionths, MinimumSixteenths, MaximumSixteenths>::floatTable;
+
+template <int32_t ExponentMillionths, int32_t MinimumSixteenths, int32_t MaximumSixteenths>
+constexpr PowerSegments<int32_t> PowerTable<ExponentMillionths, MinimumSixteenths, MaximumSixteenths>::fixedTable;
+
+/**
+ * @brief Static methods for altitude and sealevel pressure. Pressures are in Pa, altitudes in m; the fixed point
+ * methods take pressures in Pa and altitudes in mm as integers.
+ *
+ */
+class Barometric {
+
+    private:
+        //(p / p0)^0.1903 for p / p0 from 0.25 to 1.25
+        typedef PowerTable<190300, 4, 20> AltitudeTable;
+        //(1 - h / 44330)^5.255 for altitudes from -11 km to 11 km
+        typedef PowerTable<5255000, 12, 20> SealevelTable;
+
+        static const int64_t ONE = (int64_t) 1 << BAROMETRIC_FIXED_BITS;
+
+    public:
+
+        /**
+         * @brief Reference altitude with pow(), as calculated by the Adafruit library.
+         *
+         * @param pressure pressure in Pa
+         * @param sealevelPressure pressure at sealevel in Pa
+         * @return float altitude in m
+         */
+        static float referenceAltitude(float pressure, float sealevelPressure = 101325) {
+            return BAROMETRIC_ALTITUDE_SCALE * (1.0 - pow(pressure / sealevelPressure, 0.1903));
+        }
+
+        /**
+         * @brief Reference sealevel pressure with pow(), as calculated by the Adafruit library.
+         *
+         * @param pressure pressure in Pa
+         * @param altitude altitude of the measurement in m
+         * @return float pressure at sealevel in Pa
+         */
+        static float referenceSealevelPressure(float pressure, float altitude) {
+            return pressure / pow(1.0 - altitude / BAROMETRIC_ALTITUDE_SCALE, 5.255);
+        }
+
+        /**
+         * @brief Calculates the altitude from a pressure.
+         *
+         * @param pressure pressure in Pa
+         * @param sealevelPressure pressure at sealevel in Pa
+         * @return float altitude in m
+         */
+        static float altitude(float pressure, float sealevelPressure = 101325) {
+            return BAROMETRIC_ALTITUDE_SCALE * (1.0f - AltitudeTable::evaluate(pressure / sealevelPressure));
+        }
+
+        /**
+         * @brief Calculates the pressure at sealevel from a pressure measured at an altitude.
+         *
+         * @param pressure pressure in Pa
+         * @param altitude altitude of the measurement in m
+         * @return float pressure at sealevel in Pa
+         */
+        static float sealevelPressure(float pressure, float altitude) {
+            return pressure / SealevelTable::evaluate(1.0f - altitude * (1.0f / BAROMETRIC_ALTITUDE_SCALE));
+        }
+
+        /**
+         * @brief Calculates the altitude from a pressure in fixed point.
+         *
+         * @param pressure pressure in Pa
+         * @param sealevelPressure pressure at sealevel in Pa
+         * @return int32_t altitude in mm
+         */
+        static int32_t altitude(int32_t pressure, int32_t sealevelPressure) {
+            int32_t ratio = (int32_t) (((int64_t) pressure << BAROMETRIC_FIXED_BITS) / sealevelPressure);
+            int64_t scaled = (ONE - AltitudeTable::evaluate(ratio)) * (BAROMETRIC_ALTITUDE_SCALE * 1000LL);
+            return (int32_t) ((scaled + (scaled < 0 ? -ONE / 2 : ONE / 2)) / ONE);
+        }
+
+        /**
+         * @brief Calculates the pressure at sealevel in fixed point.
+         *
+         * @param pressure pressure in Pa
+         * @param altitude altitude of the measurement in mm
+         * @return int32_t pressure at sealevel in Pa
+         */
+        static int32_t sealevelPressure(int32_t pressure, int32_t altitude) {
+            int64_t base = ONE - ((int64_t) altitude << BAROMETRIC_FIXED_BITS) / (BAROMETRIC_ALTITUDE_SCALE * 1000LL);
+            int64_t factor = SealevelTable::evaluate((int32_t) base);
+            return (int32_t) ((((int64_t) pressure << BAROMETRIC_FIXED_BITS) + factor / 2) / factor);
+        }
+
+        /**
+         * @brief Calculates the altitudes of an array of pressures.
+         *
+         * @param pressures pressures in Pa
+         * @param count number of values
+         * @param sealevelPressure pressure at sealevel in Pa
+         * @param altitudes receives the altitudes in m, may be the array of pressures
+         */
+        static void altitudes(const float* pressures, size_t count, float sealevelPressure, float* altitudes) {
+            const float inverse = 1.0f / sealevelPressure;
+            for(size_t i = 0; i < count; i++) {
+                altitudes[i] = BAROMETRIC_ALTITUDE_SCALE * (1.0f - AltitudeTable::evaluate(pressures[i] * inverse));
+            }
+        }
+
+        /**
+         * @brief Calculates the sealevel pressures of arrays of pressures and altitudes.
+         *
+         * @param pressures pressures in Pa
+         * @param altitudes altitudes of the measurements in m
+         * @param count number of values
+         * @param sealevelPressures receives the sealevel pressures in Pa, may be one of the input arrays
+         */
+        static void sealevelPressures(const float* pressures, const float* altitudes, size_t count, float* sealevelPressures) {
+            for(size_t i = 0; i < count; i++) {
+                sealevelPressures[i] = sealevelPressure(pressures[i], altitudes[i]);
+            }
+        }
+
+        /**
+         * @brief Calculates the altitudes of an array of pressures in fixed point.
+         *
+         * @param pressures pressures in Pa
+         * @param count number of values
+         * @param sealevelPressure pressure at sealevel in Pa
+         * @param altitudes receives the altitudes in mm, may be the array of pressures
+         */
+        static void altitudes(const int32_t* pressures, size_t count, int32_t sealevelPressure, int32_t* altitudes) {
+            for(size_t i = 0; i < count; i++) {
+                altitudes[i] = altitude(pressures[i], sealevelPressure);
+            }
+        }
+
+        /**
+         * @brief Calculates the sealevel pressures of arrays of pressures and altitudes in fixed point.
+         *
+         * @param pressures pressures in Pa
+         * @param altitudes altitudes of the measurements in mm
+         * @param count number of values
+         * @param sealevelPressures receives the sealevel pressures in Pa, may be one of the input arrays
+         */
+        static void sealevelPressures(const int32_t* pressures, const int32_t* altitudes, size_t count, int32_t* sealevelPressures) {
+            for(size_t i = 0; i < count; i++) {
+                sealevelPressures[i] = sealevelPressure(pressures[i], altitudes[i]);
+            }
+        }
+};
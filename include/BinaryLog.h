@@ -0,0 +1,234 @@
+/**
+ * @file BinaryLog.h
+ * @brief Compact binary format for climate logs. It only depends on the C library, so the host tools in tools/
+ * use the same code for decoding.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * A file starts with an 8 byte header: the magic "CLOG", the format version, the record size and two reserved bytes.
+ * It is followed by blocks. Every block starts with the sync word 0xB10C, the number of records and the CRC-32 of
+ * the records, followed by the records. All integers are little endian. A corrupt block is skipped by searching
+ * the next sync word, so only the records of this block are lost.
+ *
+ * A record contains the local time as seconds since 1970-01-01 00:00 and fixed point values: centi-degrees,
+ * centi-percent, pressures in Pa and the height in cm. NAN is stored as the smallest value of the type.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <CRC32.h>
+
+#define BINARY_LOG_VERSION 1
+#define BINARY_LOG_HEADER_SIZE 8
+#define BINARY_LOG_BLOCK_SYNC 0xB10C
+#define BINARY_LOG_BLOCK_HEADER_SIZE 8
+#define BINARY_LOG_RECORD_SIZE 20
+
+/**
+ * @brief Maximum number of records in a block written by the logger. 12 records fill 240 bytes, like the payload
+ * of a delta block.
+ */
+#ifndef BINARY_LOG_BLOCK_RECORDS
+#define BINARY_LOG_BLOCK_RECORDS 12
+#endif
+
+/**
+ * @brief One record in fixed point representation.
+ *
+ */
+struct BinaryLogRecord {
+    uint32_t time;
+    int16_t temperature;
+    int16_t humidity;
+    int32_t pressure;
+    int32_t pressureAtSealevel;
+    int32_t height;
+};
+
+/**
+ * @brief Static methods for encoding and decoding binary logs.
+ *
+ */
+class BinaryLog {
+
+    private:
+        static void put16(uint8_t* buffer, uint16_t value) {
+            buffer[0] = value;
+            buffer[1] = value >> 8;
+        }
+
+        static void put32(uint8_t* buffer, uint32_t value) {
+            put16(buffer, value);
+            put16(buffer + 2, value >> 16);
+        }
+
+        static uint16_t get16(const uint8_t* buffer) {
+            return buffer[0] | (buffer[1] << 8);
+        }
+
+        static uint32_t get32(const uint8_t* buffer) {
+            return get16(buffer) | ((uint32_t) get16(buffer + 2) << 16);
+        }
+
+        static int16_t toFixed16(float value, float scale) {
+            if(isnan(value)) {
+                return INT16_MIN;
+            }
+            float scaled = roundf(value * scale);
+            return scaled > INT16_MAX ? INT16_MAX : scaled <= INT16_MIN ? INT16_MIN + 1 : (int16_t) scaled;
+        }
+
+        static int32_t toFixed32(float value, float scale) {
+            return isnan(value) ? INT32_MIN : (int32_t) lroundf(value * scale);
+        }
+
+    public:
+
+        /**
+         * @brief Writes the file header.
+         *
+         * @param buffer buffer of at least BINARY_LOG_HEADER_SIZE bytes
+         * @return size_t size of the header
+         */
+        static size_t writeHeader(uint8_t* buffer) {
+            memcpy(buffer, "CLOG", 4);
+            buffer[4] = BINARY_LOG_VERSION;
+            buffer[5] = BINARY_LOG_RECORD_SIZE;
+            buffer[6] = 0;
+            buffer[7] = 0;
+            return BINARY_LOG_HEADER_SIZE;
+        }
+
+        /**
+         * @brief Checks the file header.
+         *
+         * @param buffer start of the file
+         * @param length length of the buffer
+         * @return bool true if the file is a binary log of a supported version
+         */
+        static bool checkHeader(const uint8_t* buffer, size_t length) {
+            return length >= BINARY_LOG_HEADER_SIZE && memcmp(buffer, "CLOG", 4) == 0
+                && buffer[4] == BINARY_LOG_VERSION && buffer[5] == BINARY_LOG_RECORD_SIZE;
+        }
+
+        /**
+         * @brief Converts the broken down local time to seconds since 1970-01-01 00:00 without applying a time zone.
+         *
+         * @param timeInfo broken down local time
+         * @return uint32_t local time in seconds
+         */
+        static uint32_t localTime(const struct tm& timeInfo) {
+            int32_t year = timeInfo.tm_year + 1900 - (timeInfo.tm_mon < 2);
+            int32_t era = (year >= 0 ? year : year - 399) / 400;
+            uint32_t yearOfEra = year - era * 400;
+            uint32_t month = timeInfo.tm_mon + 1;
+            uint32_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + timeInfo.tm_mday - 1;
+            uint32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+            int32_t days = era * 146097 + (int32_t) dayOfEra - 719468;
+            return days * 86400 + timeInfo.tm_hour * 3600 + timeInfo.tm_min * 60 + timeInfo.tm_sec;
+        }
+
+        /**
+         * @brief Converts measurements to a record.
+         *
+         * @param time local time in seconds, see localTime()
+         * @param temperature temperature in °C
+         * @param humidity humidity in %
+         * @param pressure pressure in hPa
+         * @param pressureAtSealevel pressure at sealevel in hPa
+         * @param height height in m
+         * @return BinaryLogRecord record
+         */
+        static BinaryLogRecord toRecord(uint32_t time, float temperature, float humidity, float pressure, float pressureAtSealevel, float height) {
+            BinaryLogRecord record;
+            record.time = time;
+            record.temperature = toFixed16(temperature, 100);
+            record.humidity = toFixed16(humidity, 100);
+            record.pressure = toFixed32(pressure, 100);
+            record.pressureAtSealevel = toFixed32(pressureAtSealevel, 100);
+            record.height = toFixed32(height, 100);
+            return record;
+        }
+
+        /**
+         * @brief Converts a record back to the units of the csv log.
+         *
+         * @param record record
+         * @param values temperature, humidity, pressure, pressureAtSealevel and height
+         */
+        static void toValues(const BinaryLogRecord& record, float values[5]) {
+            values[0] = record.temperature == INT16_MIN ? NAN : record.temperature / 100.0f;
+            values[1] = record.humidity == INT16_MIN ? NAN : record.humidity / 100.0f;
+            values[2] = record.pressure == INT32_MIN ? NAN : record.pressure / 100.0f;
+            values[3] = record.pressureAtSealevel == INT32_MIN ? NAN : record.pressureAtSealevel / 100.0f;
+            values[4] = record.height == INT32_MIN ? NAN : record.height / 100.0f;
+        }
+
+        /**
+         * @brief Encodes records as one block.
+         *
+         * @param records records
+         * @param count number of records
+         * @param buffer buffer of at least BINARY_LOG_BLOCK_HEADER_SIZE + count * BINARY_LOG_RECORD_SIZE bytes
+         * @return size_t size of the block
+         */
+        static size_t encodeBlock(const BinaryLogRecord* records, uint16_t count, uint8_t* buffer) {
+            uint8_t* data = buffer + BINARY_LOG_BLOCK_HEADER_SIZE;
+            for(uint16_t i = 0; i < count; i++) {
+                uint8_t* r = data + i * BINARY_LOG_RECORD_SIZE;
+                put32(r, records[i].time);
+                put16(r + 4, records[i].temperature);
+                put16(r + 6, records[i].humidity);
+                put32(r + 8, records[i].pressure);
+                put32(r + 12, records[i].pressureAtSealevel);
+                put32(r + 16, records[i].height);
+            }
+            size_t length = count * BINARY_LOG_RECORD_SIZE;
+            put16(buffer, BINARY_LOG_BLOCK_SYNC);
+            put16(buffer + 2, count);
+            put32(buffer + 4, crc32(data, length));
+            return BINARY_LOG_BLOCK_HEADER_SIZE + length;
+        }
+
+        /**
+         * @brief Decodes one block.
+         *
+         * @param buffer start of the block
+         * @param length available bytes
+         * @param records output records, maxCount entries
+         * @param maxCount capacity of records
+         * @param count number of decoded records
+         * @return size_t size of the block, 0 if there is no valid block at the start of the buffer
+         */
+        static size_t decodeBlock(const uint8_t* buffer, size_t length, BinaryLogRecord* records, uint16_t maxCount, uint16_t& count) {
+            count = 0;
+            if(length < BINARY_LOG_BLOCK_HEADER_SIZE || get16(buffer) != BINARY_LOG_BLOCK_SYNC) {
+                return 0;
+            }
+            uint16_t blockCount = get16(buffer + 2);
+            size_t size = BINARY_LOG_BLOCK_HEADER_SIZE + blockCount * BINARY_LOG_RECORD_SIZE;
+            const uint8_t* data = buffer + BINARY_LOG_BLOCK_HEADER_SIZE;
+            if(blockCount == 0 || blockCount > maxCount || size > length
+                || crc32(data, blockCount * BINARY_LOG_RECORD_SIZE) != get32(buffer + 4)) {
+                return 0;
+            }
+            for(uint16_t i = 0; i < blockCount; i++) {
+                const uint8_t* r = data + i * BINARY_LOG_RECORD_SIZE;
+                records[i].time = get32(r);
+                records[i].temperature = get16(r + 4);
+                records[i].humidity = get16(r + 6);
+                records[i].pressure = get32(r + 8);
+                records[i].pressureAtSealevel = get32(r + 12);
+                records[i].height = get32(r + 16);
+            }
+            count = blockCount;
+            return size;
+        }
+};
@@ -0,0 +1,37 @@
+/**
+ * @file CRC32.h
+ * @brief CRC-32 (IEEE 802.3, as used by zip and PNG) with a 16 entry table, small enough for the ESP32 and usable
+ * by the host tools.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Calculates the CRC-32 of a buffer. Longer data can be processed in pieces by passing the previous result.
+ *
+ * @param data data
+ * @param length length of data in bytes
+ * @param crc result of the previous piece, 0 for the first one
+ * @return uint32_t checksum
+ */
+inline uint32_t crc32(const uint8_t* data, size_t length, uint32_t crc = 0) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    crc = ~crc;
+    while(length--) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file ChangeFilter.h
+ * @brief Change-only logging: a sample is only logged if a channel moved beyond its deadband since the last logged
+ * sample or a heartbeat interval has passed. The log then is a step-wise time series, which tools/expand_log.cpp
+ * turns back into fixed-rate rows.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <HAL.h>
+#include <SampleBuffer.h>
+
+/**
+ * @brief Largest change of a channel since the last logged sample that is not logged. Values are compared at the
+ * logged precision of two decimals, so 0 suppresses exact repeats only.
+ *
+ */
+struct ChangeDeadband {
+    float temperature = 0;
+    float humidity = 0;
+    float pressure = 0;
+    float pressureAtSealevel = 0;
+    float height = 0;
+};
+
+/**
+ * @brief Last logged sample and counters. Valid when zero initialised, so it can be declared with RTC_DATA_ATTR.
+ *
+ */
+struct ChangeState {
+    int64_t time;
+    float values[5];
+    uint32_t samples;
+    uint32_t suppressed;
+};
+
+/**
+ * @brief A class for deciding which samples are logged.
+ *
+ * @code
+ * RTC_DATA_ATTR ChangeState changeState;
+ * ChangeFilter changeFilter(changeState, deadband, 3600);
+ * if(changeFilter.keep(sample)) {
+ *     batch.add(sample);
+ * }
+ * @endcode
+ */
+class ChangeFilter {
+
+    private:
+        ChangeState& _state;
+        float _deadband[5];
+        uint32_t _heartbeatSeconds;
+
+        static boolean moved(float value, float last, float deadband) {
+            if(isnan(value) || isnan(last)) {
+                return isnan(value) != isnan(last);
+            }
+            return fabs(roundf(value * 100) - roundf(last * 100)) > roundf(deadband * 100);
+        }
+
+    public:
+
+        /**
+         * @brief Construct a new ChangeFilter object.
+         *
+         * @param state last logged sample, usually in RTC memory
+         * @param deadband deadband of every channel
+         * @param heartbeatSeconds maximum time between two logged samples, 0 for no heartbeat
+         */
+        ChangeFilter(ChangeState& state, const ChangeDeadband& deadband = ChangeDeadband(), uint32_t heartbeatSeconds = 3600)
+            : _state(state) {
+                _deadband[0] = deadband.temperature;
+                _deadband[1] = deadband.humidity;
+                _deadband[2] = deadband.pressure;
+                _deadband[3] = deadband.pressureAtSealevel;
+                _deadband[4] = deadband.height;
+                _heartbeatSeconds = heartbeatSeconds;
+        }
+
+        /**
+         * @brief Decides if a sample is logged. A kept sample becomes the reference for the next ones.
+         *
+         * @param sample sample
+         * @return boolean true if the sample has to be logged
+         */
+        boolean keep(const ClimateSample& sample) {
+            const float values[5] = {
+                sample.temperature, sample.humidity, sample.pressure, sample.pressureAtSealevel, sample.height
+            };
+            _state.samples++;
+            boolean due = _state.time == 0 || (_heartbeatSeconds > 0 && sample.time - _state.time >= (int64_t) _heartbeatSeconds);
+            for(uint8_t i = 0; i < 5 && !due; i++) {
+                due = moved(values[i], _state.values[i], _deadband[i]);
+            }
+            if(!due) {
+                _state.suppressed++;
+                return false;
+            }
+            _state.time = sample.time;
+            memcpy(_state.values, values, sizeof(values));
+            return true;
+        }
+
+        /**
+         * @brief Returns the number of samples passed to keep().
+         *
+         * @return uint32_t number of samples
+         */
+        uint32_t samples() {
+            return _state.samples;
+        }
+
+        /**
+         * @brief Returns the number of samples which were not logged.
+         *
+         * @return uint32_t number of samples
+         */
+        uint32_t suppressed() {
+            return _state.suppressed;
+        }
+};
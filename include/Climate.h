@@ -9,11 +9,23 @@
  * 
  */
 
+#pragma once
+
 #include <cmath>
-#include <Adafruit_HTU21DF.h>
-#include <Adafruit_BMP085.h>
+#include <HAL.h>
+#include <ClimateMeasurement.h>
 #include <SDCard.h>
-#include <WiFi.h>
+#include <SDLogWriter.h>
+#include <SampleBuffer.h>
+#include <BinaryLog.h>
+#include <DeltaLog.h>
+#include <WakeCache.h>
+#include <TextFormat.h>
+#include <LogIndex.h>
+#include <LogJournal.h>
+#include <LogRotation.h>
+#include <ClimateAggregate.h>
+#include <TimeSync.h>
 #include <time.h>
 
 /**
@@ -54,21 +66,22 @@ class ClimateTimeStamp {
         }
 
         /**
-         * @brief Sets the real time clock;
+         * @brief Sets the real time clock over WiFi and NTP. The attempt ends after the timeouts of TimeSyncPolicy
+         * (TimeSync.h), so a missing access point does not keep the radio on.
          * 
+         * @return boolean true if the time was set
          */
-        void setRealTimeClock() {
-            Serial.begin(115200);
+        boolean setRealTimeClock() {
             Serial.print("Setting Real Time Clock (RTC)");
-            WiFi.begin(_ssid, _password);
-            while(WiFi.status() != WL_CONNECTED) {
-                Serial.print(".");
-                delay(500);
-            };
-            configTime(_gmtOffset_sec, _daylightOffset_sec, _ntpServer);
+            TimeSyncState state = {};
+            hal::TimeNetwork network;
+            TimeSync<> sync(state, network, _ssid, _password, _ntpServer, _gmtOffset_sec, _daylightOffset_sec);
+            if(sync.run() != TIME_SYNC_DONE) {
+                Serial.println("\nRTC not set, time server not reached");
+                return false;
+            }
             Serial.println("\nRTC initalised");
-            getTimeStamp();
-            WiFi.mode(WIFI_OFF);
+            return true;
         }
 
         /**
@@ -81,19 +94,44 @@ class ClimateTimeStamp {
             if(!getLocalTime(&timeInfo)){
                 return "Failed to obtain time";
             }
-            String timeString = "";
-            timeString.concat(timeInfo.tm_mday);
-            timeString.concat(".");
-            timeString.concat(timeInfo.tm_mon + 1);
-            timeString.concat(".");
-            timeString.concat(timeInfo.tm_year + 1900);
-            timeString.concat(" ");
-            timeString.concat(timeInfo.tm_hour);
-            timeString.concat(":");
-            timeString.concat(timeInfo.tm_min);
-            timeString.concat(":");
-            timeString.concat(timeInfo.tm_sec);
-            return timeString;
+            return formatTimeStamp(timeInfo);
+        }
+
+        /**
+         * @brief Returns the time stamp of a given point in time as String
+         * 
+         * @param time point in time, e.g. the time a buffered sample was taken
+         * @return String time stamp
+         */
+        String getTimeStamp(time_t time) {
+            char buffer[TEXT_TIMESTAMP_LENGTH + 1];
+            getTimeStamp(buffer, time);
+            return buffer;
+        }
+
+        /**
+         * @brief Writes the time stamp of a given point in time into a buffer without heap allocations.
+         * 
+         * @param buffer buffer of at least TEXT_TIMESTAMP_LENGTH + 1 characters
+         * @param time point in time
+         * @return size_t length of the time stamp
+         */
+        size_t getTimeStamp(char* buffer, time_t time) {
+            struct tm timeInfo;
+            localtime_r(&time, &timeInfo);
+            return TextFormat::formatTimestamp(buffer, timeInfo);
+        }
+
+        /**
+         * @brief Formats a broken down time as zero padded ISO 8601 time stamp, e.g. "2022-05-27T09:05:03"
+         * 
+         * @param timeInfo broken down time
+         * @return String time stamp
+         */
+        String formatTimeStamp(const struct tm& timeInfo) {
+            char buffer[TEXT_TIMESTAMP_LENGTH + 1];
+            TextFormat::formatTimestamp(buffer, timeInfo);
+            return buffer;
         }  
 
         /**
@@ -102,20 +140,70 @@ class ClimateTimeStamp {
          * @return String 
          */
         String fileDate() {
+            char buffer[16];
+            if(!fileDate(buffer)) {
+                return "Failed to obtain time";
+            }
+            return buffer;
+        }
+
+        /**
+         * @brief Writes the date stamp for log filenames, e.g. "27_5_2022", into a buffer without heap allocations.
+         * 
+         * @param buffer buffer of at least 16 characters
+         * @return size_t length of the date stamp, 0 if the time is not available
+         */
+        size_t fileDate(char* buffer) {
             struct tm timeInfo;
             if(!getLocalTime(&timeInfo)){
-                return "Failed to obtain time";
+                buffer[0] = '\0';
+                return 0;
             }
-            String timeString = "";
-            timeString.concat(timeInfo.tm_mday);
-            timeString.concat("_");
-            timeString.concat(timeInfo.tm_mon + 1);
-            timeString.concat("_");
-            timeString.concat(timeInfo.tm_year + 1900);
-            return timeString;
-        }   
+            size_t length = TextFormat::formatUnsigned(buffer, timeInfo.tm_mday);
+            buffer[length++] = '_';
+            length += TextFormat::formatUnsigned(buffer + length, timeInfo.tm_mon + 1);
+            buffer[length++] = '_';
+            length += TextFormat::formatUnsigned(buffer + length, timeInfo.tm_year + 1900);
+            return length;
+        }
 };
 
+/**
+ * @brief Formats of the log file. LOG_CSV writes text lines to "log_d_m_y.csv", LOG_BINARY writes the compact format
+ * of BinaryLog.h to "log_d_m_y.bin", LOG_DELTA the delta compressed format of DeltaLog.h to "log_d_m_y.dlt". Both
+ * binary formats can be converted to csv with tools/decode_log.cpp. LogRotation.h adds a part number and a month
+ * directory to the name.
+ * 
+ */
+enum LogFormat {
+    LOG_CSV,
+    LOG_BINARY,
+    LOG_DELTA
+};
+
+/**
+ * @brief File of the hourly and daily statistics, written in all log formats.
+ */
+#define SUMMARY_FILE_NAME "/summary.csv"
+
+static_assert(ClimateLogSet::channels == 5, "the binary formats store five values");
+static_assert(ClimateLogSet::channels == AGGREGATE_CHANNELS, "the statistics keep one channel per logged value");
+static_assert(ClimateLogSet::channel(0).scale == 100 && ClimateLogSet::channel(1).scale == 100
+    && ClimateLogSet::channel(2).scale == 100 && ClimateLogSet::channel(3).scale == 100
+    && ClimateLogSet::channel(4).scale == 100, "the binary formats store the values in hundredths");
+static_assert(ClimateLogSet::csvRecordSize <= TEXT_RECORD_SIZE, "the readers of the csv log use TEXT_RECORD_SIZE");
+
+/**
+ * @brief Buffer size of the first line of a csv log, see ClimateDataLogger::csvHeader().
+ */
+#define CSV_LOG_HEADER_SIZE 96
+
+/**
+ * @brief First line of the csv logs written before the header was derived from ClimateLogSet. Such a file is still
+ * recovered and continued.
+ */
+#define CSV_LOG_LEGACY_HEADER "time,temperature, humidity, pressure, pressureAtSealevel, height, sequence, crc\n"
+
 /**
  * @brief A class for logging climate measurements to an SD card.
  * 
@@ -124,9 +212,34 @@ class ClimateDataLogger {
 
     private:
         SDCard sdcard;
+        SDLogWriter writer;
         ClimateTimeStamp time;
-        String fileName;
+        char fileName[WAKE_CACHE_FILE_NAME_SIZE];
+        char indexName[WAKE_CACHE_FILE_NAME_SIZE];
+        time_t indexTime = 0;
+        size_t indexOffset = 0;
+        boolean indexPending = false;
+        AggregateState ownAggregates = {};
+        AggregateState* aggregates = nullptr;
+        DeltaState ownDelta = {};
+        DeltaState* delta = nullptr;
+        BinaryLogRecord binaryBlock[BINARY_LOG_BLOCK_RECORDS];
+        uint16_t binaryCount = 0;
+        time_t blockTime = 0;
+        uint32_t blockMillis = 0;
+        LogFileState* fileState = nullptr;
+        uint32_t sequence = 0;
+        uint32_t committedSequence = 0;
+        uint32_t storedRecords = 0;
+        uint32_t durableRecords = 0;
+        uint32_t commits = 0;
+        size_t discarded = 0;
+        RotationPolicy rotation;
+        int32_t fileDay = 0;
+        uint16_t filePart = 0;
         boolean rtcState;
+        boolean started = false;
+        LogFormat format;
 
     public:
         /**
@@ -135,28 +248,242 @@ class ClimateDataLogger {
          * @param ssid SSID of yout WiFi network
          * @param password password of yout WiFi network
          * @param rtcAlreadySet boolean, if the real time clock is already set
+         * @param logFormat format of the log file, LOG_CSV, LOG_BINARY or LOG_DELTA
          */
-        ClimateDataLogger(const char *ssid = "SSID",  const char *password = "PASSWORD", boolean rtcAlreadySet = false) {
+        ClimateDataLogger(const char *ssid = "SSID",  const char *password = "PASSWORD", boolean rtcAlreadySet = false, LogFormat logFormat = LOG_CSV) {
                 time = ClimateTimeStamp(ssid, password);
-                fileName = "/log_";
+                strcpy(fileName, "/log_");
                 rtcState = rtcAlreadySet;
+                format = logFormat;
         }
 
         /**
-         * @brief Initialises the SD card. If the real time clock is not set, it initialises the rtc. If no log file for the current
-         * day is found, a new csv file is created.
+         * @brief Initialises the SD card. If the real time clock is not set, it initialises the rtc. Summaries of periods closed
+         * by observe() before are written. If no log file for the current day is found, a new csv file is created. An existing file is recovered from a power loss first: a torn record at its
+         * end is removed, see recover(). With a size limit of the rotation policy the first part of the day which is not full
+         * is used.
          * 
+         * @param state log file of the last wakeup, usually in RTC memory. If it has a header, it is opened again, also
+         * if its day is over: the file name and the sequence number are taken from it, the check for the header and the
+         * recovery are skipped and data behind its end is removed, e.g. records a failed flush left on the card. The first
+         * record of another day changes the file. It is updated for the next wakeup.
          */
-        void begin() {
+        void begin(LogFileState* state = nullptr) {
             sdcard.begin();   
             if(!rtcState) {      
                 time.setRealTimeClock();   
             }         
-            fileName.concat(time.fileDate());
-            fileName.concat(".csv");
-            if(!sdcard.exists(fileName.c_str())) {
-                sdcard.writeFile(fileName.c_str() , "time,temperature, humidity, pressure, pressureAtSealevel, height\n");
+            struct tm timeInfo;
+            time_t now = hal::epoch();
+            localtime_r(&now, &timeInfo);
+            int32_t day = (timeInfo.tm_year + 1900) * 1000 + timeInfo.tm_yday + 1;
+            indexPending = false;
+            fileState = state;
+            discarded = 0;
+            started = true;
+            writeSummaries();
+            if(state && state->day != 0 && state->headerWritten) {
+                fileDay = state->day;
+                filePart = state->part;
+                sequence = state->sequence;
+                committedSequence = sequence;
+                strcpy(fileName, state->fileName);
+                LogIndex::path(fileName, indexName);
+                openWriter(state->size);
+                return;
+            }
+            openLog(timeInfo, day, 0);
+        }
+
+        /**
+         * @brief Sets when a new log file is started besides midnight, whether it is preallocated, put into a month
+         * directory, and what happens to old files when the card runs full, see LogRotation.h. Has to be called before
+         * begin().
+         * 
+         * @param policy rotation policy
+         */
+        void setRotation(const RotationPolicy& policy) {
+            rotation = policy;
+        }
+
+        /**
+         * @brief Sets when buffered records are written to the SD card. Records are always written when 512 bytes
+         * are buffered. The default is one minute. The policy also applies to the records in the open block of
+         * LOG_BINARY and LOG_DELTA: the block is closed and written once it holds maxRecords records or its first
+         * record is maxAgeMillis old, so a record reaches the card within maxAgeMillis in every format.
+         * 
+         * @param maxRecords number of buffered records which triggers a write, 0 for no limit
+         * @param maxAgeMillis age of the oldest buffered record in milliseconds which triggers a write, 0 for no limit
+         */
+        void setFlushPolicy(uint16_t maxRecords, uint32_t maxAgeMillis) {
+            writer.setPolicy(maxRecords, maxAgeMillis);
+        }
+
+        /**
+         * @brief Writes all buffered records to the SD card. Call it before deep sleep or a restart.
+         * 
+         * @return success/failure of writing
+         */
+        boolean flush() {
+            writeSummaries();
+            boolean success = closeBlock() && writer.flush();
+            checkCommit();
+            commitIndex();
+            rememberSize();
+            return success;
+        }
+
+        /**
+         * @brief Writes the buffered records if the oldest one exceeds the maximum age of setFlushPolicy(). log()
+         * only checks the age when a record arrives, so call it regularly while no records are logged, e.g. when the
+         * writer of the log is idle.
+         * 
+         * @return success/failure of writing
+         */
+        boolean poll() {
+            boolean success = closeDueBlock() && writer.poll();
+            checkCommit();
+            commitIndex();
+            rememberSize();
+            return success;
+        }
+
+        /**
+         * @brief Returns the time until poll() writes the buffered records, e.g. to end a light sleep for it.
+         * 
+         * @return uint32_t milliseconds, 0 if it is due, UINT32_MAX if no record waits for the maximum age
+         */
+        uint32_t millisToPoll() {
+            uint32_t buffer = writer.millisToPoll();
+            uint32_t block = blockMillisToPoll();
+            return block < buffer ? block : buffer;
+        }
+
+        /**
+         * @brief Discards the records which are not committed to the card yet, see SDLogWriter::rollback(), and the
+         * open block of LOG_BINARY and LOG_DELTA. The sequence numbers continue behind the last committed record. Call
+         * it after a failed log() or flush() if the records are logged again, like SampleBatch::flush() does.
+         */
+        void rollback() {
+            DeltaState& state = delta ? *delta : ownDelta;
+            writer.rollback();
+            state.count = 0;
+            state.length = 0;
+            binaryCount = 0;
+            blockTime = 0;
+            sequence = committedSequence;
+            if(fileState) {
+                fileState->sequence = sequence;
+            }
+            storedRecords = durableRecords;
+            if(indexPending && indexOffset >= writer.committed()) {
+                indexPending = false;
             }
+            rememberSize();
+        }
+
+        /**
+         * @brief Returns the number of records committed to the card since the logger was started. The difference
+         * before and after logging is the number of records which survive a power loss.
+         * 
+         * @return uint32_t committed records
+         */
+        uint32_t committedRecords() {
+            return durableRecords;
+        }
+
+        /**
+         * @brief Adds a sample to the hourly and daily statistics without logging it. Call it with every sample, also
+         * with the ones a ChangeFilter keeps out of the log, so the statistics describe the climate and not the logged
+         * records; log() only adds samples newer than the last observed one. The summary rows of the periods a sample
+         * closes are written once the logger is started, until then they are kept in the AggregateState.
+         * 
+         * @param sample timestamped climate measurement
+         * @return boolean true if a summary row waits for the SD card
+         */
+        boolean observe(const ClimateSample& sample) {
+            struct tm timeInfo;
+            localtime_r(&sample.time, &timeInfo);
+            const float values[5] = {sample.temperature, sample.humidity, sample.pressure, sample.pressureAtSealevel, sample.height};
+            aggregate(sample.time, timeInfo, values);
+            return summaryPending();
+        }
+
+        /**
+         * @brief Returns whether the summary row of a closed hour or day is not written yet, e.g. to mount the SD
+         * card in deep sleep mode.
+         * 
+         * @return boolean true if a summary row waits for the SD card
+         */
+        boolean summaryPending() {
+            const AggregateState& state = aggregates ? *aggregates : ownAggregates;
+            return state.closedHourStart != 0 || state.closedDayStart != 0;
+        }
+
+        /**
+         * @brief Sets the accumulators of the hourly and daily statistics, e.g. in RTC memory so they survive deep
+         * sleep. Without it the statistics start over with every boot.
+         * 
+         * @param state accumulators
+         */
+        void setAggregateState(AggregateState* state) {
+            aggregates = state;
+        }
+
+        /**
+         * @brief Sets the encoder state of LOG_DELTA, e.g. in RTC memory. The open block is written by flush().
+         * 
+         * @param state encoder state
+         */
+        void setDeltaState(DeltaState* state) {
+            delta = state;
+        }
+
+        /**
+         * @brief Returns the number of bytes of a torn record removed from the end of the log file by begin().
+         * 
+         * @return size_t removed bytes
+         */
+        size_t recovered() {
+            return discarded;
+        }
+
+        /**
+         * @brief Returns the sequence number of the last csv record.
+         * 
+         * @return uint32_t sequence number, 0 if the file has no records
+         */
+        uint32_t lastSequence() {
+            return sequence;
+        }
+
+        /**
+         * @brief Returns the path of the current log file.
+         * 
+         * @return const char* path
+         */
+        const char* currentFile() {
+            return fileName;
+        }
+
+        /**
+         * @brief Returns the writer of the log file, e.g. for its statistics.
+         * 
+         * @return SDLogWriter& writer
+         */
+        SDLogWriter& getWriter() {
+            return writer;
+        }
+
+        /**
+         * @brief Logs a record of the channels of ClimateLogSet with the time it was taken. It is written to the log
+         * file of its own day, also if that day is already over.
+         *
+         * @param record timestamped values of the climate log
+         * @return success/failure of appending
+         */
+        boolean log(const ClimateLogSet::Record& record) {
+            return append(record);
         }
 
         /**
@@ -167,21 +494,520 @@ class ClimateDataLogger {
          * @param pressure current pressure
          * @param pressureAtSealevel calculated pressure at sealevel
          * @param height calculated height
+         * @return success/failure of appending
+         */
+        boolean log(float temperature, float humidity, float pressure, float pressureAtSealevel, float height) {
+            const ClimateLogSet::Record record = {hal::epoch(), {temperature, humidity, pressure, pressureAtSealevel, height}};
+            return append(record);
+        }
+
+        /**
+         * @brief Logs a measurement snapshot with the current time.
+         * 
+         * @param reading climate measurement
+         * @return success/failure of appending
+         */
+        boolean log(const ClimateReading& reading) {
+            return log(reading.temperature, reading.humidity, reading.pressure, reading.pressureAtSealevel, reading.height);
+        }
+
+        /**
+         * @brief Logs a sample with the time it was taken, e.g. a sample buffered during deep sleep.
+         * 
+         * @param sample timestamped climate measurement
+         * @return success/failure of appending
+         */
+        boolean log(const ClimateSample& sample) {
+            const ClimateLogSet::Record record = {
+                sample.time,
+                {sample.temperature, sample.humidity, sample.pressure, sample.pressureAtSealevel, sample.height}
+            };
+            return append(record);
+        }
+
+        /**
+         * @brief Writes the first line of a csv log: the channels of ClimateLogSet and the columns of the journal.
+         * The records are sealed with a sequence number and a CRC-32, see LogJournal.h.
+         * 
+         * @param buffer buffer of CSV_LOG_HEADER_SIZE characters
+         * @return size_t number of characters
+         */
+        static size_t csvHeader(char* buffer) {
+            return ClimateLogSet::csvHeader(buffer, CSV_LOG_HEADER_SIZE, LOG_JOURNAL_COLUMNS);
+        }
+
+    private:
+        static boolean foreignHeader(const uint8_t* data, size_t length, const char* header) {
+            return length > strlen(header) && memcmp(data, header, strlen(header)) != 0;
+        }
+
+        boolean append(const ClimateLogSet::Record& record) {
+            const time_t timestamp = record.time;
+            const float* values = record.values;
+            struct tm timeInfo;
+            localtime_r(&timestamp, &timeInfo);
+            int32_t day = (timeInfo.tm_year + 1900) * 1000 + timeInfo.tm_yday + 1;
+            if(fileDay != 0 && day != fileDay) {
+                //also backwards: a batch flushed after midnight starts with samples of the day before
+                if(!rotate(timeInfo, day, 0)) {
+                    return false;
+                }
+            } else if(fileDay != 0 && rotation.maxFileBytes > 0 && writer.offset() >= rotation.maxFileBytes) {
+                if(!rotate(timeInfo, fileDay, filePart + 1)) {
+                    return false;
+                }
+            }
+            uint32_t stored = storedRecords;
+            boolean success;
+            if(format == LOG_BINARY) {
+                success = appendBinary(timeInfo, timestamp, values);
+            } else if(format == LOG_DELTA) {
+                success = appendDelta(timeInfo, timestamp, values);
+            } else {
+                char line[ClimateLogSet::csvRecordSize + LOG_JOURNAL_TRAILER_SIZE];
+                size_t length = LogJournal::seal(line, ClimateLogSet::csvRecord(line, timeInfo, values), sequence + 1);
+                success = appendRecord(timestamp, (const uint8_t *) line, length, 1, sequence + 1);
+            }
+            if(storedRecords != stored) {
+                aggregate(timestamp, timeInfo, values);
+            }
+            return success;
+        }
+
+        /**
+         * @brief Opens the log file of a day, starting at a part number. Parts which reached the size limit are
+         * skipped. A new file gets its header and is preallocated, and the retention policy makes room for it.
+         */
+        void openLog(const struct tm& timeInfo, int32_t day, uint16_t part) {
+            const char* extension = format == LOG_BINARY ? ".bin" : format == LOG_DELTA ? ".dlt" : ".csv";
+            fileDay = day;
+            filePart = part;
+            LogRotation::fileName(fileName, timeInfo, filePart, extension, rotation.monthDirectories);
+            while(rotation.maxFileBytes > 0 && dataSize() >= rotation.maxFileBytes) {
+                LogRotation::fileName(fileName, timeInfo, ++filePart, extension, rotation.monthDirectories);
+            }
+            LogIndex::path(fileName, indexName);
+            sequence = 0;
+            size_t end = 0;
+            if(sdcard.exists(fileName)) {
+                end = recover();
+            }
+            boolean headerWritten = sdcard.exists(fileName);
+            if(!headerWritten) {
+                if(rotation.minFreeBytes > 0) {
+                    LogRotation::enforce(rotation, fileName);
+                }
+                LogRotation::makeDirectory(fileName);
+                if(format == LOG_BINARY) {
+                    uint8_t header[BINARY_LOG_HEADER_SIZE];
+                    end = BinaryLog::writeHeader(header);
+                    headerWritten = sdcard.writeFile(fileName, header, end);
+                } else if(format == LOG_DELTA) {
+                    uint8_t header[DELTA_LOG_HEADER_SIZE];
+                    end = DeltaLog::writeHeader(header);
+                    headerWritten = sdcard.writeFile(fileName, header, end);
+                } else {
+                    char header[CSV_LOG_HEADER_SIZE];
+                    end = csvHeader(header);
+                    headerWritten = sdcard.writeFile(fileName, header);
+                }
+                if(headerWritten && rotation.preallocateBytes > 0) {
+                    LogRotation::preallocate(fileName, rotation.preallocateBytes);
+                }
+            }
+            if(fileState) {
+                fileState->day = day;
+                fileState->headerWritten = headerWritten;
+                fileState->sequence = sequence;
+                fileState->part = filePart;
+                strcpy(fileState->fileName, fileName);
+            }
+            committedSequence = sequence;
+            openWriter(end);
+        }
+
+        /**
+         * @brief Opens the writer behind the end of the data: in a preallocated file the records overwrite the zeros,
+         * otherwise they are appended and what lies behind the end is cut off.
+         */
+        void openWriter(size_t end) {
+            if(rotation.preallocateBytes > 0) {
+                writer.openAt(fileName, end);
+            } else if(writer.open(fileName) && writer.offset() > end) {
+                //records a failed flush left behind the committed end before the restart
+                writer.truncate(end);
+            }
+            rememberSize();
+        }
+
+        void rememberSize() {
+            if(fileState) {
+                fileState->size = writer.offset() - writer.buffered();
+            }
+        }
+
+        /**
+         * @brief Returns the size of the data of the current file name, 0 if it does not exist.
+         */
+        size_t dataSize() {
+            File file = hal::storage().open(fileName, FILE_READ);
+            if(!file) {
+                return 0;
+            }
+            size_t size = file.size();
+            if(rotation.preallocateBytes > 0 && size >= rotation.maxFileBytes) {
+                size = LogRotation::dataEnd(file);
+            }
+            file.close();
+            return size;
+        }
+
+        /**
+         * @brief Closes the current log file and continues in the next one. The zeros behind the data of a
+         * preallocated file are cut off. If the last records can not be written, the writer stays on the current
+         * file, so rollback() removes them from it.
+         */
+        boolean rotate(const struct tm& timeInfo, int32_t day, uint16_t part) {
+            boolean success = closeBlock() && writer.close();
+            checkCommit();
+            commitIndex();
+            if(!success) {
+                return false;
+            }
+            if(rotation.preallocateBytes > 0) {
+                hal::truncateFile(fileName, writer.offset());
+            }
+            indexPending = false;
+            openLog(timeInfo, day, part);
+            return true;
+        }
+
+        /**
+         * @brief Removes a record torn by a power loss from the end of the log file. Only the last
+         * LOG_JOURNAL_TAIL_SIZE bytes are read, so it takes the same time for every file size. If the file can not be
+         * truncated, the torn record is skipped: a newline is added to a csv file, so the next record starts on its own
+         * line, and readers drop the record by its CRC. The same happens if no intact record ends in the tail, then the
+         * sequence numbers start over. A file without an intact header is removed and written again. Csv files of earlier
+         * versions without sequence numbers are left alone. In a preallocated file the end of the data is searched
+         * first, and the torn record is overwritten with zeros instead of truncated.
+         * 
+         * @return size_t end of the data after the recovery
+         */
+        size_t recover() {
+            File file = hal::storage().open(fileName, FILE_READ);
+            if(!file) {
+                return 0;
+            }
+            boolean preallocated = rotation.preallocateBytes > 0;
+            size_t size = preallocated ? LogRotation::dataEnd(file) : file.size();
+            size_t start = size > LOG_JOURNAL_TAIL_SIZE ? size - LOG_JOURNAL_TAIL_SIZE : 0;
+            uint8_t tail[LOG_JOURNAL_TAIL_SIZE];
+            size_t length = file.seek(start) ? file.read(tail, size - start) : 0;
+            file.close();
+            if(length != size - start) {
+                return size;
+            }
+            while(preallocated && length > 0 && tail[length - 1] == 0) {
+                length--;
+            }
+            size = start + length;
+            size_t end = 0;
+            boolean found;
+            if(format == LOG_CSV) {
+                char header[CSV_LOG_HEADER_SIZE];
+                csvHeader(header);
+                if(start == 0 && foreignHeader(tail, length, header) && foreignHeader(tail, length, CSV_LOG_LEGACY_HEADER)) {
+                    return size;
+                }
+                found = LogJournal::recoverText(tail, length, start == 0, end, sequence);
+            } else {
+                const uint16_t maxCount = DELTA_LOG_BLOCK_CAPACITY / 6;
+                BinaryLogRecord records[maxCount];
+                uint16_t count;
+                size_t headerSize = 0;
+                if(start == 0 && format == LOG_BINARY && BinaryLog::checkHeader(tail, length)) {
+                    headerSize = BINARY_LOG_HEADER_SIZE;
+                } else if(start == 0 && format == LOG_DELTA && DeltaLog::checkHeader(tail, length)) {
+                    headerSize = DELTA_LOG_HEADER_SIZE;
+                }
+                found = LogJournal::recoverBlocks(tail, length, start == 0, headerSize, [&](const uint8_t* buffer, size_t available) {
+                    return format == LOG_BINARY
+                        ? BinaryLog::decodeBlock(buffer, available, records, maxCount, count)
+                        : DeltaLog::decodeBlock(buffer, available, records, maxCount, count);
+                }, end);
+            }
+            if(!found && start == 0) {
+                discarded = length;
+                hal::storage().remove(fileName);
+                size = 0;
+            } else if(!found) {
+                if(format == LOG_CSV && length > 0 && tail[length - 1] != '\n' && appendNewline(size)) {
+                    size++;
+                }
+            } else if(end < length) {
+                if(preallocated ? LogRotation::writeAt(fileName, start + end, nullptr, length - end)
+                    : hal::truncateFile(fileName, start + end)) {
+                        discarded = length - end;
+                        size = start + end;
+                } else if(format == LOG_CSV && appendNewline(size)) {
+                    size++;
+                }
+            }
+            if(discarded > 0) {
+                Serial.printf("Recovered %s: %u bytes of a torn record removed\n", fileName, (unsigned) discarded);
+            }
+            return size;
+        }
+
+        boolean appendNewline(size_t end) {
+            if(rotation.preallocateBytes > 0) {
+                return LogRotation::writeAt(fileName, end, (const uint8_t*) "\n", 1);
+            }
+            return sdcard.appendFile(fileName, "\n");
+        }
+
+        /**
+         * @brief Adds a record to the hourly and daily statistics and appends the periods it closes to the summary
+         * file, or keeps them in the AggregateState if the logger is not started.
+         */
+        void aggregate(time_t timestamp, const struct tm& timeInfo, const float values[5]) {
+            AggregateState& state = aggregates ? *aggregates : ownAggregates;
+            ClimateAggregator aggregator(state);
+            aggregator.add(timestamp, timeInfo, values, [&state](AggregatePeriod period, time_t start, const RunningStatistics* channels) {
+                //a period still waiting for the card is replaced, deep sleep mode mounts it when summaryPending()
+                boolean hour = period == AGGREGATE_HOUR;
+                (hour ? state.closedHourStart : state.closedDayStart) = start;
+                memcpy(hour ? state.closedHour : state.closedDay, channels, sizeof(state.closedHour));
+            });
+            writeSummaries();
+        }
+
+        /**
+         * @brief Writes the first line of the summary file: period, start and the statistics of each channel of
+         * ClimateLogSet, in the order of ClimateAggregator::formatSummary().
+         *
+         * @param buffer buffer
+         * @param size size of the buffer
+         * @return size_t number of characters, 0 if the buffer is too small
+         */
+        static size_t summaryHeader(char* buffer, size_t size) {
+            static const char* const statistics[] = {"Count", "Min", "Max", "Mean", "Std"};
+            size_t length = copy(buffer, size, 0, "period,start");
+            for(uint8_t i = 0; i < ClimateLogSet::channels; i++) {
+                for(uint8_t j = 0; j < 5; j++) {
+                    length = copy(buffer, size, length, ",");
+                    length = copy(buffer, size, length, ClimateLogSet::channel(i).name);
+                    length = copy(buffer, size, length, statistics[j]);
+                }
+            }
+            length = copy(buffer, size, length, "\n");
+            if(length >= size) {
+                buffer[0] = '\0';
+                return 0;
+            }
+            return length;
+        }
+
+        static size_t copy(char* buffer, size_t size, size_t length, const char* text) {
+            size_t count = strlen(text);
+            if(length + count >= size) {
+                return size;
+            }
+            memcpy(buffer + length, text, count + 1);
+            return length + count;
+        }
+
+        /**
+         * @brief Appends the summary rows of the closed periods to the summary file if the logger is started. A
+         * period stays pending if its row could not be written.
+         */
+        void writeSummaries() {
+            AggregateState& state = aggregates ? *aggregates : ownAggregates;
+            if(!started || (state.closedHourStart == 0 && state.closedDayStart == 0)) {
+                return;
+            }
+            if(!sdcard.exists(SUMMARY_FILE_NAME)) {
+                char header[AGGREGATE_SUMMARY_SIZE];
+                if(summaryHeader(header, sizeof(header)) == 0) {
+                    return;
+                }
+                sdcard.writeFile(SUMMARY_FILE_NAME, header);
+            }
+            for(uint8_t i = 0; i < 2; i++) {
+                AggregatePeriod period = i == 0 ? AGGREGATE_HOUR : AGGREGATE_DAY;
+                int64_t& start = period == AGGREGATE_HOUR ? state.closedHourStart : state.closedDayStart;
+                if(start == 0) {
+                    continue;
+                }
+                time_t startTime = (time_t) start;
+                struct tm startInfo;
+                localtime_r(&startTime, &startInfo);
+                char summary[AGGREGATE_SUMMARY_SIZE];
+                ClimateAggregator::formatSummary(summary, period, startInfo, period == AGGREGATE_HOUR ? state.closedHour : state.closedDay);
+                if(sdcard.appendFile(SUMMARY_FILE_NAME, summary)) {
+                    start = 0;
+                }
+            }
+        }
+
+        /**
+         * @brief Appends an encoded record and remembers it for the index if it is due. The index entry is only
+         * written once the record is committed to the card, so it never points behind the end of the log. The
+         * sequence number only advances if the writer took the record.
+         *
+         * @param records number of samples in the record which are not counted yet, 0 for a delta block
+         * @param recordSequence sequence number of a csv record, 0 for none
+         */
+        boolean appendRecord(time_t timestamp, const uint8_t * data, size_t length, uint32_t records, uint32_t recordSequence) {
+            size_t offset = writer.offset();
+            boolean success = writer.write(data, length);
+            if(writer.offset() != offset) {
+                storedRecords += records;
+                if(recordSequence > 0) {
+                    sequence = recordSequence;
+                    if(fileState) {
+                        fileState->sequence = sequence;
+                    }
+                }
+                if(!indexPending && LogIndex::due(offset, length)) {
+                    indexPending = true;
+                    indexTime = timestamp;
+                    indexOffset = offset;
+                }
+            }
+            checkCommit();
+            commitIndex();
+            rememberSize();
+            return success;
+        }
+
+        /**
+         * @brief Remembers the state of the last commit of the writer for rollback(). The records in the open block
+         * are not committed.
+         */
+        void checkCommit() {
+            if(writer.flushes() == commits) {
+                return;
+            }
+            commits = writer.flushes();
+            committedSequence = sequence;
+            durableRecords = storedRecords - openRecords();
+        }
+
+        /**
+         * @brief Returns the number of records in the open block of LOG_BINARY or LOG_DELTA.
+         */
+        uint16_t openRecords() {
+            const DeltaState& state = delta ? *delta : ownDelta;
+            return format == LOG_DELTA ? state.count : format == LOG_BINARY ? binaryCount : 0;
+        }
+
+        void commitIndex() {
+            if(indexPending && writer.committed() > indexOffset) {
+                LogIndex::append(indexName, indexTime, indexOffset);
+                indexPending = false;
+            }
+        }
+
+        /**
+         * @brief Adds a record to the open binary block. The block is written when it holds BINARY_LOG_BLOCK_RECORDS
+         * records, when the flush policy fires (see closeDueBlock()) or on flush(), so the block header is shared by
+         * the records.
+         */
+        boolean appendBinary(const struct tm& timeInfo, time_t timestamp, const float values[5]) {
+            if(binaryCount == BINARY_LOG_BLOCK_RECORDS && !closeBlock()) {
+                return false;
+            }
+            if(binaryCount == 0) {
+                blockTime = timestamp;
+                blockMillis = millis();
+            }
+            binaryBlock[binaryCount++] = BinaryLog::toRecord(
+                BinaryLog::localTime(timeInfo), values[0], values[1], values[2], values[3], values[4]
+            );
+            storedRecords++;
+            return closeDueBlock();
+        }
+
+        /**
+         * @brief Adds a record to the open delta block. The block is written when it is full, when the flush policy
+         * fires (see closeDueBlock()) or on flush().
+         */
+        boolean appendDelta(const struct tm& timeInfo, time_t timestamp, const float values[5]) {
+            DeltaState& state = delta ? *delta : ownDelta;
+            BinaryLogRecord record = BinaryLog::toRecord(
+                BinaryLog::localTime(timeInfo), values[0], values[1], values[2], values[3], values[4]
+            );
+            if(state.count == 0 || blockTime == 0) {
+                blockTime = timestamp;
+                blockMillis = millis();
+            }
+            if(!DeltaLog::add(state, record)) {
+                if(!closeBlock()) {
+                    return false;
+                }
+                blockTime = timestamp;
+                blockMillis = millis();
+                DeltaLog::add(state, record);
+            }
+            storedRecords++;
+            return closeDueBlock();
+        }
+
+        /**
+         * @brief Returns the time until the open block reaches the maximum age of the flush policy.
+         *
+         * @return uint32_t milliseconds, 0 if it is due, UINT32_MAX if there is no open block or no age limit
+         */
+        uint32_t blockMillisToPoll() {
+            if(openRecords() == 0 || writer.maxAgeMillis() == 0) {
+                return UINT32_MAX;
+            }
+            uint32_t age = millis() - blockMillis;
+            return age >= writer.maxAgeMillis() ? 0 : writer.maxAgeMillis() - age;
+        }
+
+        /**
+         * @brief Closes the open block and flushes the writer if the flush policy of the writer fires for the records
+         * in the block: the block holds its maximum number of records or the first one reached the maximum age. A
+         * block kept in RTC memory over a reboot counts its age from the boot.
+         */
+        boolean closeDueBlock() {
+            uint16_t records = openRecords();
+            if(records == 0) {
+                return true;
+            }
+            if((writer.maxRecords() == 0 || records < writer.maxRecords()) && blockMillisToPoll() > 0) {
+                return true;
+            }
+            boolean success = closeBlock() && writer.flush();
+            checkCommit();
+            commitIndex();
+            rememberSize();
+            return success;
+        }
+
+        /**
+         * @brief Writes the open block of LOG_BINARY or LOG_DELTA. If the writer does not take it, the records stay
+         * counted and are discarded by rollback().
          */
-        void log(float temperature, float humidity, float pressure, float pressureAtSealevel, float height) {
-            String data = time.getTimeStamp();
-            data.concat(",");
-            data.concat(temperature);
-            data.concat(",");
-            data.concat(humidity);
-            data.concat(",");
-            data.concat(pressure);
-            data.concat(",");
-            data.concat(pressureAtSealevel);
-            data.concat(",");
-            data.concat(height);
-            data.concat("\n");
-            sdcard.appendFile(fileName.c_str(), data.c_str());
+        boolean closeBlock() {
+            if(openRecords() == 0) {
+                return true;
+            }
+            static_assert(BINARY_LOG_BLOCK_HEADER_SIZE + BINARY_LOG_BLOCK_RECORDS * BINARY_LOG_RECORD_SIZE
+                <= DELTA_LOG_BLOCK_HEADER_SIZE + DELTA_LOG_BLOCK_CAPACITY, "a binary block fits into the buffer");
+            uint8_t block[DELTA_LOG_BLOCK_HEADER_SIZE + DELTA_LOG_BLOCK_CAPACITY];
+            size_t size;
+            if(format == LOG_BINARY) {
+                size = BinaryLog::encodeBlock(binaryBlock, binaryCount, block);
+                binaryCount = 0;
+            } else {
+                size = DeltaLog::close(delta ? *delta : ownDelta, block);
+            }
+            boolean success = appendRecord(blockTime, block, size, 0, 0);
+            blockTime = 0;
+            return success;
         }
 };
 
@@ -194,12 +1020,23 @@ class ClimateDataLogger {
 class ClimateSensor {
 
     private:
-        Adafruit_HTU21DF humiditySensor;
-        Adafruit_BMP085 barometricSensor;
+        HTU21DF humiditySensor;
+        BMP180 barometricSensor;
+        ClimateMeasurement measurement{humiditySensor, barometricSensor};
         float referencePressure = 101325;
+        uint8_t oversampling = BMP180_ULTRAHIGHRES;
+        uint8_t burst = 1;
+        uint32_t filterGap = 0;
         ClimateDataLogger logger;
+        LogFormat logFormat = LOG_CSV;
+        uint16_t flushRecords = 0;
+        uint32_t flushMillis = 60000;
         const char* _ssid;
         const char* _password;
+        WakeCache* wakeCache = nullptr;
+        AggregateState* aggregateState = nullptr;
+        DeltaState* deltaState = nullptr;
+        RotationPolicy rotation;
 
     public:
         /**
@@ -220,9 +1057,264 @@ class ClimateSensor {
          * @return boolean success of initalisation
          */
         boolean begin(boolean rtcAlreadySet = false) {
-            logger = ClimateDataLogger(_ssid, _password, rtcAlreadySet);
-            logger.begin();
-            return humiditySensor.begin() && barometricSensor.begin();
+            beginLogger(rtcAlreadySet);
+            return beginSensors();
+        }
+
+        /**
+         * @brief Initialises only the sensors. Together with beginLogger() this allows measuring without mounting
+         * the SD card.
+         * 
+         * @return boolean success of initalisation
+         */
+        boolean beginSensors() {
+            if(wakeCache && wakeCache->calibrated) {
+                humiditySensor.wake();
+                return barometricSensor.begin(wakeCache->calibration, oversampling);
+            }
+            if(!humiditySensor.begin() || !barometricSensor.begin(oversampling)) {
+                return false;
+            }
+            if(wakeCache) {
+                wakeCache->calibration = barometricSensor.calibration();
+                wakeCache->calibrated = true;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Uses a cache for the results of beginSensors(), setReferenceHeight() and beginLogger(), so they skip
+         * the sensor reset, the calibration EEPROM, the reference measurement and the log file lookup on a warm start.
+         * 
+         * @param cache cache in RTC memory, prepared with WakeCache::begin(), or nullptr to disable caching
+         */
+        void setWakeCache(WakeCache* cache) {
+            wakeCache = cache;
+        }
+
+        /**
+         * @brief Sets the accumulators of the hourly and daily statistics of the logger. Has to be called before
+         * observe(), begin() or beginLogger().
+         * 
+         * @param state accumulators, usually in RTC memory, or nullptr to keep them in the logger
+         */
+        void setAggregateState(AggregateState* state) {
+            aggregateState = state;
+            logger.setAggregateState(state);
+        }
+
+        /**
+         * @brief Sets the encoder state of the LOG_DELTA format of the logger. Has to be called before begin() or
+         * beginLogger().
+         * 
+         * @param state encoder state, usually in RTC memory, or nullptr to keep it in the logger
+         */
+        void setDeltaState(DeltaState* state) {
+            deltaState = state;
+        }
+
+        /**
+         * @brief Sets the rotation policy of the logger, see ClimateDataLogger::setRotation(). Has to be called before
+         * begin() or beginLogger().
+         * 
+         * @param policy rotation policy
+         */
+        void setRotation(const RotationPolicy& policy) {
+            rotation = policy;
+        }
+
+        /**
+         * @brief Starts the Datalogger, which mounts the SD card.
+         * 
+         * @param rtcAlreadySet boolean, true if the real time clock is already set.
+         */
+        void beginLogger(boolean rtcAlreadySet = false) {
+            logger.flush();
+            logger = ClimateDataLogger(_ssid, _password, rtcAlreadySet, logFormat);
+            logger.setFlushPolicy(flushRecords, flushMillis);
+            logger.setAggregateState(aggregateState);
+            logger.setDeltaState(deltaState);
+            logger.setRotation(rotation);
+            logger.begin(wakeCache ? &wakeCache->logFile : nullptr);
+        }
+
+        /**
+         * @brief Sets when buffered log records are written to the SD card, see ClimateDataLogger::setFlushPolicy().
+         * 
+         * @param maxRecords number of buffered records which triggers a write, 0 for no limit
+         * @param maxAgeMillis age of the oldest buffered record in milliseconds which triggers a write, 0 for no limit
+         */
+        void setFlushPolicy(uint16_t maxRecords, uint32_t maxAgeMillis) {
+            flushRecords = maxRecords;
+            flushMillis = maxAgeMillis;
+            logger.setFlushPolicy(maxRecords, maxAgeMillis);
+        }
+
+        /**
+         * @brief Writes all buffered log records to the SD card. Call it before deep sleep or a restart.
+         * 
+         * @return success/failure of writing
+         */
+        boolean flush() {
+            return logger.flush();
+        }
+
+        /**
+         * @brief Writes the buffered log records if the oldest one exceeds the maximum age, see
+         * ClimateDataLogger::poll(). Call it regularly while no samples are logged.
+         * 
+         * @return success/failure of writing
+         */
+        boolean poll() {
+            return logger.poll();
+        }
+
+        /**
+         * @brief Returns the time until poll() writes the buffered log records, see ClimateDataLogger::millisToPoll().
+         * 
+         * @return uint32_t milliseconds, 0 if it is due, UINT32_MAX if no record waits for the maximum age
+         */
+        uint32_t millisToPoll() {
+            return logger.millisToPoll();
+        }
+
+        /**
+         * @brief Adds a sample to the hourly and daily statistics without logging it, see
+         * ClimateDataLogger::observe(). Works without a started logger, e.g. in deep sleep mode.
+         * 
+         * @param sample timestamped climate measurement
+         * @return boolean true if a summary row waits for the SD card
+         */
+        boolean observe(const ClimateSample& sample) {
+            return logger.observe(sample);
+        }
+
+        /**
+         * @brief Discards the log records which are not committed yet, see ClimateDataLogger::rollback().
+         * 
+         */
+        void rollback() {
+            logger.rollback();
+        }
+
+        /**
+         * @brief Returns the number of log records committed to the card, see ClimateDataLogger::committedRecords().
+         * 
+         * @return uint32_t committed records
+         */
+        uint32_t committedRecords() {
+            return logger.committedRecords();
+        }
+
+        /**
+         * @brief Sets the format of the log file. Has to be called before begin() or beginLogger().
+         * 
+         * @param format LOG_CSV (default), LOG_BINARY or LOG_DELTA
+         */
+        void setLogFormat(LogFormat format) {
+            logFormat = format;
+        }
+
+        /**
+         * @brief Reads every sensor exactly once and derives all values from these readings: one HTU21DF temperature
+         * and humidity conversion, one BMP180 temperature and pressure conversion. The conversions of both sensors
+         * run in parallel and the CPU is released while waiting. Use this instead of the single read methods when 
+         * more than one value is needed.
+         * 
+         * @return ClimateReading snapshot of the measurement cycle
+         */
+        ClimateReading read() {
+            startMeasurement();
+            while(!pollMeasurement()) {
+                uint32_t wait = measurement.nextStep(micros());
+                if(wait >= 1000) {
+                    delay(wait / 1000);
+                } else {
+                    delayMicroseconds(wait);
+                }
+            }
+            return measurementResult();
+        }
+
+        /**
+         * @brief Sets the pressure oversampling of the BMP180. Higher settings reduce the noise (datasheet: 6 Pa RMS
+         * at BMP180_ULTRALOWPOWER, 3 Pa at BMP180_ULTRAHIGHRES) and take longer (4.5 to 25.5 ms). Has to be called
+         * before begin() or beginSensors().
+         * 
+         * @param mode BMP180_ULTRALOWPOWER, BMP180_STANDARD, BMP180_HIGHRES or BMP180_ULTRAHIGHRES (default)
+         */
+        void setOversampling(uint8_t mode) {
+            oversampling = mode;
+        }
+
+        /**
+         * @brief Sets the number of measurement cycles read(filter) passes through the filters for one reading.
+         * 
+         * @param count measurement cycles per reading, at least 1 (default)
+         */
+        void setBurst(uint8_t count) {
+            burst = count > 0 ? count : 1;
+        }
+
+        /**
+         * @brief Sets the longest time between two bursts the filters of read(filter) average over. After a longer
+         * gap, e.g. a deep sleep of several minutes, the filter state is reset and the reading only depends on the
+         * new burst, so the schedule and the change filter do not follow a value lagging behind the climate.
+         * 
+         * @param seconds longest gap in seconds, 0 (default) keeps the state for ever
+         */
+        void setFilterGap(uint32_t seconds) {
+            filterGap = seconds;
+        }
+
+        /**
+         * @brief Runs a burst of measurement cycles, see setBurst(), passes every reading through streaming filters
+         * and returns the filtered reading. The filter type is chosen at compile time, e.g.
+         * ClimateFilter<KalmanFusion<20, 40, 100>, MedianFilter<3>, FilterChain<MedianFilter<3>, EmaFilter<1, 4>>>.
+         * The filters are reset first if the last burst is older than the filter gap, see setFilterGap().
+         * 
+         * @tparam Filter ClimateFilter or a type with add(reading), result(referencePressure), reset() and time
+         * @param filter filter state, e.g. in RTC memory
+         * @return ClimateReading filtered reading
+         */
+        template <typename Filter>
+        ClimateReading read(Filter& filter) {
+            time_t now = hal::epoch();
+            if(filterGap > 0 && (now < filter.time || now - filter.time > (time_t) filterGap)) {
+                filter.reset();
+            }
+            filter.time = now;
+            for(uint8_t i = 0; i < burst; i++) {
+                filter.add(read());
+            }
+            return filter.result(referencePressure);
+        }
+
+        /**
+         * @brief Starts a non-blocking measurement. Call pollMeasurement() until it returns true, then get the
+         * values with measurementResult().
+         * 
+         */
+        void startMeasurement() {
+            measurement.start(micros());
+        }
+
+        /**
+         * @brief Advances a measurement started with startMeasurement().
+         * 
+         * @return boolean true if the measurement is complete
+         */
+        boolean pollMeasurement() {
+            return measurement.step(micros());
+        }
+
+        /**
+         * @brief Returns the result of a complete measurement.
+         * 
+         * @return ClimateReading snapshot of the measurement cycle
+         */
+        ClimateReading measurementResult() {
+            return measurement.result(referencePressure);
         }
 
         /**
@@ -277,16 +1369,25 @@ class ClimateSensor {
          * @return float altitude at sealevel
          */
         float readSeaLevelPressure(float altitude_meters = 0) {
-            return barometricSensor.readSealevelPressure(altitude_meters) / 100.0;
+            return BMP180::sealevelPressure(barometricSensor.readPressure(), altitude_meters) / 100.0;
         }
 
         /**
-         * @brief Set the reference height for calculating the sealevel pressure.
+         * @brief Set the reference height for calculating the sealevel pressure. With a wake cache the measured
+         * reference pressure is reused until the next cold start, so the height has to be part of its configuration.
          * 
          * @param height height above sealevel of current position
          */
         void setReferenceHeight(float height) {
+            if(wakeCache && wakeCache->referenced) {
+                referencePressure = wakeCache->referencePressure;
+                return;
+            }
             referencePressure = readSeaLevelPressure(height) * 100;
+            if(wakeCache) {
+                wakeCache->referencePressure = referencePressure;
+                wakeCache->referenced = true;
+            }
         }
 
         /**
@@ -295,7 +1396,7 @@ class ClimateSensor {
          * @return float altitude
          */
         float readAltitude() {
-            return barometricSensor.readAltitude(referencePressure);
+            return BMP180::altitude(barometricSensor.readPressure(), referencePressure);
         }
 
         /**
@@ -305,18 +1406,82 @@ class ClimateSensor {
              humiditySensor.reset();
         }
 
+        /**
+         * @brief Returns the number of I2C transactions of both sensors since the last call of resetBusTransactions().
+         * 
+         * @return uint32_t number of transactions
+         */
+        uint32_t busTransactions() {
+            return humiditySensor.transactions() + barometricSensor.transactions();
+        }
+
+        /**
+         * @brief Resets the I2C transaction counters, e.g. at the start of a measurement cycle.
+         * 
+         */
+        void resetBusTransactions() {
+            humiditySensor.resetTransactions();
+            barometricSensor.resetTransactions();
+        }
+
         /**
          * @brief Creates or appends a csv log file for the measurements. The file is named in format "log_d_m_y.csv".
          * For example: "log_27_5_2022.csv"
          */
         void log() {
-            logger.log(
-                readTemperature(),
-                readHumidity(),
-                readPressure(),
-                readSeaLevelPressure(readAltitude()),
-                readAltitude()
-            );
+            log(read());
+        }
+
+        /**
+         * @brief Logs a measurement snapshot taken with read().
+         * 
+         * @param reading climate measurement
+         * @return success/failure of logging
+         */
+        boolean log(const ClimateReading& reading) {
+            return logger.log(reading);
+        }
+
+        /**
+         * @brief Logs a sample taken earlier. The logger has to be started with begin() or beginLogger().
+         * 
+         * @param sample timestamped climate measurement
+         * @return success/failure of logging
+         */
+        boolean log(const ClimateSample& sample) {
+            return logger.log(sample);
+        }
+
+        /**
+         * @brief Takes a timestamped sample from one measurement snapshot.
+         * 
+         * @return ClimateSample sample
+         */
+        ClimateSample sample() {
+            return toSample(read());
+        }
+
+        /**
+         * @brief Takes a timestamped sample from a filtered burst, see read(filter).
+         * 
+         * @param filter filter state
+         * @return ClimateSample sample
+         */
+        template <typename Filter>
+        ClimateSample sample(Filter& filter) {
+            return toSample(read(filter));
+        }
+
+    private:
+        ClimateSample toSample(const ClimateReading& reading) {
+            ClimateSample sample;
+            sample.time = hal::epoch();
+            sample.temperature = reading.temperature;
+            sample.humidity = reading.humidity;
+            sample.pressure = reading.pressure;
+            sample.pressureAtSealevel = reading.pressureAtSealevel;
+            sample.height = reading.height;
+            return sample;
         }
 };
 
@@ -333,9 +1498,10 @@ class RTC {
          * 
          * @param ssid SSID of WiFi network
          * @param password password of WiFi network
+         * @return boolean true if the time was set
          */
-        static void set(const char* ssid, const char* password) {
+        static boolean set(const char* ssid, const char* password) {
             ClimateTimeStamp rtc(ssid, password);
-            rtc.setRealTimeClock();
+            return rtc.setRealTimeClock();
         }
 };
\ No newline at end of file
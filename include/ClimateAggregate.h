@@ -0,0 +1,221 @@
+/**
+ * @file ClimateAggregate.h
+ * @brief Running hourly and daily statistics (count, min, max, mean, standard deviation) of the five climate
+ * channels in constant memory. Depends only on the C library, so tools/ checks it against a batch computation over
+ * recorded logs with the same code.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <TextFormat.h>
+
+/**
+ * @brief Number of channels: temperature, humidity, pressure, pressure at sealevel and height.
+ */
+#define AGGREGATE_CHANNELS 5
+
+/**
+ * @brief Size of a buffer for one summary row of the summary csv.
+ */
+#define AGGREGATE_SUMMARY_SIZE (48 + AGGREGATE_CHANNELS * (12 + 4 * 32))
+
+/**
+ * @brief Length of an aggregation period.
+ *
+ */
+enum AggregatePeriod {
+    AGGREGATE_HOUR,
+    AGGREGATE_DAY
+};
+
+/**
+ * @brief Running statistics of one channel, updated with Welford's algorithm: mean and the sum of squared
+ * deviations are updated per value, so no cancellation happens like with a sum of squares. NAN values are not
+ * counted. Valid when zero initialised.
+ *
+ */
+struct RunningStatistics {
+    uint32_t count;
+    float min;
+    float max;
+    double mean;
+    double m2;
+
+    /**
+     * @brief Adds a value.
+     *
+     * @param value value, NAN is ignored
+     */
+    void add(float value) {
+        if(isnan(value)) {
+            return;
+        }
+        count++;
+        if(count == 1 || value < min) {
+            min = value;
+        }
+        if(count == 1 || value > max) {
+            max = value;
+        }
+        double delta = value - mean;
+        mean += delta / count;
+        m2 += delta * (value - mean);
+    }
+
+    /**
+     * @brief Returns the sample standard deviation.
+     *
+     * @return double standard deviation, 0 for less than two values
+     */
+    double deviation() const {
+        return count > 1 ? sqrt(m2 / (count - 1)) : 0;
+    }
+};
+
+/**
+ * @brief Accumulators of the current hour and day. The closed hour and day are kept until their summary row is
+ * written, e.g. while the SD card is not mounted during deep sleep; their start is 0 if there is none. Valid when
+ * zero initialised, so it can be declared with RTC_DATA_ATTR and survives deep sleep.
+ *
+ */
+struct AggregateState {
+    int64_t hourStart;
+    int64_t dayStart;
+    int64_t last;
+    RunningStatistics hour[AGGREGATE_CHANNELS];
+    RunningStatistics day[AGGREGATE_CHANNELS];
+    int64_t closedHourStart;
+    int64_t closedDayStart;
+    RunningStatistics closedHour[AGGREGATE_CHANNELS];
+    RunningStatistics closedDay[AGGREGATE_CHANNELS];
+};
+
+/**
+ * @brief A class for aggregating samples by local hour and day. The samples have to be added in time order; the
+ * first sample of a new hour or day closes the previous one and passes its statistics to a callback. A sample which
+ * is not newer than the last one is ignored, so samples written again after a failed flush are counted once.
+ *
+ * @code
+ * RTC_DATA_ATTR AggregateState aggregateState;
+ * ClimateAggregator aggregator(aggregateState);
+ * aggregator.add(time, timeInfo, values, [](AggregatePeriod period, time_t start, const RunningStatistics* channels) {
+ *     //write a summary row
+ * });
+ * @endcode
+ */
+class ClimateAggregator {
+
+    private:
+        AggregateState& _state;
+
+        static bool used(const RunningStatistics* channels) {
+            for(uint8_t i = 0; i < AGGREGATE_CHANNELS; i++) {
+                if(channels[i].count > 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static void clear(RunningStatistics* channels) {
+            memset(channels, 0, sizeof(RunningStatistics) * AGGREGATE_CHANNELS);
+        }
+
+    public:
+
+        /**
+         * @brief Construct a new ClimateAggregator object.
+         *
+         * @param state accumulators, usually in RTC memory
+         */
+        ClimateAggregator(AggregateState& state) : _state(state) {
+        }
+
+        /**
+         * @brief Adds a sample. If it belongs to a later hour or day than the accumulated samples, the closed
+         * periods are passed to the callback first, the hour before the day. A sample which is not newer than the
+         * last added one is ignored.
+         *
+         * @tparam Callback callable as void(AggregatePeriod period, time_t start, const RunningStatistics* channels)
+         * @param time time of the sample
+         * @param timeInfo local broken down time of the sample
+         * @param values temperature, humidity, pressure, pressure at sealevel and height
+         * @param closed called for every closed period
+         */
+        template <typename Callback>
+        void add(time_t time, const struct tm& timeInfo, const float values[AGGREGATE_CHANNELS], Callback closed) {
+            if((int64_t) time <= _state.last) {
+                return;
+            }
+            _state.last = time;
+            int64_t hourStart = (int64_t) time - timeInfo.tm_min * 60 - timeInfo.tm_sec;
+            int64_t dayStart = hourStart - timeInfo.tm_hour * 3600;
+            if(hourStart != _state.hourStart) {
+                if(used(_state.hour)) {
+                    closed(AGGREGATE_HOUR, (time_t) _state.hourStart, (const RunningStatistics*) _state.hour);
+                }
+                clear(_state.hour);
+                _state.hourStart = hourStart;
+            }
+            if(dayStart != _state.dayStart) {
+                if(used(_state.day)) {
+                    closed(AGGREGATE_DAY, (time_t) _state.dayStart, (const RunningStatistics*) _state.day);
+                }
+                clear(_state.day);
+                _state.dayStart = dayStart;
+            }
+            for(uint8_t i = 0; i < AGGREGATE_CHANNELS; i++) {
+                _state.hour[i].add(values[i]);
+                _state.day[i].add(values[i]);
+            }
+        }
+
+        /**
+         * @brief Returns the statistics of the current period.
+         *
+         * @param period AGGREGATE_HOUR or AGGREGATE_DAY
+         * @return const RunningStatistics* statistics of the channels
+         */
+        const RunningStatistics* current(AggregatePeriod period) const {
+            return period == AGGREGATE_HOUR ? _state.hour : _state.day;
+        }
+
+        /**
+         * @brief Writes one summary row: period, local start time, then count, min, max, mean and standard
+         * deviation of every channel, terminated by a newline.
+         *
+         * @param buffer buffer of at least AGGREGATE_SUMMARY_SIZE characters
+         * @param period AGGREGATE_HOUR or AGGREGATE_DAY
+         * @param startInfo local broken down start time of the period
+         * @param channels statistics of the channels
+         * @return size_t number of characters
+         */
+        static size_t formatSummary(char* buffer, AggregatePeriod period, const struct tm& startInfo, const RunningStatistics* channels) {
+            size_t length = 0;
+            const char* name = period == AGGREGATE_HOUR ? "hour," : "day,";
+            strcpy(buffer, name);
+            length += strlen(name);
+            length += TextFormat::formatTimestamp(buffer + length, startInfo);
+            for(uint8_t i = 0; i < AGGREGATE_CHANNELS; i++) {
+                const RunningStatistics& channel = channels[i];
+                buffer[length++] = ',';
+                length += TextFormat::formatUnsigned(buffer + length, channel.count);
+                float values[4] = {channel.min, channel.max, (float) channel.mean, (float) channel.deviation()};
+                for(uint8_t j = 0; j < 4; j++) {
+                    buffer[length++] = ',';
+                    length += TextFormat::formatFixed(buffer + length, channel.count > 0 ? values[j] : NAN, 2);
+                }
+            }
+            buffer[length++] = '\n';
+            buffer[length] = '\0';
+            return length;
+        }
+};
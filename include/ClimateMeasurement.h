@@ -0,0 +1,471 @@
+/**
+ * @file ClimateMeasurement.h
+ * @brief Non-blocking measurement engine which runs the HTU21DF and BMP180 conversions at the same time. Both
+ * sensors declare their channels for SensorSet.h, ClimateMeasurement composes them.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <HAL.h>
+#include <HTU21DF.h>
+#include <BMP180.h>
+#include <SensorFilter.h>
+#include <SensorSet.h>
+
+/**
+ * @brief Snapshot of one measurement cycle. All values are derived from one HTU21DF temperature and humidity
+ * conversion and one BMP180 temperature and pressure conversion.
+ *
+ */
+struct ClimateReading {
+    float temperature;
+    float humidity;
+    float pressure;
+    float pressureAtSealevel;
+    float height;
+    float temperatureHTU21DF;
+    float temperatureBMP085;
+};
+
+/**
+ * @brief Streaming filters of the channels of a reading, see SensorFilter.h. The temperature filter fuses the
+ * HTU21DF and the BMP180 temperature; altitude and sealevel pressure are derived from the filtered pressure. Valid
+ * when zero initialised, so it can be declared with RTC_DATA_ATTR. time is the epoch of the last burst, ClimateSensor
+ * resets the filters when the next burst follows after more than the filter gap, see ClimateSensor::setFilterGap().
+ *
+ * @tparam TemperatureFilter two input filter, e.g. KalmanFusion or MeanFusion
+ * @tparam HumidityFilter filter of the humidity
+ * @tparam PressureFilter filter of the pressure in hPa
+ */
+template <typename TemperatureFilter, typename HumidityFilter, typename PressureFilter>
+struct ClimateFilter {
+    TemperatureFilter temperature;
+    HumidityFilter humidity;
+    PressureFilter pressure;
+    ClimateReading last;
+    time_t time;
+
+    /**
+     * @brief Passes one reading through the filters.
+     *
+     * @param reading unfiltered reading
+     */
+    void add(const ClimateReading& reading) {
+        last = reading;
+        temperature.update(reading.temperatureHTU21DF, reading.temperatureBMP085);
+        humidity.update(reading.humidity);
+        pressure.update(reading.pressure);
+    }
+
+    /**
+     * @brief Returns the filtered reading. The sensor temperatures are the ones of the last reading.
+     *
+     * @param referencePressure sealevel pressure in Pa used for the altitude
+     * @return ClimateReading filtered reading
+     */
+    ClimateReading result(float referencePressure) const {
+        ClimateReading reading = last;
+        reading.temperature = temperature.output();
+        reading.humidity = humidity.output();
+        reading.pressure = pressure.output();
+        reading.height = Barometric::altitude(reading.pressure * 100, referencePressure);
+        reading.pressureAtSealevel = Barometric::sealevelPressure(reading.pressure * 100, reading.height) / 100;
+        return reading;
+    }
+
+    /**
+     * @brief Forgets all values, e.g. after a change of the oversampling.
+     *
+     */
+    void reset() {
+        temperature.reset();
+        humidity.reset();
+        pressure.reset();
+    }
+};
+
+/**
+ * @brief Retry interval in microseconds if the HTU21DF does not acknowledge a read because its conversion is not
+ * finished yet.
+ */
+#define HTU21DF_RETRY_MICROS 1000
+
+/**
+ * @brief Number of read retries before a HTU21DF value is reported as NAN.
+ */
+#define HTU21DF_MAX_RETRIES 10
+
+/**
+ * @brief Microseconds added to a BMP180 conversion time. The time passed to a step of the state machine is taken
+ * before the I2C transfers of that step, so the conversion starts up to the transfers of both sensors later (below
+ * 1 ms at 100 kHz); the BMP180 does not signal an unfinished conversion and would return the previous result.
+ */
+#define BMP180_BUS_MICROS 1000
+
+/**
+ * @brief States of a sensor during a measurement.
+ *
+ */
+enum MeasurementState {
+    MEASUREMENT_IDLE,
+    MEASUREMENT_TEMPERATURE,
+    MEASUREMENT_HUMIDITY,
+    MEASUREMENT_PRESSURE,
+    MEASUREMENT_DONE
+};
+
+/**
+ * @brief The HTU21DF as sensor of a SensorSet: temperature and then humidity. A value whose conversion failed is
+ * NAN.
+ *
+ */
+class HTU21DFChannels {
+
+    private:
+        HTU21DF* _sensor;
+        MeasurementState _state = MEASUREMENT_IDLE;
+        uint32_t _deadline = 0;
+        uint8_t _retries = 0;
+        uint16_t _rawTemperature = 0;
+        uint16_t _rawHumidity = 0;
+        boolean _validTemperature = false;
+        boolean _validHumidity = false;
+
+    public:
+        static const uint8_t channels = 2;
+
+        enum Channel {
+            TEMPERATURE,
+            HUMIDITY
+        };
+
+        static constexpr SensorChannel channel(uint8_t index) {
+            return index == TEMPERATURE
+                ? SensorChannel{"temperatureHTU21DF", "°C", 2, 100}
+                : SensorChannel{"humidity", "%", 2, 100};
+        }
+
+        /**
+         * @brief Construct a new HTU21DFChannels object.
+         *
+         * @param sensor initialised HTU21DF
+         */
+        HTU21DFChannels(HTU21DF& sensor) : _sensor(&sensor) {
+        }
+
+        void start(uint32_t now) {
+            _retries = 0;
+            _validTemperature = false;
+            _validHumidity = false;
+            _sensor->startTemperature();
+            _state = MEASUREMENT_TEMPERATURE;
+            _deadline = now + HTU21DF_TEMPERATURE_MILLIS * 1000;
+        }
+
+        void step(uint32_t now) {
+            if((_state != MEASUREMENT_TEMPERATURE && _state != MEASUREMENT_HUMIDITY) || (int32_t) (now - _deadline) < 0) {
+                return;
+            }
+            uint16_t raw = 0;
+            boolean valid = _sensor->readRaw(raw);
+            if(!valid && ++_retries <= HTU21DF_MAX_RETRIES) {
+                _deadline = now + HTU21DF_RETRY_MICROS;
+                return;
+            }
+            _retries = 0;
+            if(_state == MEASUREMENT_TEMPERATURE) {
+                _rawTemperature = raw;
+                _validTemperature = valid;
+                _sensor->startHumidity();
+                _state = MEASUREMENT_HUMIDITY;
+                _deadline = now + HTU21DF_HUMIDITY_MILLIS * 1000;
+            } else {
+                _rawHumidity = raw;
+                _validHumidity = valid;
+                _state = MEASUREMENT_DONE;
+            }
+        }
+
+        uint32_t nextStep(uint32_t now) {
+            if(_state != MEASUREMENT_TEMPERATURE && _state != MEASUREMENT_HUMIDITY) {
+                return UINT32_MAX;
+            }
+            return (int32_t) (now - _deadline) >= 0 ? 0 : _deadline - now;
+        }
+
+        boolean ready() {
+            return _state == MEASUREMENT_DONE;
+        }
+
+        MeasurementState state() {
+            return _state;
+        }
+
+        void values(float* values) {
+            values[TEMPERATURE] = _validTemperature ? HTU21DF::temperature(_rawTemperature) : NAN;
+            values[HUMIDITY] = _validHumidity ? HTU21DF::humidity(_rawHumidity) : NAN;
+        }
+};
+
+/**
+ * @brief The BMP180 as sensor of a SensorSet: temperature and then pressure with the oversampling of the driver.
+ * The compensated pressure is an integer in Pa, so the float channel is exact.
+ *
+ */
+class BMP180Channels {
+
+    private:
+        BMP180* _sensor;
+        MeasurementState _state = MEASUREMENT_IDLE;
+        uint32_t _deadline = 0;
+        int32_t _rawTemperature = 0;
+        int32_t _rawPressure = 0;
+
+    public:
+        static const uint8_t channels = 2;
+
+        enum Channel {
+            TEMPERATURE,
+            PRESSURE
+        };
+
+        static constexpr SensorChannel channel(uint8_t index) {
+            return index == TEMPERATURE
+                ? SensorChannel{"temperatureBMP180", "°C", 1, 10}
+                : SensorChannel{"pressure", "Pa", 0, 1};
+        }
+
+        /**
+         * @brief Construct a new BMP180Channels object.
+         *
+         * @param sensor initialised BMP180
+         */
+        BMP180Channels(BMP180& sensor) : _sensor(&sensor) {
+        }
+
+        void start(uint32_t now) {
+            _sensor->startTemperature();
+            _state = MEASUREMENT_TEMPERATURE;
+            _deadline = now + _sensor->temperatureConversionMicros() + BMP180_BUS_MICROS;
+        }
+
+        void step(uint32_t now) {
+            if((_state != MEASUREMENT_TEMPERATURE && _state != MEASUREMENT_PRESSURE) || (int32_t) (now - _deadline) < 0) {
+                return;
+            }
+            if(_state == MEASUREMENT_TEMPERATURE) {
+                _rawTemperature = _sensor->readTemperatureResult();
+                _sensor->startPressure();
+                _state = MEASUREMENT_PRESSURE;
+                _deadline = now + _sensor->pressureConversionMicros() + BMP180_BUS_MICROS;
+            } else {
+                _rawPressure = _sensor->readPressureResult();
+                _state = MEASUREMENT_DONE;
+            }
+        }
+
+        uint32_t nextStep(uint32_t now) {
+            if(_state != MEASUREMENT_TEMPERATURE && _state != MEASUREMENT_PRESSURE) {
+                return UINT32_MAX;
+            }
+            return (int32_t) (now - _deadline) >= 0 ? 0 : _deadline - now;
+        }
+
+        boolean ready() {
+            return _state == MEASUREMENT_DONE;
+        }
+
+        MeasurementState state() {
+            return _state;
+        }
+
+        void values(float* values) {
+            values[TEMPERATURE] = _sensor->compensateTemperature(_rawTemperature);
+            values[PRESSURE] = _sensor->compensatePressure(_rawTemperature, _rawPressure);
+        }
+};
+
+/**
+ * @brief The sensors of the climate logger.
+ */
+typedef SensorSet<HTU21DFChannels, BMP180Channels> ClimateSensorSet;
+
+/**
+ * @brief The channels of the climate log, computed by ClimateMeasurement::result() from the channels of
+ * ClimateSensorSet. Declared like a sensor of a SensorSet, but never measured itself: the descriptions follow the
+ * measured channels, the fused temperature keeps the finer resolution of both thermometers and the pressures are
+ * the barometer's in hPa. Only the height has a description of its own.
+ *
+ */
+struct ClimateLogChannels {
+    static const uint8_t channels = 5;
+
+    enum Channel {
+        TEMPERATURE,
+        HUMIDITY,
+        PRESSURE,
+        PRESSURE_AT_SEALEVEL,
+        HEIGHT
+    };
+
+    static constexpr SensorChannel channel(uint8_t index) {
+        return index == TEMPERATURE
+                ? finer("temperature", measured<0>(HTU21DFChannels::TEMPERATURE), measured<1>(BMP180Channels::TEMPERATURE))
+            : index == HUMIDITY ? measured<0>(HTU21DFChannels::HUMIDITY)
+            : index == PRESSURE ? hectopascal("pressure", measured<1>(BMP180Channels::PRESSURE))
+            : index == PRESSURE_AT_SEALEVEL ? hectopascal("pressureAtSealevel", measured<1>(BMP180Channels::PRESSURE))
+            : SensorChannel{"height", "m", 2, 100};
+    }
+
+    private:
+        template <size_t Index>
+        static constexpr SensorChannel measured(uint8_t index) {
+            return ClimateSensorSet::channel(ClimateSensorSet::Sensor<Index>::offset + index);
+        }
+
+        static constexpr SensorChannel finer(const char* name, SensorChannel first, SensorChannel second) {
+            return first.decimals >= second.decimals
+                ? SensorChannel{name, first.unit, first.decimals, first.scale}
+                : SensorChannel{name, second.unit, second.decimals, second.scale};
+        }
+
+        static constexpr SensorChannel hectopascal(const char* name, SensorChannel pascal) {
+            return SensorChannel{name, "hPa", (uint8_t) (pascal.decimals + 2), pascal.scale * 100};
+        }
+};
+
+/**
+ * @brief Record and csv format of the climate log.
+ */
+typedef SensorSet<ClimateLogChannels> ClimateLogSet;
+
+/**
+ * @brief A state machine measuring with both sensors in parallel. The HTU21DF runs temperature and then humidity,
+ * while the BMP180 runs temperature and then pressure, so a cycle takes as long as the slower sensor instead of the
+ * sum of all conversions. Time is passed in by the caller, which can do other work or sleep until nextStep().
+ *
+ * @code
+ * measurement.start(micros());
+ * while(!measurement.step(micros())) {
+ *     delayMicroseconds(measurement.nextStep(micros()));
+ * }
+ * ClimateReading reading = measurement.result(101325);
+ * @endcode
+ */
+class ClimateMeasurement {
+
+    public:
+
+        /**
+         * @brief States of each sensor.
+         *
+         */
+        enum State {
+            IDLE = MEASUREMENT_IDLE,
+            TEMPERATURE = MEASUREMENT_TEMPERATURE,
+            HUMIDITY = MEASUREMENT_HUMIDITY,
+            PRESSURE = MEASUREMENT_PRESSURE,
+            DONE = MEASUREMENT_DONE
+        };
+
+    private:
+        static const uint8_t humidityOffset = ClimateSensorSet::Sensor<0>::offset;
+        static const uint8_t barometricOffset = ClimateSensorSet::Sensor<1>::offset;
+        ClimateSensorSet _sensors;
+
+    public:
+
+        /**
+         * @brief Construct a new ClimateMeasurement object for two initialised sensors.
+         *
+         * @param humiditySensor HTU21DF sensor
+         * @param barometricSensor BMP180 sensor
+         */
+        ClimateMeasurement(HTU21DF& humiditySensor, BMP180& barometricSensor)
+            : _sensors(HTU21DFChannels(humiditySensor), BMP180Channels(barometricSensor)) {
+        }
+
+        /**
+         * @brief Starts the first conversion of both sensors.
+         *
+         * @param now current time in microseconds
+         */
+        void start(uint32_t now) {
+            _sensors.start(now);
+        }
+
+        /**
+         * @brief Collects finished conversions and starts the following ones. Does nothing while all running
+         * conversions are still busy, so it can be called as often as desired.
+         *
+         * @param now current time in microseconds
+         * @return boolean true if the measurement is complete
+         */
+        boolean step(uint32_t now) {
+            return _sensors.step(now);
+        }
+
+        /**
+         * @brief Returns the time until the next conversion finishes.
+         *
+         * @param now current time in microseconds
+         * @return uint32_t microseconds until step() has something to do, 0 if it should be called now
+         */
+        uint32_t nextStep(uint32_t now) {
+            return _sensors.nextStep(now);
+        }
+
+        /**
+         * @brief Checks if both sensors finished.
+         *
+         * @return boolean true if the measurement is complete
+         */
+        boolean ready() {
+            return _sensors.ready();
+        }
+
+        /**
+         * @brief Returns the state of the HTU21DF.
+         *
+         * @return State IDLE, TEMPERATURE, HUMIDITY or DONE
+         */
+        State humidityState() {
+            return (State) _sensors.get<0>().state();
+        }
+
+        /**
+         * @brief Returns the state of the BMP180.
+         *
+         * @return State IDLE, TEMPERATURE, PRESSURE or DONE
+         */
+        State barometricState() {
+            return (State) _sensors.get<1>().state();
+        }
+
+        /**
+         * @brief Calculates the reading from the collected conversions. Values of a HTU21DF conversion that failed
+         * are NAN.
+         *
+         * @param referencePressure sealevel pressure in Pa used for the altitude
+         * @return ClimateReading snapshot of the measurement cycle
+         */
+        ClimateReading result(float referencePressure) {
+            float values[ClimateSensorSet::channels];
+            _sensors.values(values);
+            ClimateReading reading;
+            float pressure = values[barometricOffset + BMP180Channels::PRESSURE];
+            reading.temperatureHTU21DF = values[humidityOffset + HTU21DFChannels::TEMPERATURE];
+            reading.humidity = values[humidityOffset + HTU21DFChannels::HUMIDITY];
+            reading.temperatureBMP085 = values[barometricOffset + BMP180Channels::TEMPERATURE];
+            reading.temperature = (reading.temperatureHTU21DF + reading.temperatureBMP085) / 2;
+            reading.pressure = pressure / 100.0;
+            reading.height = BMP180::altitude(pressure, referencePressure);
+            reading.pressureAtSealevel = BMP180::sealevelPressure(pressure, reading.height) / 100.0;
+            return reading;
+        }
+};
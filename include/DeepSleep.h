@@ -1,43 +1,283 @@
-#include <Arduino.h>
+#pragma once
 
-    const int SECONDS = 1000000;
-    const int MINUTES = 60000000;
-    const int HOURS = 3600000000;
+#include <HAL.h>
+
+    const uint64_t SECONDS = 1000000ULL;
+    const uint64_t MINUTES = 60000000ULL;
+    const uint64_t HOURS = 3600000000ULL;
+
+    /**
+     * @brief Shortest deep sleep of the aligned schedule. If the next boundary is closer, the one after it is used.
+     */
+    #define ALIGNED_SLEEP_MIN_MICROS 100000
 
     /**
      * @brief Enables deepsleep of the ESP32 and wakes it up after the given time.
-     * 
+     *
      * @param time amount of time units to sleep
      * @param mode unit of time, available: SECONDS, MINUTES, HOURS
      */
-    void deepSleep(int time, int unit) {
-        esp_sleep_enable_timer_wakeup(time * unit);
-        esp_deep_sleep_start();
+    inline void deepSleep(uint64_t time, uint64_t unit) {
+        hal::deepSleep(time * unit);
     }
 
     /**
      * @brief Enables deepsleep of the ESP32 and wakes it up after the given time.
-     * 
+     *
      * @param seconds wake up after given seconds
      */
-    void deepSleepForSeconds(int seconds) {
+    inline void deepSleepForSeconds(uint32_t seconds) {
         deepSleep(seconds, SECONDS);
     }
 
     /**
      * @brief Enables deepsleep of the ESP32 and wakes it up after the given time.
-     * 
+     *
      * @param seconds wake up after given minutes
      */
-    void deepSleepForMinutes(int minutes) {
+    inline void deepSleepForMinutes(uint32_t minutes) {
         deepSleep(minutes, MINUTES);
     }
 
     /**
      * @brief Enables deepsleep of the ESP32 and wakes it up after the given time.
-     * 
+     *
      * @param seconds wake up after given hours
      */
-    void deepSleepForHours(int hours) {
+    inline void deepSleepForHours(uint32_t hours) {
         deepSleep(hours, HOURS);
-    }
\ No newline at end of file
+    }
+
+    /**
+     * @brief State of the aligned schedule. Valid when zero initialised, so it can be declared with RTC_DATA_ATTR.
+     *
+     */
+    struct AlignedSleepState {
+        int64_t target;
+        int64_t sleepStart;
+        uint64_t requested;
+        int32_t latency;
+        float drift;
+        int32_t error;
+        float clockDrift;
+    };
+
+    /**
+     * @brief A class for waking up at multiples of an interval of the wall clock, e.g. at hh:mm:00, hh:mm:10, ...
+     * instead of a fixed time after the work is done. The sleep time is computed from the wall clock right before
+     * sleeping, so the awake time is subtracted. The boot time from the timer wakeup to setup() is measured with
+     * hal::micros64() and compensated.
+     *
+     * The deep sleep timer runs on the RTC slow clock, which also keeps the wall clock during deep sleep, so the
+     * drift of this clock can not be seen by comparing the sleep with the wall clock. It has to be measured against a
+     * time server, e.g. by TimeSync, and passed in with setClockDrift(); the wall clock is expected to be corrected by
+     * the same estimate after the wakeup. What is learned from earlier sleeps is only the error of the timer against
+     * the wall clock kept during the sleep.
+     *
+     * @code
+     * RTC_DATA_ATTR AlignedSleepState alignedSleepState;
+     * AlignedSleep alignedSleep(alignedSleepState);
+     * alignedSleep.wake();                         //first thing in setup()
+     * timeSync.update();                           //corrects the RTC
+     * alignedSleep.setClockDrift(timeSync.drift());
+     * alignedSleep.sleep(10);                      //wakes up at the next multiple of 10 s
+     * @endcode
+     */
+    class AlignedSleep {
+
+        private:
+            AlignedSleepState& _state;
+
+        public:
+
+            /**
+             * @brief Construct a new AlignedSleep object.
+             *
+             * @param state state, usually declared with RTC_DATA_ATTR
+             */
+            AlignedSleep(AlignedSleepState& state) : _state(state) {
+            }
+
+            /**
+             * @brief Measures how far this wakeup missed its boundary and updates the boot time and drift estimates.
+             * Call it at the start of setup(). Does nothing after a boot that did not follow sleep().
+             *
+             */
+            void wake() {
+                if(_state.sleepStart == 0) {
+                    return;
+                }
+                int64_t now = hal::epochMicros();
+                int64_t latency = hal::micros64();
+                int64_t slept = now - latency - _state.sleepStart;
+                //the wall clock gained the drift of the slow clock during the sleep, it is corrected after wake()
+                int64_t gain = (int64_t) (slept * (double) _state.clockDrift / (1 + (double) _state.clockDrift));
+                int64_t error = now - gain - _state.target;
+                _state.sleepStart = 0;
+                if(!hal::timerWakeup() || slept <= 0 || error > (int64_t) _state.requested || -error > (int64_t) _state.requested) {
+                    //other wakeup cause or the wall clock was set in between
+                    return;
+                }
+                _state.error = error;
+                _state.latency = _state.latency == 0 ? latency : _state.latency + (latency - _state.latency) / 4;
+                if(_state.requested >= SECONDS) {
+                    float drift = (float) ((double) (slept - (int64_t) _state.requested) / _state.requested);
+                    _state.drift += (drift - _state.drift) / 4;
+                }
+            }
+
+            /**
+             * @brief Sets the relative error of the RTC slow clock against a time server. The sleep timer counts the
+             * same clock, so a sleep ends early by this factor if the clock gains.
+             *
+             * @param drift drift, e.g. TimeSync::drift(); 50e-6 if the RTC gains 50 µs per second
+             */
+            void setClockDrift(float drift) {
+                _state.clockDrift = drift;
+            }
+
+            /**
+             * @brief Returns the time to sleep until the next multiple of the interval, corrected by the learned
+             * latency, the drift of the timer and the drift of the slow clock.
+             *
+             * @param intervalSeconds interval between two wakeups
+             * @return uint64_t sleep duration in microseconds
+             */
+            uint64_t sleepMicros(uint32_t intervalSeconds) {
+                int64_t interval = intervalSeconds > 0 ? intervalSeconds * SECONDS : SECONDS;
+                int64_t now = hal::epochMicros();
+                int64_t target = (now / interval + 1) * interval;
+                if(target == _state.target) {
+                    //woke up before the boundary of the last sleep
+                    target += interval;
+                }
+                double scale = (1 + (double) _state.clockDrift) / (1 + (double) _state.drift);
+                while((target - now - _state.latency) * scale < ALIGNED_SLEEP_MIN_MICROS) {
+                    target += interval;
+                }
+                _state.target = target;
+                _state.sleepStart = now;
+                _state.requested = (target - now - _state.latency) * scale;
+                return _state.requested;
+            }
+
+            /**
+             * @brief Enters deep sleep until the next multiple of the interval. Does not return.
+             *
+             * @param intervalSeconds interval between two wakeups
+             */
+            void sleep(uint32_t intervalSeconds) {
+                hal::deepSleep(sleepMicros(intervalSeconds));
+            }
+
+            /**
+             * @brief Returns the deviation of the last timer wakeup from its boundary.
+             *
+             * @return int32_t deviation in microseconds, positive if too late
+             */
+            int32_t error() {
+                return _state.error;
+            }
+
+            /**
+             * @brief Returns the learned time from the timer wakeup to wake().
+             *
+             * @return int32_t latency in microseconds
+             */
+            int32_t latency() {
+                return _state.latency;
+            }
+
+            /**
+             * @brief Returns the learned relative error of the sleep timer against the wall clock kept during the
+             * sleep, without the drift of the slow clock.
+             *
+             * @return float drift, e.g. 0.01 if the timer sleeps 1 % too long
+             */
+            float drift() {
+                return _state.drift;
+            }
+    };
+
+    /**
+     * @brief Waits in light sleep instead of delay(): RAM, tasks and peripherals are kept, both cores are stopped
+     * until the time has passed or the wakeup pin changes, so a toggle switch takes effect at once. While it waits
+     * for the SD writer, the CPU runs at the idle frequency.
+     *
+     * @code
+     * LightSleep lightSleep(mode, HIGH);
+     * lightSleep.sleep(10, pipeline);  //in loop()
+     * @endcode
+     */
+    class LightSleep {
+
+        private:
+            uint8_t _pin;
+            uint8_t _level;
+            uint32_t _idleMhz;
+            uint32_t _activeMhz;
+
+        public:
+
+            /**
+             * @brief Construct a new LightSleep object.
+             *
+             * @param pin GPIO which ends the sleep, has to be an RTC GPIO
+             * @param level level of the pin which ends the sleep
+             * @param idleMhz CPU frequency while waiting for the writer
+             * @param activeMhz CPU frequency after the wakeup
+             */
+            LightSleep(uint8_t pin, uint8_t level, uint32_t idleMhz = 80, uint32_t activeMhz = 240) {
+                _pin = pin;
+                _level = level;
+                _idleMhz = idleMhz;
+                _activeMhz = activeMhz;
+            }
+
+            /**
+             * @brief Sleeps until the time has passed or the pin has the wakeup level. Light sleep stops the writer
+             * task as well, so the writer gets the start of the interval to hand its samples to the SD card, and the
+             * sleep ends early when the writer has to flush buffered records.
+             *
+             * @tparam Writer class with boolean idle() and uint64_t pollDue(), e.g. LogPipeline
+             * @param seconds time since the call to wake up at
+             * @param writer writer which has to be idle before the cores are stopped
+             * @return boolean true if the pin ended the sleep
+             */
+            template <typename Writer>
+            boolean sleep(uint32_t seconds, Writer& writer) {
+                return sleepUntil(hal::micros64() + seconds * SECONDS, writer);
+            }
+
+            /**
+             * @brief Sleeps until a time of the main clock, see sleep().
+             *
+             * @tparam Writer class with boolean idle() and uint64_t pollDue(), e.g. LogPipeline
+             * @param end hal::micros64() to wake up at
+             * @param writer writer which has to be idle before the cores are stopped
+             * @return boolean true if the pin ended the sleep
+             */
+            template <typename Writer>
+            boolean sleepUntil(uint64_t end, Writer& writer) {
+                hal::setCpuMhz(_idleMhz);
+                while(!writer.idle() && hal::micros64() < end) {
+                    if(digitalRead(_pin) == _level) {
+                        hal::setCpuMhz(_activeMhz);
+                        return true;
+                    }
+                    delay(10);
+                }
+                boolean woken = false;
+                uint64_t now = hal::micros64();
+                if(writer.idle() && writer.pollDue() < end) {
+                    end = writer.pollDue();
+                }
+                if(now < end) {
+                    Serial.flush();
+                    now = hal::micros64();
+                    woken = now < end && hal::lightSleep(end - now, _pin, _level);
+                }
+                hal::setCpuMhz(_activeMhz);
+                return woken;
+            }
+    };
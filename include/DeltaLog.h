@@ -0,0 +1,231 @@
+/**
+ * @file DeltaLog.h
+ * @brief Compressed binary format for climate logs: consecutive records are stored as zig-zag varint deltas of the
+ * fixed point values of BinaryLog.h. It only depends on the C library, so the host tools in tools/ use the same
+ * code for decoding.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * A file starts with an 8 byte header: the magic "CDLT", the format version and three reserved bytes. It is
+ * followed by blocks. Every block starts with the sync word 0xD17A, the number of records, the length of the
+ * payload and the CRC-32 of the payload. All integers of the headers are little endian. The first record of the
+ * payload is a keyframe: its time and values as deltas from zero. Every further record holds the deltas from its
+ * predecessor. A delta is the difference modulo 2^32, zig-zag mapped (0, -1, 1, -2, ... to 0, 1, 2, 3, ...) and
+ * stored as varint (7 bits per byte, least significant group first, high bit set on all but the last byte).
+ * Blocks do not depend on each other, so a corrupt block only loses its own records.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <BinaryLog.h>
+#include <CRC32.h>
+
+#define DELTA_LOG_VERSION 1
+#define DELTA_LOG_HEADER_SIZE 8
+#define DELTA_LOG_BLOCK_SYNC 0xD17A
+#define DELTA_LOG_BLOCK_HEADER_SIZE 10
+
+/**
+ * @brief Maximum payload of a block. Together with the encoder state it has to fit into RTC memory.
+ */
+#ifndef DELTA_LOG_BLOCK_CAPACITY
+#define DELTA_LOG_BLOCK_CAPACITY 240
+#endif
+
+/**
+ * @brief Maximum size of an encoded record: time and three 32 bit values with 5 bytes, two 16 bit values with 3.
+ */
+#define DELTA_LOG_RECORD_MAX_SIZE 26
+
+/**
+ * @brief Encoder state: the previous record and the open block. Valid when zero initialised, so it can be declared
+ * with RTC_DATA_ATTR.
+ *
+ */
+struct DeltaState {
+    BinaryLogRecord previous;
+    uint16_t count;
+    uint16_t length;
+    uint8_t payload[DELTA_LOG_BLOCK_CAPACITY];
+};
+
+/**
+ * @brief Static methods for encoding and decoding delta compressed logs.
+ *
+ */
+class DeltaLog {
+
+    private:
+        static void put16(uint8_t* buffer, uint16_t value) {
+            buffer[0] = value;
+            buffer[1] = value >> 8;
+        }
+
+        static uint16_t get16(const uint8_t* buffer) {
+            return buffer[0] | (buffer[1] << 8);
+        }
+
+        static uint32_t get32(const uint8_t* buffer) {
+            return get16(buffer) | ((uint32_t) get16(buffer + 2) << 16);
+        }
+
+        static size_t putDelta(uint8_t* buffer, uint32_t value, uint32_t previous) {
+            int32_t delta = (int32_t) (value - previous);
+            uint32_t zigzag = ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31);
+            size_t length = 0;
+            while(zigzag >= 0x80) {
+                buffer[length++] = zigzag | 0x80;
+                zigzag >>= 7;
+            }
+            buffer[length++] = zigzag;
+            return length;
+        }
+
+        static size_t getDelta(const uint8_t* buffer, size_t length, uint32_t previous, uint32_t& value) {
+            uint32_t zigzag = 0;
+            for(size_t i = 0; i < length && i < 5; i++) {
+                zigzag |= (uint32_t) (buffer[i] & 0x7F) << (7 * i);
+                if(!(buffer[i] & 0x80)) {
+                    value = previous + ((zigzag >> 1) ^ (0 - (zigzag & 1)));
+                    return i + 1;
+                }
+            }
+            return 0;
+        }
+
+        static size_t encodeRecord(const BinaryLogRecord& record, const BinaryLogRecord& previous, uint8_t* buffer) {
+            size_t length = putDelta(buffer, record.time, previous.time);
+            length += putDelta(buffer + length, (uint32_t) (int32_t) record.temperature, (uint32_t) (int32_t) previous.temperature);
+            length += putDelta(buffer + length, (uint32_t) (int32_t) record.humidity, (uint32_t) (int32_t) previous.humidity);
+            length += putDelta(buffer + length, record.pressure, previous.pressure);
+            length += putDelta(buffer + length, record.pressureAtSealevel, previous.pressureAtSealevel);
+            length += putDelta(buffer + length, record.height, previous.height);
+            return length;
+        }
+
+    public:
+
+        /**
+         * @brief Writes the file header.
+         *
+         * @param buffer buffer of at least DELTA_LOG_HEADER_SIZE bytes
+         * @return size_t size of the header
+         */
+        static size_t writeHeader(uint8_t* buffer) {
+            memcpy(buffer, "CDLT", 4);
+            buffer[4] = DELTA_LOG_VERSION;
+            buffer[5] = 0;
+            buffer[6] = 0;
+            buffer[7] = 0;
+            return DELTA_LOG_HEADER_SIZE;
+        }
+
+        /**
+         * @brief Checks the file header.
+         *
+         * @param buffer start of the file
+         * @param length length of the buffer
+         * @return bool true if the file is a delta log of a supported version
+         */
+        static bool checkHeader(const uint8_t* buffer, size_t length) {
+            return length >= DELTA_LOG_HEADER_SIZE && memcmp(buffer, "CDLT", 4) == 0 && buffer[4] == DELTA_LOG_VERSION;
+        }
+
+        /**
+         * @brief Adds a record to the open block of the encoder.
+         *
+         * @param state encoder state
+         * @param record record
+         * @return bool false if the block is full, then it has to be closed first
+         */
+        static bool add(DeltaState& state, const BinaryLogRecord& record) {
+            if(state.length + DELTA_LOG_RECORD_MAX_SIZE > DELTA_LOG_BLOCK_CAPACITY || state.count == UINT16_MAX) {
+                return false;
+            }
+            BinaryLogRecord zero = {};
+            state.length += encodeRecord(record, state.count == 0 ? zero : state.previous, state.payload + state.length);
+            state.previous = record;
+            state.count++;
+            return true;
+        }
+
+        /**
+         * @brief Writes the open block and starts a new one, which begins with a keyframe.
+         *
+         * @param state encoder state
+         * @param buffer buffer of at least DELTA_LOG_BLOCK_HEADER_SIZE + DELTA_LOG_BLOCK_CAPACITY bytes
+         * @return size_t size of the block, 0 if the block was empty
+         */
+        static size_t close(DeltaState& state, uint8_t* buffer) {
+            if(state.count == 0) {
+                return 0;
+            }
+            put16(buffer, DELTA_LOG_BLOCK_SYNC);
+            put16(buffer + 2, state.count);
+            put16(buffer + 4, state.length);
+            uint32_t crc = crc32(state.payload, state.length);
+            put16(buffer + 6, crc);
+            put16(buffer + 8, crc >> 16);
+            memcpy(buffer + DELTA_LOG_BLOCK_HEADER_SIZE, state.payload, state.length);
+            size_t size = DELTA_LOG_BLOCK_HEADER_SIZE + state.length;
+            state.count = 0;
+            state.length = 0;
+            return size;
+        }
+
+        /**
+         * @brief Decodes one block.
+         *
+         * @param buffer start of the block
+         * @param length available bytes
+         * @param records output records, maxCount entries
+         * @param maxCount capacity of records
+         * @param count number of decoded records
+         * @return size_t size of the block, 0 if there is no valid block at the start of the buffer
+         */
+        static size_t decodeBlock(const uint8_t* buffer, size_t length, BinaryLogRecord* records, uint16_t maxCount, uint16_t& count) {
+            count = 0;
+            if(length < DELTA_LOG_BLOCK_HEADER_SIZE || get16(buffer) != DELTA_LOG_BLOCK_SYNC) {
+                return 0;
+            }
+            uint16_t blockCount = get16(buffer + 2);
+            uint16_t payloadLength = get16(buffer + 4);
+            size_t size = DELTA_LOG_BLOCK_HEADER_SIZE + payloadLength;
+            const uint8_t* payload = buffer + DELTA_LOG_BLOCK_HEADER_SIZE;
+            if(blockCount == 0 || blockCount > maxCount || size > length || crc32(payload, payloadLength) != get32(buffer + 6)) {
+                return 0;
+            }
+            BinaryLogRecord previous = {};
+            size_t position = 0;
+            for(uint16_t i = 0; i < blockCount; i++) {
+                uint32_t values[6];
+                uint32_t previousValues[6] = {previous.time, (uint32_t) (int32_t) previous.temperature,
+                    (uint32_t) (int32_t) previous.humidity, (uint32_t) previous.pressure,
+                    (uint32_t) previous.pressureAtSealevel, (uint32_t) previous.height};
+                for(uint8_t j = 0; j < 6; j++) {
+                    size_t used = getDelta(payload + position, payloadLength - position, previousValues[j], values[j]);
+                    if(used == 0) {
+                        return 0;
+                    }
+                    position += used;
+                }
+                records[i].time = values[0];
+                records[i].temperature = (int16_t) values[1];
+                records[i].humidity = (int16_t) values[2];
+                records[i].pressure = (int32_t) values[3];
+                records[i].pressureAtSealevel = (int32_t) values[4];
+                records[i].height = (int32_t) values[5];
+                previous = records[i];
+            }
+            if(position != payloadLength) {
+                return 0;
+            }
+            count = blockCount;
+            return size;
+        }
+};
@@ -0,0 +1,225 @@
+/**
+ * @file ExportProtocol.h
+ * @brief Framed protocol of the bulk export of log files over the serial port (LogExport.h) and the host receiver
+ * (tools/receive_export.cpp). The host sends text commands terminated by a line feed:
+ * - PING                          answered with an ACK frame
+ * - LIST                          an ENTRY frame per file, then END
+ * - GET path [offset [from to]]   BEGIN, DATA frames from the offset on, END with byte count and CRC-32 of the data
+ * - BAUD rate                     ACK at the old rate, then the port switches; without a command at the new rate
+ *                                 within EXPORT_BAUD_TIMEOUT_MS it switches back
+ * from and to (seconds since 1970) select the records of a time range of a csv log. The offset counts the bytes of
+ * the exported data, so an interrupted transfer resumes with the number of bytes received. A CAN byte (0x18) from
+ * the host cancels a running transfer.
+ *
+ * Every frame is little endian: magic "LX", type, version, payload length (16 bit), sequence (32 bit, counting the
+ * frames of one command from 0), offset (32 bit, position of a DATA payload in the exported data), payload and a
+ * CRC-32 of all preceding bytes of the frame. The receiver finds frames by the magic, so text on the same port, e.g.
+ * the serial output of loop(), is skipped.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <CRC32.h>
+
+#define EXPORT_MAGIC "LX"
+#define EXPORT_VERSION 1
+#define EXPORT_HEADER_SIZE 14
+#define EXPORT_TRAILER_SIZE 4
+#define EXPORT_MAX_PAYLOAD 8192
+#define EXPORT_CANCEL 0x18
+#define EXPORT_BAUD_TIMEOUT_MS 2000
+#define EXPORT_COMMAND_SIZE 128
+
+/**
+ * @brief Payload size of DATA frames sent by LogExport. Can be changed with the build flag EXPORT_CHUNK_SIZE, up to
+ * EXPORT_MAX_PAYLOAD.
+ */
+#ifndef EXPORT_CHUNK_SIZE
+#define EXPORT_CHUNK_SIZE 2048
+#endif
+
+static_assert(EXPORT_CHUNK_SIZE >= 64 && EXPORT_CHUNK_SIZE <= EXPORT_MAX_PAYLOAD, "EXPORT_CHUNK_SIZE out of range");
+
+/**
+ * @brief Types of frames.
+ *
+ */
+enum ExportFrameType {
+    EXPORT_BEGIN = 1,
+    EXPORT_DATA = 2,
+    EXPORT_END = 3,
+    EXPORT_ENTRY = 4,
+    EXPORT_ACK = 5,
+    EXPORT_ERROR = 6
+};
+
+/**
+ * @brief A received frame. The payload points into the buffer of the parser and is valid during the callback.
+ *
+ */
+struct ExportFrame {
+    uint8_t type;
+    uint16_t length;
+    uint32_t sequence;
+    uint32_t offset;
+    const uint8_t* payload;
+};
+
+/**
+ * @brief A class with static methods for encoding frames.
+ *
+ */
+class ExportProtocol {
+
+    public:
+
+        static void put32(uint8_t* buffer, uint32_t value) {
+            buffer[0] = value;
+            buffer[1] = value >> 8;
+            buffer[2] = value >> 16;
+            buffer[3] = value >> 24;
+        }
+
+        static uint32_t get32(const uint8_t* buffer) {
+            return buffer[0] | (uint32_t) buffer[1] << 8 | (uint32_t) buffer[2] << 16 | (uint32_t) buffer[3] << 24;
+        }
+
+        /**
+         * @brief Completes a frame whose payload is already at buffer + EXPORT_HEADER_SIZE: writes the header in
+         * front of it and the CRC-32 behind it.
+         *
+         * @param buffer buffer of at least EXPORT_HEADER_SIZE + length + EXPORT_TRAILER_SIZE bytes
+         * @param type frame type
+         * @param length payload length
+         * @param sequence number of the frame
+         * @param offset position of the payload in the exported data
+         * @return size_t length of the frame
+         */
+        static size_t encode(uint8_t* buffer, uint8_t type, uint16_t length, uint32_t sequence, uint32_t offset) {
+            buffer[0] = EXPORT_MAGIC[0];
+            buffer[1] = EXPORT_MAGIC[1];
+            buffer[2] = type;
+            buffer[3] = EXPORT_VERSION;
+            buffer[4] = length;
+            buffer[5] = length >> 8;
+            put32(buffer + 6, sequence);
+            put32(buffer + 10, offset);
+            put32(buffer + EXPORT_HEADER_SIZE + length, crc32(buffer, EXPORT_HEADER_SIZE + length));
+            return EXPORT_HEADER_SIZE + length + EXPORT_TRAILER_SIZE;
+        }
+};
+
+/**
+ * @brief Incremental parser of received bytes. Bytes outside of frames and frames with a wrong CRC are skipped and
+ * counted.
+ *
+ * @code
+ * ExportParser parser;
+ * parser.feed(data, length, [](const ExportFrame& frame) {
+ *     ...
+ * });
+ * @endcode
+ */
+class ExportParser {
+
+    private:
+        uint8_t _buffer[EXPORT_HEADER_SIZE + EXPORT_MAX_PAYLOAD + EXPORT_TRAILER_SIZE];
+        size_t _length = 0;
+        uint32_t _skipped = 0;
+        uint32_t _corrupted = 0;
+
+        void drop(size_t count) {
+            memmove(_buffer, _buffer + count, _length - count);
+            _length -= count;
+        }
+
+    public:
+
+        /**
+         * @brief Parses received bytes and passes every complete frame with a valid CRC to a callback.
+         *
+         * @tparam Callback callable as void(const ExportFrame& frame)
+         * @param data received bytes
+         * @param length number of bytes
+         * @param callback called for every frame
+         */
+        template <typename Callback>
+        void feed(const uint8_t* data, size_t length, Callback callback) {
+            while(length > 0) {
+                size_t count = sizeof(_buffer) - _length < length ? sizeof(_buffer) - _length : length;
+                memcpy(_buffer + _length, data, count);
+                _length += count;
+                data += count;
+                length -= count;
+                while(_length > 0) {
+                    if(_buffer[0] != EXPORT_MAGIC[0] || (_length > 1 && _buffer[1] != EXPORT_MAGIC[1])
+                        || (_length > 3 && _buffer[3] != EXPORT_VERSION)) {
+                        _skipped++;
+                        drop(1);
+                        continue;
+                    }
+                    if(_length < EXPORT_HEADER_SIZE) {
+                        break;
+                    }
+                    uint16_t payload = _buffer[4] | _buffer[5] << 8;
+                    if(payload > EXPORT_MAX_PAYLOAD) {
+                        _skipped++;
+                        drop(1);
+                        continue;
+                    }
+                    size_t size = EXPORT_HEADER_SIZE + payload + EXPORT_TRAILER_SIZE;
+                    if(_length < size) {
+                        break;
+                    }
+                    if(crc32(_buffer, size - EXPORT_TRAILER_SIZE) != ExportProtocol::get32(_buffer + size - EXPORT_TRAILER_SIZE)) {
+                        //the magic may have been part of the data, search again behind it
+                        _corrupted++;
+                        drop(1);
+                        continue;
+                    }
+                    ExportFrame frame;
+                    frame.type = _buffer[2];
+                    frame.length = payload;
+                    frame.sequence = ExportProtocol::get32(_buffer + 6);
+                    frame.offset = ExportProtocol::get32(_buffer + 10);
+                    frame.payload = _buffer + EXPORT_HEADER_SIZE;
+                    callback(frame);
+                    drop(size);
+                }
+            }
+        }
+
+        /**
+         * @brief Discards buffered bytes, e.g. after a cancelled transfer.
+         *
+         */
+        void reset() {
+            _length = 0;
+        }
+
+        /**
+         * @brief Returns the number of bytes skipped outside of frames.
+         *
+         * @return uint32_t skipped bytes
+         */
+        uint32_t skipped() const {
+            return _skipped;
+        }
+
+        /**
+         * @brief Returns the number of frame candidates with a wrong CRC.
+         *
+         * @return uint32_t corrupted frames
+         */
+        uint32_t corrupted() const {
+            return _corrupted;
+        }
+};
@@ -0,0 +1,27 @@
+/**
+ * @file HAL.h
+ * @brief Hardware abstraction layer. On the ESP32 the functions below forward to the Arduino core and ESP-IDF,
+ * in the native environment they are backed by in-memory fakes and a virtual clock, so the firmware runs on Linux.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Every implementation provides in namespace hal:
+ * - clock: micros64() since boot, epoch() and epochMicros() wall clock time, setEpochMicros()
+ * - sleep: deepSleep(), lightSleep(), restart(), timerWakeup()
+ * - clock frequency: setCpuMhz()
+ * - LED: ledSetup(), ledAttach(), ledWrite()
+ * - sensor bus: SensorBus with the TwoWire interface, sensorBus()
+ * - filesystem: Storage with the SDFS interface, storage()
+ * - tasks: startTask(), endTask()
+ * - time sync: TimeNetwork with WiFi and SNTP, see TimeSync.h
+ */
+
+#pragma once
+
+#ifdef ARDUINO
+#include <hal/ESP32HAL.h>
+#else
+#include <hal/NativeHAL.h>
+#endif
@@ -0,0 +1,196 @@
+/**
+ * @file HTU21DF.h
+ * @brief Minimal driver for the HTU21DF temperature and humidity sensor using the no hold master commands.
+ * The I2C transactions are counted.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <HAL.h>
+#include <cmath>
+
+#define HTU21DF_ADDRESS 0x40
+#define HTU21DF_COMMAND_TEMPERATURE 0xF3
+#define HTU21DF_COMMAND_HUMIDITY 0xF5
+#define HTU21DF_COMMAND_READ_USER_REGISTER 0xE7
+#define HTU21DF_COMMAND_RESET 0xFE
+#define HTU21DF_TEMPERATURE_MILLIS 50
+#define HTU21DF_HUMIDITY_MILLIS 16
+
+/**
+ * @brief A class for reading the HTU21DF sensor.
+ *
+ */
+class HTU21DF {
+
+    private:
+        hal::SensorBus* _bus = &hal::sensorBus();
+        uint32_t _transactions = 0;
+
+        boolean command(uint8_t command) {
+            _transactions++;
+            _bus->beginTransmission(HTU21DF_ADDRESS);
+            _bus->write(command);
+            return _bus->endTransmission() == 0;
+        }
+
+        static uint8_t crc8(const uint8_t* data, uint8_t length) {
+            uint8_t crc = 0;
+            for(uint8_t i = 0; i < length; i++) {
+                crc ^= data[i];
+                for(uint8_t bit = 0; bit < 8; bit++) {
+                    crc = crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1;
+                }
+            }
+            return crc;
+        }
+
+    public:
+
+        /**
+         * @brief Resets the sensor and checks the user register.
+         *
+         * @param bus I2C bus
+         * @return boolean success of initalisation
+         */
+        boolean begin(hal::SensorBus* bus = &hal::sensorBus()) {
+            _bus = bus;
+            _bus->begin();
+            reset();
+            command(HTU21DF_COMMAND_READ_USER_REGISTER);
+            _transactions++;
+            if(_bus->requestFrom((uint8_t) HTU21DF_ADDRESS, (uint8_t) 1) != 1) {
+                return false;
+            }
+            return _bus->read() == 0x02;
+        }
+
+        /**
+         * @brief Initialises the driver without resetting the sensor, e.g. on a wakeup from deep sleep when the
+         * sensor stayed powered and was checked by begin() before.
+         *
+         * @param bus I2C bus
+         */
+        void wake(hal::SensorBus* bus = &hal::sensorBus()) {
+            _bus = bus;
+            _bus->begin();
+        }
+
+        /**
+         * @brief Resets the sensor with a 15 ms delay.
+         *
+         */
+        void reset() {
+            command(HTU21DF_COMMAND_RESET);
+            delay(15);
+        }
+
+        /**
+         * @brief Starts a temperature conversion without waiting for it. The result can be read with readRaw()
+         * after HTU21DF_TEMPERATURE_MILLIS.
+         *
+         * @return boolean success of starting the conversion
+         */
+        boolean startTemperature() {
+            return command(HTU21DF_COMMAND_TEMPERATURE);
+        }
+
+        /**
+         * @brief Starts a humidity conversion without waiting for it. The result can be read with readRaw()
+         * after HTU21DF_HUMIDITY_MILLIS.
+         *
+         * @return boolean success of starting the conversion
+         */
+        boolean startHumidity() {
+            return command(HTU21DF_COMMAND_HUMIDITY);
+        }
+
+        /**
+         * @brief Reads the result of a finished conversion. While a conversion is running the sensor does not
+         * acknowledge the read and false is returned.
+         *
+         * @param raw raw value without status bits
+         * @return boolean false if the sensor did not answer or the checksum is wrong
+         */
+        boolean readRaw(uint16_t& raw) {
+            uint8_t data[3];
+            _transactions++;
+            if(_bus->requestFrom((uint8_t) HTU21DF_ADDRESS, (uint8_t) 3) != 3) {
+                return false;
+            }
+            for(uint8_t i = 0; i < 3; i++) {
+                data[i] = _bus->read();
+            }
+            if(crc8(data, 2) != data[2]) {
+                return false;
+            }
+            raw = ((data[0] << 8) | data[1]) & 0xFFFC;
+            return true;
+        }
+
+        /**
+         * @brief Calculates the temperature from a raw value.
+         *
+         * @param raw raw temperature
+         * @return float temperature in °C
+         */
+        static float temperature(uint16_t raw) {
+            return raw * 175.72 / 65536 - 46.85;
+        }
+
+        /**
+         * @brief Calculates the humidity from a raw value.
+         *
+         * @param raw raw humidity
+         * @return float relative humidity in %
+         */
+        static float humidity(uint16_t raw) {
+            return raw * 125.0 / 65536 - 6;
+        }
+
+        /**
+         * @brief Reads the temperature.
+         *
+         * @return float temperature in °C, NAN on failure
+         */
+        float readTemperature() {
+            uint16_t raw;
+            startTemperature();
+            delay(HTU21DF_TEMPERATURE_MILLIS);
+            return readRaw(raw) ? temperature(raw) : NAN;
+        }
+
+        /**
+         * @brief Reads the relative humidity.
+         *
+         * @return float relative humidity in %, NAN on failure
+         */
+        float readHumidity() {
+            uint16_t raw;
+            startHumidity();
+            delay(HTU21DF_HUMIDITY_MILLIS);
+            return readRaw(raw) ? humidity(raw) : NAN;
+        }
+
+        /**
+         * @brief Returns the number of I2C transactions since the last reset.
+         *
+         * @return uint32_t number of transactions
+         */
+        uint32_t transactions() {
+            return _transactions;
+        }
+
+        /**
+         * @brief Resets the I2C transaction counter.
+         *
+         */
+        void resetTransactions() {
+            _transactions = 0;
+        }
+};
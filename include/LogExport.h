@@ -0,0 +1,326 @@
+/**
+ * @file LogExport.h
+ * @brief Bulk export of the log files over the serial port in the framed protocol of ExportProtocol.h, instead of
+ * SDCard::printFile(). Files are read in chunks of EXPORT_CHUNK_SIZE bytes and sent as CRC-32 protected frames, a
+ * transfer can be resumed at an offset, csv logs can be exported for a time range and the host can switch to a
+ * higher baud rate for the session. tools/receive_export.cpp is the receiver.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <HAL.h>
+#include <ExportProtocol.h>
+#include <LogReader.h>
+
+/**
+ * @brief A class serving the export commands of a host.
+ *
+ * @code
+ * LogExport<HardwareSerial> logExport(Serial, 115200);
+ * if(Serial.available()) {
+ *     logExport.serve(2000);   //until the host is silent for 2 s
+ * }
+ * logExport.update(2000);      //or one command per loop() without waiting
+ * @endcode
+ *
+ * @tparam Port serial port with available(), read(), write(buffer, size), flush() and updateBaudRate(rate)
+ */
+template <typename Port>
+class LogExport {
+
+    private:
+        Port& _port;
+        uint32_t _baud;
+        uint32_t _rate;
+        uint64_t _baudDeadline = 0;
+        uint64_t _lastCommand = 0;
+        boolean _session = false;
+        char _command[EXPORT_COMMAND_SIZE];
+        size_t _commandLength = 0;
+        boolean _overflow = false;
+        uint32_t _sequence = 0;
+        uint8_t _frame[EXPORT_HEADER_SIZE + EXPORT_CHUNK_SIZE + EXPORT_TRAILER_SIZE];
+
+        uint8_t* payload() {
+            return _frame + EXPORT_HEADER_SIZE;
+        }
+
+        void send(uint8_t type, uint16_t length, uint32_t offset = 0) {
+            _port.write(_frame, ExportProtocol::encode(_frame, type, length, _sequence++, offset));
+        }
+
+        void sendText(uint8_t type, const char* text) {
+            size_t length = strlen(text) < EXPORT_CHUNK_SIZE ? strlen(text) : EXPORT_CHUNK_SIZE;
+            memcpy(payload(), text, length);
+            send(type, length);
+        }
+
+        void sendValues(uint8_t type, uint32_t first, uint32_t second, const char* text = "") {
+            size_t length = strlen(text) < EXPORT_CHUNK_SIZE - 8 ? strlen(text) : EXPORT_CHUNK_SIZE - 8;
+            ExportProtocol::put32(payload(), first);
+            ExportProtocol::put32(payload() + 4, second);
+            memcpy(payload() + 8, text, length);
+            send(type, 8 + length);
+        }
+
+        boolean cancelled() {
+            while(_port.available() > 0) {
+                if(_port.read() == EXPORT_CANCEL) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        uint32_t listDirectory(const char* path) {
+            File directory = hal::storage().open(path);
+            if(!directory || !directory.isDirectory()) {
+                return 0;
+            }
+            uint32_t count = 0;
+            File file = directory.openNextFile();
+            while(file) {
+                if(file.isDirectory()) {
+                    count += listDirectory(file.path());
+                } else {
+                    sendValues(EXPORT_ENTRY, file.size(), 0, file.path());
+                    count++;
+                }
+                file = directory.openNextFile();
+            }
+            return count;
+        }
+
+        void execute(char* command) {
+            _sequence = 0;
+            char path[LOG_READER_PATH_SIZE];
+            unsigned long offset = 0;
+            long long from = 0, to = 0;
+            unsigned long rate = 0;
+            if(strcmp(command, "PING") == 0) {
+                sendValues(EXPORT_ACK, _rate, 0);
+            } else if(strcmp(command, "LIST") == 0) {
+                uint32_t count = listDirectory("/");
+                sendValues(EXPORT_END, count, 0);
+            } else if(sscanf(command, "GET %63s %lu %lld %lld", path, &offset, &from, &to) >= 1) {
+                exportFile(path, offset, from, to);
+            } else if(sscanf(command, "BAUD %lu", &rate) == 1 && rate >= 9600) {
+                sendValues(EXPORT_ACK, rate, 0);
+                _port.flush();
+                _port.updateBaudRate(rate);
+                _rate = rate;
+                _baudDeadline = hal::micros64() + EXPORT_BAUD_TIMEOUT_MS * 1000ULL;
+            } else {
+                sendText(EXPORT_ERROR, "unknown command");
+            }
+        }
+
+        void endSession() {
+            if(_rate != _baud) {
+                _port.flush();
+                _port.updateBaudRate(_baud);
+                _rate = _baud;
+            }
+            _session = false;
+        }
+
+    public:
+
+        /**
+         * @brief Construct a new LogExport object.
+         *
+         * @param port serial port, usually Serial
+         * @param baud baud rate the port was started with, restored after a session
+         */
+        LogExport(Port& port, uint32_t baud) : _port(port) {
+            _baud = baud;
+            _rate = baud;
+        }
+
+        /**
+         * @brief Reads the received characters and executes a complete command. Does not wait for more input.
+         *
+         * @return boolean true if a command was executed
+         */
+        boolean poll() {
+            if(_baudDeadline != 0 && hal::micros64() > _baudDeadline) {
+                //no command arrived at the new rate
+                _port.updateBaudRate(_baud);
+                _rate = _baud;
+                _baudDeadline = 0;
+            }
+            while(_port.available() > 0) {
+                int c = _port.read();
+                if(c == '\r' || c == EXPORT_CANCEL || c < 0) {
+                    continue;
+                }
+                if(c != '\n') {
+                    if(_commandLength + 1 < sizeof(_command)) {
+                        _command[_commandLength++] = c;
+                    } else {
+                        _overflow = true;
+                    }
+                    continue;
+                }
+                _command[_commandLength] = '\0';
+                boolean valid = !_overflow && _commandLength > 0;
+                _commandLength = 0;
+                _overflow = false;
+                if(valid) {
+                    //a command at the new rate confirms it
+                    _baudDeadline = 0;
+                    execute(_command);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * @brief Executes the commands of a host until it is silent for a while, then restores the baud rate.
+         *
+         * @param idleMillis time without a command that ends the session
+         * @return uint32_t number of executed commands
+         */
+        uint32_t serve(uint32_t idleMillis) {
+            uint32_t commands = 0;
+            uint64_t last = hal::micros64();
+            while(hal::micros64() - last < idleMillis * 1000ULL || _baudDeadline != 0) {
+                if(poll()) {
+                    commands++;
+                    last = hal::micros64();
+                } else {
+                    delay(1);
+                }
+            }
+            endSession();
+            return commands;
+        }
+
+        /**
+         * @brief Non-blocking serve() for a loop: executes at most one received command per call and ends the
+         * session when the host is silent for a while, then restores the baud rate. Output of the loop between the
+         * frames is skipped by the receiver.
+         *
+         * @param idleMillis time without a command that ends the session
+         * @return boolean true if a command was executed
+         */
+        boolean update(uint32_t idleMillis) {
+            if(poll()) {
+                _session = true;
+                _lastCommand = hal::micros64();
+                return true;
+            }
+            if(_session && _baudDeadline == 0 && hal::micros64() - _lastCommand >= idleMillis * 1000ULL) {
+                endSession();
+            }
+            return false;
+        }
+
+        /**
+         * @brief Returns whether a session of update() is running or a command is partly received. Light sleep
+         * would lose the characters of the host in the meantime.
+         *
+         * @return boolean true until the host was silent for the idle time
+         */
+        boolean active() const {
+            return _session || _baudDeadline != 0 || _commandLength > 0;
+        }
+
+        /**
+         * @brief Sends a file or the records of a time range of a csv log as BEGIN, DATA and END frames. Errors are
+         * sent as an ERROR frame.
+         *
+         * @param path path of the file
+         * @param offset number of bytes of the exported data to skip, e.g. the bytes received before an interruption
+         * @param from time of the first record, 0 for the whole file
+         * @param to time of the last record, 0 for the whole file
+         * @return uint32_t number of sent data bytes
+         */
+        uint32_t exportFile(const char* path, uint32_t offset = 0, time_t from = 0, time_t to = 0) {
+            File file = hal::storage().open(path);
+            if(!file || file.isDirectory()) {
+                sendText(EXPORT_ERROR, "cannot open file");
+                return 0;
+            }
+            uint32_t size = file.size();
+            boolean range = from != 0 || to != 0;
+            size_t pathLength = strlen(path);
+            if(range && (pathLength < 4 || strcmp(path + pathLength - 4, ".csv") != 0)) {
+                file.close();
+                sendText(EXPORT_ERROR, "time range needs a csv log");
+                return 0;
+            }
+            if(!range && offset > size) {
+                file.close();
+                sendText(EXPORT_ERROR, "offset behind the end");
+                return 0;
+            }
+            sendValues(EXPORT_BEGIN, size, offset, path);
+
+            uint32_t sent = 0;
+            uint32_t crc = 0;
+            boolean stopped = false;
+            if(!range) {
+                file.seek(offset);
+                size_t length;
+                while(!stopped && (length = file.read(payload(), EXPORT_CHUNK_SIZE)) > 0) {
+                    crc = crc32(payload(), length, crc);
+                    send(EXPORT_DATA, length, offset + sent);
+                    sent += length;
+                    stopped = cancelled();
+                }
+                file.close();
+            } else {
+                file.close();
+                if(to == 0) {
+                    to = 0x7FFFFFFF;
+                }
+                uint32_t position = 0;
+                size_t length = 0;
+                LogReader::query(path, from, to, [&](const char* line, size_t lineLength) {
+                    //skip the part of the data received before
+                    size_t skip = position + lineLength <= offset ? lineLength : position < offset ? offset - position : 0;
+                    position += lineLength;
+                    if(length + lineLength - skip > EXPORT_CHUNK_SIZE) {
+                        crc = crc32(payload(), length, crc);
+                        send(EXPORT_DATA, length, offset + sent);
+                        sent += length;
+                        length = 0;
+                        if(cancelled()) {
+                            stopped = true;
+                            return false;
+                        }
+                    }
+                    memcpy(payload() + length, line + skip, lineLength - skip);
+                    length += lineLength - skip;
+                    return true;
+                });
+                if(!stopped && length > 0) {
+                    crc = crc32(payload(), length, crc);
+                    send(EXPORT_DATA, length, offset + sent);
+                    sent += length;
+                }
+            }
+            if(stopped) {
+                sendText(EXPORT_ERROR, "cancelled");
+            } else {
+                sendValues(EXPORT_END, sent, crc);
+            }
+            return sent;
+        }
+
+        /**
+         * @brief Returns the current baud rate of the port.
+         *
+         * @return uint32_t baud rate
+         */
+        uint32_t baudRate() const {
+            return _rate;
+        }
+};
@@ -0,0 +1,129 @@
+/**
+ * @file LogIndex.h
+ * @brief Sparse sidecar index of a log file: log_d_m_y.idx holds the time and the byte offset of one record about
+ * every LOG_INDEX_STRIDE bytes of log_d_m_y.csv (or .bin), so a time range query seeks close to its first record
+ * instead of reading the file from the start.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * An entry is 8 bytes: the time in seconds since 1970 (UTC) and the offset of the first byte of the record, both
+ * little endian uint32. The entries are in the order of the log file. The index is only a hint: a missing or
+ * shorter index makes a query read more of the log, never return wrong records.
+ */
+
+#pragma once
+
+#include <HAL.h>
+
+/**
+ * @brief Distance between two indexed records in bytes of the log file, eight SD card sectors.
+ */
+#ifndef LOG_INDEX_STRIDE
+#define LOG_INDEX_STRIDE 4096
+#endif
+
+#define LOG_INDEX_ENTRY_SIZE 8
+
+/**
+ * @brief Static methods for maintaining and searching the index of a log file.
+ *
+ */
+class LogIndex {
+
+    private:
+        static uint32_t get32(const uint8_t* buffer) {
+            return buffer[0] | (uint32_t) buffer[1] << 8 | (uint32_t) buffer[2] << 16 | (uint32_t) buffer[3] << 24;
+        }
+
+        static void put32(uint8_t* buffer, uint32_t value) {
+            buffer[0] = value;
+            buffer[1] = value >> 8;
+            buffer[2] = value >> 16;
+            buffer[3] = value >> 24;
+        }
+
+    public:
+
+        /**
+         * @brief Writes the path of the index of a log file: the extension is replaced by ".idx".
+         *
+         * @param logPath path of the log file
+         * @param indexPath buffer for the path, at least as long as logPath plus 5 characters
+         */
+        static void path(const char* logPath, char* indexPath) {
+            strcpy(indexPath, logPath);
+            char* extension = strrchr(indexPath, '.');
+            if(!extension || strchr(extension, '/')) {
+                extension = indexPath + strlen(indexPath);
+            }
+            strcpy(extension, ".idx");
+        }
+
+        /**
+         * @brief Returns whether a record gets an index entry: the one which starts at or spans a multiple of the
+         * stride. Every stride gets exactly one entry without keeping state between wakeups.
+         *
+         * @param offset offset of the first byte of the record
+         * @param length length of the record in bytes
+         * @return boolean true if the record has to be indexed
+         */
+        static boolean due(size_t offset, size_t length) {
+            return length > 0 && (offset % LOG_INDEX_STRIDE == 0 || offset / LOG_INDEX_STRIDE != (offset + length - 1) / LOG_INDEX_STRIDE);
+        }
+
+        /**
+         * @brief Appends an entry to an index.
+         *
+         * @param indexPath path of the index
+         * @param time time of the record
+         * @param offset offset of the first byte of the record in the log file
+         * @return success/failure of appending
+         */
+        static boolean append(const char* indexPath, time_t time, size_t offset) {
+            File file = hal::storage().open(indexPath, FILE_APPEND);
+            if(!file) {
+                return false;
+            }
+            uint8_t entry[LOG_INDEX_ENTRY_SIZE];
+            put32(entry, (uint32_t) time);
+            put32(entry + 4, (uint32_t) offset);
+            boolean success = file.write(entry, LOG_INDEX_ENTRY_SIZE) == LOG_INDEX_ENTRY_SIZE;
+            file.close();
+            return success;
+        }
+
+        /**
+         * @brief Searches the offset to start reading from for records from a time on: the offset of the last
+         * indexed record older than the time. Binary search with one read per probe.
+         *
+         * @param indexPath path of the index
+         * @param from time of the first record of interest
+         * @return size_t offset in the log file, 0 if the index is missing or no indexed record is older
+         */
+        static size_t find(const char* indexPath, time_t from) {
+            File file = hal::storage().open(indexPath);
+            if(!file) {
+                return 0;
+            }
+            size_t low = 0;
+            size_t high = file.size() / LOG_INDEX_ENTRY_SIZE;
+            size_t offset = 0;
+            uint8_t entry[LOG_INDEX_ENTRY_SIZE];
+            while(low < high) {
+                size_t middle = low + (high - low) / 2;
+                if(!file.seek(middle * LOG_INDEX_ENTRY_SIZE) || file.read(entry, LOG_INDEX_ENTRY_SIZE) != LOG_INDEX_ENTRY_SIZE) {
+                    break;
+                }
+                if((time_t) get32(entry) < from) {
+                    offset = get32(entry + 4);
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+            file.close();
+            return offset;
+        }
+};
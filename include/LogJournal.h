@@ -0,0 +1,198 @@
+/**
+ * @file LogJournal.h
+ * @brief Crash consistency of the log files: csv records are sealed with a sequence number and a CRC-32, and after
+ * a power loss the end of the last intact record is found by scanning only the tail of the file, so recovery takes
+ * the same time for every file size. It only depends on the C library, so the host tools in tools/ use the same
+ * code.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * A sealed csv line ends with ",<sequence>,<crc>\n": the sequence number counts the records of the file starting
+ * at 1, the CRC-32 covers all characters before the comma in front of it and is written as 8 hex digits. The header
+ * line is not sealed. The blocks of the binary formats (BinaryLog.h, DeltaLog.h) carry a sync word and a CRC-32
+ * already, so they are recovered the same way without a sequence number.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <CRC32.h>
+
+/**
+ * @brief Number of bytes at the end of a file which are scanned for the last intact record. It covers the largest
+ * interrupted write, one 512 byte sector of SDLogWriter, and the longest record in front of it.
+ */
+#define LOG_JOURNAL_TAIL_SIZE 1024
+
+/**
+ * @brief Maximum number of characters added to a csv record by seal(): ",4294967295,ffffffff".
+ */
+#define LOG_JOURNAL_TRAILER_SIZE 20
+
+/**
+ * @brief Columns of the trailer in the header line of a csv log.
+ */
+#define LOG_JOURNAL_COLUMNS ",sequence,crc"
+
+/**
+ * @brief Static methods for sealing and recovering records.
+ *
+ */
+class LogJournal {
+
+    private:
+        static int hexDigit(char c) {
+            if(c >= '0' && c <= '9') {
+                return c - '0';
+            }
+            if(c >= 'a' && c <= 'f') {
+                return c - 'a' + 10;
+            }
+            return -1;
+        }
+
+    public:
+
+        /**
+         * @brief Appends sequence number and CRC to a csv record.
+         *
+         * @param record record terminated by a newline, with room for LOG_JOURNAL_TRAILER_SIZE more characters
+         * @param length length of the record including the newline
+         * @param sequence sequence number of the record
+         * @return size_t length of the sealed record including the newline
+         */
+        static size_t seal(char* record, size_t length, uint32_t sequence) {
+            static const char digits[] = "0123456789abcdef";
+            length--;
+            record[length++] = ',';
+            char reversed[10];
+            uint8_t count = 0;
+            do {
+                reversed[count++] = '0' + sequence % 10;
+                sequence /= 10;
+            } while(sequence > 0);
+            while(count > 0) {
+                record[length++] = reversed[--count];
+            }
+            uint32_t crc = crc32((const uint8_t*) record, length);
+            record[length++] = ',';
+            for(int8_t shift = 28; shift >= 0; shift -= 4) {
+                record[length++] = digits[(crc >> shift) & 0x0F];
+            }
+            record[length++] = '\n';
+            record[length] = '\0';
+            return length;
+        }
+
+        /**
+         * @brief Checks a sealed csv record.
+         *
+         * @param record record
+         * @param length length of the record including the newline
+         * @param sequence receives the sequence number if the record is intact
+         * @return bool true if the record is complete and its CRC matches
+         */
+        static bool check(const char* record, size_t length, uint32_t& sequence) {
+            if(length < 12 || record[length - 1] != '\n' || record[length - 10] != ',') {
+                return false;
+            }
+            uint32_t crc = 0;
+            for(size_t i = length - 9; i < length - 1; i++) {
+                int digit = hexDigit(record[i]);
+                if(digit < 0) {
+                    return false;
+                }
+                crc = (crc << 4) | digit;
+            }
+            size_t end = length - 10;
+            size_t start = end;
+            while(start > 0 && record[start - 1] >= '0' && record[start - 1] <= '9') {
+                start--;
+            }
+            if(start == end || start == 0 || record[start - 1] != ',' || end - start > 10
+                || crc32((const uint8_t*) record, end) != crc) {
+                    return false;
+            }
+            uint64_t value = 0;
+            for(size_t i = start; i < end; i++) {
+                value = value * 10 + record[i] - '0';
+            }
+            if(value > UINT32_MAX) {
+                return false;
+            }
+            sequence = value;
+            return true;
+        }
+
+        /**
+         * @brief Finds the end of the last intact line in the tail of a sealed csv file. The first line of the file
+         * is the header and counts as intact.
+         *
+         * @param tail last bytes of the file
+         * @param length length of the tail
+         * @param fileStart true if the tail starts at the beginning of the file
+         * @param end receives the offset in the tail behind the last intact line
+         * @param sequence receives the sequence number of the last intact line, 0 for the header
+         * @return bool false if no intact line ends in the tail
+         */
+        static bool recoverText(const uint8_t* tail, size_t length, bool fileStart, size_t& end, uint32_t& sequence) {
+            size_t lineEnd = length;
+            while(lineEnd > 0) {
+                while(lineEnd > 0 && tail[lineEnd - 1] != '\n') {
+                    lineEnd--;
+                }
+                if(lineEnd == 0) {
+                    break;
+                }
+                size_t lineStart = lineEnd - 1;
+                while(lineStart > 0 && tail[lineStart - 1] != '\n') {
+                    lineStart--;
+                }
+                if(lineStart == 0 && !fileStart) {
+                    break;
+                }
+                if(lineStart == 0 || check((const char*) tail + lineStart, lineEnd - lineStart, sequence)) {
+                    if(lineStart == 0) {
+                        sequence = 0;
+                    }
+                    end = lineEnd;
+                    return true;
+                }
+                lineEnd = lineStart;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Finds the end of the last intact block in the tail of a binary file.
+         *
+         * @tparam Decoder callable as size_t(const uint8_t* buffer, size_t length), returning the size of a valid
+         * block at the start of the buffer or 0, e.g. wrapping BinaryLog::decodeBlock()
+         * @param tail last bytes of the file
+         * @param length length of the tail
+         * @param fileStart true if the tail starts at the beginning of the file
+         * @param headerSize size of the file header if fileStart is set and the header is valid, otherwise 0
+         * @param decode block decoder
+         * @param end receives the offset in the tail behind the last intact block
+         * @return bool false if no intact block ends in the tail
+         */
+        template <typename Decoder>
+        static bool recoverBlocks(const uint8_t* tail, size_t length, bool fileStart, size_t headerSize, Decoder decode, size_t& end) {
+            for(size_t start = length; start > 0; start--) {
+                size_t size = decode(tail + start - 1, length - start + 1);
+                if(size > 0) {
+                    end = start - 1 + size;
+                    return true;
+                }
+            }
+            if(fileStart && headerSize > 0) {
+                end = headerSize;
+                return true;
+            }
+            return false;
+        }
+};
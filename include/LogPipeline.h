@@ -0,0 +1,239 @@
+/**
+ * @file LogPipeline.h
+ * @brief Decouples measuring from writing to the SD card in active mode: loop() measures on core 1 and pushes the
+ * samples into a lock-free ring, a writer task on core 0 drains the ring to the SD card in batches.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <HAL.h>
+#include <Climate.h>
+#include <SPSCRing.h>
+
+/**
+ * @brief Number of samples the ring holds while the SD card stalls. Has to be a power of two.
+ */
+#ifndef LOG_PIPELINE_CAPACITY
+#define LOG_PIPELINE_CAPACITY 64
+#endif
+
+/**
+ * @brief A sample in the ring of LogPipeline. Every sample is added to the statistics of the logger, only the ones
+ * with log set are written to the log file.
+ *
+ */
+struct PipelineSample {
+    ClimateSample sample;
+    boolean log;
+};
+
+/**
+ * @brief A class for logging samples from a writer task. push() is wait-free and does not touch the SD card, so the
+ * time the measuring side spends per sample is bounded no matter how long the card stalls: if the ring is full, the
+ * sample is dropped and counted in overflows(). If no task can be started (native environment), the measuring side
+ * calls drain() itself.
+ *
+ * @code
+ * LogPipeline pipeline(climate);
+ * pipeline.begin();                 //in setup(), after climate.begin()
+ * pipeline.push(climate.sample());  //in loop()
+ * @endcode
+ */
+class LogPipeline {
+
+    private:
+        ClimateSensor& _climate;
+        SPSCRing<PipelineSample, LOG_PIPELINE_CAPACITY> _ring;
+        uint16_t _batchSize;
+        uint32_t _idleMillis;
+        std::atomic<bool> _running{false};
+        std::atomic<bool> _stop{false};
+        std::atomic<bool> _stopped{false};
+        std::atomic<bool> _busy{false};
+        std::atomic<uint32_t> _written{0};
+        std::atomic<uint32_t> _errors{0};
+        std::atomic<uint64_t> _pollDue{UINT64_MAX};
+
+        static void writerTask(void* argument) {
+            LogPipeline* pipeline = (LogPipeline*) argument;
+            while(!pipeline->_stop.load()) {
+                //on an empty ring drain() polls the flush policy of the logger
+                if(pipeline->drain() == 0) {
+                    delay(pipeline->_idleMillis);
+                }
+            }
+            while(pipeline->drain() > 0) {
+            }
+            pipeline->_climate.flush();
+            pipeline->_stopped.store(true);
+            hal::endTask();
+        }
+
+    public:
+
+        /**
+         * @brief Construct a new LogPipeline object.
+         *
+         * @param climate sensor with a started logger
+         * @param batchSize maximum number of samples written per drain()
+         * @param idleMillis pause of the writer task while the ring is empty
+         */
+        LogPipeline(ClimateSensor& climate, uint16_t batchSize = 16, uint32_t idleMillis = 100) : _climate(climate) {
+            _batchSize = batchSize > 0 ? batchSize : 1;
+            _idleMillis = idleMillis;
+        }
+
+        /**
+         * @brief Starts the writer task.
+         *
+         * @param core core of the writer task
+         * @param priority priority of the writer task
+         * @return boolean false if the task could not be started, then drain() has to be called by the caller
+         */
+        boolean begin(int core = 0, uint8_t priority = 1) {
+            _stop.store(false);
+            _stopped.store(false);
+            _running.store(hal::startTask(writerTask, this, "logWriter", 8192, priority, core));
+            return _running.load();
+        }
+
+        /**
+         * @brief Queues a sample for the SD card. Only called by the measuring side. Samples which are not logged,
+         * e.g. suppressed by a ChangeFilter, are queued as well, so the writer task adds them to the statistics with
+         * ClimateSensor::observe() and is the only one using the logger.
+         *
+         * @param sample sample
+         * @param log false to add the sample to the statistics only
+         * @return boolean false if the ring was full and the sample was dropped
+         */
+        boolean push(const ClimateSample& sample, boolean log = true) {
+            PipelineSample entry = {sample, log};
+            return _ring.push(entry);
+        }
+
+        /**
+         * @brief Adds up to one batch of queued samples to the statistics and writes the ones to log. If the ring is
+         * empty, the logger is polled instead, so buffered records are written when they reach the maximum age of
+         * the flush policy. Only called by the writer task, or by the measuring side if no writer task is running.
+         *
+         * @return uint16_t number of samples taken from the ring
+         */
+        uint16_t drain() {
+            PipelineSample entry;
+            uint16_t count = 0;
+            _busy.store(true);
+            while(count < _batchSize && _ring.pop(entry)) {
+                count++;
+                _climate.observe(entry.sample);
+                if(!entry.log) {
+                    continue;
+                }
+                if(_climate.log(entry.sample)) {
+                    _written.fetch_add(1);
+                } else {
+                    _errors.fetch_add(1);
+                }
+            }
+            if(count == 0 && !_climate.poll()) {
+                _errors.fetch_add(1);
+            }
+            uint32_t pollMillis = _climate.millisToPoll();
+            _pollDue.store(pollMillis == UINT32_MAX ? UINT64_MAX : hal::micros64() + pollMillis * 1000ULL);
+            _busy.store(false);
+            return count;
+        }
+
+        /**
+         * @brief Returns whether all queued samples are handed to the logger, e.g. before light sleep stops both
+         * cores. Only meaningful on the measuring side, which is the only one adding samples.
+         *
+         * @return boolean true if the ring is empty and no batch is being written
+         */
+        boolean idle() {
+            return _ring.size() == 0 && !_busy.load();
+        }
+
+        /**
+         * @brief Returns when the buffered records of the logger reach the maximum age of the flush policy, e.g. to
+         * end a light sleep for the next drain(). Valid once idle() is true.
+         *
+         * @return uint64_t hal::micros64() of the next poll, UINT64_MAX if no record waits for its age
+         */
+        uint64_t pollDue() {
+            return _pollDue.load();
+        }
+
+        /**
+         * @brief Writes all queued samples and flushes the log, e.g. before a restart. Stops the writer task.
+         *
+         * @param timeoutMillis maximum time to wait for the writer task
+         * @return boolean false if the writer task did not finish in time
+         */
+        boolean finish(uint32_t timeoutMillis = 5000) {
+            if(!_running.load()) {
+                while(drain() > 0) {
+                }
+                return _climate.flush();
+            }
+            _stop.store(true);
+            uint32_t start = millis();
+            while(!_stopped.load()) {
+                if(millis() - start >= timeoutMillis) {
+                    return false;
+                }
+                delay(10);
+            }
+            _running.store(false);
+            return true;
+        }
+
+        /**
+         * @brief Returns whether the writer task is running.
+         *
+         * @return boolean true if the writer task drains the ring
+         */
+        boolean running() {
+            return _running.load();
+        }
+
+        /**
+         * @brief Returns the number of queued samples.
+         *
+         * @return size_t number of samples
+         */
+        size_t queued() {
+            return _ring.size();
+        }
+
+        /**
+         * @brief Returns the number of samples dropped because the ring was full.
+         *
+         * @return uint32_t number of dropped samples
+         */
+        uint32_t overflows() {
+            return _ring.overflows();
+        }
+
+        /**
+         * @brief Returns the number of samples passed to the logger.
+         *
+         * @return uint32_t number of samples
+         */
+        uint32_t written() {
+            return _written.load();
+        }
+
+        /**
+         * @brief Returns the number of samples the logger reported as failed.
+         *
+         * @return uint32_t number of samples
+         */
+        uint32_t errors() {
+            return _errors.load();
+        }
+};
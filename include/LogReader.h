@@ -0,0 +1,184 @@
+/**
+ * @file LogReader.h
+ * @brief Streaming reader for csv logs: lines are read through a sector sized buffer instead of byte by byte or
+ * into one String, and time range queries start at the offset found in the sparse index (LogIndex.h).
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <HAL.h>
+#include <LogIndex.h>
+#include <TextFormat.h>
+#include <LogJournal.h>
+
+/**
+ * @brief Size of the read buffer, one SD card sector.
+ */
+#define LOG_READER_CHUNK_SIZE 512
+
+/**
+ * @brief Maximum length of the path of an index including the terminating zero.
+ */
+#define LOG_READER_PATH_SIZE 64
+
+/**
+ * @brief A class for reading a log file line by line. A query compares the ISO 8601 timestamps of the records as
+ * text, so the logs have to be written with TextFormat; the records are expected in time order.
+ *
+ * @code
+ * LogReader::query("/log_27_5_2022.csv", now - 6 * 3600, now, [](const char* line, size_t length) {
+ *     Serial.write((const uint8_t*) line, length);
+ *     return true;
+ * });
+ * @endcode
+ */
+class LogReader {
+
+    private:
+        File _file;
+        uint8_t _buffer[LOG_READER_CHUNK_SIZE];
+        size_t _length = 0;
+        size_t _position = 0;
+
+        boolean fill() {
+            _position = 0;
+            _length = _file ? _file.read(_buffer, LOG_READER_CHUNK_SIZE) : 0;
+            return _length > 0;
+        }
+
+    public:
+
+        /**
+         * @brief Opens a log file for reading.
+         *
+         * @param path file path
+         * @param offset offset to start reading from
+         * @return success/failure of opening
+         */
+        boolean open(const char* path, size_t offset = 0) {
+            close();
+            _file = hal::storage().open(path);
+            if(!_file) {
+                return false;
+            }
+            return offset == 0 || _file.seek(offset);
+        }
+
+        /**
+         * @brief Closes the file.
+         *
+         */
+        void close() {
+            if(_file) {
+                _file.close();
+                _file = File();
+            }
+            _length = 0;
+            _position = 0;
+        }
+
+        /**
+         * @brief Reads the next line including its line feed. The part of a line longer than the buffer is skipped.
+         *
+         * @param line buffer for the line, zero terminated
+         * @param size size of the buffer
+         * @return size_t length of the line, 0 at the end of the file
+         */
+        size_t readLine(char* line, size_t size) {
+            size_t length = 0;
+            while(_position < _length || fill()) {
+                uint8_t c = _buffer[_position++];
+                if(length + 1 < size) {
+                    line[length++] = c;
+                }
+                if(c == '\n') {
+                    break;
+                }
+            }
+            line[length] = '\0';
+            return length;
+        }
+
+        /**
+         * @brief Passes the records of a log file in a time range to a callback, beginning at an offset. If the header
+         * has the sequence and crc columns, only records which pass LogJournal::check() are passed, like
+         * LogRotation::compact() does, so a torn or corrupted line is skipped.
+         *
+         * @tparam Callback callable as boolean(const char* line, size_t length), false stops the query
+         * @param path path of the log file
+         * @param offset offset of a line to start reading from
+         * @param from time of the first record
+         * @param to time of the last record
+         * @param callback called for every record in the range
+         * @return uint32_t number of records passed to the callback
+         */
+        template <typename Callback>
+        static uint32_t scan(const char* path, size_t offset, time_t from, time_t to, Callback callback) {
+            char first[TEXT_TIMESTAMP_LENGTH + 1];
+            char last[TEXT_TIMESTAMP_LENGTH + 1];
+            struct tm timeInfo;
+            localtime_r(&from, &timeInfo);
+            TextFormat::formatTimestamp(first, timeInfo);
+            localtime_r(&to, &timeInfo);
+            TextFormat::formatTimestamp(last, timeInfo);
+
+            LogReader reader;
+            if(!reader.open(path)) {
+                return 0;
+            }
+            char line[TEXT_RECORD_SIZE + LOG_JOURNAL_TRAILER_SIZE];
+            size_t length = reader.readLine(line, sizeof(line));
+            boolean sealed = strncmp(line, "time,", 5) == 0 && strstr(line, "sequence") != nullptr;
+            if(offset > 0 && !reader.open(path, offset)) {
+                reader.open(path);
+            }
+            uint32_t count = 0;
+            uint32_t sequence;
+            while((length = reader.readLine(line, sizeof(line))) > 0) {
+                if(length <= TEXT_TIMESTAMP_LENGTH || line[TEXT_TIMESTAMP_LENGTH] != ',') {
+                    continue;
+                }
+                if(sealed && !LogJournal::check(line, length, sequence)) {
+                    continue;
+                }
+                if(strncmp(line, first, TEXT_TIMESTAMP_LENGTH) < 0) {
+                    continue;
+                }
+                if(strncmp(line, last, TEXT_TIMESTAMP_LENGTH) > 0) {
+                    break;
+                }
+                count++;
+                if(!callback((const char*) line, length)) {
+                    break;
+                }
+            }
+            reader.close();
+            return count;
+        }
+
+        /**
+         * @brief Passes the records of a log file in a time range to a callback. Reading starts at the offset the
+         * index gives for the first record, or at the start of the file if there is no index.
+         *
+         * @tparam Callback callable as boolean(const char* line, size_t length), false stops the query
+         * @param path path of the log file
+         * @param from time of the first record
+         * @param to time of the last record
+         * @param callback called for every record in the range
+         * @return uint32_t number of records passed to the callback
+         */
+        template <typename Callback>
+        static uint32_t query(const char* path, time_t from, time_t to, Callback callback) {
+            char indexPath[LOG_READER_PATH_SIZE];
+            if(strlen(path) + 5 > sizeof(indexPath)) {
+                return scan(path, 0, from, to, callback);
+            }
+            LogIndex::path(path, indexPath);
+            return scan(path, LogIndex::find(indexPath, from), from, to, callback);
+        }
+};
@@ -0,0 +1,393 @@
+/**
+ * @file LogRotation.h
+ * @brief Names, preallocation and retention of the log files. A new log file is started at midnight and when a
+ * file reaches a size limit, optionally in one directory per month, e.g. "/2022-05/log_27_5_2022_1.csv". Files can
+ * be preallocated with zeros, so appending records overwrites allocated clusters instead of extending the FAT
+ * cluster chain. When the free space of the card runs low, the oldest files are compacted or deleted.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <HAL.h>
+#include <TextFormat.h>
+#include <BinaryLog.h>
+#include <DeltaLog.h>
+#include <LogIndex.h>
+#include <LogJournal.h>
+#include <LogReader.h>
+
+/**
+ * @brief Unit of preallocation and of the search for the end of the data, one SD card sector.
+ */
+#define LOG_ROTATION_SECTOR_SIZE 512
+
+/**
+ * @brief Maximum length of a log file path including the terminating zero.
+ */
+#define LOG_ROTATION_PATH_SIZE 40
+
+/**
+ * @brief What happens to the oldest log files when the free space runs low.
+ *
+ */
+enum RetentionMode {
+    //delete the oldest log file and its index
+    RETENTION_DELETE,
+    //convert the oldest csv log to the delta format (DeltaLog.h), delete the oldest file if no csv log is left
+    RETENTION_COMPACT
+};
+
+/**
+ * @brief Settings of the rotation. The default starts a new file at midnight only, like before.
+ *
+ */
+struct RotationPolicy {
+    //size which starts a new file of the same day, 0 for no limit
+    uint32_t maxFileBytes = 0;
+    //size a new file is filled with zeros up front, 0 for no preallocation
+    uint32_t preallocateBytes = 0;
+    //true to put the files of a month into a directory "/yyyy-mm"
+    boolean monthDirectories = false;
+    //free space below which the oldest files are compacted or deleted, 0 to keep all files
+    uint64_t minFreeBytes = 0;
+    RetentionMode retention = RETENTION_DELETE;
+};
+
+/**
+ * @brief Static methods for the files of the log rotation.
+ *
+ */
+class LogRotation {
+
+    private:
+        /**
+         * @brief Parses a log file name "log_d_m_y[_part].ext" into a sortable date and the part number.
+         */
+        static boolean parse(const char* name, int32_t& date, uint16_t& part) {
+            int day, month, year;
+            unsigned number = 0;
+            char extension[5];
+            if(sscanf(name, "log_%d_%d_%d_%u.%4s", &day, &month, &year, &number, extension) != 5) {
+                number = 0;
+                if(sscanf(name, "log_%d_%d_%d.%4s", &day, &month, &year, extension) != 4) {
+                    return false;
+                }
+            }
+            if(strcmp(extension, "idx") == 0) {
+                return false;
+            }
+            date = year * 10000 + month * 100 + day;
+            part = number;
+            return true;
+        }
+
+        static boolean isCsv(const char* path) {
+            size_t length = strlen(path);
+            return length > 4 && strcmp(path + length - 4, ".csv") == 0;
+        }
+
+        /**
+         * @brief Searches the oldest log file in a directory and its month directories.
+         */
+        static void findOldest(const char* directory, const char* current, boolean csvOnly, char* oldest, int32_t& oldestDate, uint16_t& oldestPart) {
+            File root = hal::storage().open(directory);
+            if(!root || !root.isDirectory()) {
+                return;
+            }
+            File file = root.openNextFile();
+            while(file) {
+                if(file.isDirectory()) {
+                    if(strcmp(directory, "/") == 0) {
+                        findOldest(file.path(), current, csvOnly, oldest, oldestDate, oldestPart);
+                    }
+                } else {
+                    int32_t date;
+                    uint16_t part;
+                    if(parse(file.name(), date, part) && strcmp(file.path(), current) != 0 && (!csvOnly || isCsv(file.path()))
+                        && (oldest[0] == '\0' || date < oldestDate || (date == oldestDate && part < oldestPart))
+                        && strlen(file.path()) < LOG_ROTATION_PATH_SIZE) {
+                            strcpy(oldest, file.path());
+                            oldestDate = date;
+                            oldestPart = part;
+                    }
+                }
+                file = root.openNextFile();
+            }
+        }
+
+        static void removeLog(const char* path) {
+            char index[LOG_ROTATION_PATH_SIZE];
+            LogIndex::path(path, index);
+            hal::storage().remove(path);
+            hal::storage().remove(index);
+            const char* slash = strrchr(path, '/');
+            if(slash && slash != path) {
+                char directory[LOG_ROTATION_PATH_SIZE];
+                memcpy(directory, path, slash - path);
+                directory[slash - path] = '\0';
+                hal::storage().rmdir(directory);
+            }
+        }
+
+    public:
+
+        /**
+         * @brief Writes the path of a log file, e.g. "/2022-05/log_27_5_2022_1.csv".
+         *
+         * @param buffer buffer of at least LOG_ROTATION_PATH_SIZE characters
+         * @param timeInfo local broken down time of the day
+         * @param part number of the file of the day, 0 for the first one, which has no suffix
+         * @param extension extension including the dot
+         * @param monthDirectory true to put the file into the directory of its month
+         * @return size_t length of the path
+         */
+        static size_t fileName(char* buffer, const struct tm& timeInfo, uint16_t part, const char* extension, boolean monthDirectory) {
+            size_t length = 0;
+            buffer[length++] = '/';
+            if(monthDirectory) {
+                length += TextFormat::formatUnsigned(buffer + length, timeInfo.tm_year + 1900);
+                buffer[length++] = '-';
+                buffer[length++] = '0' + (timeInfo.tm_mon + 1) / 10;
+                buffer[length++] = '0' + (timeInfo.tm_mon + 1) % 10;
+                buffer[length++] = '/';
+            }
+            strcpy(buffer + length, "log_");
+            length += 4;
+            length += TextFormat::formatUnsigned(buffer + length, timeInfo.tm_mday);
+            buffer[length++] = '_';
+            length += TextFormat::formatUnsigned(buffer + length, timeInfo.tm_mon + 1);
+            buffer[length++] = '_';
+            length += TextFormat::formatUnsigned(buffer + length, timeInfo.tm_year + 1900);
+            if(part > 0) {
+                buffer[length++] = '_';
+                length += TextFormat::formatUnsigned(buffer + length, part);
+            }
+            strcpy(buffer + length, extension);
+            return length + strlen(extension);
+        }
+
+        /**
+         * @brief Creates the directory of a file if it does not exist.
+         *
+         * @param path file path
+         * @return boolean success/failure of creating
+         */
+        static boolean makeDirectory(const char* path) {
+            const char* slash = strrchr(path, '/');
+            if(!slash || slash == path) {
+                return true;
+            }
+            char directory[LOG_ROTATION_PATH_SIZE];
+            memcpy(directory, path, slash - path);
+            directory[slash - path] = '\0';
+            return hal::storage().exists(directory) || hal::storage().mkdir(directory);
+        }
+
+        /**
+         * @brief Fills a file with zero sectors up to a size. The FAT has no call for allocating clusters without
+         * writing them, and clusters allocated by seeking behind the end keep old data, which would look like records.
+         *
+         * @param path file path
+         * @param size size in bytes, rounded up to whole sectors
+         * @return boolean success/failure of writing
+         */
+        static boolean preallocate(const char* path, size_t size) {
+            File file = hal::storage().open(path, FILE_APPEND);
+            if(!file) {
+                return false;
+            }
+            uint8_t zeros[LOG_ROTATION_SECTOR_SIZE];
+            memset(zeros, 0, sizeof(zeros));
+            size_t current = file.size();
+            size_t first = LOG_ROTATION_SECTOR_SIZE - current % LOG_ROTATION_SECTOR_SIZE;
+            boolean success = true;
+            while(current < size && success) {
+                size_t part = first < LOG_ROTATION_SECTOR_SIZE ? first : LOG_ROTATION_SECTOR_SIZE;
+                success = file.write(zeros, part) == part;
+                current += part;
+                first = LOG_ROTATION_SECTOR_SIZE;
+            }
+            file.close();
+            return success;
+        }
+
+        /**
+         * @brief Returns the end of the written data of a preallocated file: the start of the first sector which
+         * contains only zeros, found by a binary search over the sectors. Records never fill a whole sector with
+         * zeros, csv records contain no zeros at all and every binary block starts with a sync word. A file without
+         * zero sectors ends at its size; this takes a single read of the last sector.
+         *
+         * @param file file opened for reading
+         * @return size_t end of the data, rounded up to whole sectors
+         */
+        static size_t dataEnd(File& file) {
+            size_t size = file.size();
+            size_t sectors = (size + LOG_ROTATION_SECTOR_SIZE - 1) / LOG_ROTATION_SECTOR_SIZE;
+            uint8_t buffer[LOG_ROTATION_SECTOR_SIZE];
+            auto empty = [&](size_t sector) {
+                if(!file.seek(sector * LOG_ROTATION_SECTOR_SIZE)) {
+                    return false;
+                }
+                size_t length = file.read(buffer, sizeof(buffer));
+                for(size_t i = 0; i < length; i++) {
+                    if(buffer[i] != 0) {
+                        return false;
+                    }
+                }
+                return length > 0;
+            };
+            if(sectors == 0 || !empty(sectors - 1)) {
+                return size;
+            }
+            size_t low = 0;
+            size_t high = sectors - 1;
+            while(low < high) {
+                size_t middle = (low + high) / 2;
+                if(empty(middle)) {
+                    high = middle;
+                } else {
+                    low = middle + 1;
+                }
+            }
+            return low * LOG_ROTATION_SECTOR_SIZE;
+        }
+
+        /**
+         * @brief Writes data at an offset of an existing file, e.g. zeros over a torn record of a preallocated file.
+         *
+         * @param path file path
+         * @param offset offset, at most the size of the file
+         * @param data data, nullptr for zeros
+         * @param length length in bytes
+         * @return boolean success/failure of writing
+         */
+        static boolean writeAt(const char* path, size_t offset, const uint8_t* data, size_t length) {
+            File file = hal::storage().open(path, "r+");
+            if(!file || !file.seek(offset)) {
+                return false;
+            }
+            uint8_t zeros[64];
+            memset(zeros, 0, sizeof(zeros));
+            boolean success = true;
+            while(length > 0 && success) {
+                size_t part = data || length < sizeof(zeros) ? length : sizeof(zeros);
+                success = file.write(data ? data : zeros, part) == part;
+                data = data ? data + part : data;
+                length -= part;
+            }
+            file.close();
+            return success;
+        }
+
+        /**
+         * @brief Returns the free space of the card.
+         *
+         * @return uint64_t free bytes
+         */
+        static uint64_t freeBytes() {
+            uint64_t total = hal::storage().totalBytes();
+            uint64_t used = hal::storage().usedBytes();
+            return total > used ? total - used : 0;
+        }
+
+        /**
+         * @brief Converts a csv log to the delta format of DeltaLog.h in a file with the extension ".dlt" and deletes
+         * the csv log and its index. Records with a wrong CRC are dropped.
+         *
+         * @param path path of the csv log
+         * @return boolean success/failure of converting
+         */
+        static boolean compact(const char* path) {
+            char target[LOG_ROTATION_PATH_SIZE];
+            strcpy(target, path);
+            strcpy(target + strlen(target) - 4, ".dlt");
+            LogReader reader;
+            if(!reader.open(path)) {
+                return false;
+            }
+            boolean exists = hal::storage().exists(target);
+            File out = hal::storage().open(target, FILE_APPEND);
+            if(!out) {
+                return false;
+            }
+            uint8_t block[DELTA_LOG_BLOCK_HEADER_SIZE + DELTA_LOG_BLOCK_CAPACITY];
+            boolean success = exists || out.write(block, DeltaLog::writeHeader(block)) == DELTA_LOG_HEADER_SIZE;
+            DeltaState state;
+            memset(&state, 0, sizeof(state));
+            char line[TEXT_RECORD_SIZE + LOG_JOURNAL_TRAILER_SIZE];
+            boolean sealed = false;
+            size_t length;
+            while(success && (length = reader.readLine(line, sizeof(line))) > 0) {
+                uint32_t sequence;
+                if(strncmp(line, "time,", 5) == 0) {
+                    sealed = strstr(line, "sequence") != nullptr;
+                    continue;
+                }
+                struct tm timeInfo;
+                memset(&timeInfo, 0, sizeof(timeInfo));
+                float values[5];
+                if((sealed && !LogJournal::check(line, length, sequence))
+                    || sscanf(line, "%d-%d-%dT%d:%d:%d,%f,%f,%f,%f,%f", &timeInfo.tm_year, &timeInfo.tm_mon, &timeInfo.tm_mday,
+                        &timeInfo.tm_hour, &timeInfo.tm_min, &timeInfo.tm_sec, &values[0], &values[1], &values[2],
+                        &values[3], &values[4]) != 11) {
+                            continue;
+                }
+                timeInfo.tm_year -= 1900;
+                timeInfo.tm_mon -= 1;
+                BinaryLogRecord record = BinaryLog::toRecord(
+                    BinaryLog::localTime(timeInfo), values[0], values[1], values[2], values[3], values[4]
+                );
+                if(!DeltaLog::add(state, record)) {
+                    size_t size = DeltaLog::close(state, block);
+                    success = out.write(block, size) == size;
+                    DeltaLog::add(state, record);
+                }
+            }
+            size_t size = DeltaLog::close(state, block);
+            success = success && (size == 0 || out.write(block, size) == size);
+            out.flush();
+            out.close();
+            reader.close();
+            if(success) {
+                removeLog(path);
+            }
+            return success;
+        }
+
+        /**
+         * @brief Compacts or deletes the oldest log files until the free space reaches the minimum of the policy.
+         * The current log file is never touched.
+         *
+         * @param policy rotation policy
+         * @param current path of the current log file
+         * @return uint16_t number of compacted or deleted files
+         */
+        static uint16_t enforce(const RotationPolicy& policy, const char* current) {
+            uint16_t changed = 0;
+            while(policy.minFreeBytes > 0 && freeBytes() < policy.minFreeBytes) {
+                char oldest[LOG_ROTATION_PATH_SIZE] = "";
+                int32_t date = 0;
+                uint16_t part = 0;
+                if(policy.retention == RETENTION_COMPACT) {
+                    findOldest("/", current, true, oldest, date, part);
+                    if(oldest[0] != '\0' && compact(oldest)) {
+                        changed++;
+                        continue;
+                    }
+                    oldest[0] = '\0';
+                }
+                findOldest("/", current, false, oldest, date, part);
+                if(oldest[0] == '\0') {
+                    break;
+                }
+                removeLog(oldest);
+                changed++;
+            }
+            return changed;
+        }
+};
@@ -1,4 +1,6 @@
-#include <Arduino.h>
+#pragma once
+
+#include <HAL.h>
 
 /**
  * @brief A class for controlling rgb leds.
@@ -29,12 +31,12 @@ class RGB {
          * @param resolution pwm resolution, up to 12 bit
          */
         RGB(const int redPin, int greenPin, int bluePin, int frequency = 5000, int resolution = 8) {
-            ledcSetup(0, frequency, resolution);
-            ledcAttachPin(redPin, 0);
-            ledcSetup(1, frequency, resolution);
-            ledcAttachPin(greenPin, 1);
-            ledcSetup(2, frequency, resolution);
-            ledcAttachPin(bluePin, 2);
+            hal::ledSetup(0, frequency, resolution);
+            hal::ledAttach(redPin, 0);
+            hal::ledSetup(1, frequency, resolution);
+            hal::ledAttach(greenPin, 1);
+            hal::ledSetup(2, frequency, resolution);
+            hal::ledAttach(bluePin, 2);
             clear();
         }
 
@@ -47,9 +49,9 @@ class RGB {
          */
         void setColor(int red, int green, int blue) {
             clear();
-            ledcWrite(0, red);
-            ledcWrite(1, green);
-            ledcWrite(2, blue);
+            hal::ledWrite(0, red);
+            hal::ledWrite(1, green);
+            hal::ledWrite(2, blue);
         }
 
         /**
@@ -69,9 +71,9 @@ class RGB {
          * 
          */
         void clear() {
-            ledcWrite(0, 0);
-            ledcWrite(1, 0);
-            ledcWrite(2, 0);
+            hal::ledWrite(0, 0);
+            hal::ledWrite(1, 0);
+            hal::ledWrite(2, 0);
         }
 
         /**
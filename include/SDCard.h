@@ -1,7 +1,11 @@
-#include <Arduino.h>
-#include <FS.h>
-#include <SD.h>
-#include <SPI.h>
+#pragma once
+
+#include <HAL.h>
+
+/**
+ * @brief Size of the chunks read by SDCard::readChunks(), one SD card sector.
+ */
+#define SD_CHUNK_SIZE 512
 
 /**
  * @brief A class for handeling SPI SD card modules.
@@ -19,23 +23,22 @@ class SDCard {
          */
         boolean begin() {
 
-            Serial.begin(115200);
-            if(!SD.begin(5)){
+            if(!hal::storage().begin(5)){
                 Serial.println("Card Mount Failed");
                 return false;
             }
-            uint8_t cardType = SD.cardType();
+            uint8_t cardType = hal::storage().cardType();
 
             if(cardType == CARD_NONE){
                 Serial.println("No SD card attached");
                 return false;
             }
 
-            String types[4] = {"MMC", "SDSC", "SDHC", "UNKNOWN"};
+            const char* types[4] = {"MMC", "SDSC", "SDHC", "UNKNOWN"};
             Serial.printf(
-                "\nSD Card Type: %s\nSD Card Size: %llu MB\n", 
+                "\nSD Card Type: %s\nSD Card Size: %lu MB\n", 
                 types[cardType > 0 && cardType <= 3 ? cardType - 1 : 3],
-                SD.cardSize() / (1024 * 1024)
+                (unsigned long) (hal::storage().cardSize() / (1024 * 1024))
             );           
             return true;
     } 
@@ -50,7 +53,7 @@ class SDCard {
 
             Serial.printf("Listing directory: %s\n", dirname);
 
-            File root = SD.open(dirname);
+            File root = hal::storage().open(dirname);
             if(!root){
                 Serial.println("Failed to open directory");
                 return;
@@ -65,10 +68,10 @@ class SDCard {
                 if(file.isDirectory()){
                 Serial.printf("  DIR : %s\n", file.name());
                 if(levels){
-                    listDir(file.name(), levels -1);
+                    listDir(file.path(), levels -1);
                 }
                 } else {
-                Serial.printf("  FILE: %s SIZE: %d B\n", file.name(), file.size());
+                Serial.printf("  FILE: %s SIZE: %u B\n", file.name(), (unsigned) file.size());
                 }
                 file = root.openNextFile();
             }
@@ -89,7 +92,7 @@ class SDCard {
          * @return success/failure of creation
          */
         boolean createDir(const char * path) {
-            return SD.mkdir(path);
+            return hal::storage().mkdir(path);
 }
 
         /**
@@ -99,46 +102,85 @@ class SDCard {
          * @return success/failure of removing
          */
         boolean removeDirectory(const char * path) {
-            return SD.rmdir(path);
+            return hal::storage().rmdir(path);
         }
 
         /**
-         * @brief Reads a file and prints it to the console.
+         * @brief Reads a file in chunks of up to 512 bytes and passes them to a callback, without holding the
+         * whole file in memory.
          * 
+         * @tparam Callback callable as boolean(const uint8_t* data, size_t length), false stops reading
          * @param path file path
+         * @param callback called for every chunk
+         * @return size_t number of bytes passed to the callback
          */
-        void printFile(const char * path) {
-
-            File file = SD.open(path);
+        template <typename Callback>
+        size_t readChunks(const char * path, Callback callback) {
+            File file = hal::storage().open(path);
             if(!file){
                 Serial.printf("Failed to open %s for reading", path);
-                return;
+                return 0;
             }
+            size_t total = readChunks(file, callback);
+            file.close();
+            return total;
+        }
 
-            while(file.available()){
-                Serial.write(file.read());
+        /**
+         * @brief Reads an open file from its current position in chunks of up to 512 bytes.
+         * 
+         * @tparam Callback callable as boolean(const uint8_t* data, size_t length), false stops reading
+         * @param file open file
+         * @param callback called for every chunk
+         * @return size_t number of bytes passed to the callback
+         */
+        template <typename Callback>
+        static size_t readChunks(File& file, Callback callback) {
+            uint8_t chunk[SD_CHUNK_SIZE];
+            size_t total = 0;
+            size_t length;
+            while((length = file.read(chunk, sizeof(chunk))) > 0){
+                total += length;
+                if(!callback((const uint8_t *) chunk, length)){
+                    break;
+                }
             }
-            file.close();
+            return total;
+        }
+
+        /**
+         * @brief Reads a file and prints it to the console.
+         * 
+         * @param path file path
+         */
+        void printFile(const char * path) {
+            readChunks(path, [](const uint8_t * data, size_t length) {
+                Serial.write(data, length);
+                return true;
+            });
         }
 
         /**
-         * @brief Reads a file and return the content as String.
+         * @brief Reads a text file and return the content as String. Use readChunks() for large files.
          * 
          * @param path file to read
          * @return String file content
          */
         String readFileToString(const char * path) {
             String fileAsString = "";
-
-            File file = SD.open(path);
+            File file = hal::storage().open(path);
             if(!file){
                 Serial.printf("Failed to open %s for reading", path);
                 return fileAsString;
             }
-
-            while(file.available()){
-                fileAsString += file.read() + "\n";
-            }
+            fileAsString.reserve(file.size());
+            readChunks(file, [&fileAsString](const uint8_t * data, size_t length) {
+                char text[SD_CHUNK_SIZE + 1];
+                memcpy(text, data, length);
+                text[length] = '\0';
+                fileAsString.concat(text);
+                return true;
+            });
             file.close();
             return fileAsString;
         }
@@ -150,7 +192,7 @@ class SDCard {
          * @return File file object
          */
         File readFile(const char * path) {
-            File file = SD.open(path);
+            File file = hal::storage().open(path);
             if(!file){
                 Serial.printf("Failed to open %s for reading", path);
             }
@@ -164,7 +206,7 @@ class SDCard {
          * @return boolean true if file exists else false
          */
         boolean exists(const char* path) {
-            return SD.exists(path);
+            return hal::storage().exists(path);
         }
 
         /**
@@ -176,11 +218,11 @@ class SDCard {
          */
         boolean writeFile(const char * path, const char * content) {
             boolean success;
-            File file = SD.open(path, FILE_WRITE);
+            File file = hal::storage().open(path, FILE_WRITE);
             if(!file){
                 return false;
             }
-            if(file.print(content)){
+            if(file.print(content) == strlen(content)){
                 success = true;
             } else {
                 success = false;
@@ -189,6 +231,24 @@ class SDCard {
             return success;
         }
 
+        /**
+         * @brief Writes binary data to a file
+         * 
+         * @param path file path
+         * @param data file content
+         * @param length length of content in bytes
+         * @return success/failure of writing
+         */
+        boolean writeFile(const char * path, const uint8_t * data, size_t length) {
+            File file = hal::storage().open(path, FILE_WRITE);
+            if(!file){
+                return false;
+            }
+            boolean success = file.write(data, length) == length;
+            file.close();
+            return success;
+        }
+
         /**
          * @brief Appends data to a file.
          * 
@@ -197,15 +257,31 @@ class SDCard {
          * @return success/failure of appending
          */
         boolean appendFile(const char * path, const char * content){
-            File file = SD.open(path, FILE_APPEND);
+            File file = hal::storage().open(path, FILE_APPEND);
             if(!file){
                 return false;
             }
-            if(!file.print(content)){
+            boolean success = file.print(content) == strlen(content);
+            file.close();
+            return success;
+        }
+
+        /**
+         * @brief Appends binary data to a file.
+         * 
+         * @param path file path
+         * @param data content to append
+         * @param length length of content in bytes
+         * @return success/failure of appending
+         */
+        boolean appendFile(const char * path, const uint8_t * data, size_t length){
+            File file = hal::storage().open(path, FILE_APPEND);
+            if(!file){
                 return false;
             }
+            boolean success = file.write(data, length) == length;
             file.close();
-            return true;
+            return success;
         }
 
         /**
@@ -216,7 +292,7 @@ class SDCard {
          * @return success/failure of renaming
          */
         boolean renameFile(const char * oldPath, const char * newPath){
-            return SD.rename(oldPath, newPath);
+            return hal::storage().rename(oldPath, newPath);
         }
 
         /**
@@ -226,7 +302,7 @@ class SDCard {
          * @return success/failure of deletion
          */
         boolean deleteFile(const char * path){
-            return SD.remove(path);
+            return hal::storage().remove(path);
         }
 
 };
\ No newline at end of file
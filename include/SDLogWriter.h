@@ -0,0 +1,408 @@
+/**
+ * @file SDLogWriter.h
+ * @brief Buffered writer which keeps a log file open instead of opening, appending and closing it for every line.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <HAL.h>
+
+/**
+ * @brief Size of the write buffer, one SD card sector.
+ */
+#define SD_LOG_SECTOR_SIZE 512
+
+/**
+ * @brief A class for appending records to a file on the SD card. Records are collected in a sector sized buffer,
+ * which is written when it is full, when a number of records or an age of the oldest buffered record is reached,
+ * or when flush() is called, e.g. before deep sleep or a restart. Full buffers are written at sector boundaries of
+ * the file. Smaller limits reduce the data at risk on power loss, larger limits reduce the number of writes.
+ *
+ * @author Patrick Fock
+ */
+class SDLogWriter {
+
+    private:
+        File _file;
+        String _path;
+        uint8_t _buffer[SD_LOG_SECTOR_SIZE];
+        size_t _length = 0;
+        size_t _capacity = SD_LOG_SECTOR_SIZE;
+        size_t _size = 0;
+        size_t _committed = 0;
+        size_t _written = 0;
+        uint16_t _records = 0;
+        uint16_t _maxRecords;
+        uint32_t _maxAgeMillis;
+        uint32_t _firstRecordMillis = 0;
+        boolean _overwrite = false;
+        uint32_t _opens = 0;
+        uint32_t _writes = 0;
+        uint32_t _flushes = 0;
+
+        boolean openFile() {
+            if(_file) {
+                return true;
+            }
+            if(_written > _size && !erase()) {
+                return false;
+            }
+            _opens++;
+            _file = hal::storage().open(_path.c_str(), _overwrite ? "r+" : FILE_APPEND);
+            if(!_file) {
+                return false;
+            }
+            if(!_overwrite) {
+                _size = _file.size();
+            } else if(!_file.seek(_size)) {
+                _file.close();
+                _file = File();
+                return false;
+            }
+            _committed = _size;
+            _written = _size;
+            _capacity = SD_LOG_SECTOR_SIZE - _size % SD_LOG_SECTOR_SIZE;
+            if(_capacity < _length) {
+                //the file changed while records were buffered
+                _capacity = _length;
+            }
+            return true;
+        }
+
+        boolean writeBuffer() {
+            if(_length == 0) {
+                return true;
+            }
+            if(!openFile()) {
+                return false;
+            }
+            _writes++;
+            _written = _size + _length;
+            if(_file.write(_buffer, _length) != _length) {
+                _file.close();
+                _file = File();
+                erase();
+                return false;
+            }
+            _size += _length;
+            _length = 0;
+            _records = 0;
+            _capacity = SD_LOG_SECTOR_SIZE;
+            return true;
+        }
+
+        /**
+         * @brief Removes what was written behind the end of the data, e.g. the part of a failed write, so it does
+         * not turn up after a reboot: an appended file is truncated, in an overwritten file the bytes are set to
+         * zero again. Fails if the card does not respond, then it is repeated at the next open.
+         */
+        boolean erase() {
+            if(_file) {
+                _file.close();
+                _file = File();
+            }
+            if(!hal::storage().exists(_path.c_str())) {
+                _written = _size;
+                return true;
+            }
+            if(!_overwrite) {
+                if(!hal::truncateFile(_path.c_str(), _size)) {
+                    return false;
+                }
+                _written = _size;
+                return true;
+            }
+            File file = hal::storage().open(_path.c_str(), "r+");
+            if(!file || !file.seek(_size)) {
+                return false;
+            }
+            uint8_t zeros[64] = {};
+            boolean success = true;
+            for(size_t offset = _size; success && offset < _written; offset += sizeof(zeros)) {
+                size_t part = _written - offset < sizeof(zeros) ? _written - offset : sizeof(zeros);
+                success = file.write(zeros, part) == part;
+            }
+            file.close();
+            if(success) {
+                _written = _size;
+            }
+            return success;
+        }
+
+        /**
+         * @brief Removes everything behind an offset. Records before it in the buffer are kept, data written to the
+         * file behind it is erased.
+         */
+        void cut(size_t end) {
+            if(end >= _size) {
+                _length = end - _size;
+                if(_length == 0) {
+                    _records = 0;
+                }
+            } else {
+                _size = end;
+                _length = 0;
+                _records = 0;
+                _capacity = SD_LOG_SECTOR_SIZE - _size % SD_LOG_SECTOR_SIZE;
+                if(_committed > _size) {
+                    _committed = _size;
+                }
+            }
+            if(_written > _size) {
+                erase();
+            }
+        }
+
+    public:
+
+        /**
+         * @brief Construct a new SDLogWriter object.
+         *
+         * @param maxRecords number of buffered records which triggers a flush, 0 for no limit
+         * @param maxAgeMillis age of the oldest buffered record in milliseconds which triggers a flush, 0 for no limit
+         */
+        SDLogWriter(uint16_t maxRecords = 0, uint32_t maxAgeMillis = 60000) {
+            _maxRecords = maxRecords;
+            _maxAgeMillis = maxAgeMillis;
+        }
+
+        /**
+         * @brief Opens a file for appending. A file opened before is flushed and closed.
+         *
+         * @param path file path
+         * @return success/failure of opening
+         */
+        boolean open(const char * path) {
+            close();
+            _path = path;
+            _size = 0;
+            _committed = 0;
+            _overwrite = false;
+            _written = _size;
+            return openFile();
+        }
+
+        /**
+         * @brief Opens a file for writing behind the end of its data, e.g. a file preallocated with zeros. The
+         * records overwrite the content behind the end instead of extending the file. A file opened before is
+         * flushed and closed.
+         *
+         * @param path file path
+         * @param end end of the data, at most the size of the file
+         * @return success/failure of opening
+         */
+        boolean openAt(const char * path, size_t end) {
+            close();
+            _path = path;
+            _size = end;
+            _committed = end;
+            _overwrite = true;
+            _written = _size;
+            return openFile();
+        }
+
+        /**
+         * @brief Changes the flush policy.
+         *
+         * @param maxRecords number of buffered records which triggers a flush, 0 for no limit
+         * @param maxAgeMillis age of the oldest buffered record in milliseconds which triggers a flush, 0 for no limit
+         */
+        void setPolicy(uint16_t maxRecords, uint32_t maxAgeMillis) {
+            _maxRecords = maxRecords;
+            _maxAgeMillis = maxAgeMillis;
+        }
+
+        /**
+         * @brief Returns the number of buffered records which triggers a flush.
+         *
+         * @return uint16_t number of records, 0 for no limit
+         */
+        uint16_t maxRecords() {
+            return _maxRecords;
+        }
+
+        /**
+         * @brief Returns the age of the oldest buffered record which triggers a flush.
+         *
+         * @return uint32_t milliseconds, 0 for no limit
+         */
+        uint32_t maxAgeMillis() {
+            return _maxAgeMillis;
+        }
+
+        /**
+         * @brief Appends one record.
+         *
+         * @param data record
+         * @param length length of record in bytes
+         * @return success/failure of writing. If the record could not be written, it is removed again and offset()
+         * is unchanged; if only the following flush failed, the record stays buffered.
+         */
+        boolean write(const uint8_t * data, size_t length) {
+            if(_length == 0) {
+                _firstRecordMillis = millis();
+            }
+            size_t start = offset();
+            while(length > 0) {
+                size_t part = length < _capacity - _length ? length : _capacity - _length;
+                memcpy(_buffer + _length, data, part);
+                _length += part;
+                data += part;
+                length -= part;
+                if(_length == _capacity && !writeBuffer()) {
+                    cut(start);
+                    return false;
+                }
+            }
+            _records++;
+            if(_maxRecords > 0 && _records >= _maxRecords) {
+                return flush();
+            }
+            return poll();
+        }
+
+        /**
+         * @brief Appends one text record.
+         *
+         * @param content record
+         * @return success/failure of writing
+         */
+        boolean write(const char * content) {
+            return write((const uint8_t *) content, strlen(content));
+        }
+
+        /**
+         * @brief Flushes the buffer if the oldest record exceeds the maximum age. Call it regularly if records are
+         * written rarely.
+         *
+         * @return success/failure of flushing
+         */
+        boolean poll() {
+            if(_length > 0 && _maxAgeMillis > 0 && millis() - _firstRecordMillis >= _maxAgeMillis) {
+                return flush();
+            }
+            return true;
+        }
+
+        /**
+         * @brief Returns the time until poll() writes the buffer, e.g. to wake up for it.
+         *
+         * @return uint32_t milliseconds, 0 if it is due, UINT32_MAX if no record waits for the maximum age
+         */
+        uint32_t millisToPoll() {
+            if(_length == 0 || _maxAgeMillis == 0) {
+                return UINT32_MAX;
+            }
+            uint32_t age = millis() - _firstRecordMillis;
+            return age >= _maxAgeMillis ? 0 : _maxAgeMillis - age;
+        }
+
+        /**
+         * @brief Writes all buffered records and commits them to the card.
+         *
+         * @return success/failure of flushing
+         */
+        boolean flush() {
+            if(!writeBuffer()) {
+                return false;
+            }
+            if(_file) {
+                _flushes++;
+                _file.flush();
+                _committed = _size;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Discards everything behind the last commit: the buffered records and the records written to the
+         * file but not committed. Call it after a failed write or flush if the records are written again, e.g. by
+         * SampleBatch::flush(), so they do not appear twice.
+         */
+        void rollback() {
+            cut(_committed);
+        }
+
+        /**
+         * @brief Removes everything behind an offset, e.g. records which were not committed before a reboot.
+         *
+         * @param end new end of the data
+         */
+        void truncate(size_t end) {
+            cut(end);
+        }
+
+        /**
+         * @brief Flushes and closes the file.
+         *
+         * @return success/failure of flushing
+         */
+        boolean close() {
+            boolean success = _path.length() == 0 || flush();
+            if(_file) {
+                _file.close();
+                _file = File();
+            }
+            return success;
+        }
+
+        /**
+         * @brief Returns the number of bytes in the buffer, which are lost on power loss.
+         *
+         * @return size_t buffered bytes
+         */
+        size_t buffered() {
+            return _length;
+        }
+
+        /**
+         * @brief Returns the offset in the file at which the next record starts, including buffered records.
+         *
+         * @return size_t offset in bytes
+         */
+        size_t offset() {
+            return _size + _length;
+        }
+
+        /**
+         * @brief Returns the size of the file at the last commit to the card. Data before this offset survives a
+         * power loss.
+         *
+         * @return size_t size in bytes
+         */
+        size_t committed() {
+            return _committed;
+        }
+
+        /**
+         * @brief Returns the number of times the file was opened.
+         *
+         * @return uint32_t number of opens
+         */
+        uint32_t opens() {
+            return _opens;
+        }
+
+        /**
+         * @brief Returns the number of write operations on the file.
+         *
+         * @return uint32_t number of writes
+         */
+        uint32_t writes() {
+            return _writes;
+        }
+
+        /**
+         * @brief Returns the number of commits to the card.
+         *
+         * @return uint32_t number of flushes
+         */
+        uint32_t flushes() {
+            return _flushes;
+        }
+};
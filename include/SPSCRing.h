@@ -0,0 +1,98 @@
+/**
+ * @file SPSCRing.h
+ * @brief Lock-free ring buffer for exactly one producer and one consumer, e.g. two tasks on different cores.
+ * Depends only on the C++ standard library, so it is stress tested on the host with tools/stress_ring.cpp.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief A fixed-size ring of Capacity elements. push() and pop() never block and never allocate: push() fails and
+ * counts an overflow if the ring is full, pop() fails if it is empty. Only the producer may call push(), only the
+ * consumer may call pop(); size() and overflows() may be called from both sides.
+ *
+ * @tparam T trivially copyable element
+ * @tparam Capacity number of elements, a power of two
+ */
+template <typename T, size_t Capacity>
+class SPSCRing {
+
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    private:
+        T _elements[Capacity];
+        std::atomic<uint32_t> _head{0};
+        std::atomic<uint32_t> _tail{0};
+        std::atomic<uint32_t> _overflows{0};
+
+    public:
+
+        /**
+         * @brief Appends an element. Called by the producer only.
+         *
+         * @param element element
+         * @return bool false if the ring was full and the element was dropped
+         */
+        bool push(const T& element) {
+            uint32_t tail = _tail.load(std::memory_order_relaxed);
+            if(tail - _head.load(std::memory_order_acquire) == Capacity) {
+                _overflows.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            _elements[tail % Capacity] = element;
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Removes the oldest element. Called by the consumer only.
+         *
+         * @param element receives the element
+         * @return bool false if the ring was empty
+         */
+        bool pop(T& element) {
+            uint32_t head = _head.load(std::memory_order_relaxed);
+            if(head == _tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            element = _elements[head % Capacity];
+            _head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Returns the number of elements in the ring. From the other side it may already be outdated.
+         *
+         * @return size_t number of elements
+         */
+        size_t size() const {
+            return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @brief Returns the number of elements dropped by push() because the ring was full.
+         *
+         * @return uint32_t number of dropped elements
+         */
+        uint32_t overflows() const {
+            return _overflows.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Returns the capacity of the ring.
+         *
+         * @return size_t number of elements
+         */
+        static constexpr size_t capacity() {
+            return Capacity;
+        }
+};
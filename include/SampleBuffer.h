@@ -0,0 +1,210 @@
+/**
+ * @file SampleBuffer.h
+ * @brief Batching of climate samples in RTC memory, so the SD card only has to be mounted every few wakeups
+ * in deep sleep mode.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <HAL.h>
+#include <time.h>
+
+/**
+ * @brief Maximum number of samples held in RTC memory. Every sample takes 24 bytes of the 8 kB RTC slow memory.
+ * Can be overridden with a build flag.
+ */
+#ifndef SAMPLE_BUFFER_CAPACITY
+#define SAMPLE_BUFFER_CAPACITY 32
+#endif
+
+/**
+ * @brief One timestamped climate measurement.
+ *
+ */
+struct ClimateSample {
+    time_t time;
+    float temperature;
+    float humidity;
+    float pressure;
+    float pressureAtSealevel;
+    float height;
+};
+
+/**
+ * @brief Fixed-size ring buffer of samples. It contains no pointers and is valid when zero initialised, so it
+ * can be declared with RTC_DATA_ATTR and survives deep sleep.
+ *
+ */
+struct SampleBuffer {
+    uint16_t head;
+    uint16_t count;
+    uint32_t dropped;
+    ClimateSample samples[SAMPLE_BUFFER_CAPACITY];
+    uint32_t flushes;
+    uint32_t unfilteredFlushes;
+    uint16_t unfilteredCount;
+    int64_t unfilteredOldest;
+};
+
+/**
+ * @brief Collects samples in a SampleBuffer and writes them to a logger when the batch is full, the oldest sample
+ * exceeds a maximum age or a flush is forced.
+ *
+ */
+class SampleBatch {
+
+    private:
+        SampleBuffer& _buffer;
+        uint16_t _batchSize;
+        uint32_t _maxAgeSeconds;
+
+        void countUnfiltered(time_t time) {
+            if(_buffer.unfilteredCount == 0) {
+                _buffer.unfilteredOldest = time;
+            }
+            _buffer.unfilteredCount++;
+            if(_buffer.unfilteredCount >= _batchSize || (_maxAgeSeconds > 0 && time - _buffer.unfilteredOldest >= (int64_t) _maxAgeSeconds)) {
+                _buffer.unfilteredFlushes++;
+                _buffer.unfilteredCount = 0;
+            }
+        }
+
+    public:
+
+        /**
+         * @brief Construct a new SampleBatch object on top of a buffer.
+         *
+         * @param buffer buffer to use, usually declared with RTC_DATA_ATTR
+         * @param batchSize number of samples which triggers a flush, at most SAMPLE_BUFFER_CAPACITY
+         * @param maxAgeSeconds age of the oldest sample in seconds which triggers a flush, 0 disables the limit
+         */
+        SampleBatch(SampleBuffer& buffer, uint16_t batchSize = SAMPLE_BUFFER_CAPACITY, uint32_t maxAgeSeconds = 3600)
+            : _buffer(buffer) {
+                _batchSize = batchSize == 0 || batchSize > SAMPLE_BUFFER_CAPACITY ? SAMPLE_BUFFER_CAPACITY : batchSize;
+                _maxAgeSeconds = maxAgeSeconds;
+                if(_buffer.head >= SAMPLE_BUFFER_CAPACITY || _buffer.count > SAMPLE_BUFFER_CAPACITY) {
+                    _buffer.head = 0;
+                    _buffer.count = 0;
+                }
+        }
+
+        /**
+         * @brief Adds a sample. If the buffer is full because earlier flushes failed, the oldest sample is dropped.
+         *
+         * @param sample sample to add
+         * @return boolean false if a sample had to be dropped
+         */
+        boolean add(const ClimateSample& sample) {
+            boolean overwritten = _buffer.count == SAMPLE_BUFFER_CAPACITY;
+            if(overwritten) {
+                _buffer.head = (_buffer.head + 1) % SAMPLE_BUFFER_CAPACITY;
+                _buffer.count--;
+                _buffer.dropped++;
+            }
+            _buffer.samples[(_buffer.head + _buffer.count) % SAMPLE_BUFFER_CAPACITY] = sample;
+            _buffer.count++;
+            countUnfiltered(sample.time);
+            return !overwritten;
+        }
+
+        /**
+         * @brief Counts a sample which is not logged, e.g. suppressed by ChangeFilter, for unfilteredFlushes().
+         *
+         * @param sample sample which is not added
+         */
+        void skip(const ClimateSample& sample) {
+            countUnfiltered(sample.time);
+        }
+
+        /**
+         * @brief Checks if the batch should be written.
+         *
+         * @param now current time
+         * @return boolean true if the batch is full or the oldest sample is too old
+         */
+        boolean flushDue(time_t now) {
+            if(_buffer.count == 0) {
+                return false;
+            }
+            if(_buffer.count >= _batchSize) {
+                return true;
+            }
+            return _maxAgeSeconds > 0 && now - _buffer.samples[_buffer.head].time >= (time_t) _maxAgeSeconds;
+        }
+
+        /**
+         * @brief Writes all buffered samples, oldest first. Only the samples the logger committed to the card are
+         * removed. If a write or the flush fails, the logger discards what it did not commit, so the remaining
+         * samples are written once on the next call instead of twice.
+         *
+         * @param logger object providing boolean log(const ClimateSample&), boolean flush(), void rollback() and
+         * uint32_t committedRecords()
+         * @return uint16_t number of samples committed
+         */
+        template <typename Logger>
+        uint16_t flush(Logger& logger) {
+            if(_buffer.count > 0) {
+                _buffer.flushes++;
+            }
+            uint32_t base = logger.committedRecords();
+            uint16_t written = 0;
+            while(written < _buffer.count) {
+                if(!logger.log(_buffer.samples[(_buffer.head + written) % SAMPLE_BUFFER_CAPACITY])) {
+                    break;
+                }
+                written++;
+            }
+            if(written < _buffer.count || !logger.flush()) {
+                logger.rollback();
+            }
+            uint32_t committed = logger.committedRecords() - base;
+            if(committed > _buffer.count) {
+                committed = _buffer.count;
+            }
+            _buffer.head = (_buffer.head + committed) % SAMPLE_BUFFER_CAPACITY;
+            _buffer.count -= committed;
+            return committed;
+        }
+
+        /**
+         * @brief Returns the number of buffered samples.
+         *
+         * @return uint16_t number of samples
+         */
+        uint16_t size() {
+            return _buffer.count;
+        }
+
+        /**
+         * @brief Returns the number of samples dropped because the buffer was full.
+         *
+         * @return uint32_t number of dropped samples
+         */
+        uint32_t dropped() {
+            return _buffer.dropped;
+        }
+
+        /**
+         * @brief Returns the number of flushes of a non-empty batch. Mounts of the SD card for other reasons, e.g. a
+         * summary row, are not counted.
+         *
+         * @return uint32_t number of flushes
+         */
+        uint32_t flushes() {
+            return _buffer.flushes;
+        }
+
+        /**
+         * @brief Returns the number of flushes if the skipped samples had been added as well.
+         *
+         * @return uint32_t number of flushes
+         */
+        uint32_t unfilteredFlushes() {
+            return _buffer.unfilteredFlushes;
+        }
+};
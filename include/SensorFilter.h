@@ -0,0 +1,220 @@
+/**
+ * @file SensorFilter.h
+ * @brief Streaming filters for the measurement channels: median of the last N values, exponential moving average
+ * and a Kalman filter fusing two sensors of the same quantity. The parameters are template arguments and filters
+ * are combined by templates, so there is no virtual dispatch and no constructor: every filter is valid when zero
+ * initialised and can be declared with RTC_DATA_ATTR to keep its state during deep sleep. Not a number is skipped,
+ * e.g. a failed HTU21DF read; a filter which has not seen a value returns NAN. It only depends on the C library, so
+ * the host tools in tools/ use the same code.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * @code
+ * RTC_DATA_ATTR FilterChain<MedianFilter<3>, EmaFilter<1, 4>> pressureFilter;
+ * float filtered = pressureFilter.update(reading.pressure);
+ * @endcode
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+/**
+ * @brief Returns the value unchanged.
+ *
+ */
+struct PassThrough {
+    float value;
+    bool valid;
+
+    float update(float input) {
+        if(!isnan(input)) {
+            value = input;
+            valid = true;
+        }
+        return output();
+    }
+
+    float output() const {
+        return valid ? value : NAN;
+    }
+
+    void reset() {
+        valid = false;
+    }
+};
+
+/**
+ * @brief Median of the last Size values, removes single outliers without smoothing steps.
+ *
+ * @tparam Size window length, odd for a true median
+ */
+template <uint8_t Size>
+struct MedianFilter {
+    float values[Size];
+    uint8_t count;
+    uint8_t next;
+
+    float update(float input) {
+        if(!isnan(input)) {
+            values[next] = input;
+            next = (next + 1) % Size;
+            count = count < Size ? count + 1 : Size;
+        }
+        return output();
+    }
+
+    float output() const {
+        if(count == 0) {
+            return NAN;
+        }
+        float sorted[Size];
+        for(uint8_t i = 0; i < count; i++) {
+            float value = values[i];
+            uint8_t j = i;
+            while(j > 0 && sorted[j - 1] > value) {
+                sorted[j] = sorted[j - 1];
+                j--;
+            }
+            sorted[j] = value;
+        }
+        return count % 2 == 1 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+    }
+
+    void reset() {
+        count = 0;
+        next = 0;
+    }
+};
+
+/**
+ * @brief Exponential moving average with the weight Numerator / Denominator of the newest value. The noise is
+ * reduced by the factor sqrt(weight / (2 - weight)), a step takes about 1 / weight values.
+ *
+ * @tparam Numerator numerator of the weight
+ * @tparam Denominator denominator of the weight
+ */
+template <uint16_t Numerator, uint16_t Denominator>
+struct EmaFilter {
+    static_assert(Numerator > 0 && Numerator <= Denominator, "the weight has to be in (0, 1]");
+
+    float value;
+    bool valid;
+
+    float update(float input) {
+        if(!isnan(input)) {
+            value = valid ? value + (input - value) * ((float) Numerator / Denominator) : input;
+            valid = true;
+        }
+        return output();
+    }
+
+    float output() const {
+        return valid ? value : NAN;
+    }
+
+    void reset() {
+        valid = false;
+    }
+};
+
+/**
+ * @brief Applies two filters one after the other, e.g. a median against outliers and then an average.
+ *
+ * @tparam First first filter
+ * @tparam Second second filter, gets the output of the first one
+ */
+template <typename First, typename Second>
+struct FilterChain {
+    First first;
+    Second second;
+
+    float update(float input) {
+        return second.update(first.update(input));
+    }
+
+    float output() const {
+        return second.output();
+    }
+
+    void reset() {
+        first.reset();
+        second.reset();
+    }
+};
+
+/**
+ * @brief Filters the mean of two sensors, the former average of HTU21DF and BMP180 temperature. If one value is not
+ * a number, the other one is used.
+ *
+ * @tparam Filter filter of the mean
+ */
+template <typename Filter>
+struct MeanFusion {
+    Filter filter;
+
+    float update(float a, float b) {
+        return filter.update(isnan(a) ? b : isnan(b) ? a : (a + b) / 2);
+    }
+
+    float output() const {
+        return filter.output();
+    }
+
+    void reset() {
+        filter.reset();
+    }
+};
+
+/**
+ * @brief One dimensional Kalman filter fusing two sensors of the same quantity. The quantity is modelled as a random
+ * walk, every update adds the process variance to the variance of the estimate; then each measurement is weighted
+ * by its variance. Standard deviations are given in thousandths of the unit, e.g. 0.1 °C as 100.
+ *
+ * @tparam ProcessDeviation change of the quantity between two updates
+ * @tparam DeviationA noise of the first sensor
+ * @tparam DeviationB noise of the second sensor
+ */
+template <uint32_t ProcessDeviation, uint32_t DeviationA, uint32_t DeviationB>
+struct KalmanFusion {
+    float estimate;
+    float variance;
+    bool valid;
+
+    float update(float a, float b) {
+        const float process = (ProcessDeviation / 1000.0f) * (ProcessDeviation / 1000.0f);
+        variance += process;
+        measure(a, (DeviationA / 1000.0f) * (DeviationA / 1000.0f));
+        measure(b, (DeviationB / 1000.0f) * (DeviationB / 1000.0f));
+        return output();
+    }
+
+    float output() const {
+        return valid ? estimate : NAN;
+    }
+
+    void reset() {
+        valid = false;
+    }
+
+    /**
+     * @brief Weights one measurement with its variance against the estimate.
+     */
+    void measure(float value, float noise) {
+        if(isnan(value)) {
+            return;
+        }
+        if(!valid) {
+            estimate = value;
+            variance = noise;
+            valid = true;
+            return;
+        }
+        float gain = variance / (variance + noise);
+        estimate += gain * (value - estimate);
+        variance *= 1 - gain;
+    }
+};
@@ -0,0 +1,359 @@
+/**
+ * @file SensorSet.h
+ * @brief Composition of sensors at compile time. Every sensor declares its channels, SensorSet<Sensors...> derives
+ * the number of channels, the record and the csv header and records from them and runs the conversions of all
+ * sensors in parallel. The sensors are stored by value in a tuple and called directly, without virtual calls or
+ * heap allocations. ClimateMeasurement.h composes the HTU21DF and the BMP180.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * A sensor of a set provides:
+ * - static const uint8_t channels                          number of values per measurement
+ * - static constexpr SensorChannel channel(uint8_t index)  description of a channel, a constant expression
+ * - void start(uint32_t now)                               starts a measurement
+ * - void step(uint32_t now)                                collects finished conversions and starts the next ones
+ * - uint32_t nextStep(uint32_t now)                        microseconds until step() has work, UINT32_MAX if none
+ * - boolean ready()                                        true when the measurement is complete
+ * - void values(float* values)                             writes the channels of the measurement
+ *
+ * The channel descriptions are resolved at compile time: csvRecord() formats every channel with its decimals as a
+ * constant, so it compiles to the same code as a record written by hand (see tools/bench_sensorset.cpp).
+ */
+
+#pragma once
+
+#include <HAL.h>
+#include <TextFormat.h>
+#include <tuple>
+#include <type_traits>
+
+/**
+ * @brief Description of a channel.
+ *
+ */
+struct SensorChannel {
+    const char* name;
+    const char* unit;
+    uint8_t decimals;
+    float scale;
+};
+
+/**
+ * @brief Sum of the channels of sensors.
+ *
+ */
+template <typename... Sensors>
+struct SensorChannelCount {
+    static const uint8_t value = 0;
+};
+
+template <typename First, typename... Rest>
+struct SensorChannelCount<First, Rest...> {
+    static const uint8_t value = First::channels + SensorChannelCount<Rest...>::value;
+};
+
+/**
+ * @brief Index of the first channel of the sensor at an index.
+ *
+ */
+template <size_t Index, typename... Sensors>
+struct SensorChannelOffset;
+
+template <typename First, typename... Rest>
+struct SensorChannelOffset<0, First, Rest...> {
+    static const uint8_t value = 0;
+};
+
+template <size_t Index, typename First, typename... Rest>
+struct SensorChannelOffset<Index, First, Rest...> {
+    static const uint8_t value = First::channels + SensorChannelOffset<Index - 1, Rest...>::value;
+};
+
+/**
+ * @brief A set of sensors measuring together.
+ *
+ * @code
+ * typedef SensorSet<HTU21DFChannels, BMP180Channels> Sensors;
+ * Sensors sensors(HTU21DFChannels(humiditySensor), BMP180Channels(barometricSensor));
+ * Sensors::Record record = sensors.measure(hal::epoch());
+ * char line[Sensors::csvRecordSize];
+ * Sensors::csvRecord(line, record);
+ * @endcode
+ *
+ * @tparam Sensors sensors in the order of their channels
+ */
+template <typename... Sensors>
+class SensorSet {
+
+    public:
+        static const uint8_t sensors = sizeof...(Sensors);
+        static const uint8_t channels = SensorChannelCount<Sensors...>::value;
+
+        /**
+         * @brief Buffer size of a csv record: timestamp, per channel a separator and a formatted value, newline.
+         */
+        static const size_t csvRecordSize = TEXT_TIMESTAMP_LENGTH + channels * 32 + 2;
+
+        /**
+         * @brief The type and the index of the first channel of the sensor at an index.
+         *
+         */
+        template <size_t Index>
+        struct Sensor {
+            typedef typename std::tuple_element<Index, std::tuple<Sensors...>>::type type;
+            static const uint8_t offset = SensorChannelOffset<Index, Sensors...>::value;
+        };
+
+        /**
+         * @brief One measurement of all channels.
+         *
+         */
+        struct Record {
+            time_t time;
+            float values[channels];
+        };
+
+        static_assert(sensors > 0 && channels > 0, "a sensor set needs channels");
+
+    private:
+        std::tuple<Sensors...> _sensors;
+
+        struct Start {
+            uint32_t now;
+            template <typename S> void operator()(S& sensor, uint8_t) { sensor.start(now); }
+        };
+
+        struct Step {
+            uint32_t now;
+            template <typename S> void operator()(S& sensor, uint8_t) { sensor.step(now); }
+        };
+
+        struct NextStep {
+            uint32_t now;
+            uint32_t wait;
+            template <typename S> void operator()(S& sensor, uint8_t) {
+                uint32_t next = sensor.nextStep(now);
+                wait = next < wait ? next : wait;
+            }
+        };
+
+        struct Ready {
+            boolean ready;
+            template <typename S> void operator()(S& sensor, uint8_t) { ready = ready && sensor.ready(); }
+        };
+
+        struct Values {
+            float* values;
+            template <typename S> void operator()(S& sensor, uint8_t offset) { sensor.values(values + offset); }
+        };
+
+        template <size_t Index = 0, typename Function>
+        typename std::enable_if<Index == sizeof...(Sensors)>::type each(Function&) {
+        }
+
+        template <size_t Index = 0, typename Function>
+        typename std::enable_if<Index < sizeof...(Sensors)>::type each(Function& function) {
+            function(std::get<Index>(_sensors), Sensor<Index>::offset);
+            each<Index + 1>(function);
+        }
+
+        template <size_t Index = 0>
+        static constexpr typename std::enable_if<Index + 1 == sizeof...(Sensors), SensorChannel>::type lookup(uint8_t index) {
+            return Sensor<Index>::type::channel(index);
+        }
+
+        template <size_t Index = 0>
+        static constexpr typename std::enable_if<Index + 1 < sizeof...(Sensors), SensorChannel>::type lookup(uint8_t index) {
+            return index < Sensor<Index>::type::channels
+                ? Sensor<Index>::type::channel(index)
+                : lookup<Index + 1>(index - Sensor<Index>::type::channels);
+        }
+
+        template <uint8_t Index = 0>
+        static typename std::enable_if<Index == channels, size_t>::type formatValues(char*, const float*) {
+            return 0;
+        }
+
+        template <uint8_t Index = 0>
+        static typename std::enable_if<Index < channels, size_t>::type formatValues(char* buffer, const float* values) {
+            buffer[0] = ',';
+            size_t length = 1 + TextFormat::formatFixed(buffer + 1, values[Index],
+                std::integral_constant<uint8_t, channel(Index).decimals>::value);
+            return length + formatValues<Index + 1>(buffer + length, values);
+        }
+
+        static size_t copy(char* buffer, size_t size, size_t length, const char* text) {
+            size_t count = strlen(text);
+            if(length + count >= size) {
+                return size;
+            }
+            memcpy(buffer + length, text, count + 1);
+            return length + count;
+        }
+
+    public:
+
+        /**
+         * @brief Construct a new SensorSet object.
+         *
+         * @param sensors the sensors, copied into the set
+         */
+        explicit SensorSet(const Sensors&... sensors) : _sensors(sensors...) {
+        }
+
+        /**
+         * @brief Returns the sensor at an index.
+         *
+         * @tparam Index index of the sensor
+         * @return Sensor<Index>::type& sensor
+         */
+        template <size_t Index>
+        typename Sensor<Index>::type& get() {
+            return std::get<Index>(_sensors);
+        }
+
+        /**
+         * @brief Returns the description of a channel. A constant expression for a constant index, e.g. in
+         * static_assert().
+         *
+         * @param index index of the channel, less than channels
+         * @return SensorChannel description
+         */
+        static constexpr SensorChannel channel(uint8_t index) {
+            return lookup(index);
+        }
+
+        /**
+         * @brief Starts a measurement of all sensors.
+         *
+         * @param now current time in microseconds
+         */
+        void start(uint32_t now) {
+            Start function = {now};
+            each(function);
+        }
+
+        /**
+         * @brief Advances the measurements of all sensors, in the order of the set.
+         *
+         * @param now current time in microseconds
+         * @return boolean true if all measurements are complete
+         */
+        boolean step(uint32_t now) {
+            Step function = {now};
+            each(function);
+            return ready();
+        }
+
+        /**
+         * @brief Returns the time until the next conversion of any sensor finishes.
+         *
+         * @param now current time in microseconds
+         * @return uint32_t microseconds until step() has something to do, 0 if it should be called now
+         */
+        uint32_t nextStep(uint32_t now) {
+            NextStep function = {now, UINT32_MAX};
+            each(function);
+            return function.wait == UINT32_MAX ? 0 : function.wait;
+        }
+
+        /**
+         * @brief Checks if all sensors finished.
+         *
+         * @return boolean true if the measurement is complete
+         */
+        boolean ready() {
+            Ready function = {true};
+            each(function);
+            return function.ready;
+        }
+
+        /**
+         * @brief Writes the channels of a complete measurement.
+         *
+         * @param values array of channels values
+         */
+        void values(float* values) {
+            Values function = {values};
+            each(function);
+        }
+
+        /**
+         * @brief Runs a measurement and waits for it like ClimateSensor::read(), the CPU is released while waiting.
+         *
+         * @param time time of the record
+         * @return Record measurement of all channels
+         */
+        Record measure(time_t time) {
+            start(micros());
+            while(!step(micros())) {
+                uint32_t wait = nextStep(micros());
+                if(wait >= 1000) {
+                    delay(wait / 1000);
+                } else {
+                    delayMicroseconds(wait);
+                }
+            }
+            Record record;
+            record.time = time;
+            values(record.values);
+            return record;
+        }
+
+        /**
+         * @brief Writes the first line of a csv log: "time" and the names of the channels.
+         *
+         * @param buffer buffer
+         * @param size size of the buffer
+         * @param columns further columns behind the channels, e.g. ",sequence,crc" of LogJournal.h
+         * @return size_t number of characters, 0 if the buffer is too small
+         */
+        static size_t csvHeader(char* buffer, size_t size, const char* columns = "") {
+            size_t length = copy(buffer, size, 0, "time");
+            for(uint8_t i = 0; i < channels; i++) {
+                length = copy(buffer, size, length, ",");
+                length = copy(buffer, size, length, channel(i).name);
+            }
+            length = copy(buffer, size, length, columns);
+            length = copy(buffer, size, length, "\n");
+            if(length >= size) {
+                if(size > 0) {
+                    buffer[0] = '\0';
+                }
+                return 0;
+            }
+            return length;
+        }
+
+        /**
+         * @brief Writes a csv record: local timestamp and the values with the decimals of their channels.
+         *
+         * @param buffer buffer of at least csvRecordSize characters
+         * @param record measurement
+         * @return size_t number of characters
+         */
+        static size_t csvRecord(char* buffer, const Record& record) {
+            struct tm timeInfo;
+            localtime_r(&record.time, &timeInfo);
+            return csvRecord(buffer, timeInfo, record.values);
+        }
+
+        /**
+         * @brief Writes a csv record for a time already broken down, e.g. by a logger which needs it for the file
+         * name as well.
+         *
+         * @param buffer buffer of at least csvRecordSize characters
+         * @param timeInfo local time of the measurement
+         * @param values one value per channel
+         * @return size_t number of characters
+         */
+        static size_t csvRecord(char* buffer, const struct tm& timeInfo, const float* values) {
+            size_t length = TextFormat::formatTimestamp(buffer, timeInfo);
+            length += formatValues(buffer + length, values);
+            buffer[length++] = '\n';
+            buffer[length] = '\0';
+            return length;
+        }
+};
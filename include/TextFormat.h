@@ -0,0 +1,151 @@
+/**
+ * @file TextFormat.h
+ * @brief Formatting of csv log records into a caller provided buffer without heap allocations. Depends only on the
+ * C library, so it is shared with the host tools.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+/**
+ * @brief Length of a timestamp "YYYY-MM-DDThh:mm:ss" without the terminating zero.
+ */
+#define TEXT_TIMESTAMP_LENGTH 19
+
+/**
+ * @brief Buffer size sufficient for one csv record of the climate log.
+ */
+#define TEXT_RECORD_SIZE 192
+
+/**
+ * @brief A class with static functions for writing numbers, timestamps and csv records into char buffers. All
+ * functions return the number of characters written, excluding the terminating zero they always append.
+ *
+ */
+class TextFormat {
+
+    private:
+        static size_t writeDigits(char* buffer, uint64_t value, uint8_t minimumDigits) {
+            char digits[20];
+            uint8_t count = 0;
+            do {
+                digits[count++] = '0' + value % 10;
+                value /= 10;
+            } while(value > 0 || count < minimumDigits);
+            for(uint8_t i = 0; i < count; i++) {
+                buffer[i] = digits[count - 1 - i];
+            }
+            buffer[count] = '\0';
+            return count;
+        }
+
+    public:
+
+        /**
+         * @brief Writes an unsigned integer with leading zeros up to a minimum number of digits.
+         *
+         * @param buffer buffer of at least 21 characters
+         * @param value value
+         * @param minimumDigits minimum number of digits
+         * @return size_t number of characters
+         */
+        static size_t formatUnsigned(char* buffer, uint64_t value, uint8_t minimumDigits = 1) {
+            return writeDigits(buffer, value, minimumDigits);
+        }
+
+        /**
+         * @brief Writes a number with a fixed number of decimals, rounded half away from zero like dtostrf() of String.
+         * NAN and infinity are written as "nan", "inf" and "-inf".
+         *
+         * @param buffer buffer of at least 32 characters
+         * @param value value
+         * @param decimals number of decimals, at most 6
+         * @return size_t number of characters
+         */
+        static size_t formatFixed(char* buffer, float value, uint8_t decimals = 2) {
+            if(isnan(value)) {
+                strcpy(buffer, "nan");
+                return 3;
+            }
+            if(isinf(value)) {
+                strcpy(buffer, value < 0 ? "-inf" : "inf");
+                return value < 0 ? 4 : 3;
+            }
+            if(decimals > 6) {
+                decimals = 6;
+            }
+            uint32_t scale = 1;
+            for(uint8_t i = 0; i < decimals; i++) {
+                scale *= 10;
+            }
+            double magnitude = fabs((double) value);
+            if(magnitude >= 1e12) {
+                int length = snprintf(buffer, 32, "%.*f", decimals, value);
+                return length < 32 ? length : 31;
+            }
+            uint64_t scaled = (uint64_t) (magnitude * scale + 0.5);
+            size_t length = 0;
+            if(value < 0 && scaled > 0) {
+                buffer[length++] = '-';
+            }
+            length += writeDigits(buffer + length, scaled / scale, 1);
+            if(decimals > 0) {
+                buffer[length++] = '.';
+                length += writeDigits(buffer + length, scaled % scale, decimals);
+            }
+            return length;
+        }
+
+        /**
+         * @brief Writes a zero padded ISO 8601 timestamp "YYYY-MM-DDThh:mm:ss", which sorts in time order.
+         *
+         * @param buffer buffer of at least TEXT_TIMESTAMP_LENGTH + 1 characters
+         * @param timeInfo broken down time
+         * @return size_t number of characters
+         */
+        static size_t formatTimestamp(char* buffer, const struct tm& timeInfo) {
+            size_t length = writeDigits(buffer, timeInfo.tm_year + 1900, 4);
+            buffer[length++] = '-';
+            length += writeDigits(buffer + length, timeInfo.tm_mon + 1, 2);
+            buffer[length++] = '-';
+            length += writeDigits(buffer + length, timeInfo.tm_mday, 2);
+            buffer[length++] = 'T';
+            length += writeDigits(buffer + length, timeInfo.tm_hour, 2);
+            buffer[length++] = ':';
+            length += writeDigits(buffer + length, timeInfo.tm_min, 2);
+            buffer[length++] = ':';
+            length += writeDigits(buffer + length, timeInfo.tm_sec, 2);
+            return length;
+        }
+
+        /**
+         * @brief Writes one csv record of the climate log: timestamp and five values with two decimals, terminated
+         * by a newline.
+         *
+         * @param buffer buffer of at least TEXT_RECORD_SIZE characters
+         * @param timeInfo broken down time of the measurement
+         * @param values temperature, humidity, pressure, pressure at sealevel and height
+         * @return size_t number of characters
+         */
+        static size_t formatRecord(char* buffer, const struct tm& timeInfo, const float values[5]) {
+            size_t length = formatTimestamp(buffer, timeInfo);
+            for(uint8_t i = 0; i < 5; i++) {
+                buffer[length++] = ',';
+                length += formatFixed(buffer + length, values[i], 2);
+            }
+            buffer[length++] = '\n';
+            buffer[length] = '\0';
+            return length;
+        }
+};
@@ -0,0 +1,349 @@
+/**
+ * @file TimeSync.h
+ * @brief Bounded time synchronisation over WiFi and SNTP. An attempt ends after a connect and an SNTP timeout and
+ * switches the radio off as soon as SNTP reports the sync, so a missing access point costs at most the timeouts.
+ * Failed attempts are retried with exponential backoff, successful ones are repeated after the resync interval. The
+ * error of the RTC found by every sync teaches a drift estimate, which corrects the RTC in between. The network is a
+ * template argument: hal::TimeNetwork uses WiFi and SNTP of the Arduino core on the ESP32 and a simulated access
+ * point and time server in the native environment.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <HAL.h>
+
+/**
+ * @brief Result of TimeSync::poll(), TimeSync::update() and TimeSync::advance().
+ *
+ */
+enum TimeSyncStatus {
+    TIME_SYNC_IDLE,
+    TIME_SYNC_CONNECTING,
+    TIME_SYNC_WAITING,
+    TIME_SYNC_DONE,
+    TIME_SYNC_FAILED
+};
+
+/**
+ * @brief Timeouts and intervals of TimeSync. The radio is on for at most connectTimeoutMillis + sntpTimeoutMillis
+ * per attempt. The n-th failed attempt in a row is retried after retrySeconds * 2^(n-1), at most maxRetrySeconds.
+ * Drift corrections smaller than minCorrectionMicros are skipped.
+ *
+ */
+struct TimeSyncPolicy {
+    uint32_t connectTimeoutMillis = 10000;
+    uint32_t sntpTimeoutMillis = 5000;
+    uint32_t resyncSeconds = 86400;
+    uint32_t retrySeconds = 300;
+    uint32_t maxRetrySeconds = 21600;
+    uint32_t minCorrectionMicros = 1000;
+};
+
+/**
+ * @brief Times of the last sync and correction, the next due attempt, the learned drift of the RTC and counters. Wall
+ * clock times are in µs since 1970. Valid when zero initialised, so it can be declared with RTC_DATA_ATTR: the first
+ * attempt is due at once.
+ *
+ */
+struct TimeSyncState {
+    int64_t lastSync;
+    int64_t corrected;
+    int64_t nextAttempt;
+    int64_t offset;
+    float drift;
+    uint32_t syncs;
+    uint32_t attempts;
+    uint32_t failures;
+    uint32_t lastRadioMillis;
+    uint64_t radioMicros;
+};
+
+/**
+ * @brief A class for keeping the RTC in sync with a time server while bounding the time the radio is on.
+ *
+ * @code
+ * RTC_DATA_ATTR TimeSyncState timeSyncState;
+ * hal::TimeNetwork timeNetwork;
+ * TimeSync<> timeSync(timeSyncState, timeNetwork, "SSID", "PASSWORD");
+ * timeSync.update();   //syncs when due, otherwise corrects the drift
+ * timeSync.advance();  //the same without waiting, once per loop()
+ * @endcode
+ *
+ * @tparam Network class with begin(ssid, password), connected(), startSntp(server, gmtOffset_sec,
+ * daylightOffset_sec), sntpSynced() and end()
+ */
+template <typename Network = hal::TimeNetwork>
+class TimeSync {
+
+    private:
+        TimeSyncState& _state;
+        Network& _network;
+        TimeSyncPolicy _policy;
+        const char* _ssid;
+        const char* _password;
+        const char* _ntpServer;
+        long _gmtOffset_sec;
+        int _daylightOffset_sec;
+        TimeSyncStatus _status = TIME_SYNC_IDLE;
+        uint64_t _radioStart = 0;
+        uint64_t _sntpStart = 0;
+        int64_t _sntpStartEpoch = 0;
+
+        void finish(boolean synced) {
+            _network.end();
+            uint64_t now = hal::micros64();
+            int64_t epoch = hal::epochMicros();
+            _state.attempts++;
+            _state.lastRadioMillis = (now - _radioStart) / 1000;
+            _state.radioMicros += now - _radioStart;
+            if(!synced) {
+                _state.failures++;
+                uint32_t shift = _state.failures - 1 < 16 ? _state.failures - 1 : 16;
+                uint64_t retry = (uint64_t) _policy.retrySeconds << shift;
+                retry = retry < _policy.maxRetrySeconds ? retry : _policy.maxRetrySeconds;
+                _state.nextAttempt = epoch + (int64_t) retry * 1000000;
+                _status = TIME_SYNC_FAILED;
+                return;
+            }
+            //the RTC would show the time at the start of SNTP plus the time measured since with the main clock
+            int64_t offset = _sntpStartEpoch + (int64_t) (now - _sntpStart) - epoch;
+            _state.offset = offset;
+            if(_state.syncs > 0 && epoch - _state.lastSync >= 3600000000LL) {
+                //the remaining error is the difference of the true drift to the corrected one, after less than an
+                //hour it would be dominated by the error of SNTP
+                float measured = _state.drift + (float) ((double) offset / (epoch - _state.lastSync));
+                _state.drift = _state.drift == 0 ? measured : _state.drift + (measured - _state.drift) / 2;
+            }
+            _state.lastSync = epoch;
+            _state.corrected = epoch;
+            _state.syncs++;
+            _state.failures = 0;
+            _state.nextAttempt = epoch + (int64_t) _policy.resyncSeconds * 1000000;
+            _status = TIME_SYNC_DONE;
+        }
+
+    public:
+
+        /**
+         * @brief Construct a new TimeSync object.
+         *
+         * @param state sync state, usually in RTC memory
+         * @param network WiFi and SNTP, usually hal::TimeNetwork
+         * @param ssid SSID of your WiFi network
+         * @param password password of WiFi network
+         * @param ntpServer time server
+         * @param gmtOffset_sec time offset from GMT in seconds
+         * @param daylightOffset_sec daylightOffset, usually 3600
+         */
+        TimeSync(
+            TimeSyncState& state,
+            Network& network,
+            const char* ssid,
+            const char* password,
+            const char* ntpServer = "ptbtime1.ptb.de",
+            long gmtOffset_sec = 3600,
+            int daylightOffset_sec = 3600) : _state(state), _network(network) {
+                _ssid = ssid;
+                _password = password;
+                _ntpServer = ntpServer;
+                _gmtOffset_sec = gmtOffset_sec;
+                _daylightOffset_sec = daylightOffset_sec;
+        }
+
+        /**
+         * @brief Sets timeouts and intervals.
+         *
+         * @param policy timeouts and intervals
+         */
+        void setPolicy(const TimeSyncPolicy& policy) {
+            _policy = policy;
+        }
+
+        /**
+         * @brief Returns whether an attempt is due: before the first sync, after the resync interval or after the
+         * backoff of a failed attempt.
+         *
+         * @return boolean true if update() would start an attempt
+         */
+        boolean due() const {
+            return hal::epochMicros() >= _state.nextAttempt;
+        }
+
+        /**
+         * @brief Switches the radio on and starts connecting. Continue with poll().
+         *
+         * @return boolean false if an attempt is already running
+         */
+        boolean start() {
+            if(running()) {
+                return false;
+            }
+            //the drift up to now is not part of the error the sync measures
+            correct();
+            _radioStart = hal::micros64();
+            _network.begin(_ssid, _password);
+            _status = TIME_SYNC_CONNECTING;
+            return true;
+        }
+
+        /**
+         * @brief Advances a running attempt without waiting: starts SNTP once WiFi is connected and switches the
+         * radio off after the sync or a timeout.
+         *
+         * @return TimeSyncStatus TIME_SYNC_CONNECTING or TIME_SYNC_WAITING while running, then TIME_SYNC_DONE or
+         * TIME_SYNC_FAILED
+         */
+        TimeSyncStatus poll() {
+            uint64_t now = hal::micros64();
+            if(_status == TIME_SYNC_CONNECTING) {
+                if(_network.connected()) {
+                    _sntpStartEpoch = hal::epochMicros();
+                    _sntpStart = now;
+                    _network.startSntp(_ntpServer, _gmtOffset_sec, _daylightOffset_sec);
+                    _status = TIME_SYNC_WAITING;
+                } else if(now - _radioStart >= (uint64_t) _policy.connectTimeoutMillis * 1000) {
+                    finish(false);
+                }
+            } else if(_status == TIME_SYNC_WAITING) {
+                if(_network.sntpSynced()) {
+                    finish(true);
+                } else if(now - _sntpStart >= (uint64_t) _policy.sntpTimeoutMillis * 1000) {
+                    finish(false);
+                }
+            }
+            return _status;
+        }
+
+        /**
+         * @brief Runs an attempt until it is done or timed out.
+         *
+         * @return TimeSyncStatus TIME_SYNC_DONE or TIME_SYNC_FAILED
+         */
+        TimeSyncStatus run() {
+            start();
+            while(poll() == TIME_SYNC_CONNECTING || _status == TIME_SYNC_WAITING) {
+                delay(10);
+            }
+            return _status;
+        }
+
+        /**
+         * @brief Runs an attempt if one is due, otherwise corrects the drift of the RTC. Call it once per wakeup.
+         *
+         * @return TimeSyncStatus TIME_SYNC_DONE or TIME_SYNC_FAILED after an attempt, TIME_SYNC_IDLE otherwise
+         */
+        TimeSyncStatus update() {
+            if(due()) {
+                return run();
+            }
+            correct();
+            return TIME_SYNC_IDLE;
+        }
+
+        /**
+         * @brief Non-blocking update() for a loop: starts an attempt if one is due and advances a running attempt by
+         * one poll(), otherwise corrects the drift of the RTC. Call it once per iteration; while running() is true
+         * the radio needs the CPU, so the loop should not enter light sleep.
+         *
+         * @return TimeSyncStatus TIME_SYNC_CONNECTING or TIME_SYNC_WAITING while an attempt runs, TIME_SYNC_DONE or
+         * TIME_SYNC_FAILED once when it ends, TIME_SYNC_IDLE otherwise
+         */
+        TimeSyncStatus advance() {
+            if(running()) {
+                return poll();
+            }
+            if(due()) {
+                start();
+                return poll();
+            }
+            correct();
+            return TIME_SYNC_IDLE;
+        }
+
+        /**
+         * @brief Returns whether an attempt started by start() or advance() is not finished yet.
+         *
+         * @return boolean true while connecting or waiting for the time server
+         */
+        boolean running() const {
+            return _status == TIME_SYNC_CONNECTING || _status == TIME_SYNC_WAITING;
+        }
+
+        /**
+         * @brief Corrects the RTC by the drift learned from the syncs for the time since the last correction.
+         *
+         * @return boolean true if the RTC was set
+         */
+        boolean correct() {
+            if(_state.syncs == 0 || _state.drift == 0) {
+                return false;
+            }
+            int64_t now = hal::epochMicros();
+            int64_t error = (int64_t) ((now - _state.corrected) * (double) _state.drift / (1 + (double) _state.drift));
+            if(error < (int64_t) _policy.minCorrectionMicros && -error < (int64_t) _policy.minCorrectionMicros) {
+                return false;
+            }
+            hal::setEpochMicros(now - error);
+            _state.corrected = now - error;
+            return true;
+        }
+
+        /**
+         * @brief Returns whether the RTC was synced at least once.
+         *
+         * @return boolean true after the first sync
+         */
+        boolean synced() const {
+            return _state.syncs > 0;
+        }
+
+        /**
+         * @brief Returns the number of failed attempts in a row.
+         *
+         * @return uint32_t failed attempts since the last sync
+         */
+        uint32_t failures() const {
+            return _state.failures;
+        }
+
+        /**
+         * @brief Returns the error of the RTC found by the last sync.
+         *
+         * @return int64_t error in microseconds, positive if the RTC was ahead
+         */
+        int64_t offset() const {
+            return _state.offset;
+        }
+
+        /**
+         * @brief Returns the learned relative error of the RTC.
+         *
+         * @return float drift, e.g. 50e-6 if the RTC gains 50 µs per second
+         */
+        float drift() const {
+            return _state.drift;
+        }
+
+        /**
+         * @brief Returns the time the radio was on during the last attempt.
+         *
+         * @return uint32_t milliseconds
+         */
+        uint32_t lastRadioMillis() const {
+            return _state.lastRadioMillis;
+        }
+
+        /**
+         * @brief Returns the time from now to the next due attempt.
+         *
+         * @return int64_t seconds, 0 or less if an attempt is due
+         */
+        int64_t secondsToNextAttempt() const {
+            return (_state.nextAttempt - hal::epochMicros()) / 1000000;
+        }
+};
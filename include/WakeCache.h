@@ -0,0 +1,97 @@
+/**
+ * @file WakeCache.h
+ * @brief State which is expensive to rebuild on every wakeup: BMP180 calibration, reference pressure, the name of
+ * the current log file and whether its header is written. Kept in RTC memory, it allows a warm start after deep sleep.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <HAL.h>
+#include <BMP180.h>
+#include <CRC32.h>
+
+/**
+ * @brief Marks an initialised WakeCache.
+ */
+#define WAKE_CACHE_MAGIC 0x57414B45
+
+/**
+ * @brief Maximum length of a cached log file name including the terminating zero.
+ */
+#define WAKE_CACHE_FILE_NAME_SIZE 40
+
+/**
+ * @brief The log file of the current day. Valid if day is not 0. part is the number of the file of the day, see
+ * LogRotation.h, size the end of the data written to it.
+ *
+ */
+struct LogFileState {
+    int32_t day;
+    boolean headerWritten;
+    uint32_t sequence;
+    uint16_t part;
+    uint32_t size;
+    char fileName[WAKE_CACHE_FILE_NAME_SIZE];
+};
+
+/**
+ * @brief Cached initialisation results. Valid when zero initialised, so it can be declared with RTC_DATA_ATTR: after
+ * power-on everything is marked as missing and a cold start fills it.
+ *
+ * @code
+ * RTC_DATA_ATTR WakeCache wakeCache;
+ * wakeCache.begin(WakeCache::hash(&referenceHeight, sizeof(referenceHeight)));
+ * climate.setWakeCache(&wakeCache);
+ * @endcode
+ */
+struct WakeCache {
+    uint32_t magic;
+    uint32_t config;
+    boolean calibrated;
+    BMP180Calibration calibration;
+    boolean referenced;
+    float referencePressure;
+    LogFileState logFile;
+
+    /**
+     * @brief Decides between warm and cold start. The cache is kept on a timer wakeup if it was filled with the
+     * same configuration, otherwise, e.g. after power-on, a reset or a changed configuration, it is cleared.
+     *
+     * @param configuration hash of all settings the cached values depend on, see hash()
+     * @return boolean true for a warm start
+     */
+    boolean begin(uint32_t configuration) {
+        if(hal::timerWakeup() && magic == WAKE_CACHE_MAGIC && config == configuration) {
+            return true;
+        }
+        invalidate();
+        magic = WAKE_CACHE_MAGIC;
+        config = configuration;
+        return false;
+    }
+
+    /**
+     * @brief Clears all cached values, so the next wakeup does a cold start.
+     *
+     */
+    void invalidate() {
+        memset(this, 0, sizeof(*this));
+    }
+
+    /**
+     * @brief Hashes settings for begin(). Several settings can be chained by passing the previous hash.
+     *
+     * @param data setting
+     * @param length size of the setting in bytes
+     * @param seed previous hash
+     * @return uint32_t hash
+     */
+    static uint32_t hash(const void* data, size_t length, uint32_t seed = 0) {
+        return crc32((const uint8_t*) data, length, seed);
+    }
+};
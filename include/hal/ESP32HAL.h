@@ -0,0 +1,250 @@
+/**
+ * @file ESP32HAL.h
+ * @brief Implementation of the hardware abstraction layer for the ESP32.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SD.h>
+#include <SPI.h>
+#include <Wire.h>
+#include <WiFi.h>
+#include <esp_sntp.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <driver/uart.h>
+#include <esp_timer.h>
+#include <time.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace hal {
+
+    typedef TwoWire SensorBus;
+    typedef fs::SDFS Storage;
+
+    /**
+     * @brief Returns the time since boot.
+     *
+     * @return uint64_t microseconds since boot
+     */
+    inline uint64_t micros64() {
+        return esp_timer_get_time();
+    }
+
+    /**
+     * @brief Returns the wall clock time of the real time clock.
+     *
+     * @return time_t seconds since 1970 (UTC)
+     */
+    inline time_t epoch() {
+        return ::time(nullptr);
+    }
+
+    /**
+     * @brief Returns the wall clock time of the real time clock with microsecond resolution.
+     *
+     * @return int64_t microseconds since 1970 (UTC)
+     */
+    inline int64_t epochMicros() {
+        struct timeval now;
+        gettimeofday(&now, nullptr);
+        return (int64_t) now.tv_sec * 1000000 + now.tv_usec;
+    }
+
+    /**
+     * @brief Sets the wall clock of the real time clock, e.g. to correct its drift.
+     *
+     * @param micros microseconds since 1970 (UTC)
+     */
+    inline void setEpochMicros(int64_t micros) {
+        struct timeval now;
+        now.tv_sec = micros / 1000000;
+        now.tv_usec = micros % 1000000;
+        settimeofday(&now, nullptr);
+    }
+
+    /**
+     * @brief Enters deep sleep and wakes up after the given time. Does not return.
+     *
+     * @param micros sleep duration in microseconds
+     */
+    inline void deepSleep(uint64_t micros) {
+        esp_sleep_enable_timer_wakeup(micros);
+        esp_deep_sleep_start();
+    }
+
+    /**
+     * @brief Enters light sleep: RAM, peripherals and tasks are kept, both cores are stopped until the time has
+     * passed or a pin reaches a level. Input on the serial console wakes up as well, so a host can reach LogExport;
+     * the characters that wake up the ESP32 are lost.
+     *
+     * @param micros maximum sleep duration in microseconds
+     * @param pin GPIO which ends the sleep
+     * @param level level of the pin which ends the sleep, HIGH or LOW
+     * @return boolean true if the pin ended the sleep
+     */
+    inline boolean lightSleep(uint64_t micros, uint8_t pin, uint8_t level) {
+        esp_sleep_enable_timer_wakeup(micros);
+        gpio_wakeup_enable((gpio_num_t) pin, level ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+        esp_sleep_enable_gpio_wakeup();
+        uart_set_wakeup_threshold(UART_NUM_0, 3);
+        esp_sleep_enable_uart_wakeup(UART_NUM_0);
+        esp_light_sleep_start();
+        gpio_wakeup_disable((gpio_num_t) pin);
+        esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+        return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO;
+    }
+
+    /**
+     * @brief Sets the CPU frequency. 80, 160 and 240 MHz keep the APB clock at 80 MHz, so UART, I2C and SPI are
+     * not affected.
+     *
+     * @param mhz CPU frequency in MHz
+     */
+    inline void setCpuMhz(uint32_t mhz) {
+        setCpuFrequencyMhz(mhz);
+    }
+
+    /**
+     * @brief Returns whether this boot is a wakeup from a deep sleep started with deepSleep(). It is false after
+     * power-on, a reset or restart().
+     *
+     * @return boolean true on a timer wakeup
+     */
+    inline boolean timerWakeup() {
+        return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER;
+    }
+
+    /**
+     * @brief Restarts the ESP32. Does not return.
+     *
+     */
+    inline void restart() {
+        ESP.restart();
+    }
+
+    /**
+     * @brief Configures a PWM channel.
+     *
+     * @param channel PWM channel
+     * @param frequency PWM frequency
+     * @param resolution resolution in bits
+     */
+    inline void ledSetup(uint8_t channel, uint32_t frequency, uint8_t resolution) {
+        ledcSetup(channel, frequency, resolution);
+    }
+
+    /**
+     * @brief Connects a pin to a PWM channel.
+     *
+     * @param pin GPIO
+     * @param channel PWM channel
+     */
+    inline void ledAttach(uint8_t pin, uint8_t channel) {
+        ledcAttachPin(pin, channel);
+    }
+
+    /**
+     * @brief Sets the duty cycle of a PWM channel.
+     *
+     * @param channel PWM channel
+     * @param duty duty cycle
+     */
+    inline void ledWrite(uint8_t channel, uint32_t duty) {
+        ledcWrite(channel, duty);
+    }
+
+    /**
+     * @brief Starts a FreeRTOS task pinned to a core.
+     *
+     * @param function task function, has to call endTask() instead of returning
+     * @param argument argument of the task function
+     * @param name name of the task
+     * @param stackSize stack size in bytes
+     * @param priority priority, loop() runs with 1
+     * @param core core 0 or 1, loop() runs on core 1
+     * @return boolean false if the task could not be created
+     */
+    inline boolean startTask(void (*function)(void*), void* argument, const char* name, uint32_t stackSize, uint8_t priority, int core) {
+        return xTaskCreatePinnedToCore(function, name, stackSize, argument, priority, nullptr, core) == pdPASS;
+    }
+
+    /**
+     * @brief Ends the calling task. Does not return.
+     *
+     */
+    inline void endTask() {
+        vTaskDelete(nullptr);
+    }
+
+    /**
+     * @brief Returns the I2C bus of the sensors.
+     *
+     * @return SensorBus& bus
+     */
+    inline SensorBus& sensorBus() {
+        return Wire;
+    }
+
+    /**
+     * @brief Returns the filesystem of the SD card.
+     *
+     * @return Storage& filesystem
+     */
+    inline Storage& storage() {
+        return SD;
+    }
+
+    /**
+     * @brief Shortens a file on the SD card, which fs::FS does not offer. Goes through the VFS of ESP-IDF below
+     * "/sd", the default mount point of SD.begin().
+     *
+     * @param path file path
+     * @param size new size in bytes
+     * @return boolean success of truncating
+     */
+    inline boolean truncateFile(const char* path, size_t size) {
+        String mounted = String("/sd") + path;
+        return truncate(mounted.c_str(), size) == 0;
+    }
+
+    /**
+     * @brief WiFi station and SNTP client of the Arduino core, the network of TimeSync (TimeSync.h).
+     *
+     */
+    class TimeNetwork {
+
+        public:
+            void begin(const char* ssid, const char* password) {
+                WiFi.mode(WIFI_STA);
+                WiFi.begin(ssid, password);
+            }
+
+            boolean connected() {
+                return WiFi.status() == WL_CONNECTED;
+            }
+
+            void startSntp(const char* server, long gmtOffset_sec, int daylightOffset_sec) {
+                sntp_set_sync_status(SNTP_SYNC_STATUS_RESET);
+                configTime(gmtOffset_sec, daylightOffset_sec, server);
+            }
+
+            boolean sntpSynced() {
+                return sntp_get_sync_status() == SNTP_SYNC_STATUS_COMPLETED;
+            }
+
+            void end() {
+                sntp_stop();
+                WiFi.disconnect(true);
+                WiFi.mode(WIFI_OFF);
+            }
+    };
+}
@@ -0,0 +1,494 @@
+/**
+ * @file FakeSensors.h
+ * @brief Simulated I2C bus with a HTU21DF and a BMP180 for the native environment. The sensors report the values
+ * of hal::native::environment, respect their conversion times on the virtual clock and use the register protocol
+ * of the real devices, so the drivers run unchanged. With hal::native::sensorNoise enabled they add gaussian noise to
+ * every conversion, for the pressure depending on the oversampling. hal::native::climateReplay replays recorded csv
+ * logs into hal::native::environment.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace hal {
+    namespace native {
+
+        /**
+         * @brief Climate seen by the fake sensors.
+         *
+         */
+        struct Environment {
+            double temperature = 21.5;
+            double humidity = 45.0;
+            double pressure = 98700;
+        };
+
+        inline Environment environment;
+
+        /**
+         * @brief Standard deviations of the noise of the fake sensors, off by default. The pressure noise per
+         * oversampling setting is the RMS noise of the BMP180 datasheet, the others are assumed from the
+         * resolution and repeatability of the datasheets.
+         *
+         */
+        struct SensorNoise {
+            bool enabled = false;
+            double temperatureHTU21DF = 0.04;
+            double humidity = 0.04;
+            double temperatureBMP180 = 0.1;
+            double pressure[4] = {6, 5, 4, 3};
+            uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+            /**
+             * @brief Returns a normally distributed value with a standard deviation, 0 if the noise is off.
+             *
+             * @param deviation standard deviation
+             * @return double noise
+             */
+            double next(double deviation) {
+                if(!enabled) {
+                    return 0;
+                }
+                double u1 = (random() + 1.0) / 18446744073709551616.0;
+                double u2 = random() / 18446744073709551616.0;
+                return deviation * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+            }
+
+            uint64_t random() {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                return state;
+            }
+        };
+
+        inline SensorNoise sensorNoise;
+
+        /**
+         * @brief Climate of recorded csv logs of ClimateDataLogger replayed to the fake sensors. The first record is
+         * aligned with the first conversion of the simulation, values between two records are interpolated and the
+         * recording starts over when the simulation runs longer.
+         *
+         */
+        class ClimateReplay {
+
+            private:
+                struct Record {
+                    int64_t time;
+                    double temperature;
+                    double humidity;
+                    double pressure;
+                };
+
+                std::vector<Record> _records;
+                int64_t _start = -1;
+                size_t _position = 0;
+
+            public:
+
+                /**
+                 * @brief Adds the records of a csv log, lines which are no record are skipped. The time is read in
+                 * the ISO 8601 format of the current logger and in the d.m.yyyy h:m:s format of older logs.
+                 *
+                 * @param path path of the log on the host
+                 * @return bool false if the file cannot be read or has no record
+                 */
+                bool load(const char* path) {
+                    FILE* file = fopen(path, "r");
+                    if(!file) {
+                        return false;
+                    }
+                    size_t count = _records.size();
+                    char line[256];
+                    while(fgets(line, sizeof(line), file)) {
+                        struct tm timeInfo = {};
+                        Record record;
+                        if(sscanf(line, "%d-%d-%dT%d:%d:%d,%lf,%lf,%lf", &timeInfo.tm_year, &timeInfo.tm_mon,
+                            &timeInfo.tm_mday, &timeInfo.tm_hour, &timeInfo.tm_min, &timeInfo.tm_sec,
+                            &record.temperature, &record.humidity, &record.pressure) == 9
+                            || sscanf(line, "%d.%d.%d %d:%d:%d,%lf,%lf,%lf", &timeInfo.tm_mday, &timeInfo.tm_mon,
+                            &timeInfo.tm_year, &timeInfo.tm_hour, &timeInfo.tm_min, &timeInfo.tm_sec,
+                            &record.temperature, &record.humidity, &record.pressure) == 9) {
+                            timeInfo.tm_year -= 1900;
+                            timeInfo.tm_mon -= 1;
+                            record.time = timegm(&timeInfo);
+                            //logged in hPa
+                            record.pressure *= 100;
+                            _records.push_back(record);
+                        }
+                    }
+                    fclose(file);
+                    std::stable_sort(_records.begin(), _records.end(), [](const Record& a, const Record& b) {
+                        return a.time < b.time;
+                    });
+                    return _records.size() > count;
+                }
+
+                /**
+                 * @brief Returns the number of loaded records.
+                 *
+                 * @return size_t records
+                 */
+                size_t size() const {
+                    return _records.size();
+                }
+
+                /**
+                 * @brief Returns the duration of the recording.
+                 *
+                 * @return int64_t seconds from the first to the last record
+                 */
+                int64_t seconds() const {
+                    return _records.empty() ? 0 : _records.back().time - _records.front().time;
+                }
+
+                /**
+                 * @brief Sets the environment to the recorded climate at a time of the simulation. Does nothing
+                 * without records.
+                 *
+                 * @param epochSeconds true time of the simulation
+                 */
+                void apply(int64_t epochSeconds) {
+                    if(_records.empty()) {
+                        return;
+                    }
+                    if(_start < 0) {
+                        _start = epochSeconds;
+                    }
+                    int64_t time = _records.front().time + (seconds() > 0 ? (epochSeconds - _start) % seconds() : 0);
+                    if(time < _records[_position].time) {
+                        _position = 0;
+                    }
+                    while(_position + 1 < _records.size() && _records[_position + 1].time <= time) {
+                        _position++;
+                    }
+                    const Record& from = _records[_position];
+                    const Record& to = _position + 1 < _records.size() ? _records[_position + 1] : from;
+                    double part = to.time > from.time ? (double) (time - from.time) / (to.time - from.time) : 0;
+                    environment.temperature = from.temperature + (to.temperature - from.temperature) * part;
+                    environment.humidity = from.humidity + (to.humidity - from.humidity) * part;
+                    environment.pressure = from.pressure + (to.pressure - from.pressure) * part;
+                }
+        };
+
+        inline ClimateReplay climateReplay;
+
+        /**
+         * @brief A device on the fake I2C bus.
+         *
+         */
+        class FakeI2CDevice {
+
+            public:
+                virtual ~FakeI2CDevice() {}
+
+                /**
+                 * @brief Handles a write transaction.
+                 *
+                 * @return bool false to not acknowledge
+                 */
+                virtual bool receive(const uint8_t* data, size_t length) = 0;
+
+                /**
+                 * @brief Handles a read transaction.
+                 *
+                 * @return bool false to not acknowledge
+                 */
+                virtual bool transmit(uint8_t* data, size_t length) = 0;
+        };
+
+        /**
+         * @brief Simulated HTU21DF answering the no hold master commands.
+         *
+         */
+        class FakeHTU21DF : public FakeI2CDevice {
+
+            private:
+                uint8_t _command = 0;
+                uint64_t _ready = 0;
+
+                static uint8_t crc8(const uint8_t* data, uint8_t length) {
+                    uint8_t crc = 0;
+                    for(uint8_t i = 0; i < length; i++) {
+                        crc ^= data[i];
+                        for(uint8_t bit = 0; bit < 8; bit++) {
+                            crc = crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1;
+                        }
+                    }
+                    return crc;
+                }
+
+            public:
+                uint32_t temperatureMicros = 44000;
+                uint32_t humidityMicros = 14000;
+                uint32_t conversions = 0;
+
+                bool receive(const uint8_t* data, size_t length) override {
+                    if(length != 1) {
+                        return false;
+                    }
+                    _command = data[0];
+                    if(_command == 0xF3 || _command == 0xF5) {
+                        conversions++;
+                        _ready = micros64() + (_command == 0xF3 ? temperatureMicros : humidityMicros);
+                    }
+                    return true;
+                }
+
+                bool transmit(uint8_t* data, size_t length) override {
+                    if(_command == 0xE7 && length == 1) {
+                        data[0] = 0x02;
+                        return true;
+                    }
+                    if((_command != 0xF3 && _command != 0xF5) || length != 3 || micros64() < _ready) {
+                        return false;
+                    }
+                    climateReplay.apply(trueEpochMicros() / 1000000);
+                    double value = _command == 0xF3
+                        ? (environment.temperature + sensorNoise.next(sensorNoise.temperatureHTU21DF) + 46.85) * 65536 / 175.72
+                        : (environment.humidity + sensorNoise.next(sensorNoise.humidity) + 6) * 65536 / 125;
+                    uint16_t raw = value < 0 ? 0 : value > 65535 ? 65535 : (uint16_t) lround(value);
+                    raw = (raw & 0xFFFC) | (_command == 0xF5 ? 0x02 : 0x00);
+                    data[0] = raw >> 8;
+                    data[1] = raw;
+                    data[2] = crc8(data, 2);
+                    return true;
+                }
+        };
+
+        /**
+         * @brief Simulated BMP180 with the calibration coefficients of the datasheet example. A conversion takes
+         * temperatureMicros or the pressureMicros of its oversampling; a read of the result before is counted in
+         * earlyReads.
+         *
+         */
+        class FakeBMP180 : public FakeI2CDevice {
+
+            private:
+                int16_t ac1 = 408, ac2 = -72, ac3 = -14383, b1 = 6190, b2 = 4, mb = -32768, mc = -8711, md = 2868;
+                uint16_t ac4 = 32741, ac5 = 32757, ac6 = 23153;
+                uint8_t _register = 0;
+                uint8_t _data[3] = {0, 0, 0};
+                int32_t _UT = -1;
+                uint64_t _ready = 0;
+
+                int32_t computeB5(int32_t UT) {
+                    int32_t X1 = ((UT - (int32_t) ac6) * (int32_t) ac5) >> 15;
+                    int32_t X2 = ((int32_t) mc << 11) / (X1 + (int32_t) md);
+                    return X1 + X2;
+                }
+
+                int32_t temperature(int32_t UT) {
+                    return (computeB5(UT) + 8) >> 4;
+                }
+
+                int32_t pressure(int32_t UT, int32_t UP, uint8_t oss) {
+                    int32_t B6 = computeB5(UT) - 4000;
+                    int32_t X1 = ((int32_t) b2 * ((B6 * B6) >> 12)) >> 11;
+                    int32_t X2 = ((int32_t) ac2 * B6) >> 11;
+                    int32_t X3 = X1 + X2;
+                    int32_t B3 = ((((int32_t) ac1 * 4 + X3) << oss) + 2) / 4;
+                    X1 = ((int32_t) ac3 * B6) >> 13;
+                    X2 = ((int32_t) b1 * ((B6 * B6) >> 12)) >> 16;
+                    X3 = ((X1 + X2) + 2) >> 2;
+                    uint32_t B4 = ((uint32_t) ac4 * (uint32_t) (X3 + 32768)) >> 15;
+                    uint32_t B7 = ((uint32_t) UP - B3) * (uint32_t) (50000UL >> oss);
+                    int32_t p = B7 < 0x80000000 ? (B7 * 2) / B4 : (B7 / B4) * 2;
+                    X1 = (p >> 8) * (p >> 8);
+                    X1 = (X1 * 3038) >> 16;
+                    X2 = (-7357 * p) >> 16;
+                    return p + ((X1 + X2 + (int32_t) 3791) >> 4);
+                }
+
+                int32_t rawTemperature(double value) {
+                    int32_t low = 0, high = 65535;
+                    while(low < high) {
+                        int32_t middle = (low + high) / 2;
+                        if(temperature(middle) < lround(value * 10)) {
+                            low = middle + 1;
+                        } else {
+                            high = middle;
+                        }
+                    }
+                    return low;
+                }
+
+                int32_t rawPressure(uint8_t oss) {
+                    // the driver compensates with the last temperature conversion, noise included
+                    int32_t UT = _UT >= 0 ? _UT : rawTemperature(environment.temperature);
+                    long value = lround(environment.pressure + sensorNoise.next(sensorNoise.pressure[oss]));
+                    int32_t low = 0, high = (1 << (16 + oss)) - 1;
+                    while(low < high) {
+                        int32_t middle = (low + high) / 2;
+                        if(pressure(UT, middle, oss) < value) {
+                            low = middle + 1;
+                        } else {
+                            high = middle;
+                        }
+                    }
+                    return low;
+                }
+
+            public:
+                uint32_t temperatureMicros = 4500;
+                uint32_t pressureMicros[4] = {4500, 7500, 13500, 25500};
+                uint32_t conversions = 0;
+                uint32_t calibrationReads = 0;
+                uint32_t earlyReads = 0;
+
+                bool receive(const uint8_t* data, size_t length) override {
+                    if(length == 0) {
+                        return false;
+                    }
+                    _register = data[0];
+                    if(length == 2 && _register == 0xF4) {
+                        conversions++;
+                        climateReplay.apply(trueEpochMicros() / 1000000);
+                        _ready = micros64() + (data[1] == 0x2E ? temperatureMicros : pressureMicros[(data[1] >> 6) & 3]);
+                        if(data[1] == 0x2E) {
+                            _UT = rawTemperature(environment.temperature + sensorNoise.next(sensorNoise.temperatureBMP180));
+                            _data[0] = _UT >> 8;
+                            _data[1] = _UT;
+                            _data[2] = 0;
+                        } else if((data[1] & 0x3F) == 0x34) {
+                            uint8_t oss = data[1] >> 6;
+                            uint32_t UP = (uint32_t) rawPressure(oss) << (8 - oss);
+                            _data[0] = UP >> 16;
+                            _data[1] = UP >> 8;
+                            _data[2] = UP;
+                        }
+                    }
+                    return true;
+                }
+
+                bool transmit(uint8_t* data, size_t length) override {
+                    const int16_t calibration[11] = {
+                        ac1, ac2, ac3, (int16_t) ac4, (int16_t) ac5, (int16_t) ac6, b1, b2, mb, mc, md
+                    };
+                    if(_register == 0xAA) {
+                        calibrationReads++;
+                    }
+                    if(_register == 0xF6 && micros64() < _ready) {
+                        //the real sensor returns the previous result
+                        earlyReads++;
+                    }
+                    for(size_t i = 0; i < length; i++) {
+                        uint8_t reg = _register + i;
+                        if(reg == 0xD0) {
+                            data[i] = 0x55;
+                        } else if(reg >= 0xAA && reg <= 0xBF) {
+                            uint16_t value = calibration[(reg - 0xAA) / 2];
+                            data[i] = (reg - 0xAA) % 2 == 0 ? value >> 8 : value;
+                        } else if(reg >= 0xF6 && reg <= 0xF8) {
+                            data[i] = _data[reg - 0xF6];
+                        } else {
+                            data[i] = 0;
+                        }
+                    }
+                    return true;
+                }
+        };
+
+        inline FakeHTU21DF htu21df;
+        inline FakeBMP180 bmp180;
+    }
+
+    /**
+     * @brief Simulated I2C bus with the interface of TwoWire. Every transferred byte takes 90 µs like at 100 kHz.
+     *
+     */
+    class FakeSensorBus {
+
+        private:
+            std::map<uint8_t, native::FakeI2CDevice*> _devices;
+            uint8_t _address = 0;
+            std::vector<uint8_t> _transmit;
+            std::vector<uint8_t> _receive;
+            size_t _position = 0;
+
+            native::FakeI2CDevice* device(uint8_t address, size_t bytes) {
+                native::advance((bytes + 1) * 90);
+                auto device = _devices.find(address);
+                return device == _devices.end() ? nullptr : device->second;
+            }
+
+        public:
+            uint32_t transactions = 0;
+
+            /**
+             * @brief Connects a device to the bus.
+             *
+             * @param address I2C address
+             * @param device device
+             */
+            void attach(uint8_t address, native::FakeI2CDevice* device) {
+                _devices[address] = device;
+            }
+
+            bool begin() {
+                return true;
+            }
+
+            void beginTransmission(uint8_t address) {
+                _address = address;
+                _transmit.clear();
+            }
+
+            size_t write(uint8_t data) {
+                _transmit.push_back(data);
+                return 1;
+            }
+
+            uint8_t endTransmission(bool /* stop */ = true) {
+                transactions++;
+                native::FakeI2CDevice* target = device(_address, _transmit.size());
+                return target && target->receive(_transmit.data(), _transmit.size()) ? 0 : 2;
+            }
+
+            uint8_t requestFrom(uint8_t address, uint8_t length, bool /* stop */ = true) {
+                transactions++;
+                native::FakeI2CDevice* target = device(address, length);
+                _receive.assign(length, 0);
+                _position = 0;
+                if(!target || !target->transmit(_receive.data(), length)) {
+                    _receive.clear();
+                    return 0;
+                }
+                return length;
+            }
+
+            int available() {
+                return _receive.size() - _position;
+            }
+
+            int read() {
+                return _position < _receive.size() ? _receive[_position++] : -1;
+            }
+    };
+
+    typedef FakeSensorBus SensorBus;
+
+    /**
+     * @brief Returns the fake I2C bus with a HTU21DF at 0x40 and a BMP180 at 0x77.
+     *
+     * @return SensorBus& bus
+     */
+    inline SensorBus& sensorBus() {
+        static SensorBus bus;
+        static bool attached = false;
+        if(!attached) {
+            bus.attach(0x40, &native::htu21df);
+            bus.attach(0x77, &native::bmp180);
+            attached = true;
+        }
+        return bus;
+    }
+}
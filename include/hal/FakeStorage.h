@@ -0,0 +1,528 @@
+/**
+ * @file FakeStorage.h
+ * @brief In-memory replacement of the SD card filesystem for the native environment. It counts mounts, opens,
+ * writes, flushes and programmed sectors and charges the virtual clock with rough SD card latencies.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+typedef enum {
+    CARD_NONE,
+    CARD_MMC,
+    CARD_SD,
+    CARD_SDHC,
+    CARD_UNKNOWN
+} sdcard_type_t;
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+namespace hal {
+    namespace native {
+
+        /**
+         * @brief Latencies of SD card operations in microseconds charged to the virtual clock.
+         *
+         */
+        struct StorageTiming {
+            uint32_t mount = 40000;
+            uint32_t open = 3000;
+            uint32_t write = 1000;
+            uint32_t read = 300;
+            uint32_t sector = 500;
+            uint32_t flush = 4000;
+        };
+
+        /**
+         * @brief Counters of filesystem operations.
+         *
+         */
+        struct StorageStatistics {
+            uint32_t mounts = 0;
+            uint32_t opens = 0;
+            uint32_t writes = 0;
+            uint64_t bytesWritten = 0;
+            uint32_t reads = 0;
+            uint64_t bytesRead = 0;
+            uint32_t flushes = 0;
+            uint64_t sectorWrites = 0;
+            uint64_t busyMicros = 0;
+        };
+
+        /**
+         * @brief A file or directory of the fake filesystem.
+         *
+         */
+        struct Node {
+            bool directory = false;
+            std::vector<uint8_t> data;
+        };
+
+        /**
+         * @brief Simulated power loss for fault injection: after writeBudget bytes all writes and truncations fail. With
+         * keepSize the interrupted write still extends the file by its full length, filled with zeros, like a FAT
+         * directory entry which was updated before the data reached the card.
+         *
+         */
+        struct StorageFault {
+            int64_t writeBudget = -1;
+            bool keepSize = false;
+        };
+
+        inline StorageTiming storageTiming;
+        inline StorageStatistics storageStatistics;
+        inline StorageFault storageFault;
+
+        /**
+         * @brief Advances the virtual clock by the duration of an SD card operation and adds it to the busy time of
+         * the card.
+         *
+         * @param micros duration in microseconds
+         */
+        inline void storageBusy(uint64_t micros) {
+            storageStatistics.busyMicros += micros;
+            advance(micros);
+        }
+    }
+}
+
+class FakeStorage;
+
+/**
+ * @brief File handle of the fake filesystem with the interface of fs::File.
+ *
+ */
+class File : public Print {
+
+    private:
+        struct Handle {
+            FakeStorage* storage = nullptr;
+            std::string path;
+            std::shared_ptr<hal::native::Node> node;
+            size_t position = 0;
+            bool writable = false;
+            bool append = false;
+            std::vector<std::string> children;
+            size_t child = 0;
+        };
+
+        std::shared_ptr<Handle> _handle;
+
+        friend class FakeStorage;
+
+    public:
+        using Print::write;
+
+        File() {}
+
+        operator bool() const {
+            return _handle != nullptr;
+        }
+
+        size_t write(uint8_t c) override {
+            return write(&c, 1);
+        }
+
+        size_t write(const uint8_t* buffer, size_t size) override {
+            if(!_handle || !_handle->writable) {
+                return 0;
+            }
+            std::vector<uint8_t>& data = _handle->node->data;
+            if(_handle->append) {
+                _handle->position = data.size();
+            }
+            size_t written = size;
+            hal::native::StorageFault& fault = hal::native::storageFault;
+            if(fault.writeBudget >= 0) {
+                written = (int64_t) size < fault.writeBudget ? size : fault.writeBudget;
+                fault.writeBudget -= written;
+                if(written < size && fault.keepSize && _handle->position + size > data.size()) {
+                    data.resize(_handle->position + size);
+                    fault.keepSize = false;
+                }
+            }
+            if(written > 0) {
+                //every touched sector is programmed again, also the partly written first and last one
+                hal::native::storageStatistics.sectorWrites += (_handle->position % 512 + written + 511) / 512;
+            }
+            if(_handle->position + written > data.size()) {
+                data.resize(_handle->position + written);
+            }
+            memcpy(data.data() + _handle->position, buffer, written);
+            _handle->position += written;
+            if(written < size) {
+                return written;
+            }
+            hal::native::storageStatistics.writes++;
+            hal::native::storageStatistics.bytesWritten += size;
+            hal::native::storageBusy(hal::native::storageTiming.write + (size + 511) / 512 * hal::native::storageTiming.sector);
+            return size;
+        }
+
+        int available() {
+            return _handle && !_handle->node->directory ? _handle->node->data.size() - _handle->position : 0;
+        }
+
+        int read() {
+            uint8_t c;
+            return read(&c, 1) == 1 ? c : -1;
+        }
+
+        size_t read(uint8_t* buffer, size_t size) {
+            size_t length = available() < (int) size ? available() : size;
+            if(length == 0) {
+                return 0;
+            }
+            memcpy(buffer, _handle->node->data.data() + _handle->position, length);
+            _handle->position += length;
+            hal::native::storageStatistics.reads++;
+            hal::native::storageStatistics.bytesRead += length;
+            hal::native::storageBusy(hal::native::storageTiming.read + (length + 511) / 512 * hal::native::storageTiming.sector);
+            return length;
+        }
+
+        int peek() {
+            return available() > 0 ? _handle->node->data[_handle->position] : -1;
+        }
+
+        bool seek(uint32_t position, SeekMode mode = SeekSet) {
+            if(!_handle) {
+                return false;
+            }
+            size_t base = mode == SeekSet ? 0 : mode == SeekCur ? _handle->position : _handle->node->data.size();
+            if(base + position > _handle->node->data.size()) {
+                return false;
+            }
+            _handle->position = base + position;
+            return true;
+        }
+
+        size_t position() const {
+            return _handle ? _handle->position : 0;
+        }
+
+        size_t size() const {
+            return _handle ? _handle->node->data.size() : 0;
+        }
+
+        void flush() {
+            if(_handle && _handle->writable) {
+                hal::native::storageStatistics.flushes++;
+                //directory entry and FAT sector
+                hal::native::storageStatistics.sectorWrites += 2;
+                hal::native::storageBusy(hal::native::storageTiming.flush);
+            }
+        }
+
+        void close() {
+            _handle.reset();
+        }
+
+        const char* path() const {
+            return _handle ? _handle->path.c_str() : "";
+        }
+
+        const char* name() const {
+            if(!_handle) {
+                return "";
+            }
+            size_t slash = _handle->path.rfind('/');
+            return _handle->path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+        }
+
+        bool isDirectory() const {
+            return _handle && _handle->node->directory;
+        }
+
+        File openNextFile(const char* mode = FILE_READ);
+};
+
+/**
+ * @brief In-memory filesystem with the interface of fs::SDFS.
+ *
+ */
+class FakeStorage {
+
+    private:
+        std::map<std::string, std::shared_ptr<hal::native::Node>> _nodes;
+        bool _inserted = true;
+        uint64_t _cardSize = 16ULL * 1024 * 1024 * 1024;
+
+        static std::string normalise(const char* path) {
+            std::string normalised = path[0] == '/' ? path : std::string("/") + path;
+            while(normalised.length() > 1 && normalised.back() == '/') {
+                normalised.pop_back();
+            }
+            return normalised;
+        }
+
+        static std::string parent(const std::string& path) {
+            size_t slash = path.rfind('/');
+            return slash == 0 ? "/" : path.substr(0, slash);
+        }
+
+        bool isDirectory(const std::string& path) {
+            auto node = _nodes.find(path);
+            return node != _nodes.end() && node->second->directory;
+        }
+
+    public:
+        FakeStorage() {
+            _nodes["/"] = std::make_shared<hal::native::Node>();
+            _nodes["/"]->directory = true;
+        }
+
+        /**
+         * @brief Simulates inserting or removing the card.
+         *
+         * @param inserted true if a card is inserted
+         */
+        void setInserted(bool inserted) {
+            _inserted = inserted;
+        }
+
+        bool begin(uint8_t /* ss */ = 5) {
+            hal::native::storageStatistics.mounts++;
+            hal::native::storageBusy(hal::native::storageTiming.mount);
+            return _inserted;
+        }
+
+        void end() {
+        }
+
+        sdcard_type_t cardType() {
+            return _inserted ? CARD_SDHC : CARD_NONE;
+        }
+
+        /**
+         * @brief Sets the capacity of the card, e.g. a small card to run into the retention policy of LogRotation.h.
+         *
+         * @param size capacity in bytes, 16 GB by default
+         */
+        void setCardSize(uint64_t size) {
+            _cardSize = size;
+        }
+
+        uint64_t cardSize() {
+            return _cardSize;
+        }
+
+        uint64_t totalBytes() {
+            return cardSize();
+        }
+
+        uint64_t usedBytes() {
+            uint64_t used = 0;
+            for(auto& node : _nodes) {
+                used += node.second->data.size();
+            }
+            return used;
+        }
+
+        File open(const char* path, const char* mode = FILE_READ, bool /* create */ = false) {
+            File file;
+            std::string normalised = normalise(path);
+            auto node = _nodes.find(normalised);
+            bool creating = mode[0] == 'w' || mode[0] == 'a';
+            bool writable = creating || mode[1] == '+';
+            hal::native::storageStatistics.opens++;
+            hal::native::storageBusy(hal::native::storageTiming.open);
+            if(!_inserted) {
+                return file;
+            }
+            if(node == _nodes.end()) {
+                if(!creating || !isDirectory(parent(normalised))) {
+                    return file;
+                }
+                node = _nodes.emplace(normalised, std::make_shared<hal::native::Node>()).first;
+            } else if(node->second->directory && writable) {
+                return file;
+            }
+            file._handle = std::make_shared<File::Handle>();
+            file._handle->storage = this;
+            file._handle->path = normalised;
+            file._handle->node = node->second;
+            file._handle->writable = writable;
+            file._handle->append = mode[0] == 'a';
+            if(mode[0] == 'w') {
+                node->second->data.clear();
+            }
+            if(node->second->directory) {
+                std::string prefix = normalised == "/" ? "/" : normalised + "/";
+                for(auto& entry : _nodes) {
+                    if(entry.first.length() > prefix.length() && entry.first.compare(0, prefix.length(), prefix) == 0
+                        && entry.first.find('/', prefix.length()) == std::string::npos) {
+                        file._handle->children.push_back(entry.first);
+                    }
+                }
+            }
+            return file;
+        }
+
+        File open(const String& path, const char* mode = FILE_READ) {
+            return open(path.c_str(), mode);
+        }
+
+        bool exists(const char* path) {
+            return _inserted && _nodes.count(normalise(path)) > 0;
+        }
+
+        bool exists(const String& path) {
+            return exists(path.c_str());
+        }
+
+        bool remove(const char* path) {
+            auto node = _nodes.find(normalise(path));
+            if(node == _nodes.end() || node->second->directory) {
+                return false;
+            }
+            _nodes.erase(node);
+            return true;
+        }
+
+        bool rename(const char* from, const char* to) {
+            std::string source = normalise(from);
+            std::string target = normalise(to);
+            auto node = _nodes.find(source);
+            if(node == _nodes.end() || _nodes.count(target) || !isDirectory(parent(target))) {
+                return false;
+            }
+            _nodes[target] = node->second;
+            _nodes.erase(source);
+            return true;
+        }
+
+        bool mkdir(const char* path) {
+            std::string normalised = normalise(path);
+            if(_nodes.count(normalised) || !isDirectory(parent(normalised))) {
+                return false;
+            }
+            _nodes[normalised] = std::make_shared<hal::native::Node>();
+            _nodes[normalised]->directory = true;
+            return true;
+        }
+
+        /**
+         * @brief Shortens a file.
+         *
+         * @param path file path
+         * @param size new size in bytes, at most the current size
+         * @return bool success of truncating
+         */
+        bool truncate(const char* path, size_t size) {
+            auto node = _nodes.find(normalise(path));
+            if(!_inserted || node == _nodes.end() || node->second->directory || size > node->second->data.size()) {
+                return false;
+            }
+            if(hal::native::storageFault.writeBudget == 0) {
+                return false;
+            }
+            node->second->data.resize(size);
+            hal::native::storageStatistics.writes++;
+            hal::native::storageStatistics.sectorWrites += 2;
+            hal::native::storageBusy(hal::native::storageTiming.write);
+            return true;
+        }
+
+        /**
+         * @brief Removes all files and directories, like formatting the card.
+         *
+         */
+        void format() {
+            _nodes.clear();
+            _nodes["/"] = std::make_shared<hal::native::Node>();
+            _nodes["/"]->directory = true;
+        }
+
+        bool rmdir(const char* path) {
+            std::string normalised = normalise(path);
+            if(!isDirectory(normalised) || normalised == "/") {
+                return false;
+            }
+            std::string prefix = normalised + "/";
+            for(auto& entry : _nodes) {
+                if(entry.first.compare(0, prefix.length(), prefix) == 0) {
+                    return false;
+                }
+            }
+            _nodes.erase(normalised);
+            return true;
+        }
+
+        /**
+         * @brief Writes all files to a directory of the host, e.g. to inspect or decode the logs.
+         *
+         * @param directory existing host directory
+         * @return bool success of writing
+         */
+        bool dump(const char* directory) {
+            for(auto& entry : _nodes) {
+                std::string path = std::string(directory) + entry.first;
+                if(entry.second->directory) {
+                    if(entry.first != "/" && ::mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+                        return false;
+                    }
+                    continue;
+                }
+                FILE* file = fopen(path.c_str(), "wb");
+                if(!file) {
+                    return false;
+                }
+                fwrite(entry.second->data.data(), 1, entry.second->data.size(), file);
+                fclose(file);
+            }
+            return true;
+        }
+};
+
+inline File File::openNextFile(const char* mode) {
+    if(!_handle || _handle->child >= _handle->children.size()) {
+        return File();
+    }
+    return _handle->storage->open(_handle->children[_handle->child++].c_str(), mode);
+}
+
+namespace hal {
+
+    typedef FakeStorage Storage;
+
+    /**
+     * @brief Returns the fake filesystem.
+     *
+     * @return Storage& filesystem
+     */
+    inline Storage& storage() {
+        static Storage storage;
+        return storage;
+    }
+
+    /**
+     * @brief Shortens a file of the fake filesystem.
+     *
+     * @param path file path
+     * @param size new size in bytes
+     * @return bool success of truncating
+     */
+    inline bool truncateFile(const char* path, size_t size) {
+        return storage().truncate(path, size);
+    }
+}
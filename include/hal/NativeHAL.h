@@ -0,0 +1,657 @@
+/**
+ * @file NativeHAL.h
+ * @brief Implementation of the hardware abstraction layer for the native (Linux) environment. It provides the
+ * subset of the Arduino API used by this project on top of a virtual clock, so deep sleep cycles run at desktop
+ * speed. Deep sleep and restarts unwind the stack with hal::Reboot, which is caught by src/native_main.cpp.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <string>
+
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define IRAM_ATTR
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define LOW 0x0
+#define HIGH 0x1
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+namespace hal {
+
+    /**
+     * @brief Thrown by deepSleep() and restart() to leave setup() or loop().
+     *
+     */
+    struct Reboot {
+        bool deepSleep;
+    };
+
+    namespace native {
+
+        /**
+         * @brief State of the virtual clock. sinceBoot restarts at every reboot, total never does. The wall clock of
+         * the RTC is off by rtcOffset from the true time when it was set at rtcSetAt and gains rtcDrift per elapsed
+         * time from then on (e.g. 50e-6 gains 50 µs per second). The deep sleep timer counts the same slow clock, so it
+         * ends early by rtcDrift; sleepDrift is its error against the wall clock on top of that (e.g. 0.01 sleeps 1 %
+         * too long). bootMicros is the time from a timer wakeup to setup(); the default is the boot of the ESP32
+         * bootloader and the application image without a fast boot stub.
+         *
+         */
+        struct Clock {
+            uint64_t sinceBoot = 0;
+            uint64_t total = 0;
+            time_t epochStart = 1653638400;
+            bool synced = false;
+            bool timerWakeup = false;
+            double sleepDrift = 0;
+            uint32_t bootMicros = 150000;
+            uint32_t cpuMhz = 240;
+            int64_t rtcOffset = 0;
+            uint64_t rtcSetAt = 0;
+            double rtcDrift = 0;
+        };
+
+        /**
+         * @brief Counters of the simulated device.
+         *
+         */
+        struct Statistics {
+            uint32_t boots = 0;
+            uint32_t deepSleeps = 0;
+            uint32_t restarts = 0;
+            uint64_t awakeMicros = 0;
+            uint64_t sleepMicros = 0;
+            uint32_t lightSleeps = 0;
+            uint64_t lightSleepMicros = 0;
+        };
+
+        /**
+         * @brief Timing of the serial port: begin() takes beginMicros to install the UART driver, written bytes
+         * leave at the baud rate (10 bits per byte) through a transmit FIFO of fifoBytes, and write() waits while
+         * the FIFO is full. The output is timed the same with --quiet.
+         *
+         */
+        struct SerialTiming {
+            uint32_t beginMicros = 1000;
+            uint16_t fifoBytes = 128;
+        };
+
+        inline Clock clock;
+        inline SerialTiming serialTiming;
+        inline Statistics statistics;
+        inline uint8_t pins[40];
+        inline uint32_t ledDuty[16];
+        inline bool quiet = false;
+
+        /**
+         * @brief Advances the virtual clock while the device is awake.
+         *
+         * @param micros elapsed microseconds
+         */
+        inline void advance(uint64_t micros) {
+            clock.sinceBoot += micros;
+            clock.total += micros;
+            statistics.awakeMicros += micros;
+        }
+
+        /**
+         * @brief Sets the level of an input pin, e.g. the mode toggle switch.
+         *
+         * @param pin GPIO
+         * @param level HIGH or LOW
+         */
+        inline void setPin(uint8_t pin, uint8_t level) {
+            pins[pin] = level;
+        }
+
+        /**
+         * @brief Returns the true time of the simulation, which the fake time server reports.
+         *
+         * @return int64_t microseconds since 1970 (UTC)
+         */
+        inline int64_t trueEpochMicros() {
+            return (int64_t) clock.epochStart * 1000000 + clock.total;
+        }
+
+        /**
+         * @brief Sets the time zone from the offsets of configTime() like the ESP32 core does.
+         *
+         * @param gmtOffset_sec time offset from GMT in seconds
+         * @param daylightOffset_sec daylight offset, 0 without daylight saving time
+         */
+        inline void setTimeZone(long gmtOffset_sec, int daylightOffset_sec) {
+            char tz[40];
+            snprintf(tz, sizeof(tz), "UTC%ld%s", -gmtOffset_sec / 3600, daylightOffset_sec ? "DST" : "");
+            setenv("TZ", tz, 1);
+            tzset();
+        }
+
+        /**
+         * @brief Simulated access point and time server of hal::TimeNetwork. Without accessPoint the connection
+         * never completes; connects counts the attempts and radioMicros the time the radio was on.
+         *
+         */
+        struct Network {
+            bool accessPoint = true;
+            uint32_t connectMicros = 2000000;
+            uint32_t sntpMicros = 300000;
+            uint32_t connects = 0;
+            uint64_t radioMicros = 0;
+        };
+
+        inline Network network;
+    }
+
+    /**
+     * @brief Returns the virtual time since boot.
+     *
+     * @return uint64_t microseconds since boot
+     */
+    inline uint64_t micros64() {
+        return native::clock.sinceBoot;
+    }
+
+    /**
+     * @brief Returns the virtual wall clock time of the RTC with microsecond resolution, including its offset and
+     * drift.
+     *
+     * @return int64_t microseconds since 1970 (UTC)
+     */
+    inline int64_t epochMicros() {
+        return native::trueEpochMicros() + native::clock.rtcOffset
+            + (int64_t) ((native::clock.total - native::clock.rtcSetAt) * native::clock.rtcDrift);
+    }
+
+    /**
+     * @brief Sets the virtual wall clock of the RTC. The drift starts again from this point.
+     *
+     * @param micros microseconds since 1970 (UTC)
+     */
+    inline void setEpochMicros(int64_t micros) {
+        native::clock.rtcOffset = micros - native::trueEpochMicros();
+        native::clock.rtcSetAt = native::clock.total;
+    }
+
+    /**
+     * @brief Returns the virtual wall clock time.
+     *
+     * @return time_t seconds since 1970 (UTC)
+     */
+    inline time_t epoch() {
+        return epochMicros() / 1000000;
+    }
+
+
+    /**
+     * @brief Simulates deep sleep: advances the clock by the duration including the drift of the timer and the slow
+     * clock and the boot time, resets the time since boot and throws hal::Reboot.
+     *
+     * @param micros sleep duration in microseconds
+     */
+    [[noreturn]] inline void deepSleep(uint64_t micros) {
+        uint64_t slept = (micros + (int64_t) (micros * native::clock.sleepDrift)) / (1 + native::clock.rtcDrift);
+        native::clock.total += slept;
+        native::clock.sinceBoot = 0;
+        native::statistics.sleepMicros += slept;
+        native::advance(native::clock.bootMicros);
+        native::statistics.deepSleeps++;
+        native::clock.timerWakeup = true;
+        throw Reboot{true};
+    }
+
+    /**
+     * @brief Simulates light sleep: advances the clock unless the pin already has the wakeup level. Pins do not
+     * change while the simulation runs.
+     *
+     * @param micros maximum sleep duration in microseconds
+     * @param pin GPIO which ends the sleep
+     * @param level level of the pin which ends the sleep
+     * @return bool true if the pin ended the sleep
+     */
+    inline bool lightSleep(uint64_t micros, uint8_t pin, uint8_t level) {
+        if(native::pins[pin] == level) {
+            return true;
+        }
+        native::clock.sinceBoot += micros;
+        native::clock.total += micros;
+        native::statistics.lightSleeps++;
+        native::statistics.lightSleepMicros += micros;
+        return false;
+    }
+
+    inline void setCpuMhz(uint32_t mhz) {
+        native::clock.cpuMhz = mhz;
+    }
+
+    /**
+     * @brief Simulates a restart by throwing hal::Reboot.
+     *
+     */
+    [[noreturn]] inline void restart() {
+        native::clock.sinceBoot = 0;
+        native::statistics.restarts++;
+        native::clock.timerWakeup = false;
+        throw Reboot{false};
+    }
+
+    /**
+     * @brief Returns whether the current boot is a wakeup from deepSleep().
+     *
+     * @return bool true on a timer wakeup
+     */
+    inline bool timerWakeup() {
+        return native::clock.timerWakeup;
+    }
+
+    /**
+     * @brief Tasks are not simulated, callers have to do the work of the task themselves.
+     *
+     * @return bool always false
+     */
+    inline bool startTask(void (*/* function */)(void*), void* /* argument */, const char* /* name */, uint32_t /* stackSize */, uint8_t /* priority */, int /* core */) {
+        return false;
+    }
+
+    inline void endTask() {
+    }
+
+    inline void ledSetup(uint8_t /* channel */, uint32_t /* frequency */, uint8_t /* resolution */) {
+    }
+
+    inline void ledAttach(uint8_t /* pin */, uint8_t /* channel */) {
+    }
+
+    inline void ledWrite(uint8_t channel, uint32_t duty) {
+        native::ledDuty[channel] = duty;
+    }
+}
+
+inline unsigned long micros() {
+    return (unsigned long) hal::micros64();
+}
+
+inline unsigned long millis() {
+    return (unsigned long) (hal::micros64() / 1000);
+}
+
+inline void delayMicroseconds(uint32_t micros) {
+    hal::native::advance(micros);
+}
+
+inline void delay(uint32_t millis) {
+    hal::native::advance((uint64_t) millis * 1000);
+}
+
+inline void pinMode(uint8_t /* pin */, uint8_t /* mode */) {
+}
+
+inline int digitalRead(uint8_t pin) {
+    return hal::native::pins[pin];
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t level) {
+    hal::native::pins[pin] = level;
+}
+
+/**
+ * @brief Subset of the Arduino String class.
+ *
+ */
+class String {
+
+    private:
+        std::string _string;
+
+    public:
+        String(const char* string = "") : _string(string) {}
+        String(const std::string& string) : _string(string) {}
+        String(char c) : _string(1, c) {}
+        String(int value) : _string(std::to_string(value)) {}
+        String(unsigned int value) : _string(std::to_string(value)) {}
+        String(long value) : _string(std::to_string(value)) {}
+        String(unsigned long value) : _string(std::to_string(value)) {}
+        String(double value, unsigned char decimals = 2) {
+            char buffer[48];
+            snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+            _string = buffer;
+        }
+
+        bool reserve(unsigned int size) {
+            _string.reserve(size);
+            return true;
+        }
+
+        template <typename T>
+        bool concat(const T& value) {
+            _string += String(value)._string;
+            return true;
+        }
+
+        bool concat(const String& value) {
+            _string += value._string;
+            return true;
+        }
+
+        template <typename T>
+        String& operator+=(const T& value) {
+            concat(value);
+            return *this;
+        }
+
+        friend String operator+(const String& left, const String& right) {
+            return String(left._string + right._string);
+        }
+
+        bool operator==(const String& other) const {
+            return _string == other._string;
+        }
+
+        bool operator!=(const String& other) const {
+            return _string != other._string;
+        }
+
+        char operator[](unsigned int index) const {
+            return _string[index];
+        }
+
+        const char* c_str() const {
+            return _string.c_str();
+        }
+
+        unsigned int length() const {
+            return _string.length();
+        }
+};
+
+/**
+ * @brief Subset of the Arduino Print class.
+ *
+ */
+class Print {
+
+    public:
+        virtual ~Print() {}
+        virtual size_t write(uint8_t c) = 0;
+
+        virtual size_t write(const uint8_t* buffer, size_t size) {
+            size_t n = 0;
+            while(size-- && write(*buffer++)) {
+                n++;
+            }
+            return n;
+        }
+
+        size_t print(const char* string) {
+            return write((const uint8_t*) string, strlen(string));
+        }
+
+        size_t print(const String& string) {
+            return print(string.c_str());
+        }
+
+        size_t print(char c) {
+            return write((uint8_t) c);
+        }
+
+        size_t print(int value) {
+            return print(String(value));
+        }
+
+        size_t print(unsigned int value) {
+            return print(String(value));
+        }
+
+        size_t print(long value) {
+            return print(String(value));
+        }
+
+        size_t print(double value, int decimals = 2) {
+            return print(String(value, decimals));
+        }
+
+        template <typename T>
+        size_t println(const T& value) {
+            return print(value) + print("\r\n");
+        }
+
+        size_t println() {
+            return print("\r\n");
+        }
+
+        size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+            char buffer[256];
+            va_list arguments;
+            va_start(arguments, format);
+            int length = vsnprintf(buffer, sizeof(buffer), format, arguments);
+            va_end(arguments);
+            if(length < 0) {
+                return 0;
+            }
+            return write((const uint8_t*) buffer, (size_t) length < sizeof(buffer) ? length : sizeof(buffer) - 1);
+        }
+};
+
+/**
+ * @brief Serial console writing to stdout.
+ *
+ */
+class HardwareSerial : public Print {
+
+    private:
+        unsigned long _baudrate = 0;
+        uint64_t _sentAt = 0;
+
+        uint64_t byteMicros() {
+            return _baudrate > 0 ? 10000000 / _baudrate : 0;
+        }
+
+        /**
+         * @brief Returns the time the transmit FIFO needs to send the written bytes. A reboot empties the FIFO.
+         */
+        uint64_t pending() {
+            uint64_t now = hal::micros64();
+            if(_sentAt > now + byteMicros() * hal::native::serialTiming.fifoBytes) {
+                _sentAt = now;
+            }
+            return _sentAt > now ? _sentAt - now : 0;
+        }
+
+    public:
+        using Print::write;
+
+        void begin(unsigned long baudrate) {
+            _baudrate = baudrate;
+            _sentAt = 0;
+            hal::native::advance(hal::native::serialTiming.beginMicros);
+        }
+
+        void updateBaudRate(unsigned long baudrate) {
+            _baudrate = baudrate;
+        }
+
+        int available() {
+            return 0;
+        }
+
+        int read() {
+            return -1;
+        }
+
+        size_t write(uint8_t c) override {
+            uint64_t full = byteMicros() * hal::native::serialTiming.fifoBytes;
+            uint64_t queued = pending();
+            if(queued + byteMicros() > full) {
+                hal::native::advance(queued + byteMicros() - full);
+            }
+            _sentAt = hal::micros64() + pending() + byteMicros();
+            if(!hal::native::quiet) {
+                fputc(c, stdout);
+            }
+            return 1;
+        }
+
+        /**
+         * @brief Waits until the written bytes are sent.
+         */
+        void flush() {
+            hal::native::advance(pending());
+            fflush(stdout);
+        }
+};
+
+inline HardwareSerial Serial;
+
+/**
+ * @brief Simulated restart of the ESP32.
+ *
+ */
+struct EspClass {
+    [[noreturn]] void restart() {
+        hal::restart();
+    }
+};
+
+inline EspClass ESP;
+
+/**
+ * @brief Simulates configTime() of the ESP32 core: sets the time zone like the core does and marks the clock as
+ * synchronised.
+ *
+ */
+inline void configTime(long gmtOffset_sec, int daylightOffset_sec, const char* /* server1 */, const char* /* server2 */ = nullptr, const char* /* server3 */ = nullptr) {
+    hal::native::setTimeZone(gmtOffset_sec, daylightOffset_sec);
+    hal::native::clock.synced = true;
+}
+
+/**
+ * @brief Returns the local virtual time, fails before configTime() was called like on the ESP32.
+ *
+ */
+inline bool getLocalTime(struct tm* info, uint32_t /* ms */ = 5000) {
+    if(!hal::native::clock.synced) {
+        return false;
+    }
+    time_t now = hal::epoch();
+    localtime_r(&now, info);
+    return true;
+}
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+    WIFI_OFF = 0,
+    WIFI_STA = 1
+} wifi_mode_t;
+
+/**
+ * @brief Simulated WiFi which connects after 2 s.
+ *
+ */
+class WiFiClass {
+
+    private:
+        uint64_t _connected = 0;
+        bool _on = false;
+
+    public:
+        void begin(const char* /* ssid */, const char* /* password */) {
+            _on = true;
+            _connected = hal::micros64() + 2000000;
+        }
+
+        wl_status_t status() {
+            return _on && hal::micros64() >= _connected ? WL_CONNECTED : WL_DISCONNECTED;
+        }
+
+        bool mode(wifi_mode_t mode) {
+            _on = mode != WIFI_OFF;
+            return true;
+        }
+};
+
+inline WiFiClass WiFi;
+
+namespace hal {
+
+    /**
+     * @brief Simulated WiFi station and SNTP client on hal::native::network, the network of TimeSync (TimeSync.h).
+     * A completed sync sets the wall clock of the RTC to the true time of the simulation.
+     *
+     */
+    class TimeNetwork {
+
+        private:
+            uint64_t _radioStart = 0;
+            uint64_t _sntpStart = 0;
+            bool _on = false;
+            bool _sntp = false;
+            bool _set = false;
+
+        public:
+            void begin(const char* /* ssid */, const char* /* password */) {
+                _on = true;
+                _sntp = false;
+                _radioStart = micros64();
+                native::network.connects++;
+            }
+
+            bool connected() {
+                return _on && native::network.accessPoint && micros64() - _radioStart >= native::network.connectMicros;
+            }
+
+            void startSntp(const char* /* server */, long gmtOffset_sec, int daylightOffset_sec) {
+                native::setTimeZone(gmtOffset_sec, daylightOffset_sec);
+                _sntp = true;
+                _set = false;
+                _sntpStart = micros64();
+            }
+
+            bool sntpSynced() {
+                if(!_sntp || !connected() || micros64() - _sntpStart < native::network.sntpMicros) {
+                    return false;
+                }
+                if(!_set) {
+                    setEpochMicros(native::trueEpochMicros());
+                    native::clock.synced = true;
+                    _set = true;
+                }
+                return true;
+            }
+
+            void end() {
+                if(_on) {
+                    native::network.radioMicros += micros64() - _radioStart;
+                }
+                _on = false;
+                _sntp = false;
+            }
+    };
+}
+
+#include <hal/FakeStorage.h>
+#include <hal/FakeSensors.h>
@@ -1,61 +1,301 @@
-#include <Arduino.h>
+#include <HAL.h>
 #include <Climate.h>
 #include <DeepSleep.h>
+#include <AwakeProfiler.h>
+#include <AdaptiveSchedule.h>
+#include <LogPipeline.h>
+#include <ChangeFilter.h>
+#include <TimeSync.h>
+#include <LogExport.h>
 
 
 const char* line = "\n==========================================";
 const int mode = 34;
 const int baudrate = 115200;
-RTC_DATA_ATTR boolean rtcSet = false;
+const float referenceHeight = 223;
+const LogFormat logFormat = LOG_CSV;
 RTC_DATA_ATTR int bootCount = 0;
+RTC_DATA_ATTR SampleBuffer sampleBuffer;
+
+//deep sleep mode: write to the SD card every batchSize wakeups or when the oldest sample is batchMaxAge seconds old
+const uint16_t batchSize = 30;
+const uint32_t batchMaxAge = 3600;
+SampleBatch batch(sampleBuffer, batchSize, batchMaxAge);
+//deep sleep mode: SD card mounts, for a batch flush or for the summary row of a closed hour or day
+RTC_DATA_ATTR uint32_t sdMounts = 0;
+
+//time between two measurements: grows up to maxSleepSeconds while the climate is steady, minSleepSeconds after a change
+const uint32_t minSleepSeconds = 10;
+const uint32_t maxSleepSeconds = 600;
+RTC_DATA_ATTR ScheduleState scheduleState;
+AdaptiveSchedule schedule(scheduleState, minSleepSeconds, maxSleepSeconds);
+
+//deep sleep mode: wake up at multiples of the interval on the wall clock
+RTC_DATA_ATTR AlignedSleepState alignedSleepState;
+AlignedSleep alignedSleep(alignedSleepState);
+
+//deep sleep mode: awake time per phase, written to the SD card every diagnosticsCycles wakeups
+RTC_DATA_ATTR AwakeProfile awakeProfile;
+AwakeProfiler profiler(awakeProfile);
+const uint32_t diagnosticsCycles = 30;
+EnergyModel energyModel;
+
+//deep sleep mode: calibration, reference pressure and log file are kept between timer wakeups
+RTC_DATA_ATTR WakeCache wakeCache;
+
+//change-only logging: a sample is logged if a channel changed at the logged precision, at least every heartbeatSeconds
+const uint32_t heartbeatSeconds = 3600;
+RTC_DATA_ATTR ChangeState changeState;
+ChangeFilter changeFilter(changeState, ChangeDeadband(), heartbeatSeconds);
+
+//hourly and daily statistics of the logged samples, written to /summary.csv
+RTC_DATA_ATTR AggregateState aggregateState;
+
+//LOG_DELTA: the open block of the delta compressed log, written to the SD card with every flush
+RTC_DATA_ATTR DeltaState deltaState;
+
+//log files: a new file at midnight and after maxLogFileBytes, one directory per month, the oldest files are
+//compacted to LOG_DELTA and then deleted when less than minFreeBytes are free on the card
+const uint32_t maxLogFileBytes = 1048576;
+const uint32_t preallocateBytes = 0;
+const uint64_t minFreeBytes = 64ULL * 1024 * 1024;
+RotationPolicy rotation;
+
+//measurement: BMP180 pressure oversampling, measurement cycles per sample and the streaming filters of the channels:
+//temperature fuses HTU21DF and BMP180 with a Kalman filter, humidity drops outliers with a median, pressure with a
+//median followed by an exponential moving average; the filters only average samples less than filterGapSeconds
+//apart, after a longer sleep they start again from the new burst
+const uint8_t oversampling = BMP180_ULTRAHIGHRES;
+const uint8_t burstSize = 1;
+const uint32_t filterGapSeconds = 30;
+RTC_DATA_ATTR ClimateFilter<KalmanFusion<20, 40, 100>, MedianFilter<3>, FilterChain<MedianFilter<3>, EmaFilter<1, 2>>> climateFilter;
+
+//time: NTP over WiFi at the first boot and every resyncHours, an attempt gives up after the connect and SNTP timeouts,
+//failed attempts are retried after retrySeconds, doubled up to maxRetrySeconds; in between the learned drift of the
+//RTC is corrected
+const uint32_t resyncHours = 24;
+const uint32_t connectTimeoutMillis = 10000;
+const uint32_t sntpTimeoutMillis = 5000;
+const uint32_t retrySeconds = 300;
+const uint32_t maxRetrySeconds = 21600;
+RTC_DATA_ATTR TimeSyncState timeSyncState;
+hal::TimeNetwork timeNetwork;
+TimeSync<> timeSync(timeSyncState, timeNetwork, "SSID", "PASSWORD");
 
 //Contains sensors and data logger
 ClimateSensor climate;
 
-void printAndLogClimate() {
+//active mode: loop() measures on core 1, a writer task on core 0 writes the samples to the SD card
+LogPipeline pipeline(climate);
+
+//active mode: light sleep between two measurements, the toggle switch wakes up at once
+LightSleep lightSleep(mode, HIGH);
+
+//active mode: a host on the serial port can export the logs (tools/receive_export.cpp), loop() executes one command
+//per iteration between the measurements and stays awake until the host is silent for exportIdleMillis
+const uint32_t exportIdleMillis = 2000;
+const uint32_t exportPollMillis = 10;
+LogExport<HardwareSerial> logExport(Serial, baudrate);
+
+//active mode: the time sync runs alongside the measurements, loop() polls it every syncPollMillis instead of light
+//sleeping; the log files are named after the day, so the logger starts with the first sync and samples taken before
+//are held and logged with the corrected time
+const uint32_t syncPollMillis = 100;
+boolean loggerStarted = false;
+ClimateSample heldSamples[SAMPLE_BUFFER_CAPACITY];
+uint16_t heldCount = 0;
+uint32_t heldDropped = 0;
+uint64_t nextMeasurement = 0;
+
+void printClimate(const ClimateSample& sample) {
   Serial.printf(
-    "\rTemperatur: %.2f °C, Feuchtigkeit: %.2f% %, Luftdruck: %.2f hPa, Luftdruck auf Meereshöhe: %.2f Höhe %.2f m", 
-    climate.readTemperature(), 
-    climate.readHumidity(), 
-    climate.readPressure(),
-    climate.readSeaLevelPressure(223),
-    climate.readAltitude()
+    "\rTemperatur: %.2f °C, Feuchtigkeit: %.2f %%, Luftdruck: %.2f hPa, Luftdruck auf Meereshöhe: %.2f Höhe %.2f m", 
+    sample.temperature, 
+    sample.humidity, 
+    sample.pressure,
+    sample.pressureAtSealevel,
+    sample.height
     );
-    climate.log();
+}
+
+void syncTime(boolean wait) {
+  TimeSyncStatus status = wait ? timeSync.update() : timeSync.advance();
+  if(status == TIME_SYNC_DONE) {
+    Serial.printf("\nTime synced in %u ms, RTC was off by %.1f ms, drift %.1f ppm\n", timeSync.lastRadioMillis(), 
+      timeSync.offset() / 1000.0, timeSync.drift() * 1e6);
+  } else if(status == TIME_SYNC_FAILED) {
+    Serial.printf("\nTime sync failed after %u ms (%u in a row), next attempt in %lld s\n", timeSync.lastRadioMillis(),
+      timeSync.failures(), (long long) timeSync.secondsToNextAttempt());
+  }
+}
+
+void logSample(const ClimateSample& sample) {
+  if(!pipeline.push(sample, changeFilter.keep(sample))) {
+    Serial.printf("\nLog queue full, %u samples dropped\n", pipeline.overflows());
+  }
+}
+
+void startLogger() {
+  //the RTC is kept by timeSync, the logger does not connect itself
+  climate.beginLogger(true);
+  loggerStarted = true;
+  //forced flush of samples left over from deep sleep mode
+  batch.flush(climate);
+}
+
+//the first sync moves the RTC by its offset, the held samples are moved with it
+void releaseHeldSamples() {
+  time_t shift = (time_t) ((timeSync.offset() + (timeSync.offset() < 0 ? -500000 : 500000)) / 1000000);
+  for(uint16_t i = 0; i < heldCount; i++) {
+    heldSamples[i].time -= shift;
+    logSample(heldSamples[i]);
+  }
+  Serial.printf("\n%u samples taken before the time sync logged, %u dropped\n", heldCount, heldDropped);
+  heldCount = 0;
 }
 
 void setup() {
+  profiler.boot();
+  alignedSleep.wake();
+  profiler.start(PHASE_SERIAL);
   Serial.begin(baudrate);
+  profiler.stop();
   //Print the number of reboots and boolean if RTC is set.
-  Serial.printf("%s\nNumber of reboots: %d, RTC set: %s\n", line, bootCount++, rtcSet ? "true" : "false");
+  Serial.printf("%s\nNumber of reboots: %d, RTC set: %s\n", line, bootCount++, timeSync.synced() ? "true" : "false");
   
-  //if RTC is not set, enable WiFi and connect to NTP service.
-  if(!rtcSet) {
-    RTC::set("SSID", "PASSWORD");
-    rtcSet = true;
-  }
+  //sync the RTC over WiFi and NTP when due, otherwise correct its drift
+  TimeSyncPolicy timePolicy;
+  timePolicy.connectTimeoutMillis = connectTimeoutMillis;
+  timePolicy.sntpTimeoutMillis = sntpTimeoutMillis;
+  timePolicy.resyncSeconds = resyncHours * 3600;
+  timePolicy.retrySeconds = retrySeconds;
+  timePolicy.maxRetrySeconds = maxRetrySeconds;
+  timeSync.setPolicy(timePolicy);
 
   //toggle switch: high activates deepsleep mode
   pinMode(mode, INPUT);
+  climate.setLogFormat(logFormat);
+  climate.setOversampling(oversampling);
+  climate.setBurst(burstSize);
+  climate.setFilterGap(filterGapSeconds);
+  climate.setAggregateState(&aggregateState);
+  climate.setDeltaState(&deltaState);
+  rotation.maxFileBytes = maxLogFileBytes;
+  rotation.preallocateBytes = preallocateBytes;
+  rotation.monthDirectories = true;
+  rotation.minFreeBytes = minFreeBytes;
+  rotation.retention = RETENTION_COMPACT;
+  climate.setRotation(rotation);
+
+  //code for deepsleep mode: the sample is buffered in RTC memory, the SD card is only mounted to flush the batch
+  if(digitalRead(mode)) {
+    syncTime(true);
+    //the deep sleep timer runs on the RTC slow clock, whose drift only the time server can measure
+    alignedSleep.setClockDrift(timeSync.drift());
+    uint32_t config = WakeCache::hash(&referenceHeight, sizeof(referenceHeight));
+    config = WakeCache::hash(&logFormat, sizeof(logFormat), config);
+    config = WakeCache::hash(&rotation, sizeof(rotation), config);
+    boolean warm = wakeCache.begin(config);
+    climate.setWakeCache(&wakeCache);
+    Serial.printf("\n%s start, waiting for climate sensor...", warm ? "Warm" : "Cold");
+    profiler.start(PHASE_SENSORS);
+    climate.beginSensors();
+    profiler.stop();
+    profiler.start(PHASE_REFERENCE);
+    climate.setReferenceHeight(referenceHeight);
+    profiler.stop();
+    Serial.println("Climate Sensor is ready.\n");
+    climate.resetBusTransactions();
+    profiler.start(PHASE_READ);
+    ClimateSample sample = climate.sample(climateFilter);
+    profiler.stop();
+    printClimate(sample);
+    Serial.printf(" (%u I2C transactions)", climate.busTransactions());
+    //every sample goes into the statistics, the change filter only decides about the log
+    boolean summary = climate.observe(sample);
+    if(changeFilter.keep(sample)) {
+      batch.add(sample);
+    } else {
+      batch.skip(sample);
+    }
+    boolean mounted = batch.flushDue(sample.time) || summary;
+    if(mounted) {
+      sdMounts++;
+      profiler.start(PHASE_SD);
+      climate.beginLogger(true);
+      profiler.stop();
+      profiler.start(PHASE_LOG);
+      Serial.printf("\nFlushed %d samples to SD card\n", batch.flush(climate));
+      profiler.stop();
+    }
+    //the report rolls over the last AWAKE_PROFILE_WINDOWS windows of diagnosticsCycles wakeups
+    if(mounted && profiler.cycles() >= diagnosticsCycles) {
+      Serial.printf("\nMean awake time: %.1f ms, estimated consumption: %.2f mAh/day\n", 
+        profiler.mean(PHASE_AWAKE), profiler.milliampHoursPerDay(profiler.meanSleepSeconds(), energyModel));
+      profiler.writeReport("/diagnostics.csv", profiler.meanSleepSeconds(), energyModel);
+      profiler.nextWindow();
+    }
+    profiler.start(PHASE_SLEEP);
+    uint32_t sleepSeconds = schedule.next(sample.temperature, sample.humidity, sample.pressure);
+    Serial.printf("\n%u of %u samples suppressed, %u SD mounts (%u batch flushes instead of %u)", 
+      changeFilter.suppressed(), changeFilter.samples(), sdMounts, batch.flushes(), batch.unfilteredFlushes());
+    Serial.printf("\nWakeup off by %.1f ms, next measurement in %u s\n", alignedSleep.error() / 1000.0, sleepSeconds);
+    uint64_t sleepMicros = alignedSleep.sleepMicros(sleepSeconds);
+    profiler.endCycle(sleepSeconds);
+    hal::deepSleep(sleepMicros);
+  }
 
-  
   Serial.print("\nWaiting for climate sensor...");
-  climate.begin(rtcSet);
-  climate.setReferenceHeight(223);
+  climate.beginSensors();
+  climate.setReferenceHeight(referenceHeight);
   Serial.println("Climate Sensor is ready.\n");
+  if(timeSync.synced()) {
+    startLogger();
+  }
 
-  //code for deepsleep mode
-  if(digitalRead(mode)) {
-    printAndLogClimate();
-    deepSleepForSeconds(10);
+  if(!pipeline.begin()) {
+    Serial.println("No writer task, logging from loop()");
   }
 }
 
 //loop unreachable in deep sleep mode, only runs when deepsleep disabled
 void loop() { 
   if(digitalRead(mode)) {
-    ESP.restart();
+    pipeline.finish();
+    hal::restart();
+  }
+  syncTime(false);
+  if(!loggerStarted && timeSync.synced()) {
+    startLogger();
+    releaseHeldSamples();
+  }
+  logExport.update(exportIdleMillis);
+  if(hal::micros64() >= nextMeasurement) {
+    uint64_t start = hal::micros64();
+    climate.resetBusTransactions();
+    ClimateSample sample = climate.sample(climateFilter);
+    printClimate(sample);
+    Serial.printf(" (%u I2C transactions)", climate.busTransactions());
+    if(loggerStarted) {
+      logSample(sample);
+    } else if(heldCount < SAMPLE_BUFFER_CAPACITY) {
+      heldSamples[heldCount++] = sample;
+    } else {
+      heldDropped++;
+    }
+    uint32_t sleepSeconds = schedule.next(sample.temperature, sample.humidity, sample.pressure);
+    nextMeasurement = start + sleepSeconds * SECONDS;
+  }
+  if(!pipeline.running()) {
+    pipeline.drain();
+  }
+  //light sleep until the next measurement or until the writer has to flush the log, switching to deep sleep mode wakes up at once; WiFi needs the CPU while a
+  //time sync runs and the serial port while a host exports
+  if(logExport.active()) {
+    delay(exportPollMillis);
+  } else if(timeSync.running()) {
+    delay(syncPollMillis);
+  } else {
+    lightSleep.sleepUntil(nextMeasurement, pipeline);
   }
-  printAndLogClimate();
-  delay(10000);
 }
\ No newline at end of file
@@ -0,0 +1,134 @@
+/**
+ * @file native_main.cpp
+ * @brief Entry point of the native environment. Runs setup() and loop() of main.cpp on the fakes of NativeHAL.h and
+ * restarts setup() whenever the firmware enters deep sleep or restarts, like the ESP32 does. Globals declared with
+ * RTC_DATA_ATTR keep their values across these simulated boots. The virtual clock runs as fast as the host allows,
+ * so recorded csv logs replayed to the fake sensors can drive months of wakeups; the summary reports the wakeups,
+ * the SD card usage and the energy of the simulated time with the EnergyModel of AwakeProfiler.h.
+ *
+ * Usage: program [--deep-sleep] [--cycles N] [--days N] [--replay CSV]... [--quiet] [--noise] [--no-wifi]
+ *                [--rtc-drift PPM] [--interval N] [--dump DIR]
+ *   --deep-sleep  sets the mode toggle switch (GPIO 34) to deep sleep mode
+ *   --cycles N    number of calls of setup() and loop() to run, default 10 without --days
+ *   --days N      runs until N days of virtual time have passed
+ *   --replay CSV  climate of a recorded csv log for the fake sensors, can be repeated, the logs are joined
+ *   --quiet       suppresses the serial output
+ *   --noise       adds the noise of the datasheets to the fake sensors
+ *   --no-wifi     the access point is missing, every time sync times out
+ *   --rtc-drift   relative error of the RTC in ppm
+ *   --interval N  fixes the measurement interval to N seconds instead of the adaptive schedule of main.cpp
+ *   --dump DIR    writes the content of the fake SD card to an existing directory
+ */
+
+#ifndef ARDUINO
+
+#include <HAL.h>
+#include <AwakeProfiler.h>
+#include <AdaptiveSchedule.h>
+#include <chrono>
+
+void setup();
+void loop();
+extern AdaptiveSchedule schedule;
+
+int main(int argc, char** argv) {
+    const char* usage = "Usage: %s [--deep-sleep] [--cycles N] [--days N] [--replay CSV]... [--quiet] [--noise] "
+        "[--no-wifi] [--rtc-drift PPM] [--interval N] [--dump DIR]\n";
+    uint32_t cycles = 0;
+    double days = 0;
+    const char* dump = nullptr;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--deep-sleep") == 0) {
+            hal::native::setPin(34, HIGH);
+        } else if(strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            cycles = strtoul(argv[++i], nullptr, 10);
+        } else if(strcmp(argv[i], "--days") == 0 && i + 1 < argc) {
+            days = atof(argv[++i]);
+        } else if(strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            if(!hal::native::climateReplay.load(argv[++i])) {
+                fprintf(stderr, "%s: no csv records\n", argv[i]);
+                return 1;
+            }
+        } else if(strcmp(argv[i], "--quiet") == 0) {
+            hal::native::quiet = true;
+        } else if(strcmp(argv[i], "--noise") == 0) {
+            hal::native::sensorNoise.enabled = true;
+        } else if(strcmp(argv[i], "--no-wifi") == 0) {
+            hal::native::network.accessPoint = false;
+        } else if(strcmp(argv[i], "--rtc-drift") == 0 && i + 1 < argc) {
+            hal::native::clock.rtcDrift = atof(argv[++i]) / 1e6;
+        } else if(strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            uint32_t interval = strtoul(argv[++i], nullptr, 10);
+            schedule.setLimits(interval, interval);
+        } else if(strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+            dump = argv[++i];
+        } else {
+            fprintf(stderr, usage, argv[0]);
+            return 2;
+        }
+    }
+
+    if(cycles == 0) {
+        cycles = days > 0 ? UINT32_MAX : 10;
+    }
+    uint64_t end = days > 0 ? (uint64_t) (days * 86400e6) : UINT64_MAX;
+    auto start = std::chrono::steady_clock::now();
+    bool booted = false;
+    for(uint32_t cycle = 0; cycle < cycles && hal::native::clock.total < end; cycle++) {
+        try {
+            if(!booted) {
+                booted = true;
+                hal::native::statistics.boots++;
+                setup();
+            } else {
+                loop();
+            }
+        } catch(const hal::Reboot&) {
+            booted = false;
+        }
+    }
+    Serial.flush();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const hal::native::Statistics& device = hal::native::statistics;
+    const hal::native::StorageStatistics& storage = hal::native::storageStatistics;
+    fprintf(stderr,
+        "\nboots: %u, deep sleeps: %u, restarts: %u\n"
+        "awake: %.3f s, asleep: %.3f s, light sleeps: %u (%.3f s)\n"
+        "SD mounts: %u, opens: %u, writes: %u (%llu bytes), flushes: %u\n"
+        "SD sectors programmed: %llu, busy: %.3f s\n"
+        "I2C transactions: %u\n"
+        "WiFi connects: %u, radio on: %.3f s, RTC error: %.3f ms\n",
+        device.boots, device.deepSleeps, device.restarts,
+        device.awakeMicros / 1e6, device.sleepMicros / 1e6,
+        device.lightSleeps, device.lightSleepMicros / 1e6,
+        storage.mounts, storage.opens, storage.writes, (unsigned long long) storage.bytesWritten, storage.flushes,
+        (unsigned long long) storage.sectorWrites, storage.busyMicros / 1e6,
+        hal::sensorBus().transactions,
+        hal::native::network.connects, hal::native::network.radioMicros / 1e6,
+        (hal::epochMicros() - hal::native::trueEpochMicros()) / 1000.0);
+
+    //the SD card and the radio draw in addition to the awake current
+    EnergyModel model;
+    double simulated = hal::native::clock.total / 86400e6;
+    double milliampHours = (device.awakeMicros / 1e6 * model.awakeMilliamps
+        + storage.busyMicros / 1e6 * model.sdMilliamps
+        + hal::native::network.radioMicros / 1e6 * model.radioMilliamps
+        + device.sleepMicros / 1e6 * model.sleepMicroamps / 1000
+        + device.lightSleepMicros / 1e6 * model.lightSleepMicroamps / 1000) / 3600;
+    fprintf(stderr, "energy: %.1f mAh in %.2f days, %.2f mAh per day\n", milliampHours, simulated,
+        simulated > 0 ? milliampHours / simulated : 0);
+    if(hal::native::climateReplay.size() > 0) {
+        fprintf(stderr, "replayed %zu records of %.2f days\n", hal::native::climateReplay.size(),
+            hal::native::climateReplay.seconds() / 86400.0);
+    }
+    fprintf(stderr, "simulated in %.2f s, %.0f times real time\n", wall, wall > 0 ? simulated * 86400 / wall : 0);
+
+    if(dump && !hal::storage().dump(dump)) {
+        perror(dump);
+        return 1;
+    }
+    return 0;
+}
+
+#endif
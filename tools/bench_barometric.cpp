@@ -0,0 +1,139 @@
+/**
+ * @file bench_barometric.cpp
+ * @brief Host accuracy report and benchmark of the barometric kernels (Barometric.h) against the reference formula
+ * with pow(). The altitude is checked for every pressure from 300 to 1100 hPa in 1 Pa steps at sealevel pressures
+ * of 950, 1013.25 and 1050 hPa, the sealevel pressure for altitudes from -500 to 9000 m in 0.5 m steps at pressures
+ * from 300 to 1100 hPa in 25 hPa steps. The reference is evaluated in double precision. It prints the largest and
+ * the RMS error of the float and the fixed point kernels and the time per value on arrays of samples. Exits with 1
+ * if an error exceeds the bounds given in Barometric.h.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=c++11 -O2 -Iinclude tools/bench_barometric.cpp -o bench_barometric
+ * Usage: bench_barometric
+ */
+
+#include <Barometric.h>
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+/**
+ * @brief Largest and RMS error of a kernel.
+ *
+ */
+struct Error {
+    double maximum = 0;
+    double squares = 0;
+    uint64_t count = 0;
+
+    void add(double error) {
+        maximum = fabs(error) > maximum ? fabs(error) : maximum;
+        squares += error * error;
+        count++;
+    }
+
+    double rms() const {
+        return count > 0 ? sqrt(squares / count) : 0;
+    }
+};
+
+/**
+ * @brief Runs a kernel over all samples several times and returns the time per value.
+ *
+ * @param run kernel over the whole array
+ * @param count number of values per run
+ * @return double nanoseconds per value
+ */
+template <typename Kernel>
+double measure(Kernel run, size_t count) {
+    const uint32_t passes = 20;
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t pass = 0; pass < passes; pass++) {
+        run();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / ((double) count * passes);
+}
+
+int main() {
+    Error altitudeFloat, altitudeFixed, sealevelFloat, sealevelFixed, altitudePow, sealevelPow;
+    const double references[] = {95000, 101325, 105000};
+    for(double reference : references) {
+        for(int32_t pressure = 30000; pressure <= 110000; pressure++) {
+            double expected = BAROMETRIC_ALTITUDE_SCALE * (1 - pow(pressure / reference, 0.1903));
+            altitudeFloat.add(Barometric::altitude((float) pressure, (float) reference) - expected);
+            altitudeFixed.add(Barometric::altitude(pressure, (int32_t) reference) / 1000.0 - expected);
+            altitudePow.add(Barometric::referenceAltitude((float) pressure, (float) reference) - expected);
+        }
+    }
+    for(int32_t pressure = 30000; pressure <= 110000; pressure += 2500) {
+        for(int32_t altitude = -1000; altitude <= 18000; altitude++) {
+            double meters = altitude / 2.0;
+            double expected = pressure / pow(1 - meters / BAROMETRIC_ALTITUDE_SCALE, 5.255);
+            sealevelFloat.add(Barometric::sealevelPressure((float) pressure, (float) meters) - expected);
+            sealevelFixed.add(Barometric::sealevelPressure(pressure, altitude * 500) - expected);
+            sealevelPow.add(Barometric::referenceSealevelPressure((float) pressure, (float) meters) - expected);
+        }
+    }
+
+    printf("%-28s %14s %14s\n", "error against double pow()", "max", "rms");
+    printf("%-28s %12.4f m %12.4f m\n", "altitude pow() float", altitudePow.maximum, altitudePow.rms());
+    printf("%-28s %12.4f m %12.4f m\n", "altitude float", altitudeFloat.maximum, altitudeFloat.rms());
+    printf("%-28s %12.4f m %12.4f m\n", "altitude fixed", altitudeFixed.maximum, altitudeFixed.rms());
+    printf("%-28s %11.4f Pa %11.4f Pa\n", "sealevel pow() float", sealevelPow.maximum, sealevelPow.rms());
+    printf("%-28s %11.4f Pa %11.4f Pa\n", "sealevel float", sealevelFloat.maximum, sealevelFloat.rms());
+    printf("%-28s %11.4f Pa %11.4f Pa\n", "sealevel fixed", sealevelFixed.maximum, sealevelFixed.rms());
+
+    const size_t count = 100000;
+    std::vector<float> pressures(count), altitudes(count), results(count);
+    std::vector<int32_t> fixedPressures(count), fixedAltitudes(count), fixedResults(count);
+    for(size_t i = 0; i < count; i++) {
+        fixedPressures[i] = 30000 + (int32_t) (i * 80000 / count);
+        pressures[i] = fixedPressures[i];
+        fixedAltitudes[i] = (int32_t) (i * 9000000 / count) - 500000;
+        altitudes[i] = fixedAltitudes[i] / 1000.0f;
+    }
+    double checksum = 0;
+    double powAltitude = measure([&]() {
+        for(size_t i = 0; i < count; i++) {
+            results[i] = Barometric::referenceAltitude(pressures[i], 101325);
+        }
+        checksum += results[count / 2];
+    }, count);
+    double floatAltitude = measure([&]() {
+        Barometric::altitudes(pressures.data(), count, 101325, results.data());
+        checksum += results[count / 2];
+    }, count);
+    double fixedAltitude = measure([&]() {
+        Barometric::altitudes(fixedPressures.data(), count, 101325, fixedResults.data());
+        checksum += fixedResults[count / 2];
+    }, count);
+    double powSealevel = measure([&]() {
+        for(size_t i = 0; i < count; i++) {
+            results[i] = Barometric::referenceSealevelPressure(pressures[i], altitudes[i]);
+        }
+        checksum += results[count / 2];
+    }, count);
+    double floatSealevel = measure([&]() {
+        Barometric::sealevelPressures(pressures.data(), altitudes.data(), count, results.data());
+        checksum += results[count / 2];
+    }, count);
+    double fixedSealevel = measure([&]() {
+        Barometric::sealevelPressures(fixedPressures.data(), fixedAltitudes.data(), count, fixedResults.data());
+        checksum += fixedResults[count / 2];
+    }, count);
+
+    printf("\n%-28s %14s %14s %14s\n", "ns per value", "pow()", "float", "fixed");
+    printf("%-28s %14.2f %14.2f %14.2f\n", "altitude", powAltitude, floatAltitude, fixedAltitude);
+    printf("%-28s %14.2f %14.2f %14.2f\n", "sealevel pressure", powSealevel, floatSealevel, fixedSealevel);
+    printf("(checksum %.1f)\n", checksum);
+
+    bool valid = altitudeFloat.maximum <= 0.01 && altitudeFixed.maximum <= 0.002
+        && sealevelFloat.maximum <= 0.2 && sealevelFixed.maximum <= 0.6;
+    printf("error bounds: %s\n", valid ? "ok" : "EXCEEDED");
+    return valid ? 0 : 1;
+}
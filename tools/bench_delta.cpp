@@ -0,0 +1,197 @@
+/**
+ * @file bench_delta.cpp
+ * @brief Host benchmark of the delta compressed log format (DeltaLog.h) against the csv records of
+ * ClimateDataLogger::log() with sequence number and CRC and the fixed size records of BinaryLog.h. The records of csv
+ * logs copied from the SD card or dumped by the native build, with ISO 8601 timestamps or the "d.m.y h:m:s" timestamps
+ * of older logs, are encoded in all three formats; without a log a synthetic noisy day in 10 s steps is used, which
+ * the output states. It prints bytes per sample, the compression ratio against csv and the encode time per sample,
+ * and checks that every delta block decodes to the same records. Exits with 1 on a mismatch.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=c++11 -O2 -Iinclude tools/bench_delta.cpp -o bench_delta
+ * Usage: bench_delta [log_27_5_2022.csv ...]
+ */
+
+#include <BinaryLog.h>
+#include <DeltaLog.h>
+#include <TextFormat.h>
+#include <LogJournal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+/**
+ * @brief One row of the csv log.
+ *
+ */
+struct Row {
+    struct tm timeInfo;
+    float values[5];
+};
+
+/**
+ * @brief Reads the rows of a csv log with ISO 8601 timestamps or the "d.m.y h:m:s" timestamps of older logs. The
+ * header and malformed lines are skipped.
+ *
+ * @param in input file
+ * @param rows rows are appended
+ */
+void readLog(FILE* in, std::vector<Row>& rows) {
+    char line[256];
+    while(fgets(line, sizeof(line), in)) {
+        Row row;
+        memset(&row.timeInfo, 0, sizeof(row.timeInfo));
+        if(sscanf(line, "%d-%d-%dT%d:%d:%d,%f,%f,%f,%f,%f", &row.timeInfo.tm_year, &row.timeInfo.tm_mon,
+            &row.timeInfo.tm_mday, &row.timeInfo.tm_hour, &row.timeInfo.tm_min, &row.timeInfo.tm_sec, &row.values[0],
+            &row.values[1], &row.values[2], &row.values[3], &row.values[4]) != 11
+            && sscanf(line, "%d.%d.%d %d:%d:%d,%f,%f,%f,%f,%f", &row.timeInfo.tm_mday, &row.timeInfo.tm_mon,
+            &row.timeInfo.tm_year, &row.timeInfo.tm_hour, &row.timeInfo.tm_min, &row.timeInfo.tm_sec, &row.values[0],
+            &row.values[1], &row.values[2], &row.values[3], &row.values[4]) != 11) {
+                continue;
+        }
+        row.timeInfo.tm_mon -= 1;
+        row.timeInfo.tm_year -= 1900;
+        rows.push_back(row);
+    }
+}
+
+/**
+ * @brief Encodes all rows with one encoder several times and returns the encode time per sample.
+ *
+ * @param rows rows
+ * @param encode encoder returning the number of bytes written for a row
+ * @param bytes receives the bytes of one pass
+ * @return double nanoseconds per sample
+ */
+template <typename Encoder>
+double run(const std::vector<Row>& rows, Encoder encode, uint64_t& bytes) {
+    const uint32_t passes = rows.size() < 100000 ? 20 : 2;
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t pass = 0; pass < passes; pass++) {
+        bytes = 0;
+        for(const Row& row : rows) {
+            bytes += encode(row);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / ((double) rows.size() * passes);
+}
+
+int main(int argc, char** argv) {
+    std::vector<Row> rows;
+    for(int i = 1; i < argc; i++) {
+        FILE* in = fopen(argv[i], "r");
+        if(!in) {
+            perror(argv[i]);
+            return 1;
+        }
+        readLog(in, rows);
+        fclose(in);
+    }
+    if(argc == 1) {
+        srand(1);
+        time_t start = 1653609600;
+        for(uint32_t i = 0; i < 8640; i++) {
+            Row row;
+            time_t time = start + i * 10;
+            gmtime_r(&time, &row.timeInfo);
+            double phase = i * 2 * M_PI / 8640;
+            row.values[0] = 20 + 5 * sin(phase) + (rand() % 5 - 2) * 0.01;
+            row.values[1] = 50 + 20 * cos(phase) + (rand() % 9 - 4) * 0.01;
+            row.values[2] = 987 + 0.3 * sin(phase * 24) + (rand() % 7 - 3) * 0.01;
+            row.values[3] = 1013.25 + 0.3 * sin(phase * 24) + (rand() % 7 - 3) * 0.01;
+            row.values[4] = 223 + (rand() % 3 - 1) * 0.01;
+            rows.push_back(row);
+        }
+    }
+    if(rows.empty()) {
+        fprintf(stderr, "no records\n");
+        return 1;
+    }
+
+    std::vector<BinaryLogRecord> records;
+    for(const Row& row : rows) {
+        records.push_back(BinaryLog::toRecord(BinaryLog::localTime(row.timeInfo), row.values[0], row.values[1],
+            row.values[2], row.values[3], row.values[4]));
+    }
+
+    uint64_t csvBytes = 0;
+    uint32_t sequence = 0;
+    double csvTime = run(rows, [&sequence](const Row& row) {
+        char record[TEXT_RECORD_SIZE + LOG_JOURNAL_TRAILER_SIZE];
+        return LogJournal::seal(record, TextFormat::formatRecord(record, row.timeInfo, row.values), ++sequence);
+    }, csvBytes);
+
+    //like the logger, binary records are collected into blocks of BINARY_LOG_BLOCK_RECORDS
+    BinaryLogRecord binaryBlock[BINARY_LOG_BLOCK_RECORDS];
+    uint16_t binaryCount = 0;
+    uint64_t binaryBytes = 0;
+    double binaryTime = run(rows, [&binaryBlock, &binaryCount](const Row& row) -> size_t {
+        binaryBlock[binaryCount++] = BinaryLog::toRecord(BinaryLog::localTime(row.timeInfo), row.values[0],
+            row.values[1], row.values[2], row.values[3], row.values[4]);
+        if(binaryCount < BINARY_LOG_BLOCK_RECORDS) {
+            return 0;
+        }
+        uint8_t buffer[BINARY_LOG_BLOCK_HEADER_SIZE + BINARY_LOG_BLOCK_RECORDS * BINARY_LOG_RECORD_SIZE];
+        binaryCount = 0;
+        return BinaryLog::encodeBlock(binaryBlock, BINARY_LOG_BLOCK_RECORDS, buffer);
+    }, binaryBytes);
+
+    DeltaState state = {};
+    std::vector<uint8_t> stream;
+    uint64_t deltaBytes = 0;
+    double deltaTime = run(rows, [&state, &stream](const Row& row) -> size_t {
+        BinaryLogRecord record = BinaryLog::toRecord(BinaryLog::localTime(row.timeInfo), row.values[0],
+            row.values[1], row.values[2], row.values[3], row.values[4]);
+        if(DeltaLog::add(state, record)) {
+            return 0;
+        }
+        uint8_t block[DELTA_LOG_BLOCK_HEADER_SIZE + DELTA_LOG_BLOCK_CAPACITY];
+        size_t size = DeltaLog::close(state, block);
+        DeltaLog::add(state, record);
+        stream.insert(stream.end(), block, block + size);
+        return size;
+    }, deltaBytes);
+    uint8_t block[DELTA_LOG_BLOCK_HEADER_SIZE + DELTA_LOG_BLOCK_CAPACITY];
+    size_t size = DeltaLog::close(state, block);
+    stream.insert(stream.end(), block, block + size);
+    deltaBytes += size;
+
+    std::vector<BinaryLogRecord> decoded(UINT16_MAX);
+    size_t position = 0;
+    size_t matched = 0;
+    size_t blocks = 0;
+    bool valid = true;
+    while(position < stream.size() && valid) {
+        uint16_t count;
+        size = DeltaLog::decodeBlock(stream.data() + position, stream.size() - position, decoded.data(), UINT16_MAX, count);
+        valid = size > 0;
+        for(uint16_t i = 0; i < count && valid; i++) {
+            const BinaryLogRecord& expected = records[matched % records.size()];
+            valid = memcmp(&decoded[i], &expected, sizeof(BinaryLogRecord)) == 0;
+            matched++;
+        }
+        position += size;
+        blocks++;
+    }
+    valid = valid && matched % records.size() == 0 && matched > 0;
+
+    double samples = rows.size();
+    if(argc == 1) {
+        printf("synthetic day, no log given\n");
+    } else {
+        printf("%d recorded log files\n", argc - 1);
+    }
+    printf("%zu samples, %.1f delta blocks per pass\n", rows.size(), (double) blocks * rows.size() / matched);
+    printf("%-8s %10s %10s %10s\n", "format", "B/sample", "ratio", "ns/sample");
+    printf("%-8s %10.2f %10.2f %10.1f\n", "csv", csvBytes / samples, 1.0, csvTime);
+    printf("%-8s %10.2f %10.2f %10.1f\n", "binary", binaryBytes / samples, (double) csvBytes / binaryBytes, binaryTime);
+    printf("%-8s %10.2f %10.2f %10.1f\n", "delta", deltaBytes / samples, (double) csvBytes / deltaBytes, deltaTime);
+    printf("round trip: %s\n", valid ? "ok" : "MISMATCH");
+    return valid ? 0 : 1;
+}
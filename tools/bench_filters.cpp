@@ -0,0 +1,229 @@
+/**
+ * @file bench_filters.cpp
+ * @brief Host replay test and benchmark of the acquisition pipeline of ClimateSensor: BMP180 oversampling, bursts of
+ * measurement cycles and the streaming filters of SensorFilter.h. The climate of csv logs, e.g. written by the native
+ * build or copied from the SD card, is replayed through the fake sensors of the native environment with the noise of
+ * the datasheets; without a log a synthetic day in 10 s steps is used. For every configuration it prints the RMS
+ * error of the readings against the replayed climate, the noise reduction of the altitude against one unfiltered
+ * cycle at the default oversampling and the conversion time per reading on the virtual clock. Then the time per
+ * filter update on the host is measured. Exits with 1 if the filters of main.cpp do not reduce the noise of
+ * temperature, pressure and altitude.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=gnu++17 -O2 -Iinclude tools/bench_filters.cpp -o bench_filters
+ * Usage: bench_filters [log_27_5_2022.csv ...]
+ */
+
+#include <HAL.h>
+#include <Climate.h>
+#include <chrono>
+#include <vector>
+
+/**
+ * @brief One step of the replayed climate.
+ *
+ */
+struct Step {
+    double temperature;
+    double humidity;
+    double pressure;
+};
+
+/**
+ * @brief RMS errors of one configuration.
+ *
+ */
+struct Result {
+    double temperature;
+    double humidity;
+    double pressure;
+    double height;
+    double millis;
+};
+
+typedef ClimateFilter<MeanFusion<PassThrough>, PassThrough, PassThrough> Unfiltered;
+typedef ClimateFilter<KalmanFusion<20, 40, 100>, MedianFilter<3>, FilterChain<MedianFilter<3>, EmaFilter<1, 2>>> MainFilter;
+
+/**
+ * @brief Reads the climate of a csv log. The header and malformed lines are skipped.
+ *
+ * @param in input file
+ * @param steps steps are appended
+ */
+void readLog(FILE* in, std::vector<Step>& steps) {
+    char line[256];
+    while(fgets(line, sizeof(line), in)) {
+        int year, month, day, hour, minute, second;
+        float temperature, humidity, pressure;
+        if(sscanf(line, "%d-%d-%dT%d:%d:%d,%f,%f,%f", &year, &month, &day, &hour, &minute, &second, &temperature,
+            &humidity, &pressure) == 9) {
+                steps.push_back({temperature, humidity, pressure * 100.0});
+        }
+    }
+}
+
+/**
+ * @brief Replays the climate through the fake sensors and a filter.
+ *
+ * @tparam Filter ClimateFilter type
+ * @param steps replayed climate
+ * @param oversampling BMP180 oversampling
+ * @param burst measurement cycles per reading
+ * @return Result RMS errors and conversion time per reading
+ */
+template <typename Filter>
+Result replay(const std::vector<Step>& steps, uint8_t oversampling, uint8_t burst) {
+    hal::native::environment.temperature = steps[0].temperature;
+    hal::native::environment.humidity = steps[0].humidity;
+    hal::native::environment.pressure = steps[0].pressure;
+    hal::native::sensorNoise = hal::native::SensorNoise();
+    WakeCache cache = {};
+    ClimateSensor climate;
+    climate.setWakeCache(&cache);
+    climate.setOversampling(oversampling);
+    climate.setBurst(burst);
+    climate.beginSensors();
+    climate.setReferenceHeight(223);
+    float referencePressure = cache.referencePressure;
+    hal::native::sensorNoise.enabled = true;
+
+    Filter filter = {};
+    double squares[4] = {0, 0, 0, 0};
+    uint64_t micros = 0;
+    for(const Step& step : steps) {
+        hal::native::environment.temperature = step.temperature;
+        hal::native::environment.humidity = step.humidity;
+        hal::native::environment.pressure = step.pressure;
+        uint64_t start = hal::micros64();
+        ClimateReading reading = climate.read(filter);
+        micros += hal::micros64() - start;
+        double errors[4] = {
+            reading.temperature - step.temperature,
+            reading.humidity - step.humidity,
+            reading.pressure * 100 - step.pressure,
+            reading.height - Barometric::altitude((float) step.pressure, referencePressure)
+        };
+        for(int i = 0; i < 4; i++) {
+            squares[i] += errors[i] * errors[i];
+        }
+    }
+    double count = steps.size();
+    return {sqrt(squares[0] / count), sqrt(squares[1] / count), sqrt(squares[2] / count), sqrt(squares[3] / count),
+        micros / 1e3 / count};
+}
+
+/**
+ * @brief Prints one configuration.
+ *
+ * @param name name of the configuration
+ * @param result result of replay()
+ * @param baseline result of the default configuration without filters
+ */
+void print(const char* name, const Result& result, const Result& baseline) {
+    printf("%-36s %8.3f %8.3f %8.2f %8.3f %8.2fx %8.1f\n", name, result.temperature, result.humidity, result.pressure,
+        result.height, baseline.height / result.height, result.millis);
+}
+
+/**
+ * @brief Measures the time of a filter update on the host.
+ *
+ * @tparam Filter filter with update(float)
+ * @return double nanoseconds per update
+ */
+template <typename Filter>
+double measureUpdate() {
+    Filter filter = {};
+    const uint32_t count = 10000000;
+    float sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < count; i++) {
+        sum += filter.update(1000 + (i * 7919 % 101) * 0.01f);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(sum == 0) {
+        printf(" ");
+    }
+    return seconds * 1e9 / count;
+}
+
+/**
+ * @brief Measures the time of a fusion update of two sensors on the host.
+ *
+ * @tparam Filter filter with update(float, float)
+ * @return double nanoseconds per update
+ */
+template <typename Filter>
+double measureFusion() {
+    Filter filter = {};
+    const uint32_t count = 10000000;
+    float sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < count; i++) {
+        sum += filter.update(20 + (i * 7919 % 101) * 0.001f, 20 + (i * 104729 % 103) * 0.001f);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(sum == 0) {
+        printf(" ");
+    }
+    return seconds * 1e9 / count;
+}
+
+int main(int argc, char** argv) {
+    std::vector<Step> steps;
+    for(int i = 1; i < argc; i++) {
+        FILE* in = fopen(argv[i], "r");
+        if(!in) {
+            perror(argv[i]);
+            return 1;
+        }
+        readLog(in, steps);
+        fclose(in);
+    }
+    if(argc == 1) {
+        for(uint32_t i = 0; i < 8640; i++) {
+            double phase = i * 2 * M_PI / 8640;
+            steps.push_back({20 + 5 * sin(phase), 50 + 20 * cos(phase), 98700 + 150 * sin(phase * 3)});
+        }
+    }
+    if(steps.empty()) {
+        fprintf(stderr, "no records\n");
+        return 1;
+    }
+    hal::native::quiet = true;
+
+    printf("%zu steps, RMS error against the replayed climate\n", steps.size());
+    printf("%-36s %8s %8s %8s %8s %9s %8s\n", "configuration", "T [°C]", "RH [%]", "p [Pa]", "h [m]", "h noise", "ms");
+    Result baseline = replay<Unfiltered>(steps, BMP180_ULTRAHIGHRES, 1);
+    print("ultra low power, unfiltered", replay<Unfiltered>(steps, BMP180_ULTRALOWPOWER, 1), baseline);
+    print("standard, unfiltered", replay<Unfiltered>(steps, BMP180_STANDARD, 1), baseline);
+    print("high res, unfiltered", replay<Unfiltered>(steps, BMP180_HIGHRES, 1), baseline);
+    print("ultra high res, unfiltered", baseline, baseline);
+    print("ultra high res, burst 3, median", replay<ClimateFilter<MeanFusion<MedianFilter<3>>, MedianFilter<3>,
+        MedianFilter<3>>>(steps, BMP180_ULTRAHIGHRES, 3), baseline);
+    print("ultra high res, burst 5, median", replay<ClimateFilter<MeanFusion<MedianFilter<5>>, MedianFilter<5>,
+        MedianFilter<5>>>(steps, BMP180_ULTRAHIGHRES, 5), baseline);
+    print("ultra high res, EMA 1/4", replay<ClimateFilter<MeanFusion<EmaFilter<1, 4>>, EmaFilter<1, 4>,
+        EmaFilter<1, 4>>>(steps, BMP180_ULTRAHIGHRES, 1), baseline);
+    print("ultra high res, Kalman temperature", replay<ClimateFilter<KalmanFusion<20, 40, 100>, PassThrough,
+        PassThrough>>(steps, BMP180_ULTRAHIGHRES, 1), baseline);
+    Result filtered = replay<MainFilter>(steps, BMP180_ULTRAHIGHRES, 1);
+    print("ultra high res, main.cpp filters", filtered, baseline);
+    print("ultra high res, burst 3, main.cpp", replay<MainFilter>(steps, BMP180_ULTRAHIGHRES, 3), baseline);
+
+    printf("\n%-36s %8s\n", "filter update on the host", "ns");
+    printf("%-36s %8.2f\n", "MedianFilter<3>", measureUpdate<MedianFilter<3>>());
+    printf("%-36s %8.2f\n", "MedianFilter<5>", measureUpdate<MedianFilter<5>>());
+    printf("%-36s %8.2f\n", "EmaFilter<1, 4>", measureUpdate<EmaFilter<1, 4>>());
+    printf("%-36s %8.2f\n", "MedianFilter<3> + EmaFilter<1, 2>",
+        measureUpdate<FilterChain<MedianFilter<3>, EmaFilter<1, 2>>>());
+    printf("%-36s %8.2f\n", "MeanFusion<PassThrough>", measureFusion<MeanFusion<PassThrough>>());
+    printf("%-36s %8.2f\n", "KalmanFusion<20, 40, 100>", measureFusion<KalmanFusion<20, 40, 100>>());
+
+    bool valid = filtered.temperature < baseline.temperature && filtered.pressure < baseline.pressure
+        && filtered.height < baseline.height;
+    printf("\nmain.cpp filters %s the noise\n", valid ? "reduce" : "DO NOT reduce");
+    return valid ? 0 : 1;
+}
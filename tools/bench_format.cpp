@@ -0,0 +1,144 @@
+/**
+ * @file bench_format.cpp
+ * @brief Host microbenchmark of the record encoding of the log formats. It compares the String::concat path used
+ * before with TextFormat::formatRecord() and the record derived from the channels of ClimateLogSet, the sealed csv
+ * record of the log, the binary record written by ClimateDataLogger (one block with CRC per record) and the delta
+ * blocks, reports the bytes written to the card per record and counts the heap allocations per record by replacing
+ * operator new.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=gnu++17 -O2 -Iinclude tools/bench_format.cpp -o bench_format
+ * Usage: bench_format [records]
+ */
+
+#include <HAL.h>
+#include <Climate.h>
+#include <TextFormat.h>
+#include <LogJournal.h>
+#include <BinaryLog.h>
+#include <DeltaLog.h>
+#include <chrono>
+#include <new>
+
+static uint64_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* memory = malloc(size ? size : 1);
+    if(!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+/**
+ * @brief The record formatting of ClimateDataLogger before TextFormat, with about 15 String::concat calls.
+ *
+ * @param timeInfo broken down time
+ * @param values temperature, humidity, pressure, pressure at sealevel and height
+ * @return size_t length of the record
+ */
+size_t formatWithString(const struct tm& timeInfo, const float values[5]) {
+    String data = "";
+    data.concat(timeInfo.tm_mday);
+    data.concat(".");
+    data.concat(timeInfo.tm_mon + 1);
+    data.concat(".");
+    data.concat(timeInfo.tm_year + 1900);
+    data.concat(" ");
+    data.concat(timeInfo.tm_hour);
+    data.concat(":");
+    data.concat(timeInfo.tm_min);
+    data.concat(":");
+    data.concat(timeInfo.tm_sec);
+    for(uint8_t i = 0; i < 5; i++) {
+        data.concat(",");
+        data.concat(values[i]);
+    }
+    data.concat("\n");
+    return data.length();
+}
+
+/**
+ * @brief Encodes records in 10 s steps with a formatter and prints time, allocations and bytes per record.
+ *
+ * @param name name of the formatter
+ * @param records number of records
+ * @param format formatter returning the number of bytes written for the record
+ */
+template <typename Formatter>
+void run(const char* name, uint32_t records, Formatter format) {
+    time_t time = 1653638400;
+    float values[5] = {21.5, 45.0, 987.0, 1013.51, 223.01};
+    uint64_t bytes = 0;
+    uint64_t allocationsBefore = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < records; i++) {
+        time_t now = time + i * 10;
+        struct tm timeInfo;
+        gmtime_r(&now, &timeInfo);
+        values[0] = 15 + (i % 1000) * 0.013f;
+        values[2] = 980 + (i % 700) * 0.031f;
+        bytes += format(timeInfo, values);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%-14s %8.1f ns/record  %6.2f allocations/record  %6.2f bytes/record\n", name,
+        seconds * 1e9 / records, (double) (allocations - allocationsBefore) / records, (double) bytes / records);
+}
+
+int main(int argc, char** argv) {
+    uint32_t records = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    run("String", records, formatWithString);
+    run("TextFormat", records, [](const struct tm& timeInfo, const float values[5]) {
+        char record[TEXT_RECORD_SIZE];
+        return TextFormat::formatRecord(record, timeInfo, values);
+    });
+    run("ClimateLogSet", records, [](const struct tm& timeInfo, const float values[5]) {
+        char record[ClimateLogSet::csvRecordSize];
+        return ClimateLogSet::csvRecord(record, timeInfo, values);
+    });
+    uint32_t sequence = 0;
+    run("csv", records, [&sequence](const struct tm& timeInfo, const float values[5]) {
+        char record[ClimateLogSet::csvRecordSize + LOG_JOURNAL_TRAILER_SIZE];
+        return LogJournal::seal(record, ClimateLogSet::csvRecord(record, timeInfo, values), ++sequence);
+    });
+    //the size of a block is counted when it is closed, so the last partial block is missing from the average
+    static BinaryLogRecord block[BINARY_LOG_BLOCK_RECORDS];
+    static uint16_t count = 0;
+    run("binary", records, [](const struct tm& timeInfo, const float values[5]) {
+        block[count++] = BinaryLog::toRecord(
+            BinaryLog::localTime(timeInfo), values[0], values[1], values[2], values[3], values[4]
+        );
+        if(count < BINARY_LOG_BLOCK_RECORDS) {
+            return (size_t) 0;
+        }
+        uint8_t buffer[BINARY_LOG_BLOCK_HEADER_SIZE + BINARY_LOG_BLOCK_RECORDS * BINARY_LOG_RECORD_SIZE];
+        count = 0;
+        return BinaryLog::encodeBlock(block, BINARY_LOG_BLOCK_RECORDS, buffer);
+    });
+    static DeltaState state;
+    run("delta", records, [](const struct tm& timeInfo, const float values[5]) {
+        BinaryLogRecord record = BinaryLog::toRecord(
+            BinaryLog::localTime(timeInfo), values[0], values[1], values[2], values[3], values[4]
+        );
+        uint8_t block[DELTA_LOG_BLOCK_HEADER_SIZE + DELTA_LOG_BLOCK_CAPACITY];
+        size_t size = 0;
+        if(!DeltaLog::add(state, record)) {
+            size = DeltaLog::close(state, block);
+            DeltaLog::add(state, record);
+        }
+        return size;
+    });
+    return 0;
+}
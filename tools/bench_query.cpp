@@ -0,0 +1,104 @@
+/**
+ * @file bench_query.cpp
+ * @brief Host benchmark of time range queries on a daily csv log. It writes a synthetic log with one record per
+ * second through ClimateDataLogger with its default flush policy on the fake SD card of the native environment,
+ * which also maintains the sparse index, and compares LogReader::query() with a scan from the start of the file:
+ * host time, bytes read from the card and SD card time charged by the fake (FakeStorage.h).
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=gnu++17 -O2 -Iinclude tools/bench_query.cpp -o bench_query
+ * Usage: bench_query [records]
+ */
+
+#include <HAL.h>
+#include <Climate.h>
+#include <LogReader.h>
+#include <chrono>
+
+/**
+ * @brief Result of one query.
+ *
+ */
+struct QueryResult {
+    uint32_t records;
+    double hostMillis;
+    uint64_t bytesRead;
+    double cardMillis;
+};
+
+/**
+ * @brief Runs a query and measures it.
+ *
+ * @param path path of the log file
+ * @param from time of the first record
+ * @param to time of the last record
+ * @param indexed true to start at the offset of the index, false to scan from the start
+ * @return QueryResult records and costs
+ */
+QueryResult measure(const char* path, time_t from, time_t to, bool indexed) {
+    uint64_t bytesRead = hal::native::storageStatistics.bytesRead;
+    uint64_t clock = hal::micros64();
+    auto callback = [](const char*, size_t) {
+        return true;
+    };
+    auto start = std::chrono::steady_clock::now();
+    uint32_t records = indexed ? LogReader::query(path, from, to, callback) : LogReader::scan(path, 0, from, to, callback);
+    double hostMillis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return {records, hostMillis, hal::native::storageStatistics.bytesRead - bytesRead, (hal::micros64() - clock) / 1e3};
+}
+
+int main(int argc, char** argv) {
+    uint32_t records = argc > 1 ? strtoul(argv[1], nullptr, 10) : 86400;
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    hal::native::quiet = true;
+    hal::native::clock.epochStart = 1653609600;
+    hal::native::clock.synced = true;
+
+    ClimateDataLogger logger("SSID", "PASSWORD", true);
+    logger.begin();
+    time_t start = hal::epoch();
+    for(uint32_t i = 0; i < records; i++) {
+        ClimateSample sample = {start + (time_t) i, 15 + (i % 1000) * 0.013f, 45 + (i % 300) * 0.07f,
+            980 + (i % 700) * 0.031f, 1013 + (i % 700) * 0.031f, 223};
+        logger.log(sample);
+        hal::native::advance(1000000);
+    }
+    logger.flush();
+
+    const char* path = "/log_27_5_2022.csv";
+    File log = hal::storage().open(path);
+    File index = hal::storage().open("/log_27_5_2022.idx");
+    printf("log: %zu bytes, %u records, index: %zu bytes\n", log.size(), records, index.size());
+    log.close();
+    index.close();
+
+    struct Range {
+        const char* name;
+        time_t from;
+        time_t to;
+    };
+    time_t end = start + records - 1;
+    Range ranges[] = {
+        {"first hour", start, start + 3599},
+        {"10 min at noon", start + 12 * 3600, start + 12 * 3600 + 599},
+        {"last 6 hours", end - 6 * 3600 + 1, end},
+        {"last minute", end - 59, end}
+    };
+    bool valid = true;
+    printf("%-16s %8s  %12s %12s  %12s %12s  %12s %12s\n", "range", "records", "scan ms", "indexed ms",
+        "scan bytes", "indexed bytes", "scan SD ms", "indexed SD ms");
+    for(const Range& range : ranges) {
+        QueryResult scan = measure(path, range.from, range.to, false);
+        QueryResult indexed = measure(path, range.from, range.to, true);
+        valid = valid && scan.records == indexed.records;
+        printf("%-16s %8u  %12.2f %12.2f  %12llu %12llu  %12.1f %12.1f%s\n", range.name, indexed.records,
+            scan.hostMillis, indexed.hostMillis, (unsigned long long) scan.bytesRead,
+            (unsigned long long) indexed.bytesRead, scan.cardMillis, indexed.cardMillis,
+            scan.records == indexed.records ? "" : "  MISMATCH");
+    }
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,443 @@
+/**
+ * @file bench_sensorset.cpp
+ * @brief Host benchmark of the sensor composition of SensorSet.h. It compares ClimateMeasurement, which composes
+ * HTU21DFChannels and BMP180Channels, with a copy of the former hand written state machine on the fake sensors of
+ * the native environment: the readings have to be bit identical with the same I2C transactions and conversion time,
+ * and the host time per cycle is printed for both. The dispatch alone is measured with sensors without I/O, a set of
+ * three against the same three called by hand, and the csv record of ClimateLogSet, whose channel descriptions are
+ * resolved at compile time, against TextFormat::formatRecord() written by hand. Finally a third sensor is added to
+ * the climate sensors to show the generated csv format. Exits with 1 if a reading or a csv record differs.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=gnu++17 -O2 -Iinclude tools/bench_sensorset.cpp -o bench_sensorset
+ * Usage: bench_sensorset [cycles]
+ */
+
+#include <HAL.h>
+#include <Climate.h>
+#include <chrono>
+
+/**
+ * @brief ClimateMeasurement before SensorSet, with the state machines of both sensors written out.
+ *
+ */
+class FormerMeasurement {
+
+    public:
+        enum State {
+            IDLE,
+            TEMPERATURE,
+            HUMIDITY,
+            PRESSURE,
+            DONE
+        };
+
+    private:
+        HTU21DF& _humiditySensor;
+        BMP180& _barometricSensor;
+        State _humidityState = IDLE;
+        State _barometricState = IDLE;
+        uint32_t _humidityDeadline = 0;
+        uint32_t _barometricDeadline = 0;
+        uint8_t _retries = 0;
+        uint16_t _rawTemperatureHTU21DF = 0;
+        uint16_t _rawHumidity = 0;
+        boolean _validTemperatureHTU21DF = false;
+        boolean _validHumidity = false;
+        int32_t _rawTemperatureBMP180 = 0;
+        int32_t _rawPressure = 0;
+
+        static boolean reached(uint32_t now, uint32_t deadline) {
+            return (int32_t) (now - deadline) >= 0;
+        }
+
+        void stepHumiditySensor(uint32_t now) {
+            if((_humidityState != TEMPERATURE && _humidityState != HUMIDITY) || !reached(now, _humidityDeadline)) {
+                return;
+            }
+            uint16_t raw = 0;
+            boolean valid = _humiditySensor.readRaw(raw);
+            if(!valid && ++_retries <= HTU21DF_MAX_RETRIES) {
+                _humidityDeadline = now + HTU21DF_RETRY_MICROS;
+                return;
+            }
+            _retries = 0;
+            if(_humidityState == TEMPERATURE) {
+                _rawTemperatureHTU21DF = raw;
+                _validTemperatureHTU21DF = valid;
+                _humiditySensor.startHumidity();
+                _humidityState = HUMIDITY;
+                _humidityDeadline = now + HTU21DF_HUMIDITY_MILLIS * 1000;
+            } else {
+                _rawHumidity = raw;
+                _validHumidity = valid;
+                _humidityState = DONE;
+            }
+        }
+
+        void stepBarometricSensor(uint32_t now) {
+            if((_barometricState != TEMPERATURE && _barometricState != PRESSURE) || !reached(now, _barometricDeadline)) {
+                return;
+            }
+            if(_barometricState == TEMPERATURE) {
+                _rawTemperatureBMP180 = _barometricSensor.readTemperatureResult();
+                _barometricSensor.startPressure();
+                _barometricState = PRESSURE;
+                _barometricDeadline = now + _barometricSensor.pressureConversionMicros();
+            } else {
+                _rawPressure = _barometricSensor.readPressureResult();
+                _barometricState = DONE;
+            }
+        }
+
+    public:
+        FormerMeasurement(HTU21DF& humiditySensor, BMP180& barometricSensor)
+            : _humiditySensor(humiditySensor), _barometricSensor(barometricSensor) {
+        }
+
+        void start(uint32_t now) {
+            _retries = 0;
+            _validTemperatureHTU21DF = false;
+            _validHumidity = false;
+            _humiditySensor.startTemperature();
+            _humidityState = TEMPERATURE;
+            _humidityDeadline = now + HTU21DF_TEMPERATURE_MILLIS * 1000;
+            _barometricSensor.startTemperature();
+            _barometricState = TEMPERATURE;
+            _barometricDeadline = now + _barometricSensor.temperatureConversionMicros();
+        }
+
+        boolean step(uint32_t now) {
+            stepHumiditySensor(now);
+            stepBarometricSensor(now);
+            return ready();
+        }
+
+        uint32_t nextStep(uint32_t now) {
+            uint32_t wait = UINT32_MAX;
+            if(_humidityState == TEMPERATURE || _humidityState == HUMIDITY) {
+                wait = reached(now, _humidityDeadline) ? 0 : _humidityDeadline - now;
+            }
+            if(_barometricState == TEMPERATURE || _barometricState == PRESSURE) {
+                uint32_t barometricWait = reached(now, _barometricDeadline) ? 0 : _barometricDeadline - now;
+                wait = barometricWait < wait ? barometricWait : wait;
+            }
+            return wait == UINT32_MAX ? 0 : wait;
+        }
+
+        boolean ready() {
+            return _humidityState == DONE && _barometricState == DONE;
+        }
+
+        ClimateReading result(float referencePressure) {
+            ClimateReading reading;
+            int32_t pressure = _barometricSensor.compensatePressure(_rawTemperatureBMP180, _rawPressure);
+            reading.temperatureHTU21DF = _validTemperatureHTU21DF ? HTU21DF::temperature(_rawTemperatureHTU21DF) : NAN;
+            reading.humidity = _validHumidity ? HTU21DF::humidity(_rawHumidity) : NAN;
+            reading.temperatureBMP085 = _barometricSensor.compensateTemperature(_rawTemperatureBMP180);
+            reading.temperature = (reading.temperatureHTU21DF + reading.temperatureBMP085) / 2;
+            reading.pressure = pressure / 100.0;
+            reading.height = BMP180::altitude(pressure, referencePressure);
+            reading.pressureAtSealevel = BMP180::sealevelPressure(pressure, reading.height) / 100.0;
+            return reading;
+        }
+};
+
+/**
+ * @brief Runs one measurement cycle on the virtual clock like ClimateSensor::read().
+ *
+ */
+template <typename Measurement>
+ClimateReading measure(Measurement& measurement) {
+    measurement.start(micros());
+    while(!measurement.step(micros())) {
+        hal::native::advance(measurement.nextStep(micros()));
+    }
+    return measurement.result(101325);
+}
+
+/**
+ * @brief A sensor without I/O for timing the dispatch: one conversion of a fixed duration, one channel.
+ *
+ */
+template <uint32_t ConversionMicros>
+class TimerChannels {
+
+    private:
+        uint32_t _deadline = 0;
+        boolean _running = false;
+        uint32_t _count = 0;
+
+    public:
+        static const uint8_t channels = 1;
+
+        static constexpr SensorChannel channel(uint8_t) {
+            return SensorChannel{"count", "", 0, 1};
+        }
+
+        void start(uint32_t now) {
+            _deadline = now + ConversionMicros;
+            _running = true;
+        }
+
+        void step(uint32_t now) {
+            if(_running && (int32_t) (now - _deadline) >= 0) {
+                _running = false;
+                _count++;
+            }
+        }
+
+        uint32_t nextStep(uint32_t now) {
+            return !_running ? UINT32_MAX : (int32_t) (now - _deadline) >= 0 ? 0 : _deadline - now;
+        }
+
+        boolean ready() {
+            return !_running;
+        }
+
+        void values(float* values) {
+            values[0] = _count;
+        }
+};
+
+/**
+ * @brief The same three timers as the SensorSet of the dispatch benchmark, called by hand.
+ *
+ */
+struct HandWrittenTimers {
+    TimerChannels<4500> first;
+    TimerChannels<13500> second;
+    TimerChannels<50000> third;
+
+    void start(uint32_t now) {
+        first.start(now);
+        second.start(now);
+        third.start(now);
+    }
+
+    boolean step(uint32_t now) {
+        first.step(now);
+        second.step(now);
+        third.step(now);
+        return first.ready() && second.ready() && third.ready();
+    }
+
+    uint32_t nextStep(uint32_t now) {
+        uint32_t wait = first.nextStep(now);
+        uint32_t next = second.nextStep(now);
+        wait = next < wait ? next : wait;
+        next = third.nextStep(now);
+        wait = next < wait ? next : wait;
+        return wait == UINT32_MAX ? 0 : wait;
+    }
+
+    void values(float* values) {
+        first.values(values);
+        second.values(values + 1);
+        third.values(values + 2);
+    }
+};
+
+/**
+ * @brief Runs timer cycles and returns the host time per cycle.
+ *
+ */
+template <typename Timers>
+double dispatch(Timers& timers, uint32_t cycles, float& sink) {
+    uint32_t now = 0;
+    float values[3];
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < cycles; i++) {
+        timers.start(now);
+        while(!timers.step(now)) {
+            now += timers.nextStep(now);
+        }
+        timers.values(values);
+        sink += values[0] + values[1] + values[2];
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / cycles;
+}
+
+/**
+ * @brief An illuminance sensor for the composition example, following a day on the virtual clock.
+ *
+ */
+class DaylightChannels {
+
+    private:
+        boolean _done = false;
+
+    public:
+        static const uint8_t channels = 1;
+
+        static constexpr SensorChannel channel(uint8_t) {
+            return SensorChannel{"illuminance", "lx", 0, 1};
+        }
+
+        void start(uint32_t) {
+            _done = true;
+        }
+
+        void step(uint32_t) {
+        }
+
+        uint32_t nextStep(uint32_t) {
+            return UINT32_MAX;
+        }
+
+        boolean ready() {
+            return _done;
+        }
+
+        void values(float* values) {
+            double day = fmod(hal::epoch() / 86400.0, 1.0);
+            double sun = sin((day - 0.25) * 2 * M_PI);
+            values[0] = sun > 0 ? 50000 * sun : 0;
+        }
+};
+
+/**
+ * @brief Formats csv records of the climate log with changing values and returns the time per record.
+ *
+ * @param format formatter returning the number of characters
+ * @param records number of records
+ * @param sink receives the characters, so the formatting is not optimised away
+ * @return double nanoseconds per record
+ */
+template <typename Formatter>
+double formatNanos(Formatter format, uint32_t records, size_t& sink) {
+    time_t time = 1653638400;
+    struct tm timeInfo;
+    gmtime_r(&time, &timeInfo);
+    float values[5] = {21.5, 45.0, 987.0, 1013.51, 223.01};
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < records; i++) {
+        values[0] = 15 + (i % 1000) * 0.013f;
+        values[2] = 980 + (i % 700) * 0.031f;
+        char line[TEXT_RECORD_SIZE];
+        sink += format(line, timeInfo, values);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / records;
+}
+
+int main(int argc, char** argv) {
+    uint32_t cycles = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000;
+    hal::native::quiet = true;
+    hal::native::sensorNoise.enabled = true;
+    HTU21DF humiditySensor;
+    BMP180 barometricSensor;
+    if(!humiditySensor.begin() || !barometricSensor.begin(BMP180_ULTRAHIGHRES)) {
+        fprintf(stderr, "fake sensors not found\n");
+        return 1;
+    }
+    FormerMeasurement former(humiditySensor, barometricSensor);
+    ClimateMeasurement composed(humiditySensor, barometricSensor);
+
+    //same noise, bus traffic and conversion time for both
+    uint32_t mismatches = 0;
+    uint64_t formerTransactions = 0, composedTransactions = 0, formerMicros = 0, composedMicros = 0;
+    for(uint32_t i = 0; i < cycles; i++) {
+        hal::native::environment.temperature = 20 + 5 * sin(i / 300.0);
+        hal::native::environment.humidity = 50 + 20 * cos(i / 500.0);
+        hal::native::environment.pressure = 98700 + 500 * sin(i / 1000.0);
+        hal::native::SensorNoise noise = hal::native::sensorNoise;
+        uint32_t transactions = hal::sensorBus().transactions;
+        uint64_t start = hal::micros64();
+        ClimateReading expected = measure(former);
+        formerMicros += hal::micros64() - start;
+        formerTransactions += hal::sensorBus().transactions - transactions;
+        hal::native::sensorNoise = noise;
+        transactions = hal::sensorBus().transactions;
+        start = hal::micros64();
+        ClimateReading reading = measure(composed);
+        composedMicros += hal::micros64() - start;
+        composedTransactions += hal::sensorBus().transactions - transactions;
+        mismatches += memcmp(&expected, &reading, sizeof(reading)) != 0;
+    }
+    bool identical = mismatches == 0 && formerTransactions == composedTransactions && formerMicros == composedMicros;
+    printf("%u cycles on the fake sensors with noise\n", cycles);
+    printf("%-28s %12s %14s %12s\n", "", "I2C/cycle", "conversion µs", "host ns");
+
+    double timing[2];
+    for(int run = 0; run < 2; run++) {
+        auto start = std::chrono::steady_clock::now();
+        for(uint32_t i = 0; i < cycles; i++) {
+            if(run == 0) {
+                measure(former);
+            } else {
+                measure(composed);
+            }
+        }
+        timing[run] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / cycles;
+    }
+    printf("%-28s %12.2f %14.1f %12.0f\n", "hand written (former)", (double) formerTransactions / cycles,
+        (double) formerMicros / cycles, timing[0]);
+    printf("%-28s %12.2f %14.1f %12.0f\n", "SensorSet<HTU21DF, BMP180>", (double) composedTransactions / cycles,
+        (double) composedMicros / cycles, timing[1]);
+    printf("readings bit identical: %s (%u differ), object size %zu and %zu bytes\n", identical ? "yes" : "NO",
+        mismatches, sizeof(FormerMeasurement), sizeof(ClimateMeasurement));
+
+    //the dispatch alone
+    float sink = 0;
+    HandWrittenTimers handWritten;
+    SensorSet<TimerChannels<4500>, TimerChannels<13500>, TimerChannels<50000>> timers(
+        (TimerChannels<4500>()), TimerChannels<13500>(), TimerChannels<50000>());
+    uint32_t dispatchCycles = cycles * 50;
+    double handNanos = 1e9, setNanos = 1e9;
+    for(int run = 0; run < 5; run++) {
+        double nanos = dispatch(handWritten, dispatchCycles, sink);
+        handNanos = nanos < handNanos ? nanos : handNanos;
+        nanos = dispatch(timers, dispatchCycles, sink);
+        setNanos = nanos < setNanos ? nanos : setNanos;
+    }
+    printf("\ndispatch of three sensors without I/O, best of 5: by hand %.1f ns, SensorSet %.1f ns per cycle (ratio %.2f)%s\n",
+        handNanos, setNanos, setNanos / handNanos, sink < 0 ? " " : "");
+
+    //the csv record: decimals of the channels as constants against the record written by hand
+    auto byHand = [](char* line, const struct tm& timeInfo, const float* values) {
+        return TextFormat::formatRecord(line, timeInfo, values);
+    };
+    auto bySet = [](char* line, const struct tm& timeInfo, const float* values) {
+        return ClimateLogSet::csvRecord(line, timeInfo, values);
+    };
+    uint32_t csvMismatches = 0;
+    for(uint32_t i = 0; i < cycles; i++) {
+        time_t time = 1653638400 + i * 10;
+        struct tm timeInfo;
+        gmtime_r(&time, &timeInfo);
+        const float values[5] = {15 + (i % 1000) * 0.013f, NAN, 980 + (i % 700) * 0.031f, -1.005f, i * 0.5f};
+        char expected[TEXT_RECORD_SIZE], line[TEXT_RECORD_SIZE];
+        size_t length = byHand(expected, timeInfo, values);
+        csvMismatches += bySet(line, timeInfo, values) != length || memcmp(expected, line, length) != 0;
+    }
+    size_t csvSink = 0;
+    uint32_t csvRecords = cycles * 50;
+    double handCsv = 1e9, setCsv = 1e9;
+    for(int run = 0; run < 5; run++) {
+        double nanos = formatNanos(byHand, csvRecords, csvSink);
+        handCsv = nanos < handCsv ? nanos : handCsv;
+        nanos = formatNanos(bySet, csvRecords, csvSink);
+        setCsv = nanos < setCsv ? nanos : setCsv;
+    }
+    identical = identical && csvMismatches == 0;
+    printf("csv record of the climate log, best of 5: by hand %.1f ns, ClimateLogSet %.1f ns (ratio %.2f), %s%s\n",
+        handCsv, setCsv, setCsv / handCsv, csvMismatches == 0 ? "identical" : "DIFFERENT", csvSink == 0 ? " " : "");
+
+    //a third sensor changes the record and the csv format, nothing else
+    typedef SensorSet<HTU21DFChannels, BMP180Channels, DaylightChannels> ExtendedSet;
+    static_assert(ExtendedSet::channels == 5, "two, two and one channel");
+    static_assert(sizeof(ExtendedSet::Record::values) == 5 * sizeof(float), "one float per channel");
+    ExtendedSet extended((HTU21DFChannels(humiditySensor)), BMP180Channels(barometricSensor), DaylightChannels());
+    hal::native::advance(12 * 3600ULL * 1000000);
+    ExtendedSet::Record record = extended.measure(hal::epoch());
+    char header[128];
+    char line[ExtendedSet::csvRecordSize];
+    ExtendedSet::csvHeader(header, sizeof(header));
+    ExtendedSet::csvRecord(line, record);
+    printf("\nSensorSet<HTU21DF, BMP180, Daylight>: %u channels, record %zu bytes\n%s%s", ExtendedSet::channels,
+        sizeof(ExtendedSet::Record), header, line);
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+/**
+ * @file check_aggregates.cpp
+ * @brief Host check of ClimateAggregator against a batch computation: the records of csv logs are passed through
+ * the aggregator like ClimateDataLogger does, and every closed hour and day is compared with count, min, max, a
+ * two-pass mean and a two-pass standard deviation over the same records. Without a log a synthetic week with a
+ * large offset is checked, where the textbook sum of squares loses its precision. Exits with 1 on a mismatch.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=c++11 -O2 -Iinclude tools/check_aggregates.cpp -o check_aggregates
+ * Usage: check_aggregates [log_27_5_2022.csv ...]  (the records of all logs are sorted by time)
+ */
+
+#include <ClimateAggregate.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+/**
+ * @brief One row of the csv log.
+ *
+ */
+struct Row {
+    time_t time;
+    float values[AGGREGATE_CHANNELS];
+};
+
+/**
+ * @brief Reads the rows of a csv log with ISO 8601 timestamps. The timestamps are local time, they are read as UTC
+ * and the tool runs with TZ=UTC0, so hours and days are the same as on the device.
+ *
+ * @param in input file
+ * @param rows rows are appended
+ */
+void readLog(FILE* in, std::vector<Row>& rows) {
+    char line[256];
+    while(fgets(line, sizeof(line), in)) {
+        struct tm timeInfo;
+        memset(&timeInfo, 0, sizeof(timeInfo));
+        Row row;
+        if(sscanf(line, "%d-%d-%dT%d:%d:%d,%f,%f,%f,%f,%f", &timeInfo.tm_year, &timeInfo.tm_mon, &timeInfo.tm_mday,
+            &timeInfo.tm_hour, &timeInfo.tm_min, &timeInfo.tm_sec, &row.values[0], &row.values[1], &row.values[2],
+            &row.values[3], &row.values[4]) != 11) {
+                continue;
+        }
+        timeInfo.tm_mon -= 1;
+        timeInfo.tm_year -= 1900;
+        row.time = timegm(&timeInfo);
+        rows.push_back(row);
+    }
+}
+
+/**
+ * @brief Returns the start of the hour or day of a time.
+ *
+ * @param time time
+ * @param period AGGREGATE_HOUR or AGGREGATE_DAY
+ * @return time_t start of the period
+ */
+time_t periodStart(time_t time, AggregatePeriod period) {
+    return time - time % (period == AGGREGATE_HOUR ? 3600 : 86400);
+}
+
+/**
+ * @brief Compares the statistics of one period with a two-pass computation over its rows.
+ *
+ * @param rows all rows
+ * @param period AGGREGATE_HOUR or AGGREGATE_DAY
+ * @param start start of the period
+ * @param channels statistics of the aggregator
+ * @param naiveError receives the largest relative error of the sum of squares variance
+ * @return bool true if the statistics match
+ */
+bool compare(const std::vector<Row>& rows, AggregatePeriod period, time_t start, const RunningStatistics* channels, double& naiveError) {
+    bool valid = true;
+    for(uint8_t channel = 0; channel < AGGREGATE_CHANNELS; channel++) {
+        uint32_t count = 0;
+        float min = 0;
+        float max = 0;
+        double sum = 0;
+        float floatSum = 0;
+        float floatSquares = 0;
+        for(const Row& row : rows) {
+            float value = row.values[channel];
+            if(periodStart(row.time, period) != start || isnan(value)) {
+                continue;
+            }
+            if(count == 0 || value < min) {
+                min = value;
+            }
+            if(count == 0 || value > max) {
+                max = value;
+            }
+            count++;
+            sum += value;
+            floatSum += value;
+            floatSquares += value * value;
+        }
+        double mean = count > 0 ? sum / count : 0;
+        double squares = 0;
+        for(const Row& row : rows) {
+            float value = row.values[channel];
+            if(periodStart(row.time, period) == start && !isnan(value)) {
+                squares += (value - mean) * (value - mean);
+            }
+        }
+        double deviation = count > 1 ? sqrt(squares / (count - 1)) : 0;
+        const RunningStatistics& statistics = channels[channel];
+        double scale = fabs(mean) > 1 ? fabs(mean) : 1;
+        if(statistics.count != count || statistics.min != min || statistics.max != max
+            || fabs(statistics.mean - mean) > 1e-9 * scale || fabs(statistics.deviation() - deviation) > 1e-6 * scale) {
+            fprintf(stderr, "%s %ld channel %u: count %u/%u, min %g/%g, max %g/%g, mean %.12g/%.12g, std %.12g/%.12g\n",
+                period == AGGREGATE_HOUR ? "hour" : "day", (long) start, channel, statistics.count, count,
+                statistics.min, min, statistics.max, max, statistics.mean, mean, statistics.deviation(), deviation);
+            valid = false;
+        }
+        if(count > 1 && deviation > 0) {
+            double naiveVariance = (floatSquares - floatSum * floatSum / count) / (count - 1);
+            double naive = sqrt(naiveVariance > 0 ? naiveVariance : 0);
+            double error = fabs(naive - deviation) / deviation;
+            naiveError = error > naiveError ? error : naiveError;
+        }
+    }
+    return valid;
+}
+
+int main(int argc, char** argv) {
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    std::vector<Row> rows;
+    for(int i = 1; i < argc; i++) {
+        FILE* in = fopen(argv[i], "r");
+        if(!in) {
+            perror(argv[i]);
+            return 1;
+        }
+        readLog(in, rows);
+        fclose(in);
+    }
+    if(argc == 1) {
+        time_t start = 1653609600;
+        for(uint32_t i = 0; i < 7 * 8640; i++) {
+            Row row;
+            row.time = start + i * 10;
+            double phase = i * 2 * M_PI / 8640;
+            row.values[0] = 20 + 5 * sin(phase) + (i % 7) * 0.01;
+            row.values[1] = i % 997 == 0 ? NAN : 50 + 20 * cos(phase);
+            row.values[2] = 98700 + 0.3 * sin(phase * 24) + (i % 13) * 0.01;
+            row.values[3] = 101351 + 0.3 * sin(phase * 24);
+            row.values[4] = 223 + (i % 3) * 0.01;
+            rows.push_back(row);
+        }
+    }
+    std::stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+        return a.time < b.time;
+    });
+    if(rows.empty()) {
+        fprintf(stderr, "no records\n");
+        return 1;
+    }
+
+    AggregateState state = {};
+    ClimateAggregator aggregator(state);
+    bool valid = true;
+    uint32_t hours = 0;
+    uint32_t days = 0;
+    double naiveError = 0;
+    for(const Row& row : rows) {
+        struct tm timeInfo;
+        gmtime_r(&row.time, &timeInfo);
+        aggregator.add(row.time, timeInfo, row.values, [&](AggregatePeriod period, time_t start, const RunningStatistics* channels) {
+            valid = compare(rows, period, start, channels, naiveError) && valid;
+            (period == AGGREGATE_HOUR ? hours : days)++;
+        });
+    }
+    valid = compare(rows, AGGREGATE_HOUR, (time_t) state.hourStart, aggregator.current(AGGREGATE_HOUR), naiveError) && valid;
+    valid = compare(rows, AGGREGATE_DAY, (time_t) state.dayStart, aggregator.current(AGGREGATE_DAY), naiveError) && valid;
+    printf("%zu records, %u hours and %u days checked: %s\n", rows.size(), hours + 1, days + 1, valid ? "ok" : "MISMATCH");
+    printf("largest relative error of the float sum of squares deviation: %.2g\n", naiveError);
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,296 @@
+/**
+ * @file check_batch.cpp
+ * @brief Host fault injection test of SampleBatch::flush() (SampleBuffer.h) on the fake SD card of the native
+ * environment. Deep sleep cycles take one sample per minute from 23:50 on and flush a batch of eight samples, so
+ * one batch is written after midnight and starts with samples of the day before. For every log format and every
+ * flush, the card fails after every byte offset of the writes of that flush; the device reboots with its RTC memory
+ * and goes on. Afterwards every sample has to be in the log file of its own day exactly once, without torn records
+ * or gaps in the sequence numbers, and the daily statistics have to count it once. Exits with 1 if a check fails.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=gnu++17 -O2 -Iinclude tools/check_batch.cpp -o check_batch
+ * Usage: check_batch [cycles]
+ */
+
+#include <HAL.h>
+#include <Climate.h>
+#include <SampleBuffer.h>
+#include <vector>
+
+/**
+ * @brief Time of the first sample, 27.5.2022 23:50 UTC.
+ */
+const time_t firstSample = 1653695400;
+const uint32_t sampleSeconds = 60;
+const uint16_t batchSize = 8;
+
+/**
+ * @brief The RTC memory of the simulated device, kept across reboots.
+ *
+ */
+struct Device {
+    SampleBuffer buffer;
+    WakeCache wakeCache;
+    AggregateState aggregates;
+    DeltaState delta;
+};
+
+/**
+ * @brief Returns the sample of a cycle.
+ *
+ * @param cycle number of the cycle
+ * @return ClimateSample sample
+ */
+ClimateSample sampleOf(uint32_t cycle) {
+    ClimateSample sample = {firstSample + (time_t) cycle * sampleSeconds, 15 + cycle * 0.01f, 45 + (cycle % 7) * 0.5f,
+        980 + cycle * 0.02f, 1013 + cycle * 0.02f, 223};
+    return sample;
+}
+
+/**
+ * @brief Returns the path of the log file of a day.
+ *
+ * @param time a time of the day
+ * @param format log format
+ * @return std::string path
+ */
+std::string logPath(time_t time, LogFormat format) {
+    struct tm timeInfo;
+    localtime_r(&time, &timeInfo);
+    char path[LOG_ROTATION_PATH_SIZE];
+    LogRotation::fileName(path, timeInfo, 0, format == LOG_BINARY ? ".bin" : format == LOG_DELTA ? ".dlt" : ".csv", false);
+    return path;
+}
+
+/**
+ * @brief Reads a file of the fake card.
+ *
+ * @param path path
+ * @return std::vector<uint8_t> content, empty if the file does not exist
+ */
+std::vector<uint8_t> readFile(const char* path) {
+    std::vector<uint8_t> data;
+    File file = hal::storage().open(path);
+    if(file) {
+        data.resize(file.size());
+        file.read(data.data(), data.size());
+    }
+    return data;
+}
+
+/**
+ * @brief Mounts the card after a wakeup and flushes the batch like the deep sleep mode of main.cpp.
+ *
+ * @param device RTC memory
+ * @param batch batch on the buffer of the device
+ * @param format log format
+ */
+void flushBatch(Device& device, SampleBatch& batch, LogFormat format) {
+    ClimateSensor climate;
+    climate.setLogFormat(format);
+    climate.setAggregateState(&device.aggregates);
+    climate.setDeltaState(&device.delta);
+    climate.setWakeCache(&device.wakeCache);
+    climate.beginLogger(true);
+    batch.flush(climate);
+}
+
+/**
+ * @brief Runs the deep sleep cycles on an empty card. One flush fails after a number of bytes.
+ *
+ * @param device RTC memory
+ * @param format log format
+ * @param cycles number of samples
+ * @param failingFlush number of the flush which fails
+ * @param budget bytes written before the card fails
+ * @return bool true if the card failed, false if the flush wrote less than budget bytes
+ */
+bool run(Device& device, LogFormat format, uint32_t cycles, uint32_t failingFlush, int64_t budget) {
+    hal::storage() = FakeStorage();
+    hal::native::storageFault = hal::native::StorageFault();
+    memset(&device, 0, sizeof(device));
+    device.wakeCache.begin(format);
+    SampleBatch batch(device.buffer, batchSize, 0);
+    uint32_t flushes = 0;
+    bool failed = false;
+    for(uint32_t cycle = 0; cycle < cycles; cycle++) {
+        ClimateSample sample = sampleOf(cycle);
+        hal::setEpochMicros((int64_t) sample.time * 1000000 + 500000);
+        batch.add(sample);
+        if(!batch.flushDue(sample.time)) {
+            continue;
+        }
+        if(flushes++ == failingFlush) {
+            hal::native::storageFault.writeBudget = budget;
+        }
+        flushBatch(device, batch, format);
+        failed = failed || hal::native::storageFault.writeBudget == 0;
+        hal::native::storageFault = hal::native::StorageFault();
+    }
+    for(uint8_t attempt = 0; attempt < 3 && batch.size() > 0; attempt++) {
+        flushBatch(device, batch, format);
+    }
+    return failed;
+}
+
+/**
+ * @brief Reads the times of the records of a log file and checks that it contains nothing else. Csv records have
+ * to be numbered without gaps.
+ *
+ * @param path path
+ * @param format log format
+ * @param times receives the times of the records
+ * @return bool true if the log is intact
+ */
+bool readLog(const char* path, LogFormat format, std::vector<time_t>& times) {
+    std::vector<uint8_t> data = readFile(path);
+    if(data.empty()) {
+        return true;
+    }
+    if(format == LOG_CSV) {
+        char header[CSV_LOG_HEADER_SIZE];
+        size_t start = ClimateDataLogger::csvHeader(header);
+        if(data.size() < start || memcmp(data.data(), header, start) != 0) {
+            return false;
+        }
+        uint32_t expected = 1;
+        while(start < data.size()) {
+            const char* line = (const char*) data.data() + start;
+            const char* newline = (const char*) memchr(line, '\n', data.size() - start);
+            uint32_t sequence;
+            struct tm timeInfo = {};
+            if(!newline || !LogJournal::check(line, newline + 1 - line, sequence) || sequence != expected++
+                || sscanf(line, "%d-%d-%dT%d:%d:%d", &timeInfo.tm_year, &timeInfo.tm_mon, &timeInfo.tm_mday,
+                    &timeInfo.tm_hour, &timeInfo.tm_min, &timeInfo.tm_sec) != 6) {
+                        return false;
+            }
+            timeInfo.tm_year -= 1900;
+            timeInfo.tm_mon -= 1;
+            times.push_back(BinaryLog::localTime(timeInfo));
+            start = newline + 1 - (const char*) data.data();
+        }
+        return true;
+    }
+    bool binary = format == LOG_BINARY;
+    if(binary ? !BinaryLog::checkHeader(data.data(), data.size()) : !DeltaLog::checkHeader(data.data(), data.size())) {
+        return false;
+    }
+    std::vector<BinaryLogRecord> records(UINT16_MAX);
+    size_t position = binary ? BINARY_LOG_HEADER_SIZE : DELTA_LOG_HEADER_SIZE;
+    while(position < data.size()) {
+        uint16_t count;
+        size_t size = binary
+            ? BinaryLog::decodeBlock(data.data() + position, data.size() - position, records.data(), UINT16_MAX, count)
+            : DeltaLog::decodeBlock(data.data() + position, data.size() - position, records.data(), UINT16_MAX, count);
+        if(size == 0) {
+            return false;
+        }
+        for(uint16_t i = 0; i < count; i++) {
+            times.push_back(records[i].time);
+        }
+        position += size;
+    }
+    return true;
+}
+
+/**
+ * @brief Checks the logs and the statistics after a run.
+ *
+ * @param device RTC memory after the run
+ * @param format log format
+ * @param cycles number of samples
+ * @param error receives the failed check
+ * @return bool true if every sample was logged once in the file of its day and counted once
+ */
+bool check(const Device& device, LogFormat format, uint32_t cycles, const char*& error) {
+    time_t lastSample = sampleOf(cycles - 1).time;
+    std::vector<uint32_t> found(cycles, 0);
+    for(time_t day = firstSample - firstSample % 86400; day <= lastSample; day += 86400) {
+        std::vector<time_t> times;
+        if(!readLog(logPath(day, format).c_str(), format, times)) {
+            error = "torn record or gap in the sequence numbers";
+            return false;
+        }
+        for(time_t time : times) {
+            if(time < firstSample || time > lastSample || (time - firstSample) % sampleSeconds != 0) {
+                error = "unknown record";
+                return false;
+            }
+            if(time - time % 86400 != day) {
+                error = "record in the file of another day";
+                return false;
+            }
+            found[(time - firstSample) / sampleSeconds]++;
+        }
+    }
+    for(uint32_t count : found) {
+        if(count != 1) {
+            error = count == 0 ? "sample lost" : "sample logged twice";
+            return false;
+        }
+    }
+    time_t lastDay = lastSample - lastSample % 86400;
+    uint32_t lastDayCount = (lastSample - lastDay) / sampleSeconds + 1;
+    if(device.aggregates.day[0].count != lastDayCount) {
+        error = "daily statistics count a sample twice or not at all";
+        return false;
+    }
+    //the summary row of the day before may be missing or torn if the card failed while it was written, but it must
+    //not be there twice or with another count
+    std::vector<uint8_t> summary = readFile(SUMMARY_FILE_NAME);
+    std::string text(summary.begin(), summary.end());
+    const char* row = "day,2022-05-27T00:00:00,";
+    char count[16];
+    snprintf(count, sizeof(count), "%u,", (unsigned) (cycles - lastDayCount));
+    uint32_t rows = 0;
+    for(size_t start = text.find(row); start != std::string::npos; start = text.find(row, start + 1)) {
+        size_t end = text.find('\n', start);
+        if(end == std::string::npos || text.find("day,", start + 1) < end || text.find("hour,", start) < end) {
+            continue;
+        }
+        if(rows++ > 0 || text.compare(start + strlen(row), strlen(count), count) != 0) {
+            error = "wrong summary of the day before";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    uint32_t cycles = argc > 1 ? strtoul(argv[1], nullptr, 10) : 40;
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    hal::native::quiet = true;
+    hal::native::clock.epochStart = firstSample;
+    hal::native::clock.synced = true;
+    hal::native::clock.timerWakeup = true;
+
+    bool valid = cycles > 10;
+    static Device device;
+    const LogFormat formats[3] = {LOG_CSV, LOG_BINARY, LOG_DELTA};
+    for(LogFormat format : formats) {
+        const char* error = nullptr;
+        run(device, format, cycles, UINT32_MAX, -1);
+        bool intact = check(device, format, cycles, error);
+        uint32_t runs = 0;
+        uint32_t failures = 0;
+        for(uint32_t flush = 0; flush * batchSize < cycles; flush++) {
+            for(int64_t budget = 0; run(device, format, cycles, flush, budget); budget++) {
+                runs++;
+                if(!check(device, format, cycles, error)) {
+                    if(failures++ == 0) {
+                        printf("flush %u failing after %lld bytes: %s\n", flush, (long long) budget, error);
+                    }
+                }
+            }
+        }
+        printf("%-4s %6u faults %6u failed%s\n", format == LOG_BINARY ? "bin" : format == LOG_DELTA ? "dlt" : "csv",
+            runs, failures, intact ? "" : ", without faults as well");
+        valid = valid && intact && failures == 0;
+    }
+    printf("%s\n", valid ? "ok" : "FAILED");
+    return valid ? 0 : 1;
+}
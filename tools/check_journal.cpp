@@ -0,0 +1,260 @@
+/**
+ * @file check_journal.cpp
+ * @brief Host fault injection test of the power loss recovery of ClimateDataLogger (LogJournal.h) on the fake SD
+ * card of the native environment. For every log format a reference log is written, then the same records are
+ * written again with a simulated power loss after every byte offset of all writes to the card, once with the
+ * interrupted write cut short and once with the file extended by zeros (FakeStorage.h). After the reboot begin()
+ * has to keep every intact record, remove the torn one and read no more than the tail of the file; records logged
+ * afterwards have to follow without a gap. Then the recovery cost is measured for growing files with a torn
+ * record at the end. Exits with 1 if a check fails.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=gnu++17 -O2 -Iinclude tools/check_journal.cpp -o check_journal
+ * Usage: check_journal [records]
+ */
+
+#include <HAL.h>
+#include <Climate.h>
+#include <vector>
+
+/**
+ * @brief Returns the path of the log file of the simulated day.
+ *
+ * @param format log format
+ * @return const char* path
+ */
+const char* logPath(LogFormat format) {
+    return format == LOG_BINARY ? "/log_27_5_2022.bin" : format == LOG_DELTA ? "/log_27_5_2022.dlt" : "/log_27_5_2022.csv";
+}
+
+/**
+ * @brief Logs records and flushes after every fifth record.
+ *
+ * @param logger started logger
+ * @param first number of the first record
+ * @param count number of records
+ * @param step seconds between two records
+ */
+void logRecords(ClimateDataLogger& logger, uint32_t first, uint32_t count, uint32_t step = 10) {
+    for(uint32_t i = first; i < first + count; i++) {
+        ClimateSample sample = {1653609600 + (time_t) i * step, 15 + (i % 1000) * 0.013f, 45 + (i % 300) * 0.07f,
+            980 + (i % 700) * 0.031f, 1013 + (i % 700) * 0.031f, 223};
+        logger.log(sample);
+        if(i % 5 == 4) {
+            logger.flush();
+        }
+    }
+    logger.flush();
+}
+
+/**
+ * @brief Reads a file of the fake card.
+ *
+ * @param path path
+ * @return std::vector<uint8_t> content, empty if the file does not exist
+ */
+std::vector<uint8_t> readFile(const char* path) {
+    std::vector<uint8_t> data;
+    File file = hal::storage().open(path);
+    if(file) {
+        data.resize(file.size());
+        file.read(data.data(), data.size());
+    }
+    return data;
+}
+
+/**
+ * @brief Splits a log into its records and checks that it contains nothing else. Csv records have to be numbered
+ * without gaps.
+ *
+ * @param data content of the log
+ * @param format log format
+ * @param ends receives the end offset of the header and of every record
+ * @return bool true if the log is intact
+ */
+bool parse(const std::vector<uint8_t>& data, LogFormat format, std::vector<size_t>& ends) {
+    ends.clear();
+    if(format == LOG_CSV) {
+        char expectedHeader[CSV_LOG_HEADER_SIZE];
+        size_t header = ClimateDataLogger::csvHeader(expectedHeader);
+        if(data.size() < header || memcmp(data.data(), expectedHeader, header) != 0) {
+            return false;
+        }
+        ends.push_back(header);
+        uint32_t expected = 1;
+        size_t start = header;
+        while(start < data.size()) {
+            const uint8_t* newline = (const uint8_t*) memchr(data.data() + start, '\n', data.size() - start);
+            uint32_t sequence;
+            if(!newline || !LogJournal::check((const char*) data.data() + start, newline + 1 - data.data() - start, sequence)
+                || sequence != expected++) {
+                    return false;
+            }
+            start = newline + 1 - data.data();
+            ends.push_back(start);
+        }
+        return true;
+    }
+    bool binary = format == LOG_BINARY;
+    size_t header = binary ? BINARY_LOG_HEADER_SIZE : DELTA_LOG_HEADER_SIZE;
+    if(binary ? !BinaryLog::checkHeader(data.data(), data.size()) : !DeltaLog::checkHeader(data.data(), data.size())) {
+        return false;
+    }
+    ends.push_back(header);
+    std::vector<BinaryLogRecord> records(UINT16_MAX);
+    size_t position = header;
+    while(position < data.size()) {
+        uint16_t count;
+        size_t size = binary
+            ? BinaryLog::decodeBlock(data.data() + position, data.size() - position, records.data(), UINT16_MAX, count)
+            : DeltaLog::decodeBlock(data.data() + position, data.size() - position, records.data(), UINT16_MAX, count);
+        if(size == 0) {
+            return false;
+        }
+        position += size;
+        ends.push_back(position);
+    }
+    return true;
+}
+
+/**
+ * @brief Cuts the power after every byte offset of the reference run and checks the recovery.
+ *
+ * @param format log format
+ * @param records number of records before the power loss
+ * @return bool true if all checks passed
+ */
+bool checkFormat(LogFormat format, uint32_t records) {
+    const char* path = logPath(format);
+    const hal::native::Clock clock = hal::native::clock;
+    DeltaState delta = {};
+
+    hal::storage().format();
+    uint64_t written = hal::native::storageStatistics.bytesWritten;
+    {
+        ClimateDataLogger logger("SSID", "PASSWORD", true, format);
+        logger.setDeltaState(&delta);
+        logger.begin();
+        logRecords(logger, 0, records);
+    }
+    written = hal::native::storageStatistics.bytesWritten - written;
+    std::vector<uint8_t> reference = readFile(path);
+    std::vector<size_t> referenceEnds;
+    if(!parse(reference, format, referenceEnds)) {
+        fprintf(stderr, "%s: reference log is not intact\n", path);
+        return false;
+    }
+
+    uint32_t failures = 0;
+    uint32_t torn = 0;
+    uint64_t maxRead = 0;
+    for(uint64_t cut = 0; cut <= written; cut++) {
+        for(int keepSize = 0; keepSize < 2; keepSize++) {
+            hal::storage().format();
+            hal::native::clock = clock;
+            delta = {};
+            hal::native::storageFault.writeBudget = cut;
+            hal::native::storageFault.keepSize = keepSize;
+            {
+                ClimateDataLogger logger("SSID", "PASSWORD", true, format);
+                logger.setDeltaState(&delta);
+                logger.begin();
+                logRecords(logger, 0, records);
+            }
+            hal::native::storageFault = hal::native::StorageFault();
+            delta = {};
+
+            std::vector<uint8_t> damaged = readFile(path);
+            size_t intact = 0;
+            for(size_t end : referenceEnds) {
+                if(end <= damaged.size() && memcmp(damaged.data(), reference.data(), end) == 0) {
+                    intact = end;
+                }
+            }
+            if(intact < damaged.size()) {
+                torn++;
+            }
+            if(intact == 0) {
+                intact = referenceEnds[0];
+            }
+
+            uint64_t read = hal::native::storageStatistics.bytesRead;
+            ClimateDataLogger logger("SSID", "PASSWORD", true, format);
+            logger.setDeltaState(&delta);
+            logger.begin();
+            read = hal::native::storageStatistics.bytesRead - read;
+            maxRead = read > maxRead ? read : maxRead;
+            std::vector<uint8_t> recovered = readFile(path);
+            bool valid = recovered.size() == intact && memcmp(recovered.data(), reference.data(), intact) == 0;
+
+            logRecords(logger, records, 5);
+            std::vector<uint8_t> continued = readFile(path);
+            std::vector<size_t> ends;
+            valid = valid && parse(continued, format, ends) && continued.size() > intact && read <= LOG_JOURNAL_TAIL_SIZE;
+            if(!valid) {
+                if(failures++ < 10) {
+                    fprintf(stderr, "%s: power loss after %llu bytes%s: %zu bytes left, %zu intact, %zu after recovery, "
+                        "%llu bytes read\n", path, (unsigned long long) cut, keepSize ? " (size kept)" : "",
+                        damaged.size(), intact, recovered.size(), (unsigned long long) read);
+                }
+            }
+        }
+    }
+    printf("%-20s %8llu cuts %8u torn %8u failed, at most %llu bytes read by begin()\n", path,
+        (unsigned long long) written + 1, torn, failures, (unsigned long long) maxRead);
+    return failures == 0;
+}
+
+/**
+ * @brief Measures begin() on logs of growing size which end with half a record. The records are 1 s apart, so
+ * they stay in the log file of one day.
+ *
+ * @return bool true if the torn record was removed every time
+ */
+bool measureRecovery() {
+    bool valid = true;
+    printf("%10s %12s %14s %14s\n", "records", "log bytes", "bytes read", "begin() ms");
+    for(uint32_t records = 100; records <= 80000; records *= records < 10000 ? 10 : 8) {
+        hal::storage().format();
+        {
+            ClimateDataLogger logger("SSID", "PASSWORD", true);
+            logger.begin();
+            logRecords(logger, 0, records, 1);
+        }
+        const char* path = logPath(LOG_CSV);
+        File file = hal::storage().open(path, FILE_APPEND);
+        const char* half = "2022-05-28T00:00:00,15.00,45.";
+        file.write((const uint8_t*) half, strlen(half));
+        size_t size = file.size();
+        file.close();
+
+        uint64_t read = hal::native::storageStatistics.bytesRead;
+        uint64_t clock = hal::micros64();
+        ClimateDataLogger logger("SSID", "PASSWORD", true);
+        logger.begin();
+        double millis = (hal::micros64() - clock) / 1e3;
+        read = hal::native::storageStatistics.bytesRead - read;
+        valid = valid && logger.recovered() == strlen(half) && logger.lastSequence() == records;
+        printf("%10u %12zu %14llu %14.1f\n", records, size, (unsigned long long) read, millis);
+    }
+    return valid;
+}
+
+int main(int argc, char** argv) {
+    uint32_t records = argc > 1 ? strtoul(argv[1], nullptr, 10) : 40;
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    hal::native::quiet = true;
+    hal::native::clock.epochStart = 1653609600;
+    hal::native::clock.synced = true;
+
+    bool valid = checkFormat(LOG_CSV, records);
+    valid = checkFormat(LOG_BINARY, records) && valid;
+    valid = checkFormat(LOG_DELTA, records) && valid;
+    valid = measureRecovery() && valid;
+    printf("%s\n", valid ? "ok" : "FAILED");
+    return valid ? 0 : 1;
+}
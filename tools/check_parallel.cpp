@@ -0,0 +1,92 @@
+/**
+ * @file check_parallel.cpp
+ * @brief Host test of the parallel measurement of ClimateSensor::read() (ClimateMeasurement.h) with scripted
+ * conversion times of the fake HTU21DF and BMP180. For every BMP180 oversampling and a grid of HTU21DF temperature
+ * and humidity conversion times the wall time of one read() on the virtual clock has to equal the longer of the two
+ * sensor chains plus the I2C transfers, not their sum, no result may be read before its conversion finished and
+ * every value has to be valid. With the waits of the drivers the HTU21DF chain takes at least 66 ms and the BMP180
+ * chain at most 32 ms, so the BMP180 conversions have to disappear in the HTU21DF chain. Exits with 1 if a check
+ * fails.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=gnu++17 -O2 -Iinclude tools/check_parallel.cpp -o check_parallel
+ * Usage: check_parallel
+ */
+
+#include <HAL.h>
+#include <Climate.h>
+
+/**
+ * @brief Upper bound of the bus time of one I2C transaction of the fake bus: address and up to four bytes.
+ */
+const uint32_t transactionMicros = 5 * 90;
+
+/**
+ * @brief Returns when the driver gets the result of a HTU21DF conversion: it reads after its datasheet time and
+ * then retries every HTU21DF_RETRY_MICROS until the sensor acknowledges.
+ *
+ * @param waitMicros datasheet time the driver waits
+ * @param conversionMicros scripted conversion time
+ * @return uint32_t microseconds until the result is read, without bus time
+ */
+uint32_t htu21dfMicros(uint32_t waitMicros, uint32_t conversionMicros) {
+    if(conversionMicros <= waitMicros) {
+        return waitMicros;
+    }
+    return waitMicros + (conversionMicros - waitMicros + HTU21DF_RETRY_MICROS - 1) / HTU21DF_RETRY_MICROS * HTU21DF_RETRY_MICROS;
+}
+
+int main() {
+    hal::native::quiet = true;
+    hal::native::sensorNoise = hal::native::SensorNoise();
+    const uint32_t temperatureMicros[] = {20000, 44000, 50000, 54300, 58000};
+    const uint32_t humidityMicros[] = {3000, 14000, 16000, 19500, 24000};
+    const char* names[] = {"ultra low power", "standard", "high resolution", "ultra high res"};
+    bool valid = true;
+    uint32_t checks = 0;
+    double worstSlack = 0;
+    printf("%-16s %8s %8s %10s %10s %10s %8s\n", "oversampling", "htu T", "htu RH", "longest", "sum", "read()", "bus");
+    for(uint8_t oversampling = BMP180_ULTRALOWPOWER; oversampling <= BMP180_ULTRAHIGHRES; oversampling++) {
+        ClimateSensor climate;
+        climate.setOversampling(oversampling);
+        if(!climate.beginSensors()) {
+            printf("sensors not found\n");
+            return 1;
+        }
+        uint32_t bmp180Micros = hal::native::bmp180.temperatureMicros + hal::native::bmp180.pressureMicros[oversampling]
+            + 2 * BMP180_BUS_MICROS;
+        for(uint32_t temperature : temperatureMicros) {
+            for(uint32_t humidity : humidityMicros) {
+                hal::native::htu21df.temperatureMicros = temperature;
+                hal::native::htu21df.humidityMicros = humidity;
+                hal::native::bmp180.earlyReads = 0;
+                uint32_t htu21df = htu21dfMicros(HTU21DF_TEMPERATURE_MILLIS * 1000, temperature)
+                    + htu21dfMicros(HTU21DF_HUMIDITY_MILLIS * 1000, humidity);
+                uint32_t longest = htu21df > bmp180Micros ? htu21df : bmp180Micros;
+                climate.resetBusTransactions();
+                uint64_t start = hal::micros64();
+                ClimateReading reading = climate.read();
+                uint32_t elapsed = hal::micros64() - start;
+                uint32_t bus = climate.busTransactions() * transactionMicros;
+                bool ok = elapsed >= longest && elapsed <= longest + bus && elapsed < htu21df + bmp180Micros && hal::native::bmp180.earlyReads == 0
+                    && !isnan(reading.temperatureHTU21DF) && !isnan(reading.humidity) && !isnan(reading.pressure);
+                if(!ok || temperature == temperatureMicros[1]) {
+                    printf("%-16s %6.1fms %6.1fms %8.1fms %8.1fms %8.1fms %6.1fms%s\n", names[oversampling], temperature / 1e3,
+                        humidity / 1e3, longest / 1e3, (htu21df + bmp180Micros) / 1e3, elapsed / 1e3, bus / 1e3,
+                        ok ? "" : "  FAILED");
+                }
+                double slack = (double) (elapsed - longest) / (htu21df + bmp180Micros - longest);
+                worstSlack = slack > worstSlack ? slack : worstSlack;
+                valid = valid && ok;
+                checks++;
+            }
+        }
+    }
+    printf("%u conversion time combinations, read() exceeds the longest chain by at most %.0f %% of the shorter one\n",
+        checks, worstSlack * 100);
+    printf("%s\n", valid ? "ok" : "FAILED");
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file decode_log.cpp
+ * @brief Host tool converting binary climate logs (log_d_m_y.bin) and delta compressed logs (log_d_m_y.dlt) to the
+ * csv layout of ClimateLogSet written by ClimateDataLogger, without the journal columns. The format is detected from
+ * the file header.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=gnu++17 -O2 -Iinclude tools/decode_log.cpp -o decode_log
+ * Usage: decode_log log_27_5_2022.bin > log_27_5_2022.csv
+ *        decode_log log_27_5_2022.dlt > log_27_5_2022.csv
+ */
+
+#include <Climate.h>
+#include <stdio.h>
+#include <vector>
+
+/**
+ * @brief Writes one record as csv line in the format of ClimateDataLogger::log().
+ *
+ * @param out output file
+ * @param record record
+ */
+void printRecord(FILE* out, const BinaryLogRecord& record) {
+    time_t time = record.time;
+    struct tm timeInfo;
+    gmtime_r(&time, &timeInfo);
+    float values[ClimateLogSet::channels];
+    BinaryLog::toValues(record, values);
+    char line[ClimateLogSet::csvRecordSize];
+    fwrite(line, 1, ClimateLogSet::csvRecord(line, timeInfo, values), out);
+}
+
+int main(int argc, char** argv) {
+    if(argc != 2) {
+        fprintf(stderr, "Usage: %s <log.bin|log.dlt>\n", argv[0]);
+        return 2;
+    }
+    FILE* in = fopen(argv[1], "rb");
+    if(!in) {
+        perror(argv[1]);
+        return 1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t length;
+    while((length = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+        data.insert(data.end(), chunk, chunk + length);
+    }
+    fclose(in);
+
+    bool delta = DeltaLog::checkHeader(data.data(), data.size());
+    if(!delta && !BinaryLog::checkHeader(data.data(), data.size())) {
+        fprintf(stderr, "%s: not a climate log of binary version %d or delta version %d\n", argv[1],
+            BINARY_LOG_VERSION, DELTA_LOG_VERSION);
+        return 1;
+    }
+
+    char header[CSV_LOG_HEADER_SIZE];
+    fwrite(header, 1, ClimateLogSet::csvHeader(header, sizeof(header)), stdout);
+    std::vector<BinaryLogRecord> records(UINT16_MAX);
+    size_t position = delta ? DELTA_LOG_HEADER_SIZE : BINARY_LOG_HEADER_SIZE;
+    size_t skipped = 0;
+    size_t decoded = 0;
+    while(position < data.size()) {
+        uint16_t count;
+        size_t size = delta
+            ? DeltaLog::decodeBlock(data.data() + position, data.size() - position, records.data(), UINT16_MAX, count)
+            : BinaryLog::decodeBlock(data.data() + position, data.size() - position, records.data(), UINT16_MAX, count);
+        if(size == 0) {
+            position++;
+            skipped++;
+            continue;
+        }
+        for(uint16_t i = 0; i < count; i++) {
+            printRecord(stdout, records[i]);
+        }
+        decoded += count;
+        position += size;
+    }
+    fprintf(stderr, "%zu records, %zu bytes skipped\n", decoded, skipped);
+    return skipped > 0 ? 3 : 0;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file expand_log.cpp
+ * @brief Host tool turning a change-only csv log (ChangeFilter.h) back into a fixed-rate time series: every record
+ * holds its values until the next one, so the output has one row per interval from the first to the last record,
+ * like a log written without change detection.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=gnu++17 -O2 -Iinclude tools/expand_log.cpp -o expand_log
+ * Usage: expand_log [--interval S] log_27_5_2022.csv > expanded.csv
+ */
+
+#include <Climate.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+/**
+ * @brief One row of the csv log.
+ *
+ */
+typedef ClimateLogSet::Record Row;
+
+/**
+ * @brief Reads the rows of a csv log with ISO 8601 timestamps. The local timestamps are read and written as UTC, so
+ * no time zone is applied. The header and malformed lines are skipped.
+ *
+ * @param in input file
+ * @param rows rows in the order of the file
+ */
+void readLog(FILE* in, std::vector<Row>& rows) {
+    char line[256];
+    while(fgets(line, sizeof(line), in)) {
+        struct tm timeInfo;
+        memset(&timeInfo, 0, sizeof(timeInfo));
+        Row row;
+        if(sscanf(line, "%d-%d-%dT%d:%d:%d,%f,%f,%f,%f,%f", &timeInfo.tm_year, &timeInfo.tm_mon, &timeInfo.tm_mday,
+            &timeInfo.tm_hour, &timeInfo.tm_min, &timeInfo.tm_sec, &row.values[0], &row.values[1], &row.values[2],
+            &row.values[3], &row.values[4]) != 11) {
+                continue;
+        }
+        timeInfo.tm_mon -= 1;
+        timeInfo.tm_year -= 1900;
+        row.time = timegm(&timeInfo);
+        rows.push_back(row);
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t interval = 10;
+    const char* path = nullptr;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval = strtoul(argv[++i], nullptr, 10);
+        } else if(!path && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            path = nullptr;
+            break;
+        }
+    }
+    if(!path || interval == 0) {
+        fprintf(stderr, "Usage: %s [--interval S] <log.csv>\n", argv[0]);
+        return 2;
+    }
+    FILE* in = fopen(path, "r");
+    if(!in) {
+        perror(path);
+        return 1;
+    }
+    std::vector<Row> rows;
+    readLog(in, rows);
+    fclose(in);
+    if(rows.empty()) {
+        fprintf(stderr, "%s: no records\n", path);
+        return 1;
+    }
+
+    char header[CSV_LOG_HEADER_SIZE];
+    fwrite(header, 1, ClimateLogSet::csvHeader(header, sizeof(header)), stdout);
+    size_t current = 0;
+    uint32_t written = 0;
+    for(time_t time = rows[0].time; time <= rows.back().time; time += interval) {
+        while(current + 1 < rows.size() && rows[current + 1].time <= time) {
+            current++;
+        }
+        struct tm timeInfo;
+        gmtime_r(&time, &timeInfo);
+        char record[ClimateLogSet::csvRecordSize];
+        fwrite(record, 1, ClimateLogSet::csvRecord(record, timeInfo, rows[current].values), stdout);
+        written++;
+    }
+    fprintf(stderr, "%zu records expanded to %u rows\n", rows.size(), written);
+    return 0;
+}
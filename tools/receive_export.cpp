@@ -0,0 +1,554 @@
+/**
+ * @file receive_export.cpp
+ * @brief Host receiver of the framed log export (LogExport.h, ExportProtocol.h). It lists the files of the node or
+ * downloads one, optionally for a time range. A download resumes at the size of an existing output file, checks the
+ * CRC-32 and the sequence of every frame and requests the rest again after a lost frame. With --fast the session runs
+ * at a higher baud rate, the node switches back on its own if the new rate does not work.
+ *
+ * --loopback runs LogExport on the fake SD card of the native environment behind a pseudo-terminal and receives
+ * through it: a whole file, the same with corrupted bytes to exercise the resume, and a time range. It reports the
+ * sustained throughput and the time a month of logs takes at several baud rates, compared with SDCard::printFile() at
+ * 115200 baud. Exits with 1 if a received file differs.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=gnu++17 -O2 -pthread -Iinclude tools/receive_export.cpp -o receive_export
+ * Usage: receive_export --port DEVICE [--baud RATE] [--fast RATE] list
+ *        receive_export --port DEVICE [--baud RATE] [--fast RATE] get PATH OUTPUT [FROM TO]
+ *        receive_export --loopback [--megabytes N] [--corrupt N]
+ */
+
+#include <HAL.h>
+#include <Climate.h>
+#include <LogExport.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+/**
+ * @brief Returns the termios constant of a baud rate.
+ *
+ * @param rate baud rate
+ * @return speed_t constant, B0 if unsupported
+ */
+speed_t speed(uint32_t rate) {
+    switch(rate) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 500000: return B500000;
+        case 921600: return B921600;
+        case 1000000: return B1000000;
+        case 1500000: return B1500000;
+        case 2000000: return B2000000;
+        default: return B0;
+    }
+}
+
+/**
+ * @brief Sets a terminal to raw 8N1 at a baud rate.
+ *
+ * @param fd file descriptor of the terminal
+ * @param rate baud rate
+ * @return bool success
+ */
+bool configure(int fd, uint32_t rate) {
+    struct termios options;
+    if(tcgetattr(fd, &options) != 0 || speed(rate) == B0) {
+        return false;
+    }
+    cfmakeraw(&options);
+    options.c_cflag |= CLOCAL | CREAD;
+    options.c_cflag &= ~CRTSCTS;
+    cfsetispeed(&options, speed(rate));
+    cfsetospeed(&options, speed(rate));
+    return tcsetattr(fd, TCSANOW, &options) == 0;
+}
+
+/**
+ * @brief Serial port of the node side in the loopback test, with the interface LogExport expects. Every corrupt-th
+ * written byte is flipped.
+ *
+ */
+class FdPort {
+
+    private:
+        int _fd;
+        uint64_t _written = 0;
+        const std::atomic<uint64_t>& _corrupt;
+
+    public:
+        FdPort(int fd, const std::atomic<uint64_t>& corrupt) : _fd(fd), _corrupt(corrupt) {}
+
+        int available() {
+            int count = 0;
+            return ioctl(_fd, FIONREAD, &count) == 0 ? count : 0;
+        }
+
+        int read() {
+            uint8_t c;
+            return ::read(_fd, &c, 1) == 1 ? c : -1;
+        }
+
+        size_t write(const uint8_t* data, size_t length) {
+            std::vector<uint8_t> copy(data, data + length);
+            uint64_t corrupt = _corrupt;
+            if(corrupt > 0) {
+                for(size_t i = 0; i < length; i++) {
+                    if((_written + i + 1) % corrupt == 0) {
+                        copy[i] ^= 0x10;
+                    }
+                }
+            }
+            _written += length;
+            size_t done = 0;
+            while(done < length) {
+                ssize_t n = ::write(_fd, copy.data() + done, length - done);
+                if(n <= 0) {
+                    return done;
+                }
+                done += n;
+            }
+            return done;
+        }
+
+        void flush() {
+            tcdrain(_fd);
+        }
+
+        void updateBaudRate(unsigned long rate) {
+            configure(_fd, rate);
+        }
+};
+
+/**
+ * @brief Host side of the protocol on a terminal.
+ *
+ */
+class Receiver {
+
+    private:
+        int _fd;
+        int _timeoutMillis;
+        ExportParser _parser;
+
+        void send(const char* command) {
+            std::string line = std::string(command) + "\n";
+            if(::write(_fd, line.data(), line.size()) != (ssize_t) line.size()) {
+                perror("write");
+            }
+        }
+
+        /**
+         * @brief Passes received frames to a handler until it returns false or nothing arrives within the timeout.
+         *
+         * @return bool false on a timeout
+         */
+        template <typename Handler>
+        bool receive(Handler handler) {
+            uint8_t buffer[4096];
+            bool running = true;
+            while(running) {
+                struct pollfd input = {_fd, POLLIN, 0};
+                if(::poll(&input, 1, _timeoutMillis) <= 0) {
+                    return false;
+                }
+                ssize_t length = ::read(_fd, buffer, sizeof(buffer));
+                if(length <= 0) {
+                    return false;
+                }
+                _parser.feed(buffer, length, [&](const ExportFrame& frame) {
+                    if(running) {
+                        running = handler(frame);
+                    }
+                });
+            }
+            return true;
+        }
+
+    public:
+        uint32_t retries = 0;
+
+        Receiver(int fd, int timeoutMillis) : _fd(fd), _timeoutMillis(timeoutMillis) {}
+
+        /**
+         * @brief Sends PING until the node answers, a node in light sleep loses the characters that wake it up.
+         *
+         * @param attempts number of attempts
+         * @return bool true if the node answered
+         */
+        bool wake(int attempts) {
+            for(int i = 0; i < attempts; i++) {
+                send("PING");
+                if(receive([](const ExportFrame& frame) { return frame.type != EXPORT_ACK; })) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * @brief Switches node and host to a higher baud rate and checks it with PING, otherwise both stay at the
+         * old rate.
+         *
+         * @param from current baud rate
+         * @param to new baud rate
+         * @return bool true if the new rate is used
+         */
+        bool negotiate(uint32_t from, uint32_t to) {
+            char command[32];
+            snprintf(command, sizeof(command), "BAUD %u", to);
+            send(command);
+            if(!receive([](const ExportFrame& frame) { return frame.type != EXPORT_ACK; })) {
+                return false;
+            }
+            configure(_fd, to);
+            usleep(20000);
+            _parser.reset();
+            if(wake(3)) {
+                return true;
+            }
+            configure(_fd, from);
+            return false;
+        }
+
+        /**
+         * @brief Prints the files of the node.
+         *
+         * @return bool false on a timeout
+         */
+        bool list() {
+            send("LIST");
+            return receive([](const ExportFrame& frame) {
+                if(frame.type == EXPORT_ENTRY && frame.length >= 8) {
+                    printf("%10u  %.*s\n", ExportProtocol::get32(frame.payload), frame.length - 8, (const char*) frame.payload + 8);
+                }
+                return frame.type != EXPORT_END;
+            });
+        }
+
+        /**
+         * @brief Downloads a file or a time range of a csv log. The download starts at the size of the output file and
+         * resumes after lost frames.
+         *
+         * @param path path on the node
+         * @param output path of the output file
+         * @param from time of the first record, 0 for the whole file
+         * @param to time of the last record
+         * @param maxRetries attempts after lost frames
+         * @return int64_t number of bytes in the output file, -1 on an error
+         */
+        int64_t get(const char* path, const char* output, long long from, long long to, uint32_t maxRetries) {
+            FILE* out = fopen(output, "ab");
+            if(!out) {
+                perror(output);
+                return -1;
+            }
+            uint32_t received = ftell(out);
+            for(uint32_t attempt = 0; attempt <= maxRetries; attempt++) {
+                char command[EXPORT_COMMAND_SIZE];
+                snprintf(command, sizeof(command), "GET %s %u %lld %lld", path, received, from, to);
+                _parser.reset();
+                send(command);
+                uint32_t expected = 0;
+                uint32_t bytes = 0;
+                uint32_t crc = 0;
+                bool done = false;
+                bool failed = false;
+                bool lost = false;
+                receive([&](const ExportFrame& frame) {
+                    if(frame.sequence != expected) {
+                        lost = true;
+                    } else if(frame.type == EXPORT_DATA && frame.offset == received) {
+                        fwrite(frame.payload, 1, frame.length, out);
+                        crc = crc32(frame.payload, frame.length, crc);
+                        bytes += frame.length;
+                        received += frame.length;
+                    } else if(frame.type == EXPORT_END) {
+                        done = frame.length >= 8 && ExportProtocol::get32(frame.payload) == bytes
+                            && ExportProtocol::get32(frame.payload + 4) == crc;
+                        lost = !done;
+                        return false;
+                    } else if(frame.type == EXPORT_ERROR) {
+                        failed = frame.length != 9 || memcmp(frame.payload, "cancelled", 9) != 0;
+                        if(failed) {
+                            fprintf(stderr, "%s: %.*s\n", path, frame.length, (const char*) frame.payload);
+                        }
+                        return false;
+                    } else if(frame.type != EXPORT_BEGIN) {
+                        lost = true;
+                    }
+                    if(lost) {
+                        //cancel and wait for the rest of this attempt
+                        uint8_t cancel = EXPORT_CANCEL;
+                        if(::write(_fd, &cancel, 1) != 1) {
+                            perror("write");
+                        }
+                        expected = UINT32_MAX;
+                        return true;
+                    }
+                    expected++;
+                    return true;
+                });
+                fflush(out);
+                if(done || failed) {
+                    fclose(out);
+                    return failed ? -1 : (int64_t) received;
+                }
+                retries++;
+            }
+            fclose(out);
+            return -1;
+        }
+
+        /**
+         * @brief Returns the parser, for its counters.
+         *
+         * @return const ExportParser& parser
+         */
+        const ExportParser& parser() const {
+            return _parser;
+        }
+};
+
+/**
+ * @brief Reads a file of the fake SD card.
+ *
+ * @param path path on the fake SD card
+ * @return std::string content
+ */
+std::string content(const char* path) {
+    std::string data;
+    File file = hal::storage().open(path);
+    uint8_t buffer[512];
+    size_t length;
+    while((length = file.read(buffer, sizeof(buffer))) > 0) {
+        data.append((const char*) buffer, length);
+    }
+    file.close();
+    return data;
+}
+
+/**
+ * @brief Reads a file of the host.
+ *
+ * @param path path of the file
+ * @return std::string content
+ */
+std::string hostContent(const char* path) {
+    std::string data;
+    FILE* in = fopen(path, "rb");
+    if(!in) {
+        return data;
+    }
+    char buffer[4096];
+    size_t length;
+    while((length = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        data.append(buffer, length);
+    }
+    fclose(in);
+    return data;
+}
+
+/**
+ * @brief Runs the loopback test over a pseudo-terminal.
+ *
+ * @param megabytes size of the exported log
+ * @param corrupt corrupt every n-th byte in the second transfer
+ * @return int exit code
+ */
+int loopback(uint32_t megabytes, uint32_t corrupt) {
+    hal::native::quiet = true;
+    hal::storage().begin(5);
+    File file = hal::storage().open("/log_27_5_2022.csv", FILE_WRITE);
+    char header[CSV_LOG_HEADER_SIZE];
+    ClimateDataLogger::csvHeader(header);
+    file.print(header);
+    //sealed like the records of ClimateDataLogger, LogReader skips records without a valid CRC
+    time_t start = 1653609600;
+    uint32_t records = 0;
+    std::vector<size_t> ends;
+    while(file.size() < megabytes * 1048576) {
+        char line[ClimateLogSet::csvRecordSize + LOG_JOURNAL_TRAILER_SIZE];
+        time_t time = start + records;
+        struct tm timeInfo;
+        localtime_r(&time, &timeInfo);
+        const float values[ClimateLogSet::channels] = {
+            20 + records % 500 / 100.0f, 50 + records % 300 / 100.0f, 987 + records % 200 / 100.0f, 1013.52f, 223.0f
+        };
+        size_t length = LogJournal::seal(line, ClimateLogSet::csvRecord(line, timeInfo, values), records + 1);
+        file.write((const uint8_t*) line, length);
+        ends.push_back(file.size());
+        records++;
+    }
+    file.close();
+    std::string whole = content("/log_27_5_2022.csv");
+    time_t from = start + records / 3, to = start + records / 2;
+    std::string range;
+    uint32_t queried = LogReader::query("/log_27_5_2022.csv", from, to, [&](const char* line, size_t length) {
+        range.append(line, length);
+        return true;
+    });
+    //the records of the range are consecutive lines of the file, from and to included
+    size_t first = ends[from - start - 1], last = ends[to - start];
+    bool covered = !range.empty() && queried == (uint32_t) (to - from + 1) && range == whole.substr(first, last - first);
+    printf("time range of %u records in the fixture: %s\n", (unsigned) (to - from + 1), covered ? "ok" : "FAILED");
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("posix_openpt");
+        return 1;
+    }
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if(slave < 0 || !configure(master, 115200) || !configure(slave, 115200)) {
+        perror("pseudo-terminal");
+        return 1;
+    }
+
+    //node side: only this thread uses the fake SD card from now on
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> corruptEvery(0);
+    std::thread node([&]() {
+        FdPort port(slave, corruptEvery);
+        LogExport<FdPort> logExport(port, 115200);
+        while(!stop) {
+            if(!logExport.update(2000)) {
+                usleep(100);
+            }
+        }
+    });
+
+    Receiver receiver(master, 300);
+    bool valid = covered && receiver.wake(3) && receiver.negotiate(115200, 921600);
+    printf("PING and BAUD 921600: %s\n", valid ? "ok" : "FAILED");
+
+    const char* output = "/tmp/receive_export_loopback.csv";
+    remove(output);
+    auto begin = std::chrono::steady_clock::now();
+    int64_t bytes = receiver.get("/log_27_5_2022.csv", output, 0, 0, 0);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    bool same = bytes == (int64_t) whole.size() && hostContent(output) == whole;
+    valid = valid && same;
+    printf("whole file: %zu bytes in %.3f s, %.1f MB/s, %s\n", whole.size(), seconds, whole.size() / seconds / 1e6,
+        same ? "identical" : "DIFFERENT");
+
+    remove(output);
+    corruptEvery = corrupt;
+    usleep(10000);
+    bytes = receiver.get("/log_27_5_2022.csv", output, 0, 0, 100000);
+    corruptEvery = 0;
+    same = bytes == (int64_t) whole.size() && hostContent(output) == whole;
+    valid = valid && same;
+    printf("one byte in %u corrupted: %u retries, %u corrupted frames, %s\n", corrupt, receiver.retries,
+        receiver.parser().corrupted(), same ? "identical" : "DIFFERENT");
+
+    remove(output);
+    usleep(10000);
+    bytes = receiver.get("/log_27_5_2022.csv", output, from, to, 3);
+    same = !range.empty() && bytes == (int64_t) range.size() && hostContent(output) == range;
+    valid = valid && same;
+    printf("time range: %zu of %zu bytes, %s\n", range.size(), whole.size(), same ? "identical" : "DIFFERENT");
+    remove(output);
+
+    stop = true;
+    node.join();
+    close(slave);
+    close(master);
+
+    //a month of logs: one record every 10 s
+    double month = 30 * 8640.0 * whole.size() / records;
+    size_t frames = (month + EXPORT_CHUNK_SIZE - 1) / EXPORT_CHUNK_SIZE;
+    double framed = month + frames * (EXPORT_HEADER_SIZE + EXPORT_TRAILER_SIZE);
+    printf("\na month of logs (%.1f MB), 10 bits per byte:\n", month / 1e6);
+    printf("%-36s %10.1f min\n", "printFile() at 115200 baud", month * 10 / 115200 / 60);
+    const uint32_t rates[] = {115200, 921600, 2000000};
+    for(uint32_t rate : rates) {
+        char name[40];
+        snprintf(name, sizeof(name), "framed at %u baud", rate);
+        printf("%-36s %10.1f min\n", name, framed * 10 / rate / 60);
+    }
+    printf("framing overhead: %.2f %%\n", (framed / month - 1) * 100);
+    printf("\nloopback: %s\n", valid ? "ok" : "FAILED");
+    return valid ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    const char* usage = "Usage: %s --port DEVICE [--baud RATE] [--fast RATE] list\n"
+        "       %s --port DEVICE [--baud RATE] [--fast RATE] get PATH OUTPUT [FROM TO]\n"
+        "       %s --loopback [--megabytes N] [--corrupt N]\n";
+    const char* port = nullptr;
+    uint32_t baud = 115200, fast = 0, megabytes = 4, corrupt = 100000;
+    bool loop = false;
+    std::vector<const char*> arguments;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = argv[++i];
+        } else if(strcmp(argv[i], "--baud") == 0 && i + 1 < argc) {
+            baud = strtoul(argv[++i], nullptr, 10);
+        } else if(strcmp(argv[i], "--fast") == 0 && i + 1 < argc) {
+            fast = strtoul(argv[++i], nullptr, 10);
+        } else if(strcmp(argv[i], "--loopback") == 0) {
+            loop = true;
+        } else if(strcmp(argv[i], "--megabytes") == 0 && i + 1 < argc) {
+            megabytes = strtoul(argv[++i], nullptr, 10);
+        } else if(strcmp(argv[i], "--corrupt") == 0 && i + 1 < argc) {
+            corrupt = strtoul(argv[++i], nullptr, 10);
+        } else {
+            arguments.push_back(argv[i]);
+        }
+    }
+    if(loop) {
+        return loopback(megabytes, corrupt);
+    }
+    bool listing = arguments.size() == 1 && strcmp(arguments[0], "list") == 0;
+    bool getting = (arguments.size() == 3 || arguments.size() == 5) && strcmp(arguments[0], "get") == 0;
+    if(!port || (!listing && !getting)) {
+        fprintf(stderr, usage, argv[0], argv[0], argv[0]);
+        return 2;
+    }
+    int fd = open(port, O_RDWR | O_NOCTTY);
+    if(fd < 0 || !configure(fd, baud)) {
+        perror(port);
+        return 1;
+    }
+    Receiver receiver(fd, 1000);
+    //in light sleep the node wakes up every measurement interval at the latest
+    if(!receiver.wake(60)) {
+        fprintf(stderr, "no answer from the node\n");
+        return 1;
+    }
+    if(fast && !receiver.negotiate(baud, fast)) {
+        fprintf(stderr, "%u baud failed, staying at %u\n", fast, baud);
+    }
+    int result = 0;
+    if(listing) {
+        result = receiver.list() ? 0 : 1;
+    } else {
+        long long from = arguments.size() == 5 ? atoll(arguments[3]) : 0;
+        long long to = arguments.size() == 5 ? atoll(arguments[4]) : 0;
+        auto begin = std::chrono::steady_clock::now();
+        int64_t bytes = receiver.get(arguments[1], arguments[2], from, to, 20);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        if(bytes < 0) {
+            result = 1;
+        } else {
+            fprintf(stderr, "%lld bytes in %.1f s (%.1f kB/s), %u retries\n", (long long) bytes, seconds,
+                bytes / seconds / 1e3, receiver.retries);
+        }
+    }
+    close(fd);
+    return result;
+}
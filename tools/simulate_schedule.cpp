@@ -0,0 +1,129 @@
+/**
+ * @file simulate_schedule.cpp
+ * @brief Host tool replaying a recorded csv log (log_d_m_y.csv) through AdaptiveSchedule. The recorded rows are the
+ * fixed-rate baseline; the tool takes the samples the adaptive schedule would have taken, reconstructs the baseline
+ * by linear interpolation between them and reports the number of samples and the worst reconstruction error.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=c++11 -O2 -Iinclude tools/simulate_schedule.cpp -o simulate_schedule
+ * Usage: simulate_schedule [--min S] [--max S] [--tolerance T H P] log_27_5_2022.csv
+ */
+
+#include <AdaptiveSchedule.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+/**
+ * @brief One row of the csv log.
+ *
+ */
+struct Row {
+    time_t time;
+    float values[3];
+};
+
+/**
+ * @brief Reads the rows of a csv log in the format of ClimateDataLogger::log(), with ISO 8601 timestamps or the
+ * "d.m.y h:m:s" timestamps of older logs. The header and malformed lines are skipped.
+ *
+ * @param in input file
+ * @param rows rows in the order of the file
+ */
+void readLog(FILE* in, std::vector<Row>& rows) {
+    char line[256];
+    while(fgets(line, sizeof(line), in)) {
+        struct tm timeInfo;
+        memset(&timeInfo, 0, sizeof(timeInfo));
+        Row row;
+        if(sscanf(line, "%d-%d-%dT%d:%d:%d,%f,%f,%f", &timeInfo.tm_year, &timeInfo.tm_mon, &timeInfo.tm_mday,
+            &timeInfo.tm_hour, &timeInfo.tm_min, &timeInfo.tm_sec, &row.values[0], &row.values[1], &row.values[2]) != 9
+            && sscanf(line, "%d.%d.%d %d:%d:%d,%f,%f,%f", &timeInfo.tm_mday, &timeInfo.tm_mon, &timeInfo.tm_year,
+            &timeInfo.tm_hour, &timeInfo.tm_min, &timeInfo.tm_sec, &row.values[0], &row.values[1], &row.values[2]) != 9) {
+                continue;
+        }
+        timeInfo.tm_mon -= 1;
+        timeInfo.tm_year -= 1900;
+        row.time = timegm(&timeInfo);
+        rows.push_back(row);
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t minSeconds = 10;
+    uint32_t maxSeconds = 600;
+    ScheduleTolerance tolerance;
+    const char* path = nullptr;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--min") == 0 && i + 1 < argc) {
+            minSeconds = strtoul(argv[++i], nullptr, 10);
+        } else if(strcmp(argv[i], "--max") == 0 && i + 1 < argc) {
+            maxSeconds = strtoul(argv[++i], nullptr, 10);
+        } else if(strcmp(argv[i], "--tolerance") == 0 && i + 3 < argc) {
+            tolerance.temperature = atof(argv[++i]);
+            tolerance.humidity = atof(argv[++i]);
+            tolerance.pressure = atof(argv[++i]);
+        } else if(!path && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            path = nullptr;
+            break;
+        }
+    }
+    if(!path) {
+        fprintf(stderr, "Usage: %s [--min S] [--max S] [--tolerance T H P] <log.csv>\n", argv[0]);
+        return 2;
+    }
+    FILE* in = fopen(path, "r");
+    if(!in) {
+        perror(path);
+        return 1;
+    }
+    std::vector<Row> rows;
+    readLog(in, rows);
+    fclose(in);
+    if(rows.empty()) {
+        fprintf(stderr, "%s: no records\n", path);
+        return 1;
+    }
+
+    ScheduleState state = {};
+    AdaptiveSchedule schedule(state, minSeconds, maxSeconds, tolerance);
+    std::vector<size_t> taken;
+    time_t due = rows[0].time;
+    for(size_t i = 0; i < rows.size(); i++) {
+        if(rows[i].time >= due) {
+            taken.push_back(i);
+            due = rows[i].time + schedule.next(rows[i].values[0], rows[i].values[1], rows[i].values[2]);
+        }
+    }
+
+    float worst[3] = {0, 0, 0};
+    size_t sample = 0;
+    for(size_t i = 0; i < rows.size(); i++) {
+        while(sample + 1 < taken.size() && taken[sample + 1] <= i) {
+            sample++;
+        }
+        const Row& before = rows[taken[sample]];
+        const Row& after = rows[sample + 1 < taken.size() ? taken[sample + 1] : taken[sample]];
+        double span = after.time - before.time;
+        double weight = span > 0 ? (rows[i].time - before.time) / span : 0;
+        for(int channel = 0; channel < 3; channel++) {
+            float estimate = before.values[channel] + weight * (after.values[channel] - before.values[channel]);
+            float error = fabs(estimate - rows[i].values[channel]);
+            if(error > worst[channel]) {
+                worst[channel] = error;
+            }
+        }
+    }
+
+    printf("fixed rate samples: %zu\n", rows.size());
+    printf("adaptive samples: %zu (%.1f %%)\n", taken.size(), 100.0 * taken.size() / rows.size());
+    printf("worst error: temperature %.2f °C, humidity %.2f %%, pressure %.2f hPa\n", worst[0], worst[1], worst[2]);
+    return 0;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file simulate_timesync.cpp
+ * @brief Host tool simulating TimeSync (TimeSync.h) over days of deep sleep cycles on the virtual clock of the native
+ * environment, with a drifting RTC and the simulated access point and time server of hal::TimeNetwork. It compares
+ * the error of the RTC with and without the learned drift correction, and replays an outage of the access point to
+ * show the backoff of the attempts and the time the radio was on. Exits with 1 if an attempt kept the radio on longer
+ * than the timeouts or the correction does not reduce the error.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=gnu++17 -O2 -Iinclude tools/simulate_timesync.cpp -o simulate_timesync
+ * Usage: simulate_timesync [--days N] [--interval S] [--drift PPM] [--resync H] [--outage H]
+ */
+
+#include <HAL.h>
+#include <TimeSync.h>
+#include <vector>
+
+/**
+ * @brief Options of the simulation.
+ *
+ */
+struct Simulation {
+    uint32_t days = 14;
+    uint32_t interval = 600;
+    double drift = 80e-6;
+    uint32_t resyncHours = 24;
+    uint32_t outageHours = 30;
+};
+
+/**
+ * @brief Result of one run. Errors of the RTC are taken after TimeSync::update() on every wakeup once the RTC was
+ * synced, settled ones after the second sync.
+ *
+ */
+struct Result {
+    uint32_t attempts = 0;
+    uint32_t syncs = 0;
+    uint64_t radioMicros = 0;
+    uint32_t maxRadioMillis = 0;
+    double maxError = 0;
+    double maxSettledError = 0;
+    std::vector<double> attemptHours;
+};
+
+/**
+ * @brief Runs the deep sleep cycles.
+ *
+ * @param simulation options
+ * @param correct true to correct the drift between the syncs
+ * @param outage true if the access point is missing for the first outageHours
+ * @return Result counters and errors
+ */
+Result run(const Simulation& simulation, bool correct, bool outage) {
+    hal::native::clock = hal::native::Clock();
+    hal::native::clock.rtcDrift = simulation.drift;
+    hal::native::network = hal::native::Network();
+    TimeSyncState state = {};
+    TimeSyncPolicy policy;
+    policy.resyncSeconds = simulation.resyncHours * 3600;
+    Result result;
+    uint64_t end = (uint64_t) simulation.days * 86400 * 1000000;
+    while(hal::native::clock.total < end) {
+        try {
+            hal::native::network.accessPoint = !outage || hal::native::clock.total >= (uint64_t) simulation.outageHours * 3600 * 1000000;
+            hal::TimeNetwork network;
+            TimeSync<> timeSync(state, network, "SSID", "PASSWORD");
+            timeSync.setPolicy(policy);
+            uint32_t attempts = state.attempts;
+            double hours = hal::native::clock.total / 3.6e9;
+            if(correct) {
+                timeSync.update();
+            } else if(timeSync.due()) {
+                timeSync.run();
+            }
+            if(state.attempts != attempts) {
+                result.attemptHours.push_back(hours);
+                result.maxRadioMillis = state.lastRadioMillis > result.maxRadioMillis ? state.lastRadioMillis : result.maxRadioMillis;
+            }
+            if(timeSync.synced()) {
+                double error = fabs((double) (hal::epochMicros() - hal::native::trueEpochMicros())) / 1000;
+                result.maxError = error > result.maxError ? error : result.maxError;
+                if(state.syncs >= 2) {
+                    result.maxSettledError = error > result.maxSettledError ? error : result.maxSettledError;
+                }
+            }
+            hal::native::advance(80000);
+            hal::deepSleep((uint64_t) simulation.interval * 1000000);
+        } catch(const hal::Reboot&) {
+        }
+    }
+    result.attempts = state.attempts;
+    result.syncs = state.syncs;
+    result.radioMicros = state.radioMicros;
+    return result;
+}
+
+/**
+ * @brief Prints one run.
+ *
+ * @param name name of the run
+ * @param result result of run()
+ */
+void report(const char* name, const Result& result) {
+    printf("%-24s %8u %6u %10.1f %10u %12.3f %12.3f\n", name, result.attempts, result.syncs, result.radioMicros / 1e6,
+        result.maxRadioMillis, result.maxError, result.maxSettledError);
+}
+
+int main(int argc, char** argv) {
+    Simulation simulation;
+    for(int i = 1; i < argc; i++) {
+        if(i + 1 >= argc) {
+            fprintf(stderr, "Usage: %s [--days N] [--interval S] [--drift PPM] [--resync H] [--outage H]\n", argv[0]);
+            return 2;
+        }
+        if(strcmp(argv[i], "--days") == 0) {
+            simulation.days = strtoul(argv[++i], nullptr, 10);
+        } else if(strcmp(argv[i], "--interval") == 0) {
+            simulation.interval = strtoul(argv[++i], nullptr, 10);
+        } else if(strcmp(argv[i], "--drift") == 0) {
+            simulation.drift = atof(argv[++i]) / 1e6;
+        } else if(strcmp(argv[i], "--resync") == 0) {
+            simulation.resyncHours = strtoul(argv[++i], nullptr, 10);
+        } else if(strcmp(argv[i], "--outage") == 0) {
+            simulation.outageHours = strtoul(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr, "Usage: %s [--days N] [--interval S] [--drift PPM] [--resync H] [--outage H]\n", argv[0]);
+            return 2;
+        }
+    }
+    hal::native::quiet = true;
+    printf("%u days, wakeup every %u s, RTC drift %.0f ppm, resync every %u h, outage of %u h\n", simulation.days,
+        simulation.interval, simulation.drift * 1e6, simulation.resyncHours, simulation.outageHours);
+    printf("%-24s %8s %6s %10s %10s %12s %12s\n", "run", "attempts", "syncs", "radio [s]", "max [ms]", "error [ms]",
+        "settled [ms]");
+    Result uncorrected = run(simulation, false, false);
+    Result corrected = run(simulation, true, false);
+    Result outage = run(simulation, true, true);
+    report("resync only", uncorrected);
+    report("resync + drift", corrected);
+    report("resync + drift, outage", outage);
+
+    printf("\nattempts during the outage at hour:");
+    for(double hours : outage.attemptHours) {
+        if(hours > simulation.outageHours + 1) {
+            break;
+        }
+        printf(" %.2f", hours);
+    }
+    printf("\n");
+
+    TimeSyncPolicy policy;
+    uint32_t budget = policy.connectTimeoutMillis + policy.sntpTimeoutMillis;
+    bool bounded = uncorrected.maxRadioMillis <= budget && corrected.maxRadioMillis <= budget && outage.maxRadioMillis <= budget;
+    bool reduced = simulation.drift == 0 || corrected.maxSettledError < uncorrected.maxSettledError;
+    printf("radio on per attempt within %u ms: %s, drift correction reduces the error: %s\n", budget,
+        bounded ? "ok" : "EXCEEDED", reduced ? "ok" : "NO");
+    return bounded && reduced ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+/**
+ * @file simulate_wake.cpp
+ * @brief Host tool simulating thousands of deep sleep cycles of AlignedSleep on the virtual clock of the native
+ * environment, with a drifting RTC slow clock, an additional error of the sleep timer, boot latency and varying awake
+ * time. Like main.cpp every wakeup runs TimeSync, which syncs the RTC every hour and corrects it by the learned drift
+ * in between, and passes the drift on to AlignedSleep. It reports the distribution of the deviation of each wakeup
+ * from its boundary in true time once the drift is known and compares it with sleeping a fixed time after the work.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=gnu++17 -O2 -Iinclude tools/simulate_wake.cpp -o simulate_wake
+ * Usage: simulate_wake [--cycles N] [--interval S] [--drift PPM] [--rtc-drift PPM] [--boot US] [--awake US] [--jitter US]
+ */
+
+#include <HAL.h>
+#include <DeepSleep.h>
+#include <TimeSync.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+/**
+ * @brief Options of the simulation.
+ *
+ */
+struct Simulation {
+    uint32_t cycles = 5000;
+    uint32_t interval = 10;
+    double drift = 0.01;
+    double rtcDrift = 80e-6;
+    uint32_t boot = 150000;
+    uint32_t awake = 70000;
+    uint32_t jitter = 30000;
+};
+
+/**
+ * @brief Runs the cycles and collects the deviation of every wakeup from the closest boundary in microseconds, from
+ * the wakeup after the first drift estimate of TimeSync on.
+ *
+ * @param simulation options
+ * @param aligned true for AlignedSleep, false for a fixed sleep after the work
+ * @return std::vector<int64_t> deviations
+ */
+std::vector<int64_t> run(const Simulation& simulation, bool aligned) {
+    hal::native::clock = hal::native::Clock();
+    hal::native::clock.sleepDrift = simulation.drift;
+    hal::native::clock.rtcDrift = simulation.rtcDrift;
+    hal::native::clock.bootMicros = simulation.boot;
+    hal::native::network = hal::native::Network();
+    std::mt19937 random(1);
+    std::uniform_int_distribution<uint32_t> jitter(0, simulation.jitter);
+    AlignedSleepState state = {};
+    AlignedSleep alignedSleep(state);
+    TimeSyncState timeSyncState = {};
+    TimeSyncPolicy policy;
+    policy.resyncSeconds = 3600;
+    int64_t interval = simulation.interval * SECONDS;
+    std::vector<int64_t> deviations;
+    for(uint32_t cycle = 0; cycle <= simulation.cycles; cycle++) {
+        try {
+            if(cycle > 0 && timeSyncState.drift != 0) {
+                int64_t now = hal::native::trueEpochMicros();
+                int64_t deviation = (now % interval + interval) % interval;
+                deviations.push_back(deviation > interval / 2 ? deviation - interval : deviation);
+            }
+            alignedSleep.wake();
+            hal::TimeNetwork network;
+            TimeSync<> timeSync(timeSyncState, network, "SSID", "PASSWORD");
+            timeSync.setPolicy(policy);
+            timeSync.update();
+            alignedSleep.setClockDrift(timeSync.drift());
+            hal::native::advance(simulation.awake + jitter(random));
+            if(aligned) {
+                alignedSleep.sleep(simulation.interval);
+            }
+            deepSleepForSeconds(simulation.interval);
+        } catch(const hal::Reboot&) {
+        }
+    }
+    return deviations;
+}
+
+/**
+ * @brief Prints percentiles of the deviations, skipping the first cycles in which the estimates settle.
+ *
+ * @param name name of the schedule
+ * @param deviations deviations in microseconds
+ * @param settle number of skipped cycles
+ */
+void report(const char* name, std::vector<int64_t> deviations, size_t settle) {
+    deviations.erase(deviations.begin(), deviations.begin() + std::min(settle, deviations.size()));
+    if(deviations.empty()) {
+        return;
+    }
+    std::sort(deviations.begin(), deviations.end());
+    auto percentile = [&](double p) {
+        return deviations[(size_t) (p / 100 * (deviations.size() - 1))] / 1000.0;
+    };
+    printf("%-8s min %9.3f  p1 %9.3f  p50 %9.3f  p99 %9.3f  max %9.3f ms\n",
+        name, percentile(0), percentile(1), percentile(50), percentile(99), percentile(100));
+}
+
+int main(int argc, char** argv) {
+    Simulation simulation;
+    for(int i = 1; i < argc; i++) {
+        if(i + 1 >= argc) {
+            fprintf(stderr, "Usage: %s [--cycles N] [--interval S] [--drift PPM] [--rtc-drift PPM] [--boot US] [--awake US] [--jitter US]\n", argv[0]);
+            return 2;
+        }
+        if(strcmp(argv[i], "--cycles") == 0) {
+            simulation.cycles = strtoul(argv[++i], nullptr, 10);
+        } else if(strcmp(argv[i], "--interval") == 0) {
+            simulation.interval = strtoul(argv[++i], nullptr, 10);
+        } else if(strcmp(argv[i], "--drift") == 0) {
+            simulation.drift = atof(argv[++i]) / 1e6;
+        } else if(strcmp(argv[i], "--rtc-drift") == 0) {
+            simulation.rtcDrift = atof(argv[++i]) / 1e6;
+        } else if(strcmp(argv[i], "--boot") == 0) {
+            simulation.boot = strtoul(argv[++i], nullptr, 10);
+        } else if(strcmp(argv[i], "--awake") == 0) {
+            simulation.awake = strtoul(argv[++i], nullptr, 10);
+        } else if(strcmp(argv[i], "--jitter") == 0) {
+            simulation.jitter = strtoul(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr, "Usage: %s [--cycles N] [--interval S] [--drift PPM] [--rtc-drift PPM] [--boot US] [--awake US] [--jitter US]\n", argv[0]);
+            return 2;
+        }
+    }
+    hal::native::quiet = true;
+    printf("%u cycles of %u s, timer drift %.0f ppm, RTC drift %.0f ppm, boot %u us, awake %u + 0..%u us\n",
+        simulation.cycles, simulation.interval, simulation.drift * 1e6, simulation.rtcDrift * 1e6, simulation.boot,
+        simulation.awake, simulation.jitter);
+    printf("deviation of the wakeups from the wall clock boundaries:\n");
+    report("fixed", run(simulation, false), 0);
+    report("aligned", run(simulation, true), 20);
+    return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file stress_ring.cpp
+ * @brief Host stress test of SPSCRing with a producer and a consumer thread. Every element carries a sequence number
+ * and a checksum; the consumer checks that the elements arrive complete and in order. In lossless runs the producer
+ * retries until an element fits and every element has to arrive, in lossy runs every missing element has to be
+ * counted as overflow. Exits with 1 if a run fails.
+ * @version 1.0
+ * @date 2022-05-27
+ *
+ * @copyright Copyright (c) 2022
+ *
+ * Build: g++ -std=c++11 -O2 -pthread -Iinclude tools/stress_ring.cpp -o stress_ring
+ * Usage: stress_ring [elements]
+ */
+
+#include <SPSCRing.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+/**
+ * @brief Element of the size of a ClimateSample.
+ *
+ */
+struct Element {
+    uint32_t sequence;
+    uint32_t values[4];
+    uint32_t checksum;
+};
+
+/**
+ * @brief Runs one producer and one consumer thread over a ring.
+ *
+ * @param name name of the run
+ * @param elements number of elements to push
+ * @param lossless true to retry full pushes instead of dropping the element
+ * @param producerPause spin iterations between two pushes
+ * @param consumerPause spin iterations between two pops
+ * @return bool true if no violation was found
+ */
+bool run(const char* name, uint32_t elements, bool lossless, uint32_t producerPause, uint32_t consumerPause) {
+    SPSCRing<Element, 64> ring;
+    std::atomic<bool> done{false};
+    uint32_t pushed = 0;
+
+    std::thread producer([&]() {
+        for(uint32_t sequence = 0; sequence < elements; sequence++) {
+            Element element;
+            element.sequence = sequence;
+            element.checksum = sequence;
+            for(uint32_t i = 0; i < 4; i++) {
+                element.values[i] = sequence * 2654435761u + i;
+                element.checksum ^= element.values[i];
+            }
+            while(!ring.push(element) && lossless) {
+                std::this_thread::yield();
+            }
+            pushed = lossless ? pushed + 1 : sequence + 1 - ring.overflows();
+            for(volatile uint32_t spin = 0; spin < producerPause; spin++) {
+            }
+        }
+        done.store(true);
+    });
+
+    uint32_t received = 0;
+    uint32_t next = 0;
+    bool valid = true;
+    Element element;
+    while(valid) {
+        if(!ring.pop(element)) {
+            if(done.load() && ring.size() == 0) {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        uint32_t checksum = element.sequence;
+        for(uint32_t i = 0; i < 4; i++) {
+            checksum ^= element.values[i];
+        }
+        if(checksum != element.checksum || element.sequence < next) {
+            fprintf(stderr, "%s: corrupt or reordered element %u after %u\n", name, element.sequence, next);
+            valid = false;
+        }
+        next = element.sequence + 1;
+        received++;
+        for(volatile uint32_t spin = 0; spin < consumerPause; spin++) {
+        }
+    }
+    producer.join();
+
+    if(valid && (received != pushed || (lossless ? received != elements : pushed + ring.overflows() != elements))) {
+        fprintf(stderr, "%s: pushed %u, received %u, overflows %u of %u\n", name, pushed, received, ring.overflows(), elements);
+        valid = false;
+    }
+    printf("%-24s %9u elements  %9u received  %9u %s  %s\n", name, elements, received, ring.overflows(),
+        lossless ? "full pushes" : "overflows  ", valid ? "ok" : "FAILED");
+    return valid;
+}
+
+int main(int argc, char** argv) {
+    uint32_t elements = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10000000;
+    bool valid = run("lossless", elements, true, 0, 0);
+    valid = run("lossless slow consumer", elements / 10, true, 0, 200) && valid;
+    valid = run("lossy", elements, false, 0, 0) && valid;
+    valid = run("lossy slow consumer", elements / 10, false, 0, 200) && valid;
+    valid = run("lossy slow producer", elements / 10, false, 200, 0) && valid;
+    return valid ? 0 : 1;
+}